@@ -76,4 +76,37 @@ SELECT create_hypertable('command_logs', 'time', if_not_exists => TRUE);
 -- Indexes
 CREATE INDEX IF NOT EXISTS idx_command_logs_device_id ON command_logs(device_id);
 CREATE INDEX IF NOT EXISTS idx_command_logs_time ON command_logs(time DESC);
-CREATE INDEX IF NOT EXISTS idx_command_logs_command_type ON command_logs(command_type);
\ No newline at end of file
+CREATE INDEX IF NOT EXISTS idx_command_logs_command_type ON command_logs(command_type);
+
+-- ============================================
+-- Power Aggregates Table (on-device window statistics)
+-- ============================================
+-- One row per channel per closed window (1 s / 10 s / 60 s) from esp32/telemetry/aggregate
+CREATE TABLE IF NOT EXISTS power_aggregates (
+    time TIMESTAMPTZ NOT NULL,
+    device_id VARCHAR(50) NOT NULL,
+    window_ms INTEGER NOT NULL,
+    channel SMALLINT NOT NULL,
+    samples INTEGER,
+    voltage_min NUMERIC(10, 3),
+    voltage_max NUMERIC(10, 3),
+    voltage_mean NUMERIC(10, 3),
+    voltage_rms NUMERIC(10, 3),
+    voltage_stddev NUMERIC(10, 3),
+    current_min NUMERIC(10, 3),
+    current_max NUMERIC(10, 3),
+    current_mean NUMERIC(10, 3),
+    current_rms NUMERIC(10, 3),
+    current_stddev NUMERIC(10, 3),
+    power_min NUMERIC(12, 3),
+    power_max NUMERIC(12, 3),
+    power_mean NUMERIC(12, 3),
+    power_rms NUMERIC(12, 3),
+    power_stddev NUMERIC(12, 3)
+);
+
+-- Create hypertable
+SELECT create_hypertable('power_aggregates', 'time', if_not_exists => TRUE);
+
+-- Indexes
+CREATE INDEX IF NOT EXISTS idx_power_aggregates_device_window ON power_aggregates(device_id, window_ms, time DESC);
@@ -0,0 +1,153 @@
+// Packs a firmware .bin into the OTA image stream the device decodes (include/ota_image.h):
+//   header: "PCOT" | u8 version | u8 flags | u16 reserved | u32 image size
+//           | 32 B SHA-256 of the image a delta was built against (espImageDigest)
+//           | 32 B SHA-256 of the new image
+//           | 64 B ECDSA P-256 signature (r | s) of that SHA-256
+//   full:   the firmware bytes
+//   delta:  0x01 COPY u32 offset u32 length (bytes of the running image)
+//           0x02 DATA u32 length + bytes    (new bytes)
+// The whole stream is zlib-compressed; the device inflates it while downloading.
+//
+// Usage: node ota-image.js <new firmware.bin> <out.pcot> [running firmware.bin] [--key <private key.pem>]
+//        node ota-image.js --keygen [private key.pem]
+// With a running image, a delta is written if it comes out smaller than the full image.
+// The base must be exactly the .bin the device runs: its image digest is checked before flashing.
+// Every image is signed; the device refuses anything its compiled-in public key
+// (ota_signing_key in src/config.cpp) does not verify. --keygen writes a new
+// private key and prints the public half as that array.
+import { readFileSync, writeFileSync } from 'fs';
+import { KeyObject, createHash, createPrivateKey, createPublicKey, generateKeyPairSync, sign } from 'crypto';
+import { deflateSync } from 'zlib';
+
+export const OTA_IMAGE_MAGIC = 0x544f4350; // "PCOT"
+export const OTA_IMAGE_VERSION = 2;
+export const OTA_IMAGE_DELTA = 0x01;
+const HEADER_SIZE = 140;
+const DEFAULT_KEY_PATH = 'ota-signing-key.pem';
+const ESP_IMAGE_MAGIC = 0xe9;
+const OP_COPY = 0x01;
+const OP_DATA = 0x02;
+const BLOCK = 32; // Shortest COPY worth its 9-byte op
+
+function header(flags, target, signingKey, baseSha256) {
+    const out = Buffer.alloc(HEADER_SIZE);
+    out.writeUInt32LE(OTA_IMAGE_MAGIC, 0);
+    out.writeUInt8(OTA_IMAGE_VERSION, 4);
+    out.writeUInt8(flags, 5);
+    out.writeUInt32LE(target.length, 8);
+    if (baseSha256) baseSha256.copy(out, 12);
+    createHash('sha256').update(target).digest().copy(out, 44);
+    // ECDSA over SHA-256 of the image, r | s as the device reads them
+    sign('sha256', target, { key: signingKey, dsaEncoding: 'ieee-p1363' }).copy(out, 76);
+    return out;
+}
+
+// What esp_partition_get_sha256() returns for the running app: SHA-256 of the ESP
+// image up to and including its checksum block. The digest esptool appends after
+// it is not part of what the device hashes (it is that hash), nor is any padding.
+export function espImageDigest(bin) {
+    if (bin.length < 24 || bin[0] !== ESP_IMAGE_MAGIC) throw new Error('not an ESP32 app image');
+    let pos = 24; // Image header + extended header
+    for (let segment = 0; segment < bin[1]; segment++) {
+        if (pos + 8 > bin.length) throw new Error('ESP image truncated');
+        pos += 8 + bin.readUInt32LE(pos + 4);
+    }
+    const end = (pos + 16) & ~15; // The checksum byte ends a 16-byte block
+    if (end > bin.length) throw new Error('ESP image truncated');
+    const digest = createHash('sha256').update(bin.subarray(0, end)).digest();
+    if (bin[23] === 1) { // hash_appended
+        const appended = bin.subarray(end, end + 32);
+        if (appended.length !== 32 || !digest.equals(appended)) throw new Error('ESP image digest does not match its contents');
+    }
+    return digest;
+}
+
+// Greedy: every BLOCK-aligned block of the base is indexed by its contents; a match
+// is extended forward as far as it goes, anything unmatched becomes DATA
+function deltaOps(base, target) {
+    const index = new Map();
+    for (let offset = 0; offset + BLOCK <= base.length; offset += BLOCK) {
+        const key = base.toString('latin1', offset, offset + BLOCK);
+        if (!index.has(key)) index.set(key, offset);
+    }
+
+    const parts = [];
+    let literalStart = 0;
+    const flushLiteral = (end) => {
+        if (end <= literalStart) return;
+        const op = Buffer.alloc(5);
+        op.writeUInt8(OP_DATA, 0);
+        op.writeUInt32LE(end - literalStart, 1);
+        parts.push(op, target.subarray(literalStart, end));
+    };
+
+    let pos = 0;
+    while (pos + BLOCK <= target.length) {
+        // Same offset first: most of an unchanged build has not moved
+        let from = pos + BLOCK <= base.length && base.compare(target, pos, pos + BLOCK, pos, pos + BLOCK) === 0 ? pos : undefined;
+        if (from === undefined) from = index.get(target.toString('latin1', pos, pos + BLOCK));
+        if (from === undefined) {
+            pos++;
+            continue;
+        }
+        let length = BLOCK;
+        while (pos + length < target.length && from + length < base.length && target[pos + length] === base[from + length]) length++;
+
+        flushLiteral(pos);
+        const op = Buffer.alloc(9);
+        op.writeUInt8(OP_COPY, 0);
+        op.writeUInt32LE(from, 1);
+        op.writeUInt32LE(length, 5);
+        parts.push(op);
+        pos += length;
+        literalStart = pos;
+    }
+    flushLiteral(target.length);
+    return Buffer.concat(parts);
+}
+
+export function packOtaImage(target, base, signingKey) {
+    const key = signingKey instanceof KeyObject ? signingKey : createPrivateKey(signingKey); // Or PEM
+    if (key.asymmetricKeyDetails?.namedCurve !== 'prime256v1') throw new Error('signing key must be an EC P-256 key');
+    const full = Buffer.concat([header(0, target, key), target]);
+    if (!base) return { image: deflateSync(full, { level: 9 }), delta: false };
+
+    const baseSha256 = espImageDigest(base);
+    const delta = Buffer.concat([header(OTA_IMAGE_DELTA, target, key, baseSha256), deltaOps(base, target)]);
+    return delta.length < full.length
+        ? { image: deflateSync(delta, { level: 9 }), delta: true }
+        : { image: deflateSync(full, { level: 9 }), delta: false };
+}
+
+// The public key as the C array for ota_signing_key
+export function publicKeyArray(signingKey) {
+    const point = createPublicKey(signingKey).export({ format: 'jwk' });
+    const bytes = Buffer.concat([Buffer.from([0x04]), Buffer.from(point.x, 'base64url'), Buffer.from(point.y, 'base64url')]);
+    const rows = [];
+    for (let i = 0; i < bytes.length; i += 13) rows.push('  ' + [...bytes.subarray(i, i + 13)].map((b) => `0x${b.toString(16).padStart(2, '0')}`).join(', '));
+    return `const uint8_t ota_signing_key[OTA_SIGNING_KEY_SIZE] = {\n${rows.join(',\n')}\n};`;
+}
+
+if (process.argv[1] && process.argv[1].endsWith('ota-image.js')) {
+    const args = process.argv.slice(2);
+    if (args[0] === '--keygen') {
+        const keyPath = args[1] || DEFAULT_KEY_PATH;
+        const { privateKey } = generateKeyPairSync('ec', { namedCurve: 'prime256v1' });
+        writeFileSync(keyPath, privateKey.export({ type: 'pkcs8', format: 'pem' }), { mode: 0o600, flag: 'wx' });
+        console.log(`✓ ${keyPath} written; keep it out of the repo. Put this in src/config.cpp:\n`);
+        console.log(publicKeyArray(privateKey));
+        process.exit(0);
+    }
+    const keyAt = args.indexOf('--key');
+    const keyPath = keyAt >= 0 ? args.splice(keyAt, 2)[1] : DEFAULT_KEY_PATH;
+    const [targetPath, outPath, basePath] = args;
+    if (!targetPath || !outPath) {
+        console.error('Usage: node ota-image.js <new firmware.bin> <out.pcot> [running firmware.bin] [--key <private key.pem>]');
+        console.error('       node ota-image.js --keygen [private key.pem]');
+        process.exit(1);
+    }
+    const target = readFileSync(targetPath);
+    const { image, delta } = packOtaImage(target, basePath ? readFileSync(basePath) : null, readFileSync(keyPath));
+    writeFileSync(outPath, image);
+    console.log(`✓ ${outPath}: ${delta ? 'delta' : 'full'} image, ${target.length} -> ${image.length} bytes`);
+}
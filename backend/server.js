@@ -5,9 +5,11 @@ import express from 'express';
 import path from 'path';
 import { fileURLToPath } from 'url';
 import { existsSync } from 'fs';
+import { monitorEventLoopDelay } from 'perf_hooks';
 import mqtt from 'mqtt';
 import cors from 'cors';
 import pkg from 'pg';
+import { decodeTelemetryFrame, TELEMETRY_FRAME_TOPIC } from './telemetry-frame.js';
 const { Pool } = pkg;
 
 // ESM compatible __dirname
@@ -16,7 +18,6 @@ const __dirname = path.dirname(__filename);
 const app = express();
 const PORT = process.env.PORT || 3000;
 
-let lastInsertTime = 0;
 const INSERT_INTERVAL = 2000;
 
 // TimescaleDB connection configuration
@@ -68,36 +69,74 @@ pool.on('error', (err) => {
 })();
 
 // MQTT Broker configuration
+// Every device publishes under <prefix>/<device id>/<suffix>; one wildcard
+// subscription per suffix covers the whole fleet.
+const TOPIC_PREFIX = process.env.TOPIC_PREFIX || 'esp32';
+const AGGREGATE_TOPIC = 'telemetry/aggregate';
 const MQTT_BROKER = process.env.MQTT_BROKER || 'mqtt://broker.hivemq.com:1883';
 const MQTT_TOPICS = [
-    'esp32/sensor/voltage',
-    'esp32/sensor/current',
-    'esp32/sensor2/voltage',
-    'esp32/sensor2/current',
-    'esp32/light/intensity',
-    'esp32/led/status',
-    'esp32/led2/status',
-    'esp32/led4/status',
-    'esp32/emergency/status',
-    'esp32/powercut/status',
-    'esp32/history/powercut',
-    'esp32/command/status'
+    'sensor/voltage',
+    'sensor/current',
+    'sensor2/voltage',
+    'sensor2/current',
+    'light/intensity',
+    'led/status',
+    'led2/status',
+    'led4/status',
+    'emergency/status',
+    'powercut/status',
+    'history/powercut',
+    'command/status',
+    TELEMETRY_FRAME_TOPIC,
+    AGGREGATE_TOPIC
 ];
 
+// Device used by the API when a request does not name one
+const DEFAULT_DEVICE_ID = process.env.DEVICE_ID || 'ESP32_001';
+
 // Connect to MQTT broker
 let mqttClient = null;
-let lastSensorReading = {
-    battery_voltage: null,
-    battery_current: null,
-    main_voltage: null,
-    main_current: null,
-    light_intensity: null,
-    led_status: null,
-    led2_status: null,
-    led4_status: null,
-    emergency_light_status: null,
-    power_cut_status: 'NORMAL'
-};
+
+// Live state per device, keyed by device id
+const devices = new Map();
+
+// Ingest counters for load tests (tools/loadgen): messages in, sensor rows written,
+// and how long a reading waits between arriving and its INSERT completing
+const ingestStats = { received: 0, inserted: 0, insertLagTotalMs: 0, insertLagMaxMs: 0 };
+const eventLoopDelay = monitorEventLoopDelay({ resolution: 20 });
+eventLoopDelay.enable();
+
+function deviceState(deviceId) {
+    let state = devices.get(deviceId);
+    if (!state) {
+        state = {
+            lastSeen: 0,
+            lastInsertTime: 0,
+            lastFrameSequence: null,
+            lastSensorReading: {
+                battery_voltage: null,
+                battery_current: null,
+                main_voltage: null,
+                main_current: null,
+                light_intensity: null,
+                led_status: null,
+                led2_status: null,
+                led4_status: null,
+                emergency_light_status: null,
+                power_cut_status: 'NORMAL'
+            }
+        };
+        devices.set(deviceId, state);
+    }
+    return state;
+}
+
+// "esp32/esp32-a1b2c3/sensor/voltage" -> { deviceId: 'esp32-a1b2c3', suffix: 'sensor/voltage' }
+function parseDeviceTopic(topic) {
+    const parts = topic.split('/');
+    if (parts.length < 3 || parts[0] !== TOPIC_PREFIX) return null;
+    return { deviceId: parts[1], suffix: parts.slice(2).join('/') };
+}
 
 function connectMQTT() {
     console.log('Connecting to MQTT broker:', MQTT_BROKER);
@@ -110,8 +149,9 @@ function connectMQTT() {
 
     mqttClient.on('connect', () => {
         console.log('✓ Connected to MQTT broker');
-        // Subscribe to all topics
-        MQTT_TOPICS.forEach(topic => {
+        // Subscribe to all topics, for every device
+        MQTT_TOPICS.forEach(suffix => {
+            const topic = `${TOPIC_PREFIX}/+/${suffix}`;
             mqttClient.subscribe(topic, (err) => {
                 if (err) {
                     console.error(`✗ Failed to subscribe to ${topic}:`, err);
@@ -123,40 +163,68 @@ function connectMQTT() {
     });
 
     mqttClient.on('message', async (topic, message) => {
+        ingestStats.received++;
+        const parsed = parseDeviceTopic(topic);
+        if (!parsed) return;
+        const { deviceId, suffix } = parsed;
+        const state = deviceState(deviceId);
+        state.lastSeen = Date.now();
+
+        // Packed frames carry every channel in one message, so each one is stored as-is
+        if (suffix === TELEMETRY_FRAME_TOPIC) {
+            try {
+                await storeTelemetryFrame(deviceId, state, decodeTelemetryFrame(message));
+            } catch (error) {
+                console.error('Error processing telemetry frame:', error.message);
+            }
+            return;
+        }
+
+        // Window statistics: one message per closed window, one row per channel
+        if (suffix === AGGREGATE_TOPIC) {
+            try {
+                await storePowerAggregate(deviceId, JSON.parse(message.toString()));
+            } catch (error) {
+                console.error('Error processing power aggregate:', error.message);
+            }
+            return;
+        }
+
         const msg = message.toString();
         const timestamp = new Date();
         
         try {
             // Update last sensor reading
-            switch (topic) {
-                case 'esp32/sensor/voltage':
+            const lastSensorReading = state.lastSensorReading;
+            switch (suffix) {
+                case 'sensor/voltage':
                     lastSensorReading.battery_voltage = parseFloat(msg);
                     break;
-                case 'esp32/sensor/current':
+                case 'sensor/current':
                     lastSensorReading.battery_current = parseFloat(msg);
                     break;
-                case 'esp32/sensor2/voltage':
+                case 'sensor2/voltage':
                     lastSensorReading.main_voltage = parseFloat(msg);
                     break;
-                case 'esp32/sensor2/current':
+                case 'sensor2/current':
                     lastSensorReading.main_current = parseFloat(msg);
                     break;
-                case 'esp32/light/intensity':
+                case 'light/intensity':
                     lastSensorReading.light_intensity = parseFloat(msg);
                     break;
-                case 'esp32/led/status':
+                case 'led/status':
                     lastSensorReading.led_status = msg;
                     break;
-                case 'esp32/led2/status':
+                case 'led2/status':
                     lastSensorReading.led2_status = msg;
                     break;
-                case 'esp32/led4/status':
+                case 'led4/status':
                     lastSensorReading.led4_status = msg;
                     break;
-                case 'esp32/emergency/status':
+                case 'emergency/status':
                     lastSensorReading.emergency_light_status = msg;
                     break;
-                case 'esp32/powercut/status':
+                case 'powercut/status':
                     lastSensorReading.power_cut_status = msg;
                     break;
             }
@@ -166,21 +234,21 @@ function connectMQTT() {
             if (
                 lastSensorReading.battery_voltage !== null &&
                 lastSensorReading.main_voltage !== null &&
-                now - lastInsertTime >= INSERT_INTERVAL
+                now - state.lastInsertTime >= INSERT_INTERVAL
             ) {
-                lastInsertTime = now;
-                await storeSensorReading(timestamp);
+                state.lastInsertTime = now;
+                await storeSensorReading(deviceId, timestamp, lastSensorReading);
             }
 
 
             // Handle power cut history
-            if (topic === 'esp32/history/powercut') {
-                await storePowerCutHistory(msg, timestamp);
+            if (suffix === 'history/powercut') {
+                await storePowerCutHistory(deviceId, msg, timestamp);
             }
 
             // Store command logs
-            if (topic === 'esp32/command/status' && msg !== 'CLEAR_LOG') {
-                await storeCommandLog(topic, msg, timestamp);
+            if (suffix === 'command/status' && msg !== 'CLEAR_LOG') {
+                await storeCommandLog(deviceId, topic, msg, timestamp);
             }
         } catch (error) {
             console.error(`Error processing MQTT message from ${topic}:`, error);
@@ -201,12 +269,10 @@ function connectMQTT() {
 }
 
 // Store sensor reading in TimescaleDB
-async function storeSensorReading(timestamp) {
-    const deviceId = process.env.DEVICE_ID || 'ESP32_001';
-    
+async function storeSensorReading(deviceId, timestamp, reading) {
     // Calculate power values
-    const batteryPower = lastSensorReading.battery_voltage * (lastSensorReading.battery_current / 1000.0);
-    const mainPower = lastSensorReading.main_voltage * (lastSensorReading.main_current / 1000.0);
+    const batteryPower = reading.battery_voltage * (reading.battery_current / 1000.0);
+    const mainPower = reading.main_voltage * (reading.main_current / 1000.0);
 
     const query = `
         INSERT INTO sensor_readings (
@@ -224,29 +290,84 @@ async function storeSensorReading(timestamp) {
         await pool.query(query, [
             timestamp,
             deviceId,
-            lastSensorReading.battery_voltage,
-            lastSensorReading.battery_current,
+            reading.battery_voltage,
+            reading.battery_current,
             batteryPower,
-            lastSensorReading.main_voltage,
-            lastSensorReading.main_current,
+            reading.main_voltage,
+            reading.main_current,
             mainPower,
-            lastSensorReading.light_intensity,
-            lastSensorReading.led_status,
-            lastSensorReading.led2_status,
-            lastSensorReading.led4_status,
-            lastSensorReading.emergency_light_status,
-            lastSensorReading.power_cut_status
+            reading.light_intensity,
+            reading.led_status,
+            reading.led2_status,
+            reading.led4_status,
+            reading.emergency_light_status,
+            reading.power_cut_status
         ]);
+        const lagMs = Date.now() - timestamp.getTime();
+        ingestStats.inserted++;
+        ingestStats.insertLagTotalMs += lagMs;
+        ingestStats.insertLagMaxMs = Math.max(ingestStats.insertLagMaxMs, lagMs);
     } catch (error) {
         console.error('Error storing sensor reading:', error);
     }
 }
 
+// Store one packed telemetry frame (channel 1 = battery, channel 2 = main, as on the text topics)
+// Frames replayed from the device's flash journal after an outage carry this flag
+const FRAME_FLAG_REPLAYED = 0x04;
+
+async function storeTelemetryFrame(deviceId, state, frame) {
+    const [battery, main] = frame.channels;
+    const reading = {
+        ...state.lastSensorReading,
+        battery_voltage: battery.voltage,
+        battery_current: battery.current,
+        main_voltage: main.voltage,
+        main_current: main.current,
+        light_intensity: frame.intensity
+    };
+
+    // Replayed frames are history: they must not overwrite the live reading
+    if (!(frame.flags & FRAME_FLAG_REPLAYED)) {
+        if (state.lastFrameSequence !== null && frame.sequence !== state.lastFrameSequence + 1) {
+            console.warn(`Telemetry frame gap on ${deviceId}: expected #${state.lastFrameSequence + 1}, got #${frame.sequence}`);
+        }
+        state.lastFrameSequence = frame.sequence;
+        state.lastSensorReading = reading;
+    }
+
+    // Prefer the device's NTP time so buffered frames land at the right place
+    const timestamp = frame.epochSeconds > 0 ? new Date(frame.epochSeconds * 1000) : new Date();
+    await storeSensorReading(deviceId, timestamp, reading);
+}
+
+// Store one window aggregate (channel 1 = battery, channel 2 = main, as on the text topics).
+// Each channel carries [min, max, mean, rms, stddev] for v (V), i (mA) and p (mW).
+async function storePowerAggregate(deviceId, aggregate) {
+    // The device stamps the end of the window once NTP has synced
+    const timestamp = aggregate.epoch > 0 ? new Date(aggregate.epoch * 1000) : new Date();
+
+    const query = `
+        INSERT INTO power_aggregates (
+            time, device_id, window_ms, channel, samples,
+            voltage_min, voltage_max, voltage_mean, voltage_rms, voltage_stddev,
+            current_min, current_max, current_mean, current_rms, current_stddev,
+            power_min, power_max, power_mean, power_rms, power_stddev
+        ) VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16, $17, $18, $19, $20)
+    `;
+
+    for (const [index, channel] of aggregate.channels.entries()) {
+        await pool.query(query, [
+            timestamp, deviceId, aggregate.window_ms, index + 1, aggregate.samples,
+            ...channel.v, ...channel.i, ...channel.p
+        ]);
+    }
+}
+
 // Store power cut history
-async function storePowerCutHistory(jsonData, timestamp) {
+async function storePowerCutHistory(deviceId, jsonData, timestamp) {
     try {
         const data = JSON.parse(jsonData);
-        const deviceId = process.env.DEVICE_ID || 'ESP32_001';
         
         const query = `
             INSERT INTO power_cut_events (
@@ -273,9 +394,7 @@ async function storePowerCutHistory(jsonData, timestamp) {
 }
 
 // Store command log
-async function storeCommandLog(topic, message, timestamp) {
-    const deviceId = process.env.DEVICE_ID || 'ESP32_001';
-    
+async function storeCommandLog(deviceId, topic, message, timestamp) {
     const query = `
         INSERT INTO command_logs (device_id, time, command_type, command_value, topic, message)
         VALUES ($1, $2, $3, $4, $5, $6)
@@ -298,8 +417,8 @@ async function storeCommandLog(topic, message, timestamp) {
     }
 }
 
-// Frontend directory paths
-const frontendPath = path.join(__dirname, '..', 'frontend');
+// Frontend directory paths: the React build, else the standalone pages in web/
+const frontendPath = path.join(__dirname, '..', 'web');
 const frontendDistPath = path.join(__dirname, '..', 'frontend', 'dist');
 
 // Middleware
@@ -310,6 +429,9 @@ app.use(cors({
     credentials: true
 }));
 
+// Firmware images for OTA updates (packed with `npm run ota:pack`)
+app.use('/ota', express.static(path.join(__dirname, 'ota')));
+
 // API routes (must come before static file serving)
 // All API routes are defined below
 
@@ -321,11 +443,9 @@ if (distExists) {
     app.use(express.static(frontendDistPath));
     
     // Serve React app for all routes (React Router handles routing)
-    app.get('*', (req, res) => {
-        // Don't serve React app for API routes
-        if (req.path.startsWith('/api')) {
-            return res.status(404).json({ error: 'API endpoint not found' });
-        }
+    app.get('*', (req, res, next) => {
+        // API routes are registered further down; this route must not shadow them
+        if (req.path.startsWith('/api')) return next();
         res.sendFile(path.join(frontendDistPath, 'index.html'));
     });
 } else {
@@ -382,11 +502,56 @@ app.get('/api/health', async (req, res) => {
     });
 });
 
+// Ingest counters; ?reset=1 restarts the lag maximum and the event loop histogram
+app.get('/api/ingest-stats', (req, res) => {
+    res.json({
+        received: ingestStats.received,
+        inserted: ingestStats.inserted,
+        insert_lag_avg_ms: ingestStats.inserted > 0 ? ingestStats.insertLagTotalMs / ingestStats.inserted : 0,
+        insert_lag_max_ms: ingestStats.insertLagMaxMs,
+        event_loop_p99_ms: eventLoopDelay.percentile(99) / 1e6,
+        devices: devices.size
+    });
+    if (req.query.reset) {
+        ingestStats.insertLagTotalMs = 0;
+        ingestStats.insertLagMaxMs = 0;
+        ingestStats.inserted = 0;
+        ingestStats.received = 0;
+        eventLoopDelay.reset();
+    }
+});
+
+// API: Devices the backend has heard from, most recent first. The dashboards
+// use it to pick a device when the URL does not name one.
+app.get('/api/devices', async (req, res) => {
+    const seen = new Map();
+    for (const [deviceId, state] of devices) {
+        if (state.lastSeen > 0) seen.set(deviceId, new Date(state.lastSeen));
+    }
+    try {
+        // Devices that reported before this server started
+        const result = await pool.query(`
+            SELECT device_id, MAX(time) AS last_seen
+            FROM sensor_readings
+            WHERE time > NOW() - INTERVAL '7 days'
+            GROUP BY device_id
+        `);
+        for (const row of result.rows) {
+            if (!seen.has(row.device_id)) seen.set(row.device_id, row.last_seen);
+        }
+    } catch (error) {
+        console.error('Error fetching devices:', error.message);
+    }
+    res.json([...seen]
+        .map(([device_id, last_seen]) => ({ device_id, last_seen }))
+        .sort((a, b) => b.last_seen - a.last_seen));
+});
+
 // API: Get sensor readings (time-series data)
 app.get('/api/sensor-readings', async (req, res) => {
     try {
         const { start_time, end_time, limit = 1000 } = req.query;
-        const deviceId = process.env.DEVICE_ID || 'ESP32_001';
+        const deviceId = req.query.device || DEFAULT_DEVICE_ID;
         
         let query = `
             SELECT time, battery_voltage, battery_current, battery_power,
@@ -426,7 +591,7 @@ app.get('/api/sensor-readings', async (req, res) => {
 app.get('/api/power-cut-events', async (req, res) => {
     try {
         const { start_time, end_time, limit = 100 } = req.query;
-        const deviceId = process.env.DEVICE_ID || 'ESP32_001';
+        const deviceId = req.query.device || DEFAULT_DEVICE_ID;
         
         let query = `
             SELECT id, start_time, end_time, duration_ms,
@@ -464,7 +629,7 @@ app.get('/api/power-cut-events', async (req, res) => {
 app.get('/api/command-logs', async (req, res) => {
     try {
         const { start_time, end_time, limit = 100 } = req.query;
-        const deviceId = process.env.DEVICE_ID || 'ESP32_001';
+        const deviceId = req.query.device || DEFAULT_DEVICE_ID;
         
         let query = `
             SELECT id, time, command_type, command_value, topic, message
@@ -501,7 +666,7 @@ app.get('/api/command-logs', async (req, res) => {
 app.get('/api/statistics', async (req, res) => {
     try {
         const { hours = 24 } = req.query;
-        const deviceId = process.env.DEVICE_ID || 'ESP32_001';
+        const deviceId = req.query.device || DEFAULT_DEVICE_ID;
         
         const query = `
             SELECT 
@@ -526,6 +691,11 @@ app.get('/api/statistics', async (req, res) => {
     }
 });
 
+// Unknown API endpoints
+app.use('/api', (req, res) => {
+    res.status(404).json({ error: 'API endpoint not found' });
+});
+
 // Start server
 app.listen(PORT, '0.0.0.0', async () => {
     /*
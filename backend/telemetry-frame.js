@@ -0,0 +1,50 @@
+// Decoder for the packed telemetry frame published on <prefix>/<device id>/telemetry/frame.
+// Layout (little-endian, see include/telemetry_frame.h in the firmware):
+//   u8 version | u8 channelCount | u8 flags | u8 reserved
+//   u32 sequence | u32 uptimeMs | u32 epochSeconds
+//   f32 intensity
+//   channelCount x { f32 voltage (V), f32 current (mA), f32 power (mW) }
+
+export const TELEMETRY_FRAME_TOPIC = 'telemetry/frame'; // Suffix under the device namespace
+export const TELEMETRY_FRAME_VERSION = 1;
+
+const HEADER_SIZE = 16;
+const CHANNEL_SIZE = 12;
+
+export function decodeTelemetryFrame(buffer) {
+    if (buffer.length < HEADER_SIZE + 4) {
+        throw new Error(`Telemetry frame too short (${buffer.length} bytes)`);
+    }
+
+    const version = buffer.readUInt8(0);
+    if (version !== TELEMETRY_FRAME_VERSION) {
+        throw new Error(`Unsupported telemetry frame version ${version}`);
+    }
+
+    const channelCount = buffer.readUInt8(1);
+    const expectedSize = HEADER_SIZE + 4 + channelCount * CHANNEL_SIZE;
+    if (buffer.length < expectedSize) {
+        throw new Error(`Telemetry frame truncated (${buffer.length}/${expectedSize} bytes)`);
+    }
+
+    const frame = {
+        version,
+        flags: buffer.readUInt8(2),
+        sequence: buffer.readUInt32LE(4),
+        uptimeMs: buffer.readUInt32LE(8),
+        epochSeconds: buffer.readUInt32LE(12),
+        intensity: buffer.readFloatLE(16),
+        channels: []
+    };
+
+    for (let i = 0; i < channelCount; i++) {
+        const offset = HEADER_SIZE + 4 + i * CHANNEL_SIZE;
+        frame.channels.push({
+            voltage: buffer.readFloatLE(offset),
+            current: buffer.readFloatLE(offset + 4),
+            power: buffer.readFloatLE(offset + 8)
+        });
+    }
+
+    return frame;
+}
@@ -0,0 +1,81 @@
+// Host checks for the OTA packer: node --test (npm test in backend/).
+// OTA_TEST_BIN=<firmware.bin> also runs them against a real PlatformIO build.
+import { test } from 'node:test';
+import assert from 'node:assert/strict';
+import { readFileSync } from 'fs';
+import { inflateSync } from 'zlib';
+import { createHash, createPublicKey, generateKeyPairSync, randomBytes, verify } from 'crypto';
+import { espImageDigest, packOtaImage } from '../ota-image.js';
+
+// An app image laid out the way esptool elf2image writes it: header, segments,
+// checksum at the end of a 16-byte block, then the appended SHA-256
+function espImage(segmentSizes, seed) {
+    const header = Buffer.alloc(24);
+    header[0] = 0xe9;
+    header[1] = segmentSizes.length;
+    header[2] = 2;          // DIO
+    header[3] = 0x20;       // 4 MB, 40 MHz
+    header.writeUInt32LE(0x400d1234 + seed, 4);
+    header[8] = 0xee;       // WP pin
+    header[23] = 1;         // hash_appended
+    const parts = [header];
+    let checksum = 0xef;
+    let length = header.length;
+    segmentSizes.forEach((size, i) => {
+        const segment = Buffer.alloc(8);
+        segment.writeUInt32LE(0x3f400020 + i * 0x10000, 0);
+        segment.writeUInt32LE(size, 4);
+        const data = createHash('sha256').update(`${seed}/${i}`).digest();
+        const body = Buffer.alloc(size, 0);
+        for (let j = 0; j < size; j++) body[j] = data[j % 32] ^ (j >> 5);
+        for (const byte of body) checksum ^= byte;
+        parts.push(segment, body);
+        length += 8 + size;
+    });
+    const padded = Buffer.alloc(((length + 16) & ~15) - length);
+    padded[padded.length - 1] = checksum;
+    parts.push(padded);
+    const image = Buffer.concat(parts);
+    return Buffer.concat([image, createHash('sha256').update(image).digest()]);
+}
+
+function baseHashInHeader(packed) {
+    return inflateSync(packed).subarray(12, 44);
+}
+
+const { privateKey } = generateKeyPairSync('ec', { namedCurve: 'prime256v1' });
+
+test('the delta base is the digest the device reports, not the hash of the .bin', () => {
+    const base = espImage([4096, 1000, 20012], 1);
+    const target = Buffer.from(base);
+    target.fill(0x5a, 2000, 2300); // A patched build: same layout, some bytes changed
+    const { image, delta } = packOtaImage(target, base, privateKey);
+    assert.equal(delta, true);
+    // esp_partition_get_sha256() on the running app returns the appended digest
+    assert.deepEqual(baseHashInHeader(image), base.subarray(base.length - 32));
+    assert.notDeepEqual(baseHashInHeader(image), createHash('sha256').update(base).digest());
+});
+
+test('the header signs the SHA-256 of the new image', () => {
+    const target = espImage([3000, 512], 2);
+    const stream = inflateSync(packOtaImage(target, null, privateKey).image);
+    const body = stream.subarray(140);
+    assert.equal(stream.readUInt32LE(8), target.length);
+    assert.deepEqual(body, target);
+    assert.deepEqual(stream.subarray(44, 76), createHash('sha256').update(target).digest());
+    assert.ok(verify('sha256', body, { key: createPublicKey(privateKey), dsaEncoding: 'ieee-p1363' }, stream.subarray(76, 140)));
+});
+
+test('a base that is not an intact ESP image is refused', () => {
+    const base = espImage([2048], 3);
+    const corrupted = Buffer.from(base);
+    corrupted[100] ^= 1;
+    assert.throws(() => packOtaImage(base, corrupted, privateKey), /digest does not match/);
+    assert.throws(() => packOtaImage(base, randomBytes(4096), privateKey), /not an ESP32 app image/);
+});
+
+test('a real firmware .bin', { skip: !process.env.OTA_TEST_BIN && 'set OTA_TEST_BIN=<firmware.bin>' }, () => {
+    const bin = readFileSync(process.env.OTA_TEST_BIN);
+    assert.deepEqual(espImageDigest(bin), bin.subarray(bin.length - 32));
+    assert.deepEqual(baseHashInHeader(packOtaImage(bin, bin, privateKey).image), bin.subarray(bin.length - 32));
+});
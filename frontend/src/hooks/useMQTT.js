@@ -1,28 +1,35 @@
 import { useEffect, useState, useRef, useCallback } from 'react'
 import mqtt from 'mqtt'
+import { deviceTopic } from '../services/device'
 
 const MQTT_BROKER = 'wss://broker.hivemq.com:8884/mqtt'
 
-export const TOPICS = {
-  CONTROL: 'esp32/led/control',
-  STATUS: 'esp32/led/status',
-  LED2: 'esp32/led2/control',
-  LED2_STATUS: 'esp32/led2/status',
-  LED4: 'esp32/led4/control',
-  LED4_STATUS: 'esp32/led4/status',
-  VOLTAGE: 'esp32/sensor/voltage',
-  CURRENT: 'esp32/sensor/current',
-  POWER: 'esp32/sensor/power',
-  VOLTAGE2: 'esp32/sensor2/voltage',
-  CURRENT2: 'esp32/sensor2/current',
-  POWER2: 'esp32/sensor2/power',
-  POWERCUT: 'esp32/powercut/status',
-  COMMAND: 'esp32/command/status',
-  EMERGENCY: 'esp32/emergency/control',
-  EMERGENCY_STATUS: 'esp32/emergency/status',
-  HISTORY: 'esp32/history/powercut',
-  LIGHT_INTENSITY: 'esp32/light/intensity',
-  BATTERY_PCT: 'esp32/sensor/battery_pct',
+const SUFFIXES = {
+  CONTROL: 'led/control',
+  STATUS: 'led/status',
+  LED2: 'led2/control',
+  LED2_STATUS: 'led2/status',
+  LED4: 'led4/control',
+  LED4_STATUS: 'led4/status',
+  VOLTAGE: 'sensor/voltage',
+  CURRENT: 'sensor/current',
+  POWER: 'sensor/power',
+  VOLTAGE2: 'sensor2/voltage',
+  CURRENT2: 'sensor2/current',
+  POWER2: 'sensor2/power',
+  POWERCUT: 'powercut/status',
+  COMMAND: 'command/status',
+  EMERGENCY: 'emergency/control',
+  EMERGENCY_STATUS: 'emergency/status',
+  HISTORY: 'history/powercut',
+  LIGHT_INTENSITY: 'light/intensity',
+  BATTERY_PCT: 'sensor/battery_pct',
+}
+
+// Full topics of the selected device (services/device.js)
+export const TOPICS = {}
+for (const [key, suffix] of Object.entries(SUFFIXES)) {
+  Object.defineProperty(TOPICS, key, { enumerable: true, get: () => deviceTopic(suffix) })
 }
 
 export function useMQTT() {
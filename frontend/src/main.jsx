@@ -1,12 +1,24 @@
 import React from 'react'
 import ReactDOM from 'react-dom/client'
 import App from './App.jsx'
+import { resolveDevice } from './services/device'
 import './index.css'
 
-ReactDOM.createRoot(document.getElementById('root')).render(
-  <React.StrictMode>
-    <App />
-  </React.StrictMode>,
-)
+function NoDevice() {
+  return (
+    <div style={{ padding: '2rem', textAlign: 'center' }}>
+      <h2>No device known yet</h2>
+      <p>Open this page with <code>?device=&lt;device id&gt;</code>. The ID is printed on the serial console at boot.</p>
+    </div>
+  )
+}
+
+resolveDevice().then((deviceId) => {
+  ReactDOM.createRoot(document.getElementById('root')).render(
+    <React.StrictMode>
+      {deviceId ? <App /> : <NoDevice />}
+    </React.StrictMode>,
+  )
+})
 
 
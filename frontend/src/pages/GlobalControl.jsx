@@ -254,8 +254,8 @@ function GlobalControl() {
         <div className="info">
           <h3>📡 How It Works</h3>
           <p><strong>MQTT Broker:</strong> broker.hivemq.com</p>
-          <p><strong>Control Topic:</strong> esp32/led/control</p>
-          <p><strong>Status Topic:</strong> esp32/led/status</p>
+          <p><strong>Control Topic:</strong> {TOPICS.CONTROL}</p>
+          <p><strong>Status Topic:</strong> {TOPICS.STATUS}</p>
           <p>This page connects to a public MQTT broker and can control your ESP32 from anywhere in the world!</p>
           
           <div className="command-log">
@@ -1,7 +1,11 @@
+import { currentDevice } from './device'
+
 const API_BASE = '/api'
 
 export const api = {
   async get(endpoint, params = {}) {
+    // Readings, events and logs are per device: the selected one unless named
+    if (currentDevice() && !('device' in params)) params = { ...params, device: currentDevice() }
     const queryString = new URLSearchParams(params).toString()
     const url = `${API_BASE}${endpoint}${queryString ? `?${queryString}` : ''}`
     
@@ -33,6 +37,10 @@ export const api = {
     return this.get('/statistics', params)
   },
 
+  async getDevices() {
+    return this.get('/devices')
+  },
+
   async getHealth() {
     return this.get('/health')
   }
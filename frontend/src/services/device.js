@@ -0,0 +1,37 @@
+// The firmware publishes under <prefix>/<device id>/<suffix>. Which device this
+// dashboard shows is settled once, before the app renders:
+//   ?device=<id> in the URL (the ID is printed on the serial console at boot),
+//   else VITE_DEVICE_ID, else the last device used in this browser,
+//   else the one the backend heard from most recently (/api/devices).
+const TOPIC_PREFIX = import.meta.env.VITE_TOPIC_PREFIX || 'esp32'
+const STORAGE_KEY = 'deviceId'
+
+let deviceId = null
+
+export function currentDevice() {
+  return deviceId
+}
+
+export function deviceTopic(suffix) {
+  return `${TOPIC_PREFIX}/${deviceId}/${suffix}`
+}
+
+async function discoverDevice() {
+  try {
+    const response = await fetch('/api/devices')
+    if (!response.ok) return null
+    const devices = await response.json()
+    return devices.length > 0 ? devices[0].device_id : null
+  } catch (error) {
+    console.error('Device discovery failed:', error)
+    return null
+  }
+}
+
+// Resolves to the device ID, or null if none is configured or known yet
+export async function resolveDevice() {
+  const fromUrl = new URLSearchParams(window.location.search).get('device')
+  deviceId = fromUrl || import.meta.env.VITE_DEVICE_ID || localStorage.getItem(STORAGE_KEY) || await discoverDevice()
+  if (deviceId) localStorage.setItem(STORAGE_KEY, deviceId)
+  return deviceId
+}
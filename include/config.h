@@ -13,6 +13,8 @@
 #define INTENSITY_B2_PIN 35   
 #define POWER_DETECT_PIN 18   
 #define POWER_CUT_STATE LOW 
+#define INA_CRITICAL_PIN 19   // INA3221 CRITICAL alert (open drain, active LOW)
+#define INA_WARNING_PIN 23    // INA3221 WARNING alert (open drain, active LOW)
 // --- TELEGRAM SETTINGS ---
 #define TELEGRAM_BOT_TOKEN "8289194016:AAG0ShZjHz_2ogcp3GiEZWYx__pwuzfSr_M" 
 #define TELEGRAM_CHAT_ID "7996858275"  
@@ -22,9 +24,27 @@ extern const char* ssid;
 extern const char* password;
 
 // --- MQTT SETTINGS ---
+// Defaults; the device ID (also the MQTT client ID), topic prefix, broker and
+// port are loaded from NVS at boot, see device_config.h
 extern const char* mqtt_broker;
 extern const int mqtt_port;
-extern const char* mqtt_client_id;
+
+// --- DEVICE NAMESPACE ---
+// Every topic is "<prefix>/<device id>/<suffix>" (topics.h)
+#define DEFAULT_TOPIC_PREFIX "esp32"
+const size_t DEVICE_ID_SIZE = 32;      // Also the MQTT client ID
+const size_t DEVICE_PREFIX_SIZE = 64;  // "<prefix>/<device id>/"
+const size_t TOPIC_STORAGE_SIZE = 2560; // All full topic strings, built once at boot
+
+// --- MQTT COMMAND TOPICS ---
+// Suffix literals so the command dispatcher can hash them at compile time (commands.cpp)
+#define MQTT_LED_TOPIC "led/control"
+#define MQTT_LED2_TOPIC "led2/control"
+#define MQTT_LED4_TOPIC "led4/control"
+#define MQTT_EMERGENCY_LIGHT_TOPIC "emergency/control"
+#define MQTT_EVENT_QUERY_TOPIC "history/powercut/query"
+#define MQTT_OTA_TOPIC "ota/control"
+#define MQTT_SNAPSHOT_GET_TOPIC "status/get"
 
 // --- MQTT TOPICS ---
 extern const char* mqtt_topic;
@@ -49,11 +69,156 @@ extern const char* mqtt_emergency_light_topic;
 extern const char* mqtt_emergency_light_status_topic;
 extern const char* mqtt_powercut_history_topic;
 extern const char* mqtt_light_intensity_topic;
+extern const char* mqtt_loop_stats_topic;
+extern const char* mqtt_telemetry_frame_topic;
+extern const char* mqtt_aggregate_topic;
+extern const char* mqtt_report_stats_topic;
+extern const char* mqtt_signal_topic;
+extern const char* mqtt_diagnostics_topic;
+extern const char* mqtt_stall_topic;
+extern const char* mqtt_boot_topic;
+extern const char* mqtt_event_query_topic; // Event log range queries (event_log.h)
+extern const char* mqtt_event_page_topic;  // ... and their answers
+extern const char* mqtt_ota_topic;         // Update image URL (ota_update.h)
+extern const char* mqtt_ota_status_topic;  // Update progress and result
+extern const char* mqtt_snapshot_get_topic; // Latest-reading requests (reading_snapshot.h)
+extern const char* mqtt_snapshot_topic;     // ... and the snapshot
 
 // --- CONSTANTS ---
 const float POWER_CUT_THRESHOLD = 1.0; // Voltage threshold to detect power cut
 const unsigned long EMERGENCY_DURATION = 60000; // 1 minute in milliseconds 
 const unsigned long GPIO14_DELAY = 200; // Delay before activating GPIO14 (200 ms)
 const long SIGNAL_UPDATE_INTERVAL = 5000; // 5 seconds
+const unsigned long SENSOR_READ_INTERVAL = 2000; // INA3221 window / sample period (intensity changes flush it early)
+const unsigned long STATUS_SAMPLE_TIMEOUT = 3000; // /status gives up on its forced reading (and puts GPIO13 back) after this
+const unsigned long LOOP_STATS_INTERVAL = 10000; // Worst-case loop latency report
+const unsigned long WIFI_RETRY_INTERVAL = 10000; // Re-issue WiFi.begin() if still not associated
+const unsigned long MQTT_RETRY_INTERVAL = 5000; // Gap between MQTT connect attempts
+const unsigned long WIFI_FAST_CONNECT_TIMEOUT = 3000; // Cached BSSID/IP attempt, then a full scan + DHCP
+
+// --- INTERRUPT-DRIVEN POWER-CUT DETECTION ---
+const unsigned long POWER_DETECT_DEBOUNCE_MS = 5;  // Detect pin must stay in POWER_CUT_STATE this long
+const int INA_ALERT_CHANNEL = 0;                   // Load moves onto this channel when mains drops
+const float INA_CRITICAL_CURRENT_MA = 2000.0;      // Single-conversion alert -> immediate re-sample
+const float INA_WARNING_CURRENT_MA = 1500.0;       // Averaged alert -> immediate re-sample
+
+// --- LIGHT INTENSITY INPUT ---
+const unsigned long INTENSITY_DEBOUNCE_MS = 20; // All three code pins quiet this long before the code is taken
+const float INTENSITY_LIGHT_ON_PCT = 35.0;      // Emergency light ON below this (during a cut)...
+const float INTENSITY_LIGHT_OFF_PCT = 50.0;     // ...and OFF above this; in between it stays as it is
+
+// --- HIGH-RATE SAMPLING ---
+const uint32_t SAMPLE_RATE_HZ = 200;      // INA3221 sampling rate from the hardware timer (100 - 1000 Hz)
+const uint32_t I2C_CLOCK_HZ = 400000;     // Fast mode, the INA3221's limit outside HS mode; one burst per sample
+const uint8_t INA3221_ADDRESS = 0x40;     // A0 to GND
+const int32_t SHUNT_MILLIOHMS = 100;      // All three channels
+const size_t READING_QUEUE_SIZE = 8;      // Decimated windows waiting for the control task
+
+// --- WINDOWED STATISTICS ---
+const uint32_t STATS_WINDOWS_MS[] = { 10000, 60000 }; // Tumbling windows, one aggregate each
+const size_t STATS_WINDOW_COUNT = sizeof(STATS_WINDOWS_MS) / sizeof(STATS_WINDOWS_MS[0]);
+const size_t AGGREGATE_QUEUE_SIZE = 8;    // Closed windows waiting for the network task
+// Window aggregates on mqtt_aggregate_topic instead of the text topics. Off until
+// the web dashboards read aggregates: they still subscribe to the text topics.
+const bool TELEMETRY_AGGREGATES = false;
+
+// --- TELEMETRY FORMAT ---
+// The packed frame carries every channel, a sequence number and the sample time in
+// one publish. The legacy text topics (7 publishes per cycle) are what the web
+// dashboards subscribe to, so they stay on unless every consumer reads frames.
+const bool TELEMETRY_BINARY_FRAME = false; // One packed frame per cycle on mqtt_telemetry_frame_topic
+const bool TELEMETRY_TEXT_TOPICS = true;   // One text publish per value (none while TELEMETRY_AGGREGATES is on)
+
+// --- REPORT BY EXCEPTION (text topics) ---
+// Published when the value moved by more than its deadband or REPORT_PERCENT_CHANGE
+// (the latter only away from zero, where a few percent is more than sensor noise)
+// since the last published value, and at least every REPORT_HEARTBEAT_MS
+const float REPORT_DEADBAND_VOLTS = 0.05;
+const float REPORT_DEADBAND_MILLIAMPS = 5.0;
+const float REPORT_DEADBAND_MILLIWATTS = 50.0;
+const float REPORT_DEADBAND_INTENSITY = 1.0;        // Any step of the 3-bit input (14.3%)
+const float REPORT_PERCENT_CHANGE = 2.0;            // % of the last published value
+const float REPORT_PERCENT_MIN_DEADBANDS = 10.0;    // Percent test only at least this many deadbands from zero
+const unsigned long REPORT_HEARTBEAT_MS = 60000;    // Longest silence per topic
+
+// --- STORE-AND-FORWARD JOURNAL ---
+const uint32_t JOURNAL_SEGMENT_RECORDS = 256;      // Records per segment file (~12 KB)
+const uint32_t JOURNAL_MAX_SEGMENTS = 16;          // ~2.3 h of 2 s samples before the oldest is dropped
+const size_t JOURNAL_REPLAY_BATCH = 20;            // Records sent per replay pass
+const unsigned long JOURNAL_REPLAY_INTERVAL = 250; // Gap between replay passes
+
+// --- POWER-CUT EVENT LOG ---
+const uint32_t EVENT_LOG_CAPACITY = 256;   // Outages kept in flash (32 B each), then the oldest is overwritten
+const uint32_t EVENT_INDEX_STRIDE = 16;    // Records per time-index entry (16 entries in RAM)
+const uint8_t EVENT_PAGE_LIMIT = 6;        // Most events per query response
+const size_t EVENT_PAGE_SIZE = 1024;       // Static buffer for one response page
+const size_t EVENT_QUERY_QUEUE_SIZE = 4;   // Queries waiting for an answer
+const size_t EVENT_QUEUE_SIZE = 4;         // Finished outages waiting for the network task
+
+// --- CONTROL STATE CHECKPOINT ---
+const size_t CHECKPOINT_RECORD_MAX = 64;             // Bytes reserved in RTC memory for the record
+const size_t CHECKPOINT_QUEUE_SIZE = 2;              // Checkpoints waiting for the network task's NVS write
+const unsigned long CHECKPOINT_NVS_INTERVAL = 60000; // NVS refresh while a cut lasts (transitions go at once)
+
+// --- LATEST-READING SNAPSHOT ---
+const unsigned long SNAPSHOT_MAX_AGE = 5000;         // Older than this, readers ask for a fresh reading first
+const unsigned long SNAPSHOT_RESAMPLE_TIMEOUT = 500; // An MQTT answer waits this long for it
+const uint16_t STATUS_HTTP_PORT = 80;                // GET /status on the LAN
+const size_t STATUS_HTTP_REQUEST_SIZE = 256;         // Request line + headers kept; the rest is ignored
+const unsigned long STATUS_HTTP_TIMEOUT = 2000;      // A client that sends no full request by then is dropped
+
+// --- OTA UPDATES ---
+const size_t OTA_URL_SIZE = 160;                  // Longest image URL
+const size_t OTA_CHUNK_SIZE = 4096;               // Flash write unit (one sector)
+const unsigned long OTA_HTTP_TIMEOUT = 10000;     // No data for this long aborts the download
+const unsigned long OTA_PROGRESS_INTERVAL = 2000; // Progress reports on mqtt_ota_status_topic
+const unsigned long OTA_RESTART_DELAY = 5000;     // After the final report, and after any power cut
+const unsigned long OTA_VERIFY_TIMEOUT = 300000;  // A new image must sample and publish by then, or roll back
+const size_t OTA_SIGNING_KEY_SIZE = 65;           // Uncompressed P-256 point: 0x04 | X | Y
+extern const uint8_t ota_signing_key[OTA_SIGNING_KEY_SIZE]; // Images must be signed with its private half
+
+// --- MQTT OUTBOX ---
+const size_t MQTT_LANE_ALARM_BYTES = 2048;     // QoS 1 alarms waiting for the broker or its PUBACK
+const size_t MQTT_LANE_STATE_BYTES = 8192;     // Telemetry and status while the socket is backed up
+const size_t MQTT_LANE_BULK_BYTES = 4096;      // Diagnostics / loop / report stats
+const uint32_t MQTT_INFLIGHT_WINDOW = 4;       // Unacked QoS 1 publishes at once
+const unsigned long MQTT_ACK_TIMEOUT = 5000;   // Then the publish is sent again with DUP
+const size_t MQTT_OUTBOX_PASS_BYTES = 2048;    // Payload bytes written per scheduler pass
+
+// --- TELEGRAM OUTBOX ---
+const size_t TELEGRAM_MESSAGE_SIZE = 512;              // Largest message incl. coalesced alerts
+const size_t TELEGRAM_OUTBOX_SIZE = 8;                 // Messages waiting for the worker
+const unsigned long TELEGRAM_COALESCE_WINDOW = 3000;   // Alerts within this window go out as one message
+const int TELEGRAM_MAX_ATTEMPTS = 5;                   // Then the message is dropped
+const unsigned long TELEGRAM_RETRY_BASE = 1000;        // Backoff: 1 s, 2 s, 4 s, 8 s
+const unsigned int TELEGRAM_LONG_POLL = 50;            // getUpdates server-side timeout (seconds)
+const size_t TELEGRAM_COMMAND_QUEUE_SIZE = 4;          // Listener -> network task
+
+// --- TEXT FORMATTING POOL ---
+const size_t TEXT_POOL_BLOCKS = 4;    // TextBuffers alive at once across all tasks
+const size_t TEXT_BLOCK_SIZE = 512;   // Longest outbound text (the /status report is ~300 B)
+
+// --- DIAGNOSTICS ---
+const unsigned long DIAG_REPORT_INTERVAL = 30000; // One payload on mqtt_diagnostics_topic
+const size_t DIAG_HISTOGRAM_BUCKETS = 20;         // log2(us) buckets, the last one is >= 0.5 s
+const size_t DIAG_PAYLOAD_SIZE = 1024;            // Static buffer for the diagnostics JSON
+const size_t DIAG_MAX_TASKS = 6;                  // Tasks whose stack high-water mark is reported
+const float DIAG_OVERHEAD_BUDGET_PCT = 1.0;       // Probe cost as % of the time measured
+
+// --- STALL PROFILER ---
+const unsigned long STALL_CHECK_MS = 20;             // Monitor period on each core
+const uint32_t STALL_BUDGET_CONTROL_MS = 30;         // One control tick
+const uint32_t STALL_BUDGET_NETWORK_MS = 250;        // One scheduler pass
+const uint32_t STALL_BUDGET_TELEGRAM_MS = 8000;      // One sendMessage attempt incl. the TLS handshake
+const size_t STALL_RING_SIZE = 8;                    // Events kept in RTC memory across resets
+const size_t STALL_BACKTRACE_DEPTH = 8;              // Frames per event
+
+// --- DUAL-CORE TASKS ---
+const int CONTROL_CORE = 1;  // INA3221 sampling + emergency state machine
+const int NETWORK_CORE = 0;  // WiFi/MQTT/Telegram (same core as the WiFi stack)
+const unsigned long CONTROL_TICK_MS = 10; // Control task period
+const size_t SAMPLE_QUEUE_SIZE = 32;      // Samples buffered while the network core is busy
+const size_t OUTBOUND_QUEUE_SIZE = 16;    // Status publishes / Telegram alerts from the control core
+const size_t COMMAND_QUEUE_SIZE = 8;      // MQTT/Telegram commands to the control core
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef CONTROL_STATE_H
+#define CONTROL_STATE_H
+
+#include <Arduino.h>
+
+// --- CONTROL STATE CHECKPOINT ---
+// A brownout in the middle of a cut used to bring the board back with every
+// output at its power-on level and the emergency sequence forgotten until the
+// detect pin or the first reading found the cut again. Now the control task
+// keeps its state (flags, resting output levels, how far into the cut and the
+// sequence it is, the energy so far) in a small checked record:
+//   - RTC memory, rewritten whenever the state changes (a memcpy per tick at
+//     most), for brownout, watchdog and software resets;
+//   - NVS, written by the network task on every transition and every
+//     CHECKPOINT_NVS_INTERVAL during a cut, for resets that lose RTC memory.
+// setupHardware() loads the RTC copy, else the NVS one, and drives the outputs
+// to the saved levels when it first configures the pins, before the tasks or
+// WiFi start. Elapsed times are saved, not timestamps: millis() restarts at 0,
+// so the timers are rebuilt relative to the new clock. The reset itself is not
+// counted (there is no clock across it), and neither is the time a board spent
+// off before an NVS restore; a cut that ended meanwhile is closed by the first
+// reading like any other.
+
+// Output levels in ControlState::outputs: bit set = pin HIGH
+enum ControlOutput : uint8_t {
+  CONTROL_OUT_LED = 1 << 0,    // LED_PIN
+  CONTROL_OUT_SYSTEM = 1 << 1, // LED2_PIN (GPIO13, HIGH = system off)
+  CONTROL_OUT_GPIO14 = 1 << 2, // LED4_PIN
+  CONTROL_OUT_LIGHT = 1 << 3,  // POWER_STATUS_PIN (HIGH = emergency light off)
+};
+const uint8_t CONTROL_OUTPUTS_DEFAULT = CONTROL_OUT_SYSTEM | CONTROL_OUT_GPIO14 | CONTROL_OUT_LIGHT; // Power-on levels
+
+// Compared byte for byte: clear it before filling it in
+struct ControlState {
+  bool powerCut;
+  bool emergencyMode;
+  bool manualLight;             // Emergency light under manual control
+  bool gpio14Activated;
+  uint8_t outputs;              // CONTROL_OUT_*, levels once any pulse has ended
+  uint32_t cutMillis;           // Since the cut began
+  uint32_t emergencyMillis;     // Since the emergency sequence began
+  uint32_t gpio14DueMillis;     // Until the GPIO14 pulse, 0 if due or sent
+  float energy;                 // mWh drawn so far in this cut
+  float startVoltage;
+  float minVoltage;
+};
+
+// Control task, every tick. Cheap when nothing changed.
+void controlStateSave(const ControlState& state);
+
+// Network task: writes the latest transition to NVS
+void controlStatePersist();
+
+// setupHardware(): false if neither copy holds a valid record
+bool controlStateLoad(ControlState& state);
+void controlStateRestored(); // Outputs and timers are back: stamps the restore time
+
+const char* controlStateRestoredFrom(); // "rtc", "nvs" or "none"
+unsigned long controlStateRestoreMicros(); // Uptime when the outputs were back, 0 if nothing was restored
+uint32_t controlStateNvsWrites();          // Since boot
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// --- RUNTIME DEVICE CONFIGURATION ---
+// Read once at boot from the NVS namespace "device", so one firmware image can
+// be flashed across a fleet and each unit told apart without a rebuild:
+//   id     - device ID, also the MQTT client ID (default "esp32-" + MAC tail)
+//   prefix - topic root (default DEFAULT_TOPIC_PREFIX)
+//   broker - MQTT broker host (default mqtt_broker)
+//   port   - MQTT broker port (default mqtt_port)
+// Every topic becomes "<prefix>/<id>/<suffix>" (topics.h).
+
+struct DeviceConfig {
+  char deviceId[DEVICE_ID_SIZE];
+  char topicPrefix[DEVICE_PREFIX_SIZE];
+  char broker[64];
+  uint16_t port;
+};
+
+void loadDeviceConfig(); // Before anything publishes or subscribes
+const DeviceConfig& deviceConfig();
+
+#endif
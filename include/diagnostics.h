@@ -0,0 +1,83 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "hal.h"
+
+class TextBuffer;
+
+// --- SUBSYSTEM INSTRUMENTATION ---
+// Each probe times one subsystem with the cycle counter (halCycleCount) and keeps
+// a count, the total and worst time, and a log2 histogram: bucket 0 is < 1 us,
+// bucket b counts times in [2^(b-1), 2^b) us, the last bucket everything longer.
+// A probe has exactly one writer task, so its words are plain volatile stores;
+// the diagnostics report reads them from the network task. The control tick
+// itself is not probed: it is short and frequent, and tasks.cpp already tracks
+// its worst case.
+
+enum DiagProbe {
+  DIAG_SENSORS,       // updateSensors() (control task)
+  DIAG_SAMPLER_READ,  // One INA3221 burst scan, all channels (sampler task)
+  DIAG_MQTT_CALLBACK, // mqttCallback() (network task)
+  DIAG_MQTT_PUBLISH,  // One mqtt_client.publish() (network task)
+  DIAG_MQTT_CONNECT,  // One broker connect attempt (network task)
+  DIAG_TELEGRAM_POLL, // One getUpdates() long-poll (Telegram listener)
+  DIAG_TELEGRAM_SEND, // One sendMessage request (Telegram worker)
+  DIAG_PROBE_COUNT
+};
+
+// Events counted by the network task
+enum DiagCounter {
+  DIAG_WIFI_RECONNECTS,    // WiFi lost after having been up
+  DIAG_MQTT_RECONNECTS,    // Broker sessions after the first
+  DIAG_MQTT_CONNECT_FAILS,
+  DIAG_PUBLISH_FAILS,      // mqtt_client.publish() returned false
+  DIAG_COUNTER_COUNT
+};
+
+// Boot milestones: uptime of the first time each one happened (0 = not yet)
+enum DiagMilestone {
+  DIAG_BOOT_FIRST_SAMPLE,  // First INA3221 read (sampler task)
+  DIAG_BOOT_WIFI,          // WiFi associated with an IP (network task)
+  DIAG_BOOT_MQTT,          // Broker session up (network task)
+  DIAG_BOOT_FIRST_PUBLISH, // First publish accepted (network task)
+  DIAG_MILESTONE_COUNT
+};
+
+struct DiagProbeStats {
+  uint32_t count;
+  uint32_t totalMicros;
+  uint32_t maxMicros;  // Since the last report
+  uint32_t buckets[DIAG_HISTOGRAM_BUCKETS];
+};
+
+void diagBegin(); // Measures what one probe costs; call once before the tasks start
+void diagRecord(DiagProbe probe, uint32_t startCycles);
+void diagCount(DiagCounter counter);
+void diagRegisterTask(const char* name, TaskHandle_t task); // Reported with its stack high-water mark
+void diagMilestone(DiagMilestone milestone); // Only the first call counts
+uint32_t diagMilestoneMillis(DiagMilestone milestone);
+void diagAppendMilestones(TextBuffer& out); // {"first_sample":..,"wifi":..,..}
+
+DiagProbeStats diagProbeStats(DiagProbe probe);
+uint32_t diagCounter(DiagCounter counter);
+uint32_t diagProbeCycles(); // Cost of one probe (start + record), from diagBegin()
+uint32_t diagTotalProbes(); // Probes recorded since boot, all subsystems
+
+// The whole report as JSON, into static storage (network task only). Resets the
+// per-report worst times.
+const char* diagFormatReport();
+
+// Times the enclosing scope
+class DiagScope {
+public:
+  explicit DiagScope(DiagProbe probe) : probe_(probe), start_(halCycleCount()) {}
+  ~DiagScope() { diagRecord(probe_, start_); }
+
+private:
+  DiagProbe probe_;
+  uint32_t start_;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include "messages.h"
+
+class TextBuffer;
+
+// --- POWER-CUT EVENT LOG ---
+// Every outage becomes one 32-byte record in a ring of EVENT_LOG_CAPACITY slots
+// in flash (halEventStore*), the oldest overwritten first. Records are numbered
+// from 1 (the id, never reused) and carry a CRC, so setupEventLog() rebuilds the
+// state from the slots alone and skips a record torn by a reset.
+//
+// The time index is one word per EVENT_INDEX_STRIDE ids: the latest start time
+// seen up to the first record of that stride. It never decreases, even across
+// records without a wall-clock time (NTP not synced), so "events since T" is a
+// binary search plus at most one stride of slot reads.
+//
+// Dashboards backfill with range queries on mqtt_event_query_topic:
+//   {"since":<epoch s>,"limit":N}  first page, events starting at or after since
+//   {"after":<id>,"limit":N}       next page, events after the id in log order
+// and get one page on mqtt_event_page_topic:
+//   {"first":..,"last":..,"events":[{"id":..,"start":..,"end":..,..},..],"next":<id or 0>}
+// Nothing is sent unasked. Network task only.
+
+struct EventQuery {
+  uint32_t since; // Epoch seconds; used when after is 0
+  uint32_t after; // Cursor: the "next" of the previous page
+  uint8_t limit;  // 1 .. EVENT_PAGE_LIMIT
+};
+
+void setupEventLog(); // Scans the slots and rebuilds the index
+
+// Stores one outage; start/end in epoch seconds, 0 if unknown. Returns its id, 0 on a write error.
+uint32_t eventLogAppend(const PowerCutEvent& event, uint32_t startEpoch, uint32_t endEpoch);
+
+// Parses a query payload (not NUL-terminated); false if it is not one
+bool eventLogParseQuery(const uint8_t* payload, size_t length, EventQuery& query);
+bool eventLogQueueQuery(const EventQuery& query); // From mqttCallback; false if the queue is full
+bool eventLogNextQuery(EventQuery& query);
+
+// Formats one page into out (sized EVENT_PAGE_SIZE); returns the events in it
+size_t eventLogFormatPage(const EventQuery& query, TextBuffer& out);
+
+uint32_t eventLogFirstId(); // Oldest id still in flash, 0 if empty
+uint32_t eventLogLastId();  // Newest id, 0 if empty
+uint32_t eventLogSlotReads(); // Slot reads since boot (queries + the boot scan)
+
+#endif
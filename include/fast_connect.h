@@ -0,0 +1,20 @@
+#ifndef FAST_CONNECT_H
+#define FAST_CONNECT_H
+
+#include <Arduino.h>
+
+// --- FAST WIFI RECONNECT ---
+// After a successful association the BSSID, channel and IP settings are cached in
+// RTC memory (survives a reset or brownout) and in NVS (survives a power cut;
+// written only when they change). On the next boot the first attempt joins that
+// access point directly with the cached static IP, skipping the scan and DHCP. If
+// it has not associated within WIFI_FAST_CONNECT_TIMEOUT, the cache is dropped
+// and the normal scan + DHCP path takes over.
+
+void setupFastConnect();     // WiFi mode and flash settings; before the first WiFi.begin()
+bool fastConnectBegin();     // Starts a cached attempt; false if there is no cache
+void fastConnectSave();      // Once connected: remember this AP and lease
+void fastConnectAbandon();   // Cached attempt failed: forget it, back to DHCP
+bool fastConnectUsed();      // The current link came up through the cache
+
+#endif
@@ -2,17 +2,31 @@
 #define GLOBALS_H
 
 #include <Arduino.h>
+#include "config.h"
+#include "messages.h"
+#include "spsc_queue.h"
+
+// --- SHARED OBJECTS (board only; the native build reaches them through hal.h) ---
+#ifdef ARDUINO
 #include <WiFi.h>           // <--- Critical Fix
 #include <PubSubClient.h>
 #include <Wire.h>
 #include "INA3221.h"
+#include "mqtt_transport.h"
 
-// --- SHARED OBJECTS ---
 extern WiFiClient espClient;
+extern MqttTransport mqttTransport; // espClient, plus CONNACK/PUBACK tracking and QoS 1 publishes
 extern PubSubClient mqtt_client;
 extern INA3221 INA;
+#endif
+
+// --- INTER-CORE QUEUES ---
+extern SpscQueue<SensorSample, SAMPLE_QUEUE_SIZE> sampleQueue;       // control -> network
+extern SpscQueue<OutboundMessage, OUTBOUND_QUEUE_SIZE> outboundQueue; // control -> network
+extern SpscQueue<ControlCommand, COMMAND_QUEUE_SIZE> commandQueue;   // network -> control
+extern SpscQueue<PowerCutEvent, EVENT_QUEUE_SIZE> eventQueue;        // control -> network
 
-// --- SHARED STATE VARIABLES ---
+// --- SHARED STATE VARIABLES (owned by the control task) ---
 extern bool powerCutDetected;
 extern bool emergencyModeActive;
 extern bool manualEmergencyControl;
@@ -23,18 +37,8 @@ extern float totalEnergyConsumed;
 extern float startVoltage;
 extern float endVoltage;
 
-// --- SHARED SENSOR VALUES ---
-extern float shared_v1; // Main Voltage
-extern float shared_c1; // Main Current
-extern float shared_p1; // Main Power
-extern float shared_v2; // System Voltage
-extern float shared_c2; // System Current
-extern float shared_p2; // System Power
-extern float shared_intensity; // Light Intensity
-
 extern unsigned long emergencyStartTime;
 extern unsigned long gpio14ActivationTime;
 extern unsigned long powerCutStartTime;
-extern unsigned long lastEnergyCalcTime;
 
-#endif
\ No newline at end of file
+#endif
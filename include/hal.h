@@ -0,0 +1,82 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#include "ina3221_scan.h"
+
+// --- HARDWARE ABSTRACTION LAYER ---
+// The portable control logic (hardware.cpp, commands.cpp, outbound.cpp) only
+// touches the board through these calls. hal_esp32.cpp maps them to the Arduino
+// core and the INA3221 driver; the native build maps them to the simulator in
+// sim/ (simulated GPIO, scripted INA3221, virtual clock).
+
+// --- GPIO ---
+void halPinMode(uint8_t pin, uint8_t mode);
+void halDigitalWrite(uint8_t pin, uint8_t level);
+int halDigitalRead(uint8_t pin);
+
+// --- TIME ---
+unsigned long halMillis();
+unsigned long halMicros();
+void halDelayMicroseconds(unsigned int us);
+uint32_t halEpochSeconds(); // Wall clock (NTP), 0 until it has synced
+
+// --- CYCLE COUNTER ---
+// For timing code sections (diagnostics.h). CCOUNT on the board (per core, so a
+// section must start and end on the same core); ns from std::chrono on the host.
+uint32_t halCycleCount();
+uint32_t halCyclesPerMicro();
+
+// --- MEMORY ---
+uint32_t halFreeHeap();                  // Bytes
+uint32_t halMinFreeHeap();               // Lowest free heap since boot
+uint32_t halStackFree(TaskHandle_t task); // Bytes of the task's stack never used
+
+// --- INA3221 ---
+bool halSensorBegin();                 // Bus + sensor, shunts configured
+bool halSensorScan(SensorScan& scan);   // All three channels in one burst; false on a bus error
+// Bus at I2C_CLOCK_HZ, continuous shunt + bus conversions with the datasheet's
+// AVG and VBUSCT/VSHCT field indexes (0-7)
+void halSensorConfigure(uint8_t averageIndex, uint8_t conversionIndex);
+
+// --- SAMPLE TIMER ---
+// Calls tick() every periodMicros from a task on the control core, above the
+// control task; missed = periods that went by while the last tick still ran.
+// Hardware timer 0 on the board; simAdvance() in the native build. Returns the
+// task (NULL in the native build).
+typedef void (*HalSampleTickFn)(uint32_t missed);
+TaskHandle_t halSampleTimerStart(uint32_t periodMicros, HalSampleTickFn tick);
+
+// --- EVENT STORE ---
+// Fixed-size record slots in flash for the event log (event_log.h). Slots never
+// written read back as zeros.
+bool halEventStoreBegin(size_t slots, size_t recordSize);
+bool halEventStoreRead(size_t slot, void* record);
+bool halEventStoreWrite(size_t slot, const void* record); // Durable once it returns true
+
+// --- STATE CHECKPOINT ---
+// One record of up to CHECKPOINT_RECORD_MAX bytes (control_state.h), kept twice.
+// RTC memory survives brownout, watchdog and software resets and costs a memcpy;
+// it reads back garbage after power-on, which the record's check rejects. NVS
+// survives anything but is a flash write: network task only.
+bool halStateRtcRead(void* record, size_t size);
+void halStateRtcWrite(const void* record, size_t size);
+bool halStateNvsRead(void* record, size_t size); // False if never written
+bool halStateNvsWrite(const void* record, size_t size);
+
+// --- JOURNAL STORE ---
+// Numbered append-only segments for the sample journal (journal.h), plus the
+// replay cursor and a boot counter in NVS. A segment that was never written
+// reads back as 0 bytes. Network task only.
+bool halJournalBegin();
+typedef void (*HalJournalSegmentFn)(uint32_t segment, uint32_t bytes);
+void halJournalList(HalJournalSegmentFn found); // Every segment on flash, in no particular order
+uint32_t halJournalSize(uint32_t segment);      // Bytes
+bool halJournalAppend(uint32_t segment, const void* data, size_t length); // Durable once it returns true
+size_t halJournalRead(uint32_t segment, uint32_t offset, void* data, size_t length); // Bytes read
+void halJournalRemove(uint32_t segment);
+uint32_t halJournalBoot(); // Counts this boot; returns the count
+bool halJournalCursorRead(uint32_t& segment, uint32_t& records); // False if never written
+void halJournalCursorWrite(uint32_t segment, uint32_t records);  // One NVS entry: both or neither
+
+#endif
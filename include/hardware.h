@@ -2,12 +2,25 @@
 #define HARDWARE_H
 
 #include <Arduino.h>
+#include "messages.h"
 
 // Setup function for pins and sensors
 void setupHardware();
 
-// Main logic loops (called repeatedly)
-void updateSensors();          // Reads INA3221 and Intensity
+// Main logic loops (called repeatedly by the control task)
+void runControlTick();         // One full control tick: everything below, in order
+void updateSensors(const PowerReading& reading); // Adds intensity, queues the sample, power-cut logic
 void handleEmergencyLogic();   // Manages the 1-minute timer and power cut logic
-void forceSensorUpdate(); // Tool to force immediate sensor update(light intensity)
+void handlePowerDetect();      // Confirms detect-pin cuts, reacts to INA3221 alerts
+void handleIntensityInput();   // Takes settled intensity changes, drives the emergency light
+uint32_t emergencyLightToggles(); // Automatic emergency light switches since boot
+void forceSensorUpdate(uint8_t flags); // Tool to force immediate sensor update (Telegram /status)
+void processCommands();        // Applies MQTT/Telegram commands queued by the network task
+
+// --- NON-BLOCKING OUTPUT SEQUENCES ---
+// Timed GPIO actions that used to delay() are state machines serviced by serviceOutputs()
+void pulseOutput(uint8_t pin, uint8_t activeLevel, unsigned long durationMs); // Hold pin at activeLevel, then release
+void strobeOutput(uint8_t pin, uint8_t strobeLevel);  // 10 us strobe (short enough to stay inline)
+void startSystemOffSequence();  // GPIO13 OFF, then GPIO14 strobe(s) 1 s later
+void serviceOutputs();          // Advances pending pulses/sequences (call every loop pass)
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef INA3221_SCAN_H
+#define INA3221_SCAN_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// --- INA3221 BURST SCAN ---
+// One scan reads the six result registers (shunt and bus for channels 1-3,
+// 0x01-0x06) in a single I2C transaction: each register is a pointer write and
+// a 2-byte read joined by repeated STARTs, with one STOP at the end. The INA3221
+// does not auto-increment its register pointer, so six pointer writes is the
+// minimum. Decoding is integer only: shunt LSB 40 uV, bus LSB 8 mV, both 13-bit
+// two's complement in bits 15..3.
+
+const int INA3221_CHANNELS = 3;
+const size_t INA3221_SCAN_REGISTERS = 2 * INA3221_CHANNELS;
+const uint8_t INA3221_FIRST_RESULT_REGISTER = 0x01; // CH1 shunt, CH1 bus, CH2 shunt, ...
+
+struct SensorScan {
+  int32_t busMillivolts[INA3221_CHANNELS];
+  int32_t currentMicroamps[INA3221_CHANNELS]; // Signed, through SHUNT_MILLIOHMS
+};
+
+// raw: the registers in scan order, big-endian as they come off the bus
+void ina3221Decode(const uint8_t raw[INA3221_SCAN_REGISTERS][2], SensorScan& scan);
+
+// Inverse, for the simulator: what the registers would hold for these values
+void ina3221Encode(const int32_t busMillivolts[INA3221_CHANNELS], const int32_t currentMicroamps[INA3221_CHANNELS],
+                   uint8_t raw[INA3221_SCAN_REGISTERS][2]);
+
+// SCL periods one scan keeps the bus busy (START/STOP counted as one each)
+uint32_t ina3221ScanBusClocks();
+uint32_t ina3221ScanBusMicros(uint32_t clockHz);
+
+#endif
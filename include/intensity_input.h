@@ -0,0 +1,32 @@
+#ifndef INTENSITY_INPUT_H
+#define INTENSITY_INPUT_H
+
+#include <Arduino.h>
+
+// --- INTERRUPT-DRIVEN LIGHT INTENSITY INPUT ---
+// The 3-bit intensity code on INTENSITY_B0..B2_PIN is watched with pin-change
+// interrupts. The ISR only stamps the edge and wakes the control task; the task
+// reads the three pins once no edge has arrived for INTENSITY_DEBOUNCE_MS. The
+// pins of one code change do not switch together, so the code is only taken
+// after the whole change has settled. A settled code equal to the last one was a
+// glitch and is counted as a bounce.
+
+void setupIntensityInput(TaskHandle_t controlTask);
+
+// Control task only. Call on every wake; true once per settled new code (and
+// once at startup with the initial code).
+bool intensityPoll();
+bool intensityDebouncePending(); // An edge is waiting out the debounce
+uint8_t intensityCode();         // Last settled code, 0-7
+float intensityPercent();        // Same, as 0-100 %
+
+struct IntensityStats {
+  uint32_t edges;              // Pin-change interrupts
+  uint32_t changes;            // Settled code changes
+  uint32_t bounces;            // Edges that settled back on the same code
+  unsigned long lastLatencyMicros;  // First edge -> new code taken (debounce included)
+  unsigned long worstLatencyMicros;
+};
+IntensityStats intensityStats();
+
+#endif
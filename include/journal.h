@@ -0,0 +1,34 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include "messages.h"
+
+// --- STORE-AND-FORWARD SAMPLE JOURNAL ---
+// Samples taken while MQTT is down are appended to fixed-size segment files on
+// LittleFS (/journal/NNNNNNNN.bin). Each record is a packed telemetry frame, so
+// replay simply republishes it on mqtt_telemetry_frame_topic with the original
+// NTP time. Fully replayed segments are deleted; when the journal is full the
+// oldest segment is dropped. LittleFS spreads the writes across the partition.
+// The replay position is saved in NVS once a batch is delivered (handed to the
+// socket), so a reboot part way through a segment resumes where it stopped. A
+// batch still in the RAM outbox at a reset is sent again: at least once, never
+// lost. Network task only.
+
+typedef bool (*JournalSendFn)(const uint8_t* frame, size_t length);
+
+void setupJournal();
+bool journalAppend(const SensorSample& sample);
+
+// Sends up to maxRecords of the oldest backlog through send().
+// Stops early if send() fails. Returns the number of records sent.
+// Sends nothing while the previous batch is unsettled.
+size_t journalReplay(size_t maxRecords, JournalSendFn send);
+// The last batch was delivered (the cursor moves past it) or lost (it is sent again)
+void journalReplaySettled(bool delivered);
+uint32_t journalUnsettledRecords(); // Sent, waiting for journalReplaySettled()
+
+uint32_t journalPendingRecords();
+uint32_t journalDroppedRecords(); // Lost because the journal was full
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include <Arduino.h>
+
+// --- MESSAGES PASSED BETWEEN THE CONTROL AND NETWORK CORES ---
+
+// Sample flags
+const uint8_t SAMPLE_FORCED = 0x01;       // Taken on demand for a Telegram /status report
+const uint8_t SAMPLE_SYSTEM_WOKEN = 0x02; // GPIO13 was woken just for this sample
+const uint8_t SAMPLE_REPLAYED = 0x04;     // Sent late from the flash journal
+
+// Control core -> network core: one INA3221 + intensity reading
+struct SensorSample {
+  uint32_t sequence;
+  unsigned long timestamp; // millis() when the sample was taken
+  float v1, c1, p1;        // Channel 1 (Main Power): V, mA, mW
+  float v2, c2, p2;        // Channel 2 (System Power): V, mA, mW
+  float intensity;         // Light intensity %
+  uint8_t flags;
+};
+
+// Sampler task -> control task: one decimated window of high-rate INA3221 samples
+const int POWER_CHANNELS = 2;
+
+struct PowerReading {
+  unsigned long timestamp;         // millis() at the end of the window
+  uint16_t count;                  // Raw samples in the window
+  uint8_t flags;                   // SAMPLE_* flags requested for this window
+  float voltage[POWER_CHANNELS];   // Mean V
+  float current[POWER_CHANNELS];   // Mean mA
+  float power[POWER_CHANNELS];     // Mean mW
+  float lastVoltage[POWER_CHANNELS]; // Most recent raw V (power-cut detection)
+  float energy[POWER_CHANNELS];    // mWh integrated over this window (trapezoidal, full rate)
+};
+
+// Control core -> network core: a status publish or a Telegram alert
+enum OutboundChannel : uint8_t { OUT_MQTT, OUT_TELEGRAM };
+
+const size_t OUTBOUND_PAYLOAD_SIZE = 200;
+
+struct OutboundMessage {
+  OutboundChannel channel;
+  const char* topic; // One of the mqtt_*_topic constants (unused for Telegram)
+  char payload[OUTBOUND_PAYLOAD_SIZE];
+};
+
+// Control core -> network core: one outage, once power is back (event_log.h)
+struct PowerCutEvent {
+  unsigned long startMillis; // millis() at the cut
+  unsigned long endMillis;   // millis() at the restore
+  float startVoltage;        // Main V at the cut
+  float endVoltage;          // Main V at the restore
+  float minVoltage;          // Lowest main V during the cut
+  float energy;              // mWh drawn during the cut
+};
+
+// Network core -> control core: a command received over MQTT or Telegram
+enum CommandTarget : uint8_t {
+  CMD_LED,             // Built-in LED
+  CMD_SYSTEM,          // GPIO13
+  CMD_GPIO14,          // GPIO14
+  CMD_EMERGENCY_LIGHT, // POWER_STATUS_PIN
+  CMD_STATUS_REPORT,   // Wake if needed and take a forced sample
+  CMD_EVENT_QUERY,     // Event log query: answered on the network task, never queued
+  CMD_OTA,             // Update URL: started on the network task, never queued
+  CMD_SNAPSHOT,        // Latest-reading request: answered on the network task, never queued
+  CMD_RESAMPLE         // End the sampler window now: the snapshot is too old for a reader
+};
+
+enum CommandAction : uint8_t { ACTION_ON, ACTION_OFF, ACTION_PULSE, ACTION_AUTO, ACTION_NONE };
+
+struct ControlCommand {
+  CommandTarget target;
+  CommandAction action;
+};
+
+#endif
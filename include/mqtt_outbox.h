@@ -0,0 +1,60 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// --- MQTT OUTBOX ---
+// Every publish is queued here and written by the network task a bounded number
+// of bytes per scheduler pass, so a full TCP window costs one pass a little
+// time instead of stalling every producer. Three lanes, drained in order:
+//   ALARM  - power cut, history and emergency light state. QoS 1: kept until the
+//            broker's PUBACK, at most MQTT_INFLIGHT_WINDOW unacked, resent with
+//            DUP after MQTT_ACK_TIMEOUT and after every reconnect.
+//   STATE  - telemetry, status and command logs (QoS 0)
+//   BULK   - the large periodic reports and event log pages (QoS 0)
+// Each lane is a byte ring of variable-length records; when it is full the
+// oldest record is dropped and counted. Network task only: no locking.
+
+enum MqttLane : uint8_t {
+  MQTT_LANE_ALARM,
+  MQTT_LANE_STATE,
+  MQTT_LANE_BULK,
+  MQTT_LANE_COUNT
+};
+
+// Writes one PUBLISH; packetId 0 means QoS 0. False if the socket did not take it.
+typedef bool (*MqttWriteFn)(const char* topic, const uint8_t* payload, size_t length, uint16_t packetId, bool dup);
+
+MqttLane mqttLaneFor(const char* topic); // By topic: one of the mqtt_*_topic pointers
+
+// topic must outlive the record (the mqtt_*_topic table does)
+bool mqttOutboxPush(MqttLane lane, const char* topic, const uint8_t* payload, size_t length);
+bool mqttOutboxFits(MqttLane lane, size_t length); // Room without dropping anything
+
+// Writes queued records, highest lane first, until byteBudget is spent or a
+// write fails. Returns the bytes written.
+size_t mqttOutboxService(MqttWriteFn write, unsigned long now, size_t byteBudget);
+void mqttOutboxAck(uint16_t packetId);
+void mqttOutboxReconnected(); // Unacked QoS 1 records go out again, with DUP
+void mqttOutboxReset();       // Everything dropped, stats cleared (native benchmarks)
+
+struct MqttLaneStats {
+  uint32_t depth;     // Records queued, in flight included
+  uint32_t bytes;     // Ring bytes they take
+  uint32_t highWater; // Most ring bytes ever used
+  uint32_t queued;    // Records ever pushed; queued - depth have left the ring
+  uint32_t sent;
+  uint32_t dropped;   // Oldest records pushed out by a full ring
+};
+
+struct MqttOutboxStats {
+  MqttLaneStats lanes[MQTT_LANE_COUNT];
+  uint32_t inflight;    // QoS 1 records waiting for a PUBACK
+  uint32_t acked;
+  uint32_t redelivered; // QoS 1 records sent again (timeout or reconnect)
+};
+
+MqttOutboxStats mqttOutboxStats();
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MQTT_TRANSPORT_H
+#define MQTT_TRANSPORT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// --- MQTT TRANSPORT ---
+// Sits between PubSubClient and the socket and forwards everything. PubSubClient
+// reads every inbound byte through here, so the packet framing is followed on the
+// side to pick up what PubSubClient drops:
+//   CONNACK (0x20 0x02 <flags> <rc>): the "session present" flag. With a
+//     clean-session=false connect it means the broker still has our subscriptions
+//     and queued QoS 1 messages, so we do not subscribe again.
+//   PUBACK (0x40 0x02 <id>): acks for our QoS 1 publishes (mqtt_outbox.h).
+typedef void (*MqttAckFn)(uint16_t packetId);
+
+class MqttTransport : public Client {
+public:
+  explicit MqttTransport(Client& inner) : inner_(inner), ackFn_(NULL) { resetFraming(); }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override { return inner_.write(b); }
+  size_t write(const uint8_t* buf, size_t size) override { return inner_.write(buf, size); }
+  int available() override { return inner_.available(); }
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override { return inner_.peek(); }
+  void flush() override { inner_.flush(); }
+  void stop() override { inner_.stop(); }
+  uint8_t connected() override { return inner_.connected(); }
+  operator bool() override { return (bool)inner_; }
+
+  void onPubAck(MqttAckFn ackFn) { ackFn_ = ackFn; }
+  bool sessionPresent() const { return sessionPresent_; } // For the last connect
+
+  // A QoS 1 PUBLISH written straight to the socket (PubSubClient only sends QoS 0)
+  bool publishQos1(const char* topic, const uint8_t* payload, size_t length, uint16_t packetId, bool dup);
+
+private:
+  enum FrameState : uint8_t { FRAME_TYPE, FRAME_LENGTH, FRAME_BODY };
+
+  void resetFraming();
+  void consume(uint8_t b);
+  void packetDone();
+
+  Client& inner_;
+  MqttAckFn ackFn_;
+  bool sessionPresent_;
+  FrameState state_;
+  uint8_t type_;
+  uint32_t remaining_;
+  uint32_t multiplier_;
+  uint32_t bodyRead_;
+  uint8_t body_[2]; // Only the start of the body is kept: CONNACK and PUBACK are 2 bytes
+};
+
+#endif
@@ -13,9 +13,20 @@ void checkNetwork();
 // The function that runs when a message arrives
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 
+// Publishes samples/status messages queued by the control core (network task only)
+void serviceTelemetry();
+void replayJournal(); // Sends the flash backlog once MQTT is back
+void serviceTelegramCommands(); // Acts on commands from the Telegram listener task
+void publishReportStats(); // Report-by-exception counters (sent / suppressed per topic)
+void publishDiagnostics(); // Subsystem latency histograms and counters (diagnostics.h)
+void serviceMqttOutbox(); // Writes queued publishes, alarms first (mqtt_outbox.h)
+void serviceEventLog(); // Logs finished outages to flash, answers event log queries (event_log.h)
+void serviceOta(); // Update progress and the verdict on a freshly updated image (ota_update.h)
+
+// Queues a publish in the outbox lane of its topic; false if it can never fit (network task only)
+bool mqttPublish(const char* topic, const char* payload);
+bool mqttPublish(const char* topic, const uint8_t* payload, size_t length);
+
 // Helper to send status updates
 void publishCommandStatus(const char* message);
-
-//Telegram message sender   
-void sendTelegramMessage(String message);
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef OTA_IMAGE_H
+#define OTA_IMAGE_H
+
+#include <Arduino.h>
+
+// --- OTA IMAGE STREAM ---
+// What an update delivers once it is inflated (ota_update.h does the HTTP and
+// zlib side; backend/ota-image.js builds the files). Little-endian:
+//   header: "PCOT" | u8 version | u8 flags | u16 reserved | u32 image size
+//           | 32 B SHA-256 of the running image a delta was built against (the
+//             ESP image digest, what esp_partition_get_sha256() returns)
+//           | 32 B SHA-256 of the new image
+//           | 64 B ECDSA P-256 signature (r | s) of that SHA-256
+//   full:   image size bytes of firmware
+//   delta:  ops until image size bytes were produced
+//           0x01 COPY u32 offset u32 length - bytes of the running image
+//           0x02 DATA u32 length + bytes     - new bytes
+// The decoder is fed the stream in pieces of any size and hands the new image to
+// the sink in order, so nothing is ever buffered whole. It only parses the
+// signature; ota_update.cpp checks it against OTA_SIGNING_KEY and the SHA-256 of
+// what was written.
+
+const uint32_t OTA_IMAGE_MAGIC = 0x544F4350; // "PCOT"
+const uint8_t OTA_IMAGE_VERSION = 2;          // 2: signed
+const uint8_t OTA_IMAGE_DELTA = 0x01;        // flags
+const size_t OTA_IMAGE_HEADER_SIZE = 140;
+const uint8_t OTA_OP_COPY = 0x01;
+const uint8_t OTA_OP_DATA = 0x02;
+
+typedef bool (*OtaSourceFn)(uint32_t offset, uint8_t* buffer, size_t length); // Reads the running image
+typedef bool (*OtaSinkFn)(const uint8_t* data, size_t length);                 // Takes the new image, in order
+
+enum OtaImageResult : uint8_t {
+  OTA_IMAGE_MORE,  // Consumed; feed the next piece
+  OTA_IMAGE_DONE,  // The whole image went to the sink (bytes past it are ignored)
+  OTA_IMAGE_ERROR, // See otaImageError()
+};
+
+struct OtaImageHeader {
+  uint8_t version;
+  uint8_t flags;
+  uint32_t imageSize;
+  uint8_t baseSha256[32];
+  uint8_t imageSha256[32];
+  uint8_t signature[64];
+};
+
+void otaImageBegin(OtaSourceFn source, OtaSinkFn sink);
+OtaImageResult otaImageFeed(const uint8_t* data, size_t length);
+
+bool otaImageHeaderReady();             // The first OTA_IMAGE_HEADER_SIZE bytes were parsed
+const OtaImageHeader& otaImageHeader();
+uint32_t otaImageProduced();            // Bytes handed to the sink so far
+const char* otaImageError();            // NULL while nothing went wrong
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+
+// --- OVER-THE-AIR UPDATES ---
+// A URL published on mqtt_ota_topic starts an update. A low-priority task on the
+// network core streams the file over HTTP in OTA_CHUNK_SIZE pieces, inflates it
+// if it is zlib-compressed (the ROM's tinfl, 32 KB window), decodes the image
+// stream (ota_image.h, full or delta against the running image) and writes the
+// result into the inactive app partition with sequential writes, one 4 KB
+// sector erased at a time. Nothing is buffered whole. The topic is open to
+// anyone on the broker, so every image must be signed (ota_image.h): nothing
+// reaches flash unless the header's signature checks out against
+// ota_signing_key, and the boot partition is only switched if what was written
+// hashes to the signed SHA-256. The device then restarts once no power cut is
+// in progress.
+//
+// The new image boots pending verification. It is marked valid once it has
+// sampled and published; if that has not happened within OTA_VERIFY_TIMEOUT, or
+// it resets before, the bootloader goes back to the previous image.
+
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_DOWNLOADING,
+  OTA_DONE,    // Boot partition switched, restart pending
+  OTA_FAILED,
+};
+
+struct OtaStatus {
+  OtaState state;
+  uint16_t attempt;          // Counts requests, so each outcome is reported once
+  const char* error;         // Static text, NULL unless failed
+  bool delta;
+  uint32_t bytesIn;          // Downloaded (compressed)
+  uint32_t bytesOut;         // Written to flash
+  uint32_t imageSize;        // From the image header, 0 until it arrived
+  uint32_t downloadMillis;   // Request to last byte
+  uint32_t flashMillis;      // Spent in flash erase/write
+  unsigned long jitterMicros; // Worst sample timer jitter since the update started
+  uint32_t sampleOverruns;   // Sample ticks missed since the update started
+};
+
+void setupOta(); // Before the tasks: notes whether this boot is an unverified update
+
+// Network task. False if an update is already running, this image is unverified
+// or no signing key was compiled in.
+bool otaRequest(const char* url, size_t length);
+OtaStatus otaStatus();
+
+// Network task: marks a pending image valid once it proved itself, or rolls back.
+// True once, right after the image was marked valid.
+bool otaCheckHealth();
+const char* otaRunningPartition(); // Label of the partition we booted from
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef OUTBOUND_H
+#define OUTBOUND_H
+
+#include <Arduino.h>
+
+// --- CONTROL -> NETWORK HELPERS (control task only) ---
+// Queue messages on outboundQueue; the network task publishes them.
+bool queuePublish(const char* topic, const char* payload);
+bool queueCommandStatus(const char* message); // Publishes on mqtt_command_status_topic + Serial
+bool queueTelegram(const char* message);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef POWER_DETECT_H
+#define POWER_DETECT_H
+
+#include <Arduino.h>
+
+// --- INTERRUPT-DRIVEN POWER-CUT DETECTION ---
+// POWER_DETECT_PIN: the ISR switches GPIO13 ON in the interrupt itself (a couple
+// of microseconds after the edge) and wakes the control task, which confirms the
+// cut once the pin has been stable for POWER_DETECT_DEBOUNCE_MS and then runs the
+// rest of the emergency sequence. A bounce that does not last is a false alarm
+// and GPIO13 is put back.
+// INA3221 CRITICAL/WARNING: the ISR wakes the control task, which asks the sampler
+// for an immediate reading instead of waiting for the end of the window.
+// The sampled voltage check stays in place as a cross-check for both.
+
+void setupPowerDetect(TaskHandle_t controlTask);
+
+// Control task only. Call on every wake; returns true once when a cut is confirmed.
+bool powerDetectConfirmCut();
+bool powerDetectPinCut(); // Pin currently reads POWER_CUT_STATE
+bool powerDetectConfirmPending(); // An edge is waiting out the debounce
+
+// Control task only: true once per INA3221 alert edge
+bool powerDetectTakeAlert();
+
+struct PowerDetectStats {
+  uint32_t edges;               // Detect pin interrupts
+  uint32_t alerts;              // INA3221 alert interrupts
+  uint32_t falseAlarms;         // Edges that did not survive the debounce
+  unsigned long lastGpioMicros;  // Edge -> GPIO13 written (last confirmed cut)
+  unsigned long worstGpioMicros;
+  unsigned long lastHandoffMicros; // Edge -> control task running the sequence
+};
+PowerDetectStats powerDetectStats();
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef READING_SNAPSHOT_H
+#define READING_SNAPSHOT_H
+
+#include <Arduino.h>
+
+class TextBuffer;
+
+// --- LATEST-READING SNAPSHOT ---
+// The control task publishes every reading, together with the output levels and
+// the cut/sequence flags, as one snapshot behind a seqlock. Readers on the
+// network core (Telegram /status, status/get over MQTT, GET /status over HTTP)
+// copy it in constant time and never see half of one reading and half of the
+// next; they also get its age. Only a snapshot older than SNAPSHOT_MAX_AGE
+// (the control task or the sampler stalled) makes them ask for a fresh reading.
+//
+// One writer. A reader retries while a write is in progress, so it must not
+// run on the writer's core at a higher priority: all readers are on the
+// network core (tasks.h).
+
+struct ReadingSnapshot {
+  uint32_t sequence;   // SensorSample::sequence of the reading
+  uint32_t timestamp;  // millis() when it was taken
+  float v1, c1, p1;    // Channel 1 (Main Power): V, mA, mW
+  float v2, c2, p2;    // Channel 2 (System Power): V, mA, mW
+  float intensity;     // Light intensity %
+  uint8_t outputs;     // CONTROL_OUT_* levels (control_state.h), current, not resting
+  uint8_t flags;       // SAMPLE_* flags of the reading
+  bool powerCut;
+  bool emergencyMode;
+};
+
+struct SnapshotStats {
+  uint32_t writes;
+  uint32_t reads;
+  uint32_t retries;   // Reads that overlapped a write and went round again
+  uint32_t resamples; // Fresh readings asked for because the snapshot was too old
+};
+
+// Control task only
+void snapshotPublish(const ReadingSnapshot& snapshot);
+
+// Any task on the network core. False until the first reading.
+bool snapshotRead(ReadingSnapshot& snapshot);
+uint32_t snapshotAge(const ReadingSnapshot& snapshot); // ms since the reading was taken
+void snapshotFormat(const ReadingSnapshot& snapshot, TextBuffer& out); // JSON, with the age
+
+// Network task: asks the control task to end the sampler window now, once per
+// SNAPSHOT_RESAMPLE_TIMEOUT at most
+void snapshotRequestResample();
+
+// status/get: mqttCallback() takes the request, the network task answers it
+// once the snapshot is fresh, or the resample timed out
+void snapshotRequest();
+bool snapshotAnswerReady(ReadingSnapshot& snapshot);
+
+SnapshotStats snapshotStats();
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef REPORT_FILTER_H
+#define REPORT_FILTER_H
+
+#include <Arduino.h>
+#include "messages.h"
+#include "text_buffer.h"
+
+// --- REPORT BY EXCEPTION ---
+// Each text telemetry topic is only published when its value has moved by more
+// than its deadband or by more than REPORT_PERCENT_CHANGE since the last value
+// actually sent (the percent test only for values at least
+// REPORT_PERCENT_MIN_DEADBANDS deadbands from zero), or when REPORT_HEARTBEAT_MS
+// has passed without a publish (so consumers can still tell a quiet device from
+// a dead one). Every topic counts sent and suppressed messages. Network task only.
+
+typedef bool (*ReportPublishFn)(const char* topic, const char* payload);
+
+// Publishes the signals of one sample that pass the filter; returns how many
+int reportSampleText(const SensorSample& sample, ReportPublishFn publish);
+
+void reportForceAll(); // Next sample publishes every topic (e.g. after an MQTT reconnect)
+
+struct ReportCounters {
+  uint32_t sent;
+  uint32_t suppressed;
+};
+ReportCounters reportTotals();
+
+// {"<topic>":[sent,suppressed],...} for mqtt_report_stats_topic
+void reportFormatStats(TextBuffer& out);
+
+#endif
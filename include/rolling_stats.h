@@ -0,0 +1,47 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <Arduino.h>
+#include "messages.h"
+#include "text_buffer.h"
+
+// --- WINDOWED STATISTICS ENGINE ---
+// Every raw INA3221 sample (SAMPLE_RATE_HZ) is folded into tumbling windows of
+// STATS_WINDOWS_MS per channel: min, max, sum and sum of squares of V, I and P in
+// 64-bit fixed point, O(1) per sample and window. Spikes and sags between the
+// 2 s readings are therefore still visible in min/max/RMS. Windows close on the
+// sample timestamps, so skipped ticks leave a window with fewer samples rather
+// than a longer span. When a window closes its aggregate (min/max/mean/RMS/
+// stddev) is handed to the network task, which publishes one message per window
+// on mqtt_aggregate_topic.
+
+const int STATS_QUANTITIES = 3; // Voltage, current, power
+enum StatsQuantity : uint8_t { STAT_VOLTAGE, STAT_CURRENT, STAT_POWER };
+
+struct StatsSummary {
+  float min, max, mean, rms, stddev;
+};
+
+struct StatsAggregate {
+  uint32_t windowMs;
+  unsigned long startMillis; // millis() of the first sample in the window
+  unsigned long endMillis;   // millis() of the last sample in the window
+  uint32_t samples;
+  StatsSummary channel[POWER_CHANNELS][STATS_QUANTITIES];
+};
+
+void statsReset();
+
+// Sampler task only (single producer). Values in V, mA, mW.
+void statsAddSample(const float* voltage, const float* current, const float* power, unsigned long nowMs);
+
+// Network task only (single consumer)
+bool statsNextAggregate(StatsAggregate& aggregate);
+uint32_t statsDroppedAggregates(); // Ring was full when a window closed
+
+// JSON body for mqtt_aggregate_topic (epochSeconds 0 = clock not synced yet):
+// {"window_ms":..,"start_ms":..,"uptime_ms":..,"epoch":..,"samples":..,
+//  "channels":[{"v":[min,max,mean,rms,sd],"i":[..],"p":[..]}, ..]}
+void statsFormatAggregate(const StatsAggregate& aggregate, uint32_t epochSeconds, TextBuffer& out);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <Arduino.h>
+#include "messages.h"
+
+// --- HIGH-RATE INA3221 SAMPLING ENGINE ---
+// A hardware timer fires at SAMPLE_RATE_HZ and wakes the sampler task (control
+// core, highest priority). Each tick reads all three channels in one I2C burst
+// (ina3221_scan.h), integrates energy with the trapezoidal rule at full rate, and
+// accumulates the window means. Every SENSOR_READ_INTERVAL the window is
+// decimated into one PowerReading for the control task. The INA3221 runs in
+// continuous mode with the longest averaging / conversion time that still
+// completes a conversion within one tick. The timer, task and sensor setup are
+// behind hal.h, so env:native runs this same code on the virtual clock.
+
+void startSampler();
+
+// Control task only (single consumer)
+bool samplerNextReading(PowerReading& reading);
+
+// Ends the current window early (e.g. Telegram /status); the reading carries flags.
+// Requests made before the sampler takes them merge, flags included.
+void samplerRequestFlush(uint8_t flags);
+
+struct SamplerStats {
+  uint32_t rateHz;
+  uint32_t samples;      // Raw samples taken since boot
+  uint32_t overruns;     // Timer ticks missed because a sample was still running
+  uint32_t readErrors;   // I2C scans that failed (tick skipped)
+  unsigned long worstMicros;   // Longest single sample (I2C + math) since last reset
+  unsigned long averageMicros; // Mean sample cost since last reset
+  unsigned long worstJitterMicros; // Largest tick-to-tick deviation from the period since last reset
+  unsigned long markJitterMicros;  // Same, since samplerMarkJitter()
+};
+SamplerStats samplerStats();
+void samplerResetStats();
+void samplerMarkJitter(); // Starts a jitter measurement that the periodic reset leaves alone
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// --- COOPERATIVE SCHEDULER ---
+// Tasks are kept in a small table ordered by their next deadline.
+// schedulerRun() is called from loop() and only runs the tasks that are due,
+// so no task ever has to delay() to wait for its turn.
+
+typedef void (*TaskCallback)();
+
+const int MAX_SCHEDULER_TASKS = 16; // setup() registers 12; room for a few more
+
+// Register a periodic task. intervalMs = 0 means "run on every pass".
+// Returns the task slot, or -1 if the table is full.
+int schedulerAddTask(const char* name, TaskCallback callback, unsigned long intervalMs);
+
+// Register a one-shot timer that fires once after delayMs.
+int schedulerAddTimer(const char* name, TaskCallback callback, unsigned long delayMs);
+
+// Run every task whose deadline has passed (call from loop())
+void schedulerRun();
+
+// --- LOOP LATENCY STATS ---
+unsigned long schedulerWorstLoopMicros();   // Longest single pass since last reset
+unsigned long schedulerAverageLoopMicros(); // Mean pass time since last reset
+const char* schedulerWorstTaskName();       // Task that caused the worst pass
+const char* schedulerRunningTaskName();     // Task running right now ("scheduler" between tasks)
+void schedulerResetStats();
+
+#endif
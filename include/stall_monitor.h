@@ -0,0 +1,52 @@
+#ifndef STALL_MONITOR_H
+#define STALL_MONITOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// --- STALL PROFILER ---
+// Watched task loops mark the start and end of every pass. A monitor task on each
+// core, above every task of ours, checks the open passes every STALL_CHECK_MS.
+// When one runs over its budget, the monitor saves the stalled task's backtrace
+// and subsystem tag. The monitor shares the core with the stalled task, so while
+// it runs the task's saved context is current. Events go into a small ring in RTC
+// memory that survives a software or watchdog reset (not a power loss); the
+// network task publishes them on mqtt_stall_topic once the broker is up.
+// Decode the backtrace with: xtensa-esp32-elf-addr2line -pfiaC -e firmware.elf <pcs>
+
+enum StallWatchId {
+  STALL_CONTROL,  // Control task, one tick per pass
+  STALL_NETWORK,  // Network task, one scheduler pass per pass (tag = scheduler task)
+  STALL_TELEGRAM, // Telegram worker, one sendMessage attempt per pass
+  STALL_WATCH_COUNT
+};
+
+typedef const char* (*StallTagFn)(); // Names the subsystem running right now
+
+struct StallEvent {
+  uint32_t bootsAgo;    // 0 = this boot
+  uint32_t startMillis; // Uptime when the pass began
+  uint32_t stallMillis; // Pass length (so far, if it never ended)
+  uint32_t budgetMillis;
+  bool ended;           // False if the pass was still running (or a reset cut it short)
+  char task[12];
+  char tag[16];
+  uint8_t depth;
+  uint32_t pcs[STALL_BACKTRACE_DEPTH];
+};
+
+void setupStallMonitor(); // Early in setup(): checks the RTC ring, counts the boot
+void stallWatch(StallWatchId id, const char* name, TaskHandle_t task, uint32_t budgetMillis,
+                StallTagFn tagFn = NULL);
+void startStallMonitor(); // After the watched tasks exist
+
+// Called by the watched task itself
+void stallPassBegin(StallWatchId id, const char* tag);
+void stallPassEnd(StallWatchId id);
+
+// Oldest finished event (network task). Take it off the ring once it is published.
+bool stallPeekEvent(StallEvent& event);
+void stallPopEvent();
+uint32_t stallEventCount(); // Captured since boot
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef STATUS_HTTP_H
+#define STATUS_HTTP_H
+
+#include <Arduino.h>
+
+// --- LOCAL STATUS ENDPOINT ---
+// GET /status on STATUS_HTTP_PORT answers with the latest-reading snapshot as
+// JSON (reading_snapshot.h), for tools on the LAN that do not speak MQTT. One
+// client at a time, read without blocking: the request is collected over as
+// many network loop passes as it takes, and a client that has not sent it
+// within STATUS_HTTP_TIMEOUT is dropped. A stale snapshot is still served, with
+// its age, and a fresh reading is asked for so the next request gets one.
+
+void setupStatusHttp();   // Listens; the socket accepts once WiFi is up
+void serviceStatusHttp(); // Network task
+
+#endif
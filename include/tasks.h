@@ -0,0 +1,20 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <Arduino.h>
+
+// --- DUAL-CORE TASK SPLIT ---
+// Sampler task (CONTROL_CORE): timer-driven INA3221 reads, see sampler.h.
+// Control task (CONTROL_CORE): decimated readings, commands, GPIO sequences, emergency logic.
+// Network task (NETWORK_CORE): WiFi/MQTT/Telegram via the cooperative scheduler.
+// They only talk through the SPSC rings declared in globals.h.
+// The control side starts first, so sampling runs while the network comes up.
+void startControlTasks();
+void startNetworkTask();
+
+// --- CONTROL TASK STATS ---
+unsigned long controlWorstTickMicros();   // Longest control tick since last reset
+unsigned long controlWorstLatenessMicros(); // Worst wake-up lateness vs. the tick schedule
+void controlResetStats();
+
+#endif
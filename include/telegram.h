@@ -0,0 +1,39 @@
+#ifndef TELEGRAM_H
+#define TELEGRAM_H
+
+#include <Arduino.h>
+
+// --- ASYNCHRONOUS TELEGRAM OUTBOX ---
+// Messages are copied into a ring and sent by a low-priority worker task on the
+// network core. The worker keeps one TLS connection to api.telegram.org open
+// (HTTP keep-alive), so only the first send after a drop pays for a handshake.
+// Plain alerts arriving within TELEGRAM_COALESCE_WINDOW of each other (e.g. cut /
+// restore flapping) are joined into a single message. Failed sends are retried
+// with exponential backoff, then dropped.
+
+void startTelegramOutbox();
+
+// --- LONG-POLL COMMAND LISTENER ---
+// A dedicated task holds a getUpdates request open for up to TELEGRAM_LONG_POLL
+// seconds, so an idle bot costs about one TLS request per minute instead of one
+// per second, and nothing on the network scheduler waits for Telegram.
+// Recognised commands from TELEGRAM_CHAT_ID are handed over through a ring.
+enum TelegramCommand : uint8_t { TG_STATUS, TG_START };
+
+void startTelegramListener();
+bool telegramNextCommand(TelegramCommand& command); // Network task only (single consumer)
+
+// Network task only (single producer). Copies the text and returns immediately.
+bool telegramEnqueue(const char* text, bool markdown = false);
+
+struct TelegramStats {
+  uint32_t sent;       // HTTP requests that returned 200
+  uint32_t coalesced;  // Messages merged into another one
+  uint32_t retries;
+  uint32_t dropped;    // Outbox full or out of attempts
+  uint32_t handshakes; // TLS connections opened
+  uint32_t polls;      // getUpdates requests made by the listener
+};
+TelegramStats telegramStats();
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <Arduino.h>
+#include "messages.h"
+
+// --- PACKED TELEMETRY FRAME ---
+// One little-endian frame per sample instead of seven text publishes:
+//   header (16 bytes) | intensity (float) | channelCount x { V, mA, mW } (floats)
+// Decoded on the ingest side by backend/telemetry-frame.js; bump the version
+// whenever the layout changes.
+const uint8_t TELEMETRY_FRAME_VERSION = 1;
+const uint8_t TELEMETRY_FRAME_CHANNELS = 2;
+
+struct __attribute__((packed)) TelemetryFrameHeader {
+  uint8_t version;
+  uint8_t channelCount;
+  uint8_t flags;         // SensorSample flags
+  uint8_t reserved;
+  uint32_t sequence;     // Lets the backend spot gaps
+  uint32_t uptimeMs;     // Device millis() at sample time
+  uint32_t epochSeconds; // Wall clock at sample time, 0 until NTP has synced
+};
+
+struct __attribute__((packed)) TelemetryFrameChannel {
+  float voltage; // V
+  float current; // mA
+  float power;   // mW
+};
+
+const size_t TELEMETRY_FRAME_SIZE = sizeof(TelemetryFrameHeader) + sizeof(float)
+                                  + TELEMETRY_FRAME_CHANNELS * sizeof(TelemetryFrameChannel);
+
+// Wall-clock time (NTP) of a millis() timestamp from this boot, or 0 if not synced yet
+uint32_t uptimeToEpochSeconds(unsigned long uptimeMs);
+
+// Returns the number of bytes written, or 0 if the buffer is too small
+size_t encodeTelemetryFrame(const SensorSample& sample, uint32_t epochSeconds, uint8_t* buffer, size_t bufferSize);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TEXT_BUFFER_H
+#define TEXT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- HEAP-FREE TEXT FORMATTING ---
+// Outbound text (MQTT status, power-cut history JSON, Telegram alerts and reports)
+// is formatted into fixed TEXT_BLOCK_SIZE blocks taken from a static pool instead
+// of chains of String temporaries, so a long uptime never fragments the heap.
+// A TextBuffer holds its block until it goes out of scope. Blocks are claimed
+// with an atomic bitmask, so any task may format. Text that does not fit is cut
+// off (and counted); it is never reallocated.
+class TextBuffer {
+public:
+  TextBuffer();
+  TextBuffer(char* storage, size_t capacity); // Caller's static storage, for payloads larger than a block
+  ~TextBuffer();
+
+  TextBuffer& append(const char* text);
+  TextBuffer& appendf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  const char* c_str() const { return text_; }
+  size_t length() const { return used_; }
+  bool truncated() const { return truncated_; }
+
+private:
+  TextBuffer(const TextBuffer&);            // Owns a pool block: not copyable
+  TextBuffer& operator=(const TextBuffer&);
+
+  int block_;   // Pool block index, -1 if the pool was exhausted, -2 for caller storage
+  char* text_;
+  size_t capacity_;
+  size_t used_;
+  bool truncated_;
+};
+
+struct TextPoolStats {
+  uint32_t blocks;     // TEXT_POOL_BLOCKS
+  uint32_t highWater;  // Most blocks ever in use at once
+  uint32_t exhausted;  // TextBuffers that found no free block (their text is empty)
+  uint32_t truncated;  // Messages cut off at TEXT_BLOCK_SIZE
+};
+TextPoolStats textPoolStats();
+
+#endif
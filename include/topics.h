@@ -0,0 +1,21 @@
+#ifndef TOPICS_H
+#define TOPICS_H
+
+#include <Arduino.h>
+
+// --- PER-DEVICE TOPIC TABLE ---
+// Every mqtt_*_topic in config.cpp starts out as a suffix ("led/control").
+// buildTopicTable() turns each one into "<prefix>/<device id>/<suffix>" once at
+// boot, in one static buffer, and repoints the mqtt_*_topic globals at the full
+// strings. Publishing never builds a topic string after that.
+
+void buildTopicTable(const char* prefix, const char* deviceId);
+
+// "<prefix>/<device id>/", for matching inbound topics against our namespace
+const char* topicDevicePrefix();
+size_t topicDevicePrefixLength();
+
+// Default device ID: "esp32-" + the last three bytes of the MAC in hex
+void deviceIdFromMac(const uint8_t mac[6], char* out, size_t size);
+
+#endif
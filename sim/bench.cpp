@@ -0,0 +1,1173 @@
+#include <chrono>
+#include <new>
+#include <thread>
+#include <atomic>
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "globals.h"
+#include "hardware.h"
+#include "network.h"
+#include "power_detect.h"
+#include "text_buffer.h"
+#include "rolling_stats.h"
+#include "report_filter.h"
+#include "topics.h"
+#include "diagnostics.h"
+#include "mqtt_outbox.h"
+#include "ina3221_scan.h"
+#include "intensity_input.h"
+#include "event_log.h"
+#include "ota_image.h"
+#include "control_state.h"
+#include "reading_snapshot.h"
+#include "journal.h"
+#include "telemetry_frame.h"
+#include "scheduler.h"
+
+// --- NATIVE BENCHMARKS ---
+// Host timings (ns) track the cost of the portable control code between commits;
+// compare them on the same machine only. Virtual-time reaction latencies are
+// deterministic and are checked against a budget, as are the zero-allocation MQTT
+// dispatch and power-cut cycle: the exit code is non-zero if one fails, so CI can run
+// `pio run -e native -t exec`.
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Heap allocations made while a benchmark is counting them
+static bool countingAllocations = false;
+static unsigned long allocationCount = 0;
+
+void* operator new(size_t size) {
+  if (countingAllocations) allocationCount++;
+  void* block = malloc(size);
+  if (block == NULL) throw std::bad_alloc();
+  return block;
+}
+
+void operator delete(void* block) noexcept {
+  free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  free(block);
+}
+
+static inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0; // No portable cycle counter: only ns are reported
+#endif
+}
+
+static unsigned long elapsedNanos(BenchClock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+}
+
+// Boots one simulated device: what setup() does, minus the network
+static void startBoard(const char* deviceId = "esp32-000000") {
+  simStateErase(); // Nothing restored from the previous benchmark
+  simReset();
+  buildTopicTable(DEFAULT_TOPIC_PREFIX, deviceId);
+  setupHardware();
+}
+
+// --- 1. CONTROL TICK COST ---
+static void benchControlTick(unsigned long iterations) {
+  startBoard();
+
+  unsigned long total = 0, worst = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    BenchClock::time_point start = BenchClock::now();
+    runControlTick();
+    unsigned long cost = elapsedNanos(start);
+    total += cost;
+    if (cost > worst) worst = cost;
+    simMqttPump();
+  }
+  printf("control tick        %8lu ns/iter  (worst %lu ns, %lu ticks)\n",
+    total / iterations, worst, iterations);
+}
+
+// --- 2. MQTT DISPATCH COST ---
+static bool benchMqttDispatch(unsigned long iterations) {
+  startBoard();
+
+  struct { const char* topic; const char* payload; } messages[] = {
+    { mqtt_topic, "ON" },
+    { mqtt_led2_topic, "PULSE" },
+    { mqtt_led4_topic, "OFF" },
+    { mqtt_emergency_light_topic, "AUTO" },
+    { "esp32/esp32-ffffff/led/control", "ON" }, // Another device's namespace
+  };
+  const int messageCount = sizeof(messages) / sizeof(messages[0]);
+
+  char topic[128];
+  unsigned long total = 0;
+  uint64_t cycles = 0;
+  ControlCommand cmd;
+  allocationCount = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    int m = i % messageCount;
+    strlcpy(topic, messages[m].topic, sizeof(topic));
+    unsigned int length = strlen(messages[m].payload);
+
+    countingAllocations = true;
+    BenchClock::time_point start = BenchClock::now();
+    uint64_t startCycles = readCycles();
+    mqttCallback(topic, (byte*)messages[m].payload, length);
+    cycles += readCycles() - startCycles;
+    total += elapsedNanos(start);
+    countingAllocations = false;
+
+    while (commandQueue.pop(cmd)) {}
+  }
+  // Commands must not touch the heap at all
+  bool ok = allocationCount == 0;
+  printf("mqtt dispatch       %8lu ns/msg   (%lu cycles, %lu allocations in %lu messages)  %s\n",
+    total / iterations, (unsigned long)(cycles / iterations), allocationCount, iterations, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 3. POWER-CUT REACTION ---
+// Plays the control task's wait loop (tasks.cpp) on the virtual clock: a tick every
+// CONTROL_TICK_MS, an immediate wake on an ISR, an early wake at the end of a
+// debounce. Returns the virtual ms from the cut to the confirmed cut.
+static unsigned long controlWait() {
+  unsigned long wait = CONTROL_TICK_MS;
+  if (powerDetectConfirmPending() && wait > POWER_DETECT_DEBOUNCE_MS) wait = POWER_DETECT_DEBOUNCE_MS;
+  if (intensityDebouncePending() && wait > INTENSITY_DEBOUNCE_MS) wait = INTENSITY_DEBOUNCE_MS;
+  return wait;
+}
+
+static long runUntilCut(unsigned long cutMillis, unsigned long budgetMs, unsigned long& gpioMillis) {
+  gpioMillis = 0;
+  bool gpioSeen = false;
+
+  while (halMillis() < cutMillis + budgetMs * 4) {
+    runControlTick();
+    simMqttPump();
+    if (!gpioSeen && halMillis() >= cutMillis && halDigitalRead(LED2_PIN) == LOW) {
+      gpioSeen = true;
+      gpioMillis = halMillis() - cutMillis;
+    }
+    if (powerCutDetected) return halMillis() - cutMillis;
+
+    simAdvance(controlWait() * 1000UL);
+  }
+  return -1;
+}
+
+static bool reportReaction(const char* name, long reaction, unsigned long gpioMillis, unsigned long budgetMs) {
+  bool ok = reaction >= 0 && (unsigned long)reaction <= budgetMs;
+  if (reaction < 0) {
+    printf("%-19s      never          (budget %lu ms)  FAIL\n", name, budgetMs);
+  } else {
+    printf("%-19s %8ld ms cut   (GPIO13 %lu ms, budget %lu ms)  %s\n",
+      name, reaction, gpioMillis, budgetMs, ok ? "ok" : "FAIL");
+  }
+  return ok;
+}
+
+static bool benchPowerCutPolling() {
+  startBoard();
+  simAdvance(3000UL * 1000UL); // Let a couple of windows through first
+  runControlTick();
+  simMqttPump();
+
+  // Detect pin not wired: only the sampled system voltage shows the cut
+  unsigned long cutMillis = halMillis() + 1;
+  simScriptSupply(cutMillis, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simAdvance(1000);
+
+  unsigned long budget = SENSOR_READ_INTERVAL + CONTROL_TICK_MS;
+  unsigned long gpioMillis;
+  long reaction = runUntilCut(cutMillis, budget, gpioMillis);
+  return reportReaction("power cut (poll)", reaction, gpioMillis, budget);
+}
+
+static bool benchPowerCutPin() {
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+  runControlTick();
+  simMqttPump();
+
+  simAdvance(3000); // Between two control ticks
+  unsigned long cutMillis = halMillis();
+  simSetSupply(1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simSetPin(POWER_DETECT_PIN, POWER_CUT_STATE); // ISR wakes the control task now
+
+  unsigned long budget = POWER_DETECT_DEBOUNCE_MS + CONTROL_TICK_MS;
+  unsigned long gpioMillis;
+  long reaction = runUntilCut(cutMillis, budget, gpioMillis);
+  return reportReaction("power cut (pin)", reaction, gpioMillis, budget);
+}
+
+// --- 4. WINDOWED STATISTICS ---
+// Cost of folding one raw sample into every window, a 20 ms sag between two
+// 2 s readings that only the 10 s window's minimum can show, and a 2 s sampler
+// stall that must leave the 10 s window short of samples, not 2 s longer
+static bool benchRollingStats(unsigned long iterations) {
+  statsReset();
+  float voltage[POWER_CHANNELS] = { 12.0f, 12.0f };
+  float current[POWER_CHANNELS] = { 250.0f, 250.0f };
+  float power[POWER_CHANNELS] = { 3000.0f, 3000.0f };
+
+  BenchClock::time_point start = BenchClock::now();
+  for (unsigned long i = 0; i < iterations; i++) {
+    voltage[0] = 12.0f + (i & 7) * 0.01f;
+    statsAddSample(voltage, current, power, i);
+  }
+  unsigned long perSample = elapsedNanos(start) / iterations;
+
+  statsReset();
+  StatsAggregate aggregate;
+  while (statsNextAggregate(aggregate)) {}
+  const unsigned long periodMs = 1000 / SAMPLE_RATE_HZ;
+  bool closed = false;
+  for (unsigned long t = 0; t < 20000 && !closed; t += periodMs) {
+    if (t >= 3000 && t < 5000) continue; // Sampler stalled
+    statsAddSample(voltage, current, power, t);
+    while (statsNextAggregate(aggregate)) {
+      if (aggregate.windowMs != 10000) continue;
+      closed = aggregate.startMillis == 0 && aggregate.endMillis == 10000 - periodMs &&
+        aggregate.samples == (10000 - 2000) / periodMs;
+      if (!closed) break;
+    }
+  }
+
+  startBoard();
+  simAdvance(10000UL * 1000UL + 1); // First 10 s window closed
+  simMqttPump();
+  unsigned long sagStart = halMillis() + 3000;
+  simScriptSupply(sagStart, 0, 6.0, 250.0);
+  simScriptSupply(sagStart + 20, 0, 12.0, 250.0);
+  simAdvance(10000UL * 1000UL);
+
+  bool sagSeen = false;
+  while (statsNextAggregate(aggregate)) {
+    if (aggregate.windowMs == 10000 && aggregate.channel[0][STAT_VOLTAGE].min < 7.0f) sagSeen = true;
+  }
+
+  bool ok = sagSeen && closed;
+  printf("rolling stats       %8lu ns/sample (%lu windows, 20 ms sag %s, 2 s stall: 10 s window %s)  %s\n",
+    perSample, (unsigned long)STATS_WINDOW_COUNT, sagSeen ? "caught" : "missed",
+    closed ? "closed on time" : "stretched", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 5. REPORT BY EXCEPTION ---
+// Ten quiet minutes: only heartbeats should reach the broker, and every text
+// topic must still be heard from at least once per REPORT_HEARTBEAT_MS. Then
+// ten noisy minutes near zero, straight through the filter.
+static const size_t MAX_REPORT_TOPICS = 8;
+static const char* reportTopics[MAX_REPORT_TOPICS];
+static uint32_t reportCounts[MAX_REPORT_TOPICS];
+
+static bool countReportPublish(const char* topic, const char* /* payload */) {
+  for (size_t i = 0; i < MAX_REPORT_TOPICS; i++) {
+    if (reportTopics[i] == NULL) reportTopics[i] = topic;
+    if (strcmp(reportTopics[i], topic) == 0) {
+      reportCounts[i]++;
+      return true;
+    }
+  }
+  return true;
+}
+
+static uint32_t reportPublishes(const char* topic) {
+  for (size_t i = 0; i < MAX_REPORT_TOPICS && reportTopics[i] != NULL; i++) {
+    if (strcmp(reportTopics[i], topic) == 0) return reportCounts[i];
+  }
+  return 0;
+}
+
+static bool benchReportByException() {
+  startBoard();
+  ReportCounters before = reportTotals();
+
+  const unsigned long minutes = 10;
+  while (halMillis() < minutes * 60000UL) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    runControlTick();
+    simMqttPump();
+  }
+
+  ReportCounters after = reportTotals();
+  unsigned long sent = after.sent - before.sent;
+  unsigned long suppressed = after.suppressed - before.suppressed;
+  unsigned long heartbeats = simMqttCount(mqtt_sensor2_power_topic);
+  bool ok = heartbeats >= minutes * 60000UL / REPORT_HEARTBEAT_MS && sent < (sent + suppressed) / 4;
+
+  // Near zero: a 0.5 mA standby current with 0.04 mA of noise moves 8% on every
+  // sample but stays inside the 5 mA deadband, so only heartbeats go out. A 3%
+  // step on 100 mA is still reported at once.
+  reportForceAll();
+  unsigned long noisyStart = halMillis();
+  uint32_t noisyBefore = reportPublishes(mqtt_sensor2_current_topic);
+  uint32_t stepSent = 0;
+  for (unsigned long i = 0; i <= minutes * 60; i++) {
+    SensorSample sample = { (uint32_t)i, noisyStart + i * 1000, 12.0f, i < 300 ? 100.0f : 103.0f, 1200.0f,
+      12.0f, (i & 1) ? 0.54f : 0.50f, 6.0f, 100.0f, 0 };
+    uint32_t stepBefore = reportPublishes(mqtt_sensor_current_topic);
+    reportSampleText(sample, countReportPublish);
+    if (i == 300) stepSent = reportPublishes(mqtt_sensor_current_topic) - stepBefore;
+  }
+  uint32_t noisySent = reportPublishes(mqtt_sensor2_current_topic) - noisyBefore;
+  ok &= noisySent <= 1 + minutes * 60000UL / REPORT_HEARTBEAT_MS && stepSent == 1;
+
+  printf("report by exception %8lu sent     (%lu suppressed in %lu quiet minutes; 0.5 mA +-8%% noise: %lu sent, "
+         "3%% step on 100 mA: %s)  %s\n",
+    sent, suppressed, minutes, (unsigned long)noisySent, stepSent == 1 ? "sent" : "missed", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 6. STEADY-STATE ALLOCATIONS ---
+// A full cut / emergency sequence / restore cycle, alerts and history JSON included
+static bool benchSteadyStateHeap() {
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+
+  unsigned long start = halMillis();
+  simScriptSupply(start + 1000, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simScriptSupply(start + 70000, 1, 12.0, 250.0);
+
+  allocationCount = 0;
+  countingAllocations = true;
+  while (halMillis() < start + 80000) {
+    runControlTick();
+    simMqttPump();
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+  }
+  countingAllocations = false;
+
+  TextPoolStats text = textPoolStats();
+  bool ok = allocationCount == 0 && simMqttCount(mqtt_powercut_history_topic) == 1 && text.exhausted == 0;
+  printf("cut/restore cycle   %8lu allocations  (text pool high water %lu/%lu, %lu truncated)  %s\n",
+    allocationCount, (unsigned long)text.highWater, (unsigned long)text.blocks,
+    (unsigned long)text.truncated, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 7. INSTRUMENTATION OVERHEAD ---
+// Ten minutes of control and network work (ticks, a command every second, the
+// publishes): the probes must cost less than DIAG_OVERHEAD_BUDGET_PCT of the host
+// time that work took, and the diagnostics report must fit its buffer. The
+// sampler's read probe is left out: the simulated scan is free, on the board it
+// is a ~700 us I2C burst next to which one probe is noise.
+static bool benchDiagnostics() {
+  startBoard();
+  diagBegin();
+  uint32_t probesBefore = diagTotalProbes();
+  uint32_t samplerBefore = diagProbeStats(DIAG_SAMPLER_READ).count;
+
+  unsigned long loopNanos = 0;
+  const unsigned long minutes = 10;
+  while (halMillis() < minutes * 60000UL) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    BenchClock::time_point start = BenchClock::now();
+    runControlTick();
+    if (halMillis() % 1000 == 0) simMqttDeliver(mqtt_topic, "ON");
+    simMqttPump();
+    loopNanos += elapsedNanos(start);
+  }
+
+  uint32_t probes = diagTotalProbes() - probesBefore - (diagProbeStats(DIAG_SAMPLER_READ).count - samplerBefore);
+  double overhead = 100.0 * probes * diagProbeCycles() / loopNanos; // Host: one cycle per ns
+  size_t reportLength = strlen(diagFormatReport());
+  bool ok = overhead < DIAG_OVERHEAD_BUDGET_PCT && reportLength < DIAG_PAYLOAD_SIZE - 1;
+  printf("diagnostics         %8.3f %% loop  (%lu probes at %lu ns, report %lu/%lu B)  %s\n",
+    overhead, (unsigned long)probes, (unsigned long)diagProbeCycles(),
+    (unsigned long)reportLength, (unsigned long)DIAG_PAYLOAD_SIZE, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 8. FLEET ---
+// One firmware image, N devices told apart only by their MAC. Each device boots
+// and runs quiet minutes on the virtual clock in turn (the firmware state is
+// global, so they cannot share one process at the same time). Checks that client
+// IDs are unique, that nothing is published outside the device's namespace, that
+// a command for a neighbour is ignored, and reports the broker load per device
+// and for the whole fleet.
+const int MAX_FLEET = 256;
+
+static bool benchFleet(int devices) {
+  static char deviceIds[MAX_FLEET][DEVICE_ID_SIZE];
+  const unsigned long minutes = 5;
+  bool ok = true;
+  unsigned long fleetMessages = 0, busiest = 0;
+
+  for (int d = 0; d < devices; d++) {
+    uint8_t mac[6] = { 0x24, 0x6f, 0x28, 0x10, (uint8_t)(d >> 8), (uint8_t)d };
+    deviceIdFromMac(mac, deviceIds[d], sizeof(deviceIds[d]));
+    for (int other = 0; other < d; other++) {
+      if (strcmp(deviceIds[d], deviceIds[other]) == 0) ok = false; // Client ID clash
+    }
+
+    startBoard(deviceIds[d]);
+    simSetSupply(0, 12.0f + d * 0.1f, 200.0f + d * 5.0f); // Every unit reads a little differently
+    while (halMillis() < minutes * 60000UL) {
+      simAdvance(CONTROL_TICK_MS * 1000UL);
+      runControlTick();
+      simMqttPump();
+    }
+
+    // Isolation: every publish under our own prefix (Telegram is not MQTT)
+    unsigned long published = simMqttTotal("") - simMqttTotal("telegram");
+    if (simMqttTotal(topicDevicePrefix()) != published) ok = false;
+
+    // A neighbour's command must not reach our control core; our own must
+    ControlCommand cmd;
+    while (commandQueue.pop(cmd)) {}
+    char topic[96];
+    if (d > 0) {
+      snprintf(topic, sizeof(topic), "%s/%s/%s", DEFAULT_TOPIC_PREFIX, deviceIds[d - 1], MQTT_LED_TOPIC);
+      simMqttDeliver(topic, "ON");
+      if (commandQueue.pop(cmd)) ok = false;
+    }
+    simMqttDeliver(mqtt_topic, "ON");
+    if (!commandQueue.pop(cmd)) ok = false;
+
+    fleetMessages += published;
+    if (published > busiest) busiest = published;
+  }
+
+  // Broker load should grow linearly: no device far above the average
+  unsigned long average = fleetMessages / devices;
+  if (busiest > average * 2) ok = false;
+  printf("fleet               %8lu msg/min  (%d devices, %lu msg/min per device, busiest %lu)  %s\n",
+    fleetMessages / minutes, devices, average / minutes, busiest / minutes, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 9. MQTT OUTBOX UNDER A BACKED-UP SOCKET ---
+// A power cut while the socket takes nothing for 20 s (full TCP window), then the
+// link recovers and the first PUBACK is lost. The alarms must all survive and go
+// out ahead of the telemetry backlog, the lost ack must be redelivered, and the
+// lane high-water marks show how much of each ring the burst needed.
+static bool benchMqttBurst() {
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+  simMqttPump();
+
+  unsigned long start = halMillis();
+  simScriptSupply(start + 1000, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simMqttSetLink(false);
+  while (halMillis() < start + 20000) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    runControlTick();
+    simMqttPump();
+  }
+
+  simMqttSetLink(true);
+  simMqttDropAcks(1);
+  while (halMillis() < start + 20000 + 2 * MQTT_ACK_TIMEOUT) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    runControlTick();
+    simMqttPump();
+  }
+
+  MqttOutboxStats stats = mqttOutboxStats();
+  const MqttLaneStats& alarm = stats.lanes[MQTT_LANE_ALARM];
+  const MqttLaneStats& state = stats.lanes[MQTT_LANE_STATE];
+  const char* first = simMqttFirstAfterLinkUp();
+  bool ok = alarm.dropped == 0 && first != NULL && mqttLaneFor(first) == MQTT_LANE_ALARM &&
+    simMqttCount(mqtt_powercut_topic) >= 1 && stats.redelivered >= 1 && stats.inflight == 0;
+  printf("mqtt burst          %8lu alarms   (hw alarm %lu/%lu B, state %lu/%lu B, %lu dropped, %lu journaled, %lu resent)  %s\n",
+    (unsigned long)alarm.sent, (unsigned long)alarm.highWater, (unsigned long)MQTT_LANE_ALARM_BYTES,
+    (unsigned long)state.highWater, (unsigned long)MQTT_LANE_STATE_BYTES, (unsigned long)state.dropped,
+    (unsigned long)simMqttJournaled(), (unsigned long)stats.redelivered, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 10. INA3221 SCAN ---
+// CPU cost of decoding one three-channel burst (integer only), and the time the
+// burst keeps the bus busy at I2C_CLOCK_HZ and at 1 MHz. The old per-register
+// Wire reads were two transactions per register, four registers per sample.
+// Round trips through the register encoding must stay within one LSB.
+static bool benchIna3221Scan(unsigned long iterations) {
+  bool ok = true;
+  int32_t busMillivolts[INA3221_CHANNELS] = { 12000, 3300, 0 };
+  int32_t currentMicroamps[INA3221_CHANNELS] = { 250000, -1200000, 0 };
+  uint8_t raw[INA3221_SCAN_REGISTERS][2];
+  SensorScan scan;
+  ina3221Encode(busMillivolts, currentMicroamps, raw);
+  ina3221Decode(raw, scan);
+  for (int ch = 0; ch < INA3221_CHANNELS; ch++) {
+    if (labs(scan.busMillivolts[ch] - busMillivolts[ch]) >= 8) ok = false;
+    if (labs(scan.currentMicroamps[ch] - currentMicroamps[ch]) >= 400) ok = false;
+  }
+
+  int64_t checksum = 0;
+  BenchClock::time_point start = BenchClock::now();
+  uint64_t startCycles = readCycles();
+  for (unsigned long i = 0; i < iterations; i++) {
+    raw[1][1] = (uint8_t)(i << 3); // Fresh bus reading each time
+    ina3221Decode(raw, scan);
+    checksum += scan.busMillivolts[0] + scan.currentMicroamps[1];
+  }
+  uint64_t cycles = readCycles() - startCycles;
+  unsigned long nanos = elapsedNanos(start);
+  if (checksum == 0) ok = false; // Keeps the loop from being optimised out
+
+  const uint32_t oldClocks = 4 * ((1 + 9 + 9 + 1) + (1 + 9 + 2 * 9 + 1)); // 8 transactions, 2 channels
+  printf("ina3221 scan        %8lu ns/scan  (%lu cycles; 1 transaction, %lu clocks: %lu us @ %lu kHz, %lu us @ 1 MHz; was 8 / %lu clocks for 2 ch)  %s\n",
+    nanos / iterations, (unsigned long)(cycles / iterations), (unsigned long)ina3221ScanBusClocks(),
+    (unsigned long)ina3221ScanBusMicros(I2C_CLOCK_HZ), (unsigned long)(I2C_CLOCK_HZ / 1000),
+    (unsigned long)ina3221ScanBusMicros(1000000), (unsigned long)oldClocks, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 11. INTENSITY INPUT ---
+// During a cut: a drop below the ON threshold switches the light within one
+// debounce, then a code flapping across one boundary and a sub-debounce glitch
+// must not switch it again
+static void setIntensityCode(uint8_t code) {
+  simSetPin(INTENSITY_B0_PIN, code & 1);
+  simSetPin(INTENSITY_B1_PIN, (code >> 1) & 1);
+  simSetPin(INTENSITY_B2_PIN, (code >> 2) & 1);
+}
+
+// Plays the control task until the light reaches the given level; returns the
+// virtual ms it took, or -1
+static long runUntilLight(int level, unsigned long budgetMs) {
+  unsigned long start = halMillis();
+  while (halMillis() - start <= budgetMs * 4) {
+    runControlTick();
+    simMqttPump();
+    if (halDigitalRead(POWER_STATUS_PIN) == level) return halMillis() - start;
+    simAdvance(controlWait() * 1000UL);
+  }
+  return -1;
+}
+
+static void runControlFor(unsigned long ms) {
+  unsigned long start = halMillis();
+  while (halMillis() - start < ms) {
+    runControlTick();
+    simMqttPump();
+    simAdvance(controlWait() * 1000UL);
+  }
+}
+
+static bool benchIntensityInput() {
+  startBoard();
+  setIntensityCode(5); // 71%: bright, light stays off
+  simAdvance(3000UL * 1000UL);
+  runControlTick();
+  simMqttPump();
+
+  simSetSupply(1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simSetPin(POWER_DETECT_PIN, POWER_CUT_STATE);
+  unsigned long gpioMillis;
+  bool ok = runUntilCut(halMillis(), POWER_DETECT_DEBOUNCE_MS + CONTROL_TICK_MS, gpioMillis) >= 0;
+  ok &= halDigitalRead(POWER_STATUS_PIN) == HIGH;
+  uint32_t togglesBefore = emergencyLightToggles();
+
+  simAdvance(3000); // Between two control ticks
+  setIntensityCode(2); // 29%: below the ON threshold
+  unsigned long budget = INTENSITY_DEBOUNCE_MS + CONTROL_TICK_MS;
+  long onMillis = runUntilLight(LOW, budget);
+  ok &= onMillis >= 0 && (unsigned long)onMillis <= budget;
+
+  // 29% <-> 43% sits inside the band, every flap settles
+  for (int i = 0; i < 20; i++) {
+    setIntensityCode(i % 2 == 0 ? 3 : 2);
+    runControlFor(INTENSITY_DEBOUNCE_MS * 3);
+  }
+  // A 57% glitch shorter than the debounce is never taken
+  setIntensityCode(4);
+  simAdvance(INTENSITY_DEBOUNCE_MS * 1000UL / 4);
+  setIntensityCode(2);
+  runControlFor(INTENSITY_DEBOUNCE_MS * 3);
+  ok &= halDigitalRead(POWER_STATUS_PIN) == LOW;
+  uint32_t flapToggles = emergencyLightToggles() - togglesBefore - 1;
+  ok &= flapToggles == 0;
+
+  setIntensityCode(5); // Back above the OFF threshold
+  long offMillis = runUntilLight(HIGH, budget);
+  ok &= offMillis >= 0 && (unsigned long)offMillis <= budget;
+
+  IntensityStats stats = intensityStats();
+  ok &= stats.bounces >= 1;
+  printf("intensity input     %8ld ms on    (%ld ms off, worst settle %lu us, %lu changes, %lu bounces, %lu extra toggles)  %s\n",
+    onMillis, offMillis, stats.worstLatencyMicros, (unsigned long)stats.changes,
+    (unsigned long)stats.bounces, (unsigned long)flapToggles, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 12. POWER-CUT EVENT LOG ---
+// One outage through the whole stack, then more than a ring's worth of records.
+// A "since" query must cost about one index stride of slot reads, cursor paging
+// must return every kept id once, and a reboot must rebuild the same log while
+// skipping a torn slot.
+static size_t pageIds(const char* page, uint32_t* ids, size_t maxIds, uint32_t& next) {
+  size_t count = 0;
+  next = 0;
+  if (page == NULL) return 0;
+  for (const char* at = strstr(page, "{\"id\":"); at != NULL && count < maxIds; at = strstr(at + 1, "{\"id\":")) {
+    ids[count++] = strtoul(at + 6, NULL, 10);
+  }
+  const char* cursor = strstr(page, "\"next\":");
+  if (cursor != NULL) next = strtoul(cursor + 7, NULL, 10);
+  return count;
+}
+
+static const char* queryPage(const char* request) {
+  simMqttDeliver(mqtt_event_query_topic, request);
+  simMqttPump();
+  return simMqttLastPayload(mqtt_event_page_topic);
+}
+
+static bool benchEventLog() {
+  simEventStoreErase();
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+
+  // A real outage with a sag on the main channel
+  unsigned long start = halMillis();
+  simScriptSupply(start + 1000, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  simScriptSupply(start + 3000, 0, 11.2, 250.0);
+  simScriptSupply(start + 5000, 0, 12.0, 250.0);
+  simScriptSupply(start + 8000, 1, 12.0, 250.0);
+  while (halMillis() < start + 12000) {
+    runControlTick();
+    simMqttPump();
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+  }
+  uint32_t ids[EVENT_PAGE_LIMIT];
+  uint32_t next;
+  const char* page = queryPage("{\"since\":0,\"limit\":1}");
+  bool ok = eventLogLastId() == 1 && pageIds(page, ids, EVENT_PAGE_LIMIT, next) == 1 && ids[0] == 1 &&
+    strstr(page, "\"minV\":11.20") != NULL;
+
+  // Wrap the ring: 300 outages, ten minutes apart
+  const uint32_t total = 300;
+  const uint32_t epochBase = simEpochSeconds(halMillis()) + 600;
+  for (uint32_t i = 2; i <= total; i++) {
+    PowerCutEvent event = { 1000, 61000, 12.0f, 11.9f, 11.5f, 42.0f };
+    uint32_t startEpoch = epochBase + i * 600;
+    eventLogAppend(event, startEpoch, startEpoch + 60);
+  }
+  uint32_t kept = eventLogLastId() - eventLogFirstId() + 1;
+  ok &= eventLogLastId() == total && kept == EVENT_LOG_CAPACITY;
+
+  // Since the start of id 200: binary search over the index, then one stride at most
+  char request[64];
+  snprintf(request, sizeof(request), "{\"since\":%lu,\"limit\":%u}",
+    (unsigned long)(epochBase + 200 * 600), EVENT_PAGE_LIMIT);
+  uint32_t readsBefore = eventLogSlotReads();
+  page = queryPage(request);
+  uint32_t sinceReads = eventLogSlotReads() - readsBefore;
+  size_t count = pageIds(page, ids, EVENT_PAGE_LIMIT, next);
+  ok &= count == EVENT_PAGE_LIMIT && ids[0] == 200 && next == 200 + EVENT_PAGE_LIMIT - 1;
+  ok &= sinceReads <= EVENT_INDEX_STRIDE + EVENT_PAGE_LIMIT + 1;
+
+  // Backfill everything with the cursor
+  uint32_t expected = eventLogFirstId(), pages = 0;
+  bool contiguous = true;
+  page = queryPage("{\"since\":0}");
+  for (;;) {
+    pages++;
+    count = pageIds(page, ids, EVENT_PAGE_LIMIT, next);
+    for (size_t i = 0; i < count; i++) contiguous &= ids[i] == expected++;
+    if (next == 0 || pages > kept) break;
+    snprintf(request, sizeof(request), "{\"after\":%lu}", (unsigned long)next);
+    page = queryPage(request);
+  }
+  ok &= contiguous && expected == total + 1;
+
+  // Reboot: the same log from the slots alone, minus a torn record
+  simEventStoreTear((210 - 1) % EVENT_LOG_CAPACITY);
+  uint32_t firstBefore = eventLogFirstId();
+  simReset();
+  buildTopicTable(DEFAULT_TOPIC_PREFIX, "esp32-000000");
+  ok &= eventLogFirstId() == firstBefore && eventLogLastId() == total;
+  page = queryPage("{\"after\":207,\"limit\":3}");
+  count = pageIds(page, ids, EVENT_PAGE_LIMIT, next);
+  ok &= count == 3 && ids[0] == 208 && ids[1] == 209 && ids[2] == 211;
+
+  printf("event log           %8lu reads/query (since, %u/page; %lu kept of %lu, %lu pages to backfill, "
+         "rebuild + torn slot)  %s\n",
+    (unsigned long)sinceReads, EVENT_PAGE_LIMIT, (unsigned long)kept, (unsigned long)total,
+    (unsigned long)pages, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 13. OTA IMAGE STREAM ---
+// A full image and a delta against a base image go through the decoder in
+// uneven pieces, as HTTP delivers them; both must reproduce the target byte for
+// byte. Broken streams must fail with a reason instead of writing past the image.
+static const size_t OTA_BENCH_IMAGE = 256 * 1024;
+static uint8_t otaBase[OTA_BENCH_IMAGE];
+static uint8_t otaTarget[OTA_BENCH_IMAGE];
+static uint8_t otaOutput[OTA_BENCH_IMAGE];
+static uint8_t otaStream[OTA_IMAGE_HEADER_SIZE + OTA_BENCH_IMAGE + 4096];
+static size_t otaOutputLength = 0;
+
+static bool otaBenchSource(uint32_t offset, uint8_t* buffer, size_t length) {
+  if (offset + length > sizeof(otaBase)) return false;
+  memcpy(buffer, otaBase + offset, length);
+  return true;
+}
+
+static bool otaBenchSink(const uint8_t* data, size_t length) {
+  if (otaOutputLength + length > sizeof(otaOutput)) return false;
+  memcpy(otaOutput + otaOutputLength, data, length);
+  otaOutputLength += length;
+  return true;
+}
+
+static size_t putU32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (8 * i));
+  return 4;
+}
+
+static size_t otaHeader(uint8_t* out, uint8_t flags, uint32_t imageSize) {
+  memset(out, 0, OTA_IMAGE_HEADER_SIZE);
+  putU32(out, OTA_IMAGE_MAGIC);
+  out[4] = OTA_IMAGE_VERSION;
+  out[5] = flags;
+  putU32(out + 8, imageSize);
+  for (size_t i = 0; i < 64; i++) out[76 + i] = (uint8_t)(0xA0 + i); // Signature: parsed here, checked on the board
+  return OTA_IMAGE_HEADER_SIZE;
+}
+
+static OtaImageResult otaDecode(const uint8_t* stream, size_t length) {
+  otaOutputLength = 0;
+  otaImageBegin(otaBenchSource, otaBenchSink);
+  OtaImageResult result = OTA_IMAGE_MORE;
+  size_t piece = 1;
+  for (size_t pos = 0; pos < length && result == OTA_IMAGE_MORE; pos += piece) {
+    piece = 1 + (pos * 7 + 13) % 1021; // 1 to 1021 bytes, never aligned to a field
+    if (piece > length - pos) piece = length - pos;
+    result = otaImageFeed(stream + pos, piece);
+  }
+  return result;
+}
+
+static bool benchOtaImage() {
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < OTA_BENCH_IMAGE; i++) {
+    seed = seed * 1103515245 + 12345;
+    otaBase[i] = (uint8_t)(seed >> 16);
+  }
+  // The new build: a few patched regions, the rest unchanged
+  memcpy(otaTarget, otaBase, sizeof(otaTarget));
+  for (size_t region = 0; region < 8; region++) {
+    size_t at = region * (OTA_BENCH_IMAGE / 8) + 1000;
+    for (size_t i = 0; i < 300; i++) otaTarget[at + i] ^= 0x5A;
+  }
+
+  // Full image
+  size_t fullLength = otaHeader(otaStream, 0, OTA_BENCH_IMAGE);
+  memcpy(otaStream + fullLength, otaTarget, OTA_BENCH_IMAGE);
+  fullLength += OTA_BENCH_IMAGE;
+  BenchClock::time_point start = BenchClock::now();
+  OtaImageResult result = otaDecode(otaStream, fullLength);
+  unsigned long fullNanos = elapsedNanos(start);
+  bool ok = result == OTA_IMAGE_DONE && otaOutputLength == OTA_BENCH_IMAGE &&
+    memcmp(otaOutput, otaTarget, OTA_BENCH_IMAGE) == 0;
+  ok &= otaImageHeader().signature[0] == 0xA0 && otaImageHeader().signature[63] == 0xA0 + 63;
+
+  // Delta: COPY the unchanged runs from the base, DATA for the patched ones
+  size_t deltaLength = otaHeader(otaStream, OTA_IMAGE_DELTA, OTA_BENCH_IMAGE);
+  for (size_t pos = 0; pos < OTA_BENCH_IMAGE;) {
+    bool same = otaBase[pos] == otaTarget[pos];
+    size_t end = pos;
+    while (end < OTA_BENCH_IMAGE && (otaBase[end] == otaTarget[end]) == same) end++;
+    otaStream[deltaLength++] = same ? OTA_OP_COPY : OTA_OP_DATA;
+    if (same) deltaLength += putU32(otaStream + deltaLength, pos);
+    deltaLength += putU32(otaStream + deltaLength, end - pos);
+    if (!same) {
+      memcpy(otaStream + deltaLength, otaTarget + pos, end - pos);
+      deltaLength += end - pos;
+    }
+    pos = end;
+  }
+  start = BenchClock::now();
+  result = otaDecode(otaStream, deltaLength);
+  unsigned long deltaNanos = elapsedNanos(start);
+  ok &= result == OTA_IMAGE_DONE && otaOutputLength == OTA_BENCH_IMAGE &&
+    memcmp(otaOutput, otaTarget, OTA_BENCH_IMAGE) == 0 && otaImageHeader().flags == OTA_IMAGE_DELTA;
+
+  // Broken streams
+  uint8_t bad[OTA_IMAGE_HEADER_SIZE + 16];
+  otaHeader(bad, 0, 16);
+  bad[0] = 'X';
+  ok &= otaDecode(bad, sizeof(bad)) == OTA_IMAGE_ERROR && otaOutputLength == 0;
+  size_t badLength = otaHeader(bad, OTA_IMAGE_DELTA, 16);
+  bad[badLength++] = OTA_OP_COPY;
+  badLength += putU32(bad + badLength, 0);
+  badLength += putU32(bad + badLength, 17); // One byte more than the image
+  ok &= otaDecode(bad, badLength) == OTA_IMAGE_ERROR && otaOutputLength == 0 && otaImageError() != NULL;
+
+  // The trigger reaches the updater through the command routes
+  startBoard();
+  uint32_t requestsBefore = simOtaRequests();
+  simMqttDeliver(mqtt_ota_topic, "http://updates.local/pcot.bin");
+  ok &= simOtaRequests() == requestsBefore + 1 && strcmp(simOtaLastUrl(), "http://updates.local/pcot.bin") == 0;
+
+  printf("ota image           %8lu ns/KB    (full %lu KB; delta %lu B for %lu KB: %lu ns/KB; uneven pieces, 2 bad streams)  %s\n",
+    fullNanos / (OTA_BENCH_IMAGE / 1024), (unsigned long)(OTA_BENCH_IMAGE / 1024), (unsigned long)deltaLength,
+    (unsigned long)(OTA_BENCH_IMAGE / 1024), deltaNanos / (OTA_BENCH_IMAGE / 1024), ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 14. BROWNOUT RESTORE ---
+// A reset 15 s into a cut (detect pin not wired, as in the polling benchmark).
+// With the RTC checkpoint the outputs must be back at their old levels when
+// setupHardware() returns, the sequence must end on its original schedule and
+// the outage must be logged once, for its whole length, with all its energy.
+// A reset that loses RTC memory falls back to NVS. Without any checkpoint the
+// board only finds the cut again at the end of its first window.
+static uint8_t outputLevels() {
+  return halDigitalRead(LED_PIN) | halDigitalRead(LED2_PIN) << 1 |
+    halDigitalRead(LED4_PIN) << 2 | halDigitalRead(POWER_STATUS_PIN) << 3;
+}
+
+// Reset with mains still gone; returns the host ns setupHardware() took
+static unsigned long rebootDuringCut() {
+  simReset();
+  simSetSupply(1, POWER_CUT_THRESHOLD - 1.0, 0);
+  buildTopicTable(DEFAULT_TOPIC_PREFIX, "esp32-000000");
+  BenchClock::time_point start = BenchClock::now();
+  setupHardware();
+  return elapsedNanos(start);
+}
+
+static bool benchBrownoutRestore() {
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+  simScriptSupply(halMillis() + 1000, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  runControlFor(16000);
+  bool ok = powerCutDetected && emergencyModeActive && gpio14Activated;
+  uint8_t levels = outputLevels();
+  float energy = totalEnergyConsumed;
+  unsigned long cutMillis = halMillis() - powerCutStartTime;
+  unsigned long sequenceLeft = EMERGENCY_DURATION - (halMillis() - emergencyStartTime);
+
+  // Brownout: RTC memory kept
+  unsigned long restoreNanos = rebootDuringCut();
+  ok &= strcmp(controlStateRestoredFrom(), "rtc") == 0 && outputLevels() == levels;
+  ok &= powerCutDetected && emergencyModeActive && gpio14Activated && totalEnergyConsumed == energy;
+
+  while (emergencyModeActive && halMillis() < EMERGENCY_DURATION) runControlFor(CONTROL_TICK_MS);
+  unsigned long sequenceEnd = halMillis();
+  ok &= !emergencyModeActive && sequenceEnd >= sequenceLeft && sequenceEnd <= sequenceLeft + 3 * CONTROL_TICK_MS; // Checkpoint up to a tick old
+  ok &= simMqttCount(mqtt_powercut_topic) == 0; // No second POWER_CUT for the same outage
+
+  // Mains back: one record for the whole outage
+  simSetSupply(1, 12.0, 250.0);
+  while (powerCutDetected && halMillis() < sequenceEnd + 2 * SENSOR_READ_INTERVAL) runControlFor(CONTROL_TICK_MS);
+  const char* history = simMqttLastPayload(mqtt_powercut_history_topic);
+  unsigned long duration = 0;
+  float loggedEnergy = 0;
+  ok &= !powerCutDetected && history != NULL &&
+    sscanf(history, "{\"duration\":%lu", &duration) == 1 && strstr(history, "\"energy\":") != NULL &&
+    sscanf(strstr(history, "\"energy\":"), "\"energy\":%f", &loggedEnergy) == 1;
+  ok &= duration + 3 * CONTROL_TICK_MS >= cutMillis + halMillis() && duration <= cutMillis + halMillis();
+  ok &= loggedEnergy >= energy;
+
+  // Power lost long enough to clear RTC memory: the last transition from NVS
+  simScriptSupply(halMillis() + 1000, 1, POWER_CUT_THRESHOLD - 1.0, 0);
+  runControlFor(3000);
+  levels = outputLevels();
+  uint32_t nvsWrites = controlStateNvsWrites();
+  simStatePowerLoss();
+  rebootDuringCut();
+  ok &= nvsWrites > 0 && strcmp(controlStateRestoredFrom(), "nvs") == 0 && outputLevels() == levels;
+  ok &= powerCutDetected && emergencyModeActive && gpio14Activated;
+
+  // Without a checkpoint: GPIO13 off until the first reading finds the cut
+  // again, which then raises a second alarm and restarts the sequence
+  simStateErase();
+  rebootDuringCut();
+  unsigned long rediscovered = 0;
+  while (!powerCutDetected && halMillis() < 2 * SENSOR_READ_INTERVAL) runControlFor(CONTROL_TICK_MS);
+  if (powerCutDetected) rediscovered = halMillis();
+  simMqttPump();
+  ok &= strcmp(controlStateRestoredFrom(), "none") == 0 && rediscovered > 0;
+  ok &= simMqttCount(mqtt_powercut_topic) == 1 && halMillis() - emergencyStartTime <= CONTROL_TICK_MS * 2;
+
+  printf("brownout restore    %8lu ns       (outputs back at 0 ms from RTC or NVS, sequence ends on time, "
+         "%lu s outage logged once; without: GPIO13 at %lu ms, alarm repeated, sequence restarted)  %s\n",
+    restoreNanos, duration / 1000, rediscovered, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 15. LATEST-READING SNAPSHOT ---
+// status/get is answered from the snapshot on the next network pass; after a
+// control task stall it waits for the fresh reading it asked for. Then a writer
+// thread hammers the seqlock while this one reads: every copy must be one
+// whole snapshot (all fields written from the same counter), never a mix.
+static std::atomic<bool> snapshotWriterDone{false};
+
+static void snapshotWriter() {
+  ReadingSnapshot snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  for (uint32_t i = 1; !snapshotWriterDone.load(std::memory_order_relaxed); i = (i + 1) & 0xFFFFFF) {
+    float value = (float)i;
+    snapshot.sequence = snapshot.timestamp = i;
+    snapshot.v1 = snapshot.c1 = snapshot.p1 = snapshot.v2 = snapshot.c2 = snapshot.p2 = snapshot.intensity = value;
+    snapshot.outputs = snapshot.flags = (uint8_t)i;
+    snapshotPublish(snapshot);
+  }
+}
+
+static bool benchSnapshot(unsigned long iterations) {
+  startBoard();
+  simAdvance(3000UL * 1000UL);
+  runControlTick();
+  simMqttDeliver(mqtt_snapshot_get_topic, "");
+  simMqttPump();
+  const char* reply = simMqttLastPayload(mqtt_snapshot_topic);
+  unsigned long age = 0;
+  bool ok = simMqttCount(mqtt_snapshot_topic) == 1 && reply != NULL && strstr(reply, "\"age_ms\":") != NULL &&
+    sscanf(strstr(reply, "\"age_ms\":"), "\"age_ms\":%lu", &age) == 1 && age <= SENSOR_READ_INTERVAL;
+
+  // Control task stalled past SNAPSHOT_MAX_AGE: answered after one fresh reading
+  simAdvance((SNAPSHOT_MAX_AGE + 1000) * 1000UL);
+  unsigned long asked = halMillis();
+  simMqttDeliver(mqtt_snapshot_get_topic, "");
+  simMqttPump();
+  ok &= simMqttCount(mqtt_snapshot_topic) == 1;
+  while (simMqttCount(mqtt_snapshot_topic) == 1 && halMillis() - asked < SNAPSHOT_RESAMPLE_TIMEOUT * 2) {
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    runControlTick();
+    simMqttPump();
+  }
+  unsigned long staleAnswer = halMillis() - asked;
+  reply = simMqttLastPayload(mqtt_snapshot_topic);
+  ok &= simMqttCount(mqtt_snapshot_topic) == 2 && strstr(reply, "\"age_ms\":") != NULL &&
+    sscanf(strstr(reply, "\"age_ms\":"), "\"age_ms\":%lu", &age) == 1 && age <= SNAPSHOT_MAX_AGE;
+  ok &= snapshotStats().resamples == 1;
+
+  // /status with GPIO13 off, then a resample asked for before the sampler took
+  // the forced flush: the reading must still come back forced, so GPIO13 goes
+  // back to sleep at once instead of after STATUS_SAMPLE_TIMEOUT
+  ok &= halDigitalRead(LED2_PIN) == HIGH;
+  ControlCommand status = { CMD_STATUS_REPORT, ACTION_NONE };
+  commandQueue.push(status);
+  runControlTick();
+  ok &= halDigitalRead(LED2_PIN) == LOW;
+  simAdvance(500 * 1000UL);
+  runControlTick(); // Settled: the forced flush
+  ControlCommand resample = { CMD_RESAMPLE, ACTION_NONE };
+  commandQueue.push(resample);
+  runControlTick(); // No sampler tick in between
+  unsigned long flushed = halMillis();
+  while (halDigitalRead(LED2_PIN) == LOW && halMillis() - flushed < STATUS_SAMPLE_TIMEOUT) runControlFor(CONTROL_TICK_MS);
+  unsigned long statusMillis = halMillis() - flushed;
+  ok &= halDigitalRead(LED2_PIN) == HIGH && statusMillis < SENSOR_READ_INTERVAL;
+
+  // Uncontended cost
+  ReadingSnapshot snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  BenchClock::time_point start = BenchClock::now();
+  for (unsigned long i = 0; i < iterations; i++) {
+    snapshot.sequence = i;
+    snapshotPublish(snapshot);
+  }
+  unsigned long writeNanos = elapsedNanos(start) / iterations;
+  start = BenchClock::now();
+  uint32_t sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    snapshotRead(snapshot);
+    sum += snapshot.sequence;
+  }
+  unsigned long readNanos = elapsedNanos(start) / iterations;
+  ok &= sum != 0;
+
+  // Contended: no torn copies
+  SnapshotStats before = snapshotStats();
+  snapshotWriterDone = false;
+  std::thread writer(snapshotWriter);
+  unsigned long torn = 0, copies = 0;
+  while (snapshotStats().writes - before.writes < 1000) std::this_thread::yield(); // Writer running
+  for (unsigned long i = 0; i < iterations * 10; i++) {
+    if (!snapshotRead(snapshot)) continue;
+    float value = (float)snapshot.sequence;
+    bool whole = snapshot.timestamp == snapshot.sequence && snapshot.v1 == value && snapshot.c1 == value &&
+      snapshot.p1 == value && snapshot.v2 == value && snapshot.c2 == value && snapshot.p2 == value &&
+      snapshot.intensity == value && snapshot.outputs == (uint8_t)snapshot.sequence &&
+      snapshot.flags == (uint8_t)snapshot.sequence;
+    if (!whole) torn++;
+    copies++;
+  }
+  snapshotWriterDone = true;
+  writer.join();
+  SnapshotStats after = snapshotStats();
+  ok &= torn == 0 && copies == iterations * 10;
+
+  printf("reading snapshot    %8lu ns/read  (%lu ns/write; status/get stale after a stall: answered in %lu ms; "
+         "/status + resample: %lu ms; %lu contended reads, %lu retries, %lu torn)  %s\n",
+    readNanos, writeNanos, staleAnswer, statusMillis, copies, (unsigned long)(after.retries - before.retries), torn, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 16. JOURNAL REPLAY ACROSS REBOOTS ---
+// A backlog of one and a half segments is replayed in network-task batches,
+// with a reboot in the middle of each segment while a batch is still in the
+// outbox, and one batch lost on the way: every sample must reach the broker
+// exactly once, as a replayed frame.
+static const uint32_t JOURNAL_BENCH_SAMPLES = JOURNAL_SEGMENT_RECORDS + JOURNAL_SEGMENT_RECORDS / 2;
+static uint8_t journalSeen[JOURNAL_BENCH_SAMPLES + 1];
+static uint32_t journalStray = 0;
+static uint32_t journalOutbox[JOURNAL_REPLAY_BATCH]; // Sequences sent, not yet delivered
+static size_t journalOutboxDepth = 0;
+
+static bool journalBenchSend(const uint8_t* frame, size_t length) {
+  TelemetryFrameHeader header;
+  memcpy(&header, frame, sizeof(header));
+  if (length != TELEMETRY_FRAME_SIZE || header.sequence == 0 || header.sequence > JOURNAL_BENCH_SAMPLES ||
+      !(header.flags & SAMPLE_REPLAYED) || journalOutboxDepth >= JOURNAL_REPLAY_BATCH) {
+    journalStray++;
+  } else {
+    journalOutbox[journalOutboxDepth++] = header.sequence;
+  }
+  return true;
+}
+
+static void deliverJournalBatch() {
+  for (size_t i = 0; i < journalOutboxDepth; i++) journalSeen[journalOutbox[i]]++;
+  journalOutboxDepth = 0;
+  journalReplaySettled(true);
+}
+
+static void replayBatches(uint32_t batches) {
+  for (uint32_t i = 0; i < batches && journalPendingRecords() > 0; i++) {
+    journalReplay(JOURNAL_REPLAY_BATCH, journalBenchSend);
+    deliverJournalBatch();
+  }
+}
+
+static bool benchJournalReplay() {
+  simJournalErase();
+  startBoard();
+  memset(journalSeen, 0, sizeof(journalSeen));
+  journalStray = 0;
+
+  bool ok = journalPendingRecords() == 0;
+  for (uint32_t i = 1; i <= JOURNAL_BENCH_SAMPLES; i++) {
+    SensorSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.sequence = i;
+    sample.timestamp = halMillis();
+    ok &= journalAppend(sample);
+    simAdvance(SENSOR_READ_INTERVAL * 1000UL);
+  }
+  ok &= journalPendingRecords() == JOURNAL_BENCH_SAMPLES;
+
+  // Reboot part way through the first segment, then part way through the
+  // second, each time with one more batch sent but not yet delivered
+  uint32_t writesBefore = simJournalCursorWrites();
+  replayBatches(5);
+  ok &= journalReplay(JOURNAL_REPLAY_BATCH, journalBenchSend) == JOURNAL_REPLAY_BATCH;
+  ok &= journalReplay(JOURNAL_REPLAY_BATCH, journalBenchSend) == 0; // One batch at a time
+  journalOutboxDepth = 0;
+  simReset();
+  uint32_t afterFirst = journalPendingRecords();
+  ok &= afterFirst == JOURNAL_BENCH_SAMPLES - 5 * JOURNAL_REPLAY_BATCH;
+  replayBatches(5);
+  journalReplay(JOURNAL_REPLAY_BATCH, journalBenchSend); // Pushed out of a full outbox
+  journalOutboxDepth = 0;
+  journalReplaySettled(false);
+  replayBatches(5);
+  journalReplay(JOURNAL_REPLAY_BATCH, journalBenchSend);
+  journalOutboxDepth = 0;
+  simReset();
+  uint32_t afterSecond = journalPendingRecords();
+  ok &= afterSecond == JOURNAL_BENCH_SAMPLES - 15 * JOURNAL_REPLAY_BATCH;
+  replayBatches(JOURNAL_BENCH_SAMPLES);
+  simReset();
+  ok &= journalPendingRecords() == 0;
+  uint32_t cursorWrites = simJournalCursorWrites() - writesBefore;
+
+  uint32_t duplicates = 0, missing = 0;
+  for (uint32_t i = 1; i <= JOURNAL_BENCH_SAMPLES; i++) {
+    if (journalSeen[i] == 0) missing++;
+    if (journalSeen[i] > 1) duplicates += journalSeen[i] - 1;
+  }
+  ok &= duplicates == 0 && missing == 0 && journalStray == 0;
+
+  printf("journal replay      %8lu records  (3 reboots mid-replay, 1 lost batch: %lu then %lu pending, %lu duplicates, "
+         "%lu missing, %lu cursor writes)  %s\n",
+    (unsigned long)JOURNAL_BENCH_SAMPLES, (unsigned long)afterFirst, (unsigned long)afterSecond,
+    (unsigned long)duplicates, (unsigned long)missing, (unsigned long)cursorWrites, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// --- 17. SCHEDULER PAST 2^31 MS ---
+// Fifty days of uptime in six-hour steps, across the 2^31 ms sign flip (24.8
+// days) and the 2^32 ms millis() wrap (49.7 days): after every step the
+// every-pass task must run on every pass and the periodic one must catch up once.
+static uint32_t everyPassRuns = 0;
+static uint32_t periodicRuns = 0;
+
+static void countEveryPass() {
+  everyPassRuns++;
+}
+
+static void countPeriodic() {
+  periodicRuns++;
+}
+
+static bool benchSchedulerUptime() {
+  startBoard();
+  schedulerAddTask("everyPass", countEveryPass, 0);
+  schedulerAddTask("periodic", countPeriodic, 1000);
+
+  const unsigned long stepMs = 6UL * 3600UL * 1000UL;
+  const int passes = 10;
+  unsigned long stalledAtMs = 0;
+  int steps = 0;
+  for (; steps < 50 * 4 && stalledAtMs == 0; steps++) {
+    simSkip(stepMs);
+    uint32_t everyPassBefore = everyPassRuns, periodicBefore = periodicRuns;
+    for (int i = 0; i < passes; i++) {
+      schedulerRun();
+      simAdvance(CONTROL_TICK_MS * 1000UL);
+    }
+    if (everyPassRuns - everyPassBefore != passes || periodicRuns - periodicBefore != 1) stalledAtMs = halMillis();
+  }
+  bool ok = stalledAtMs == 0;
+
+  printf("scheduler uptime    %8lu days    (every-pass and 1 s tasks checked every 6 h past 2^31 and 2^32 ms; %s)  %s\n",
+    (unsigned long)(halMillis() / 86400000UL), stalledAtMs == 0 ? "no stall" : "stalled", ok ? "ok" : "FAIL");
+  if (!ok) printf("                    stalled at %.1f days\n", stalledAtMs / 86400000.0);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  if (iterations == 0) iterations = 1;
+  int devices = argc > 2 ? atoi(argv[2]) : 20;
+  if (devices < 1) devices = 1;
+  if (devices > MAX_FLEET) devices = MAX_FLEET;
+
+  printf("=== native benchmarks (%lu iterations) ===\n", iterations);
+  benchControlTick(iterations);
+
+  bool ok = true;
+  ok &= benchMqttDispatch(iterations);
+  ok &= benchRollingStats(iterations);
+  ok &= benchPowerCutPolling();
+  ok &= benchPowerCutPin();
+  ok &= benchReportByException();
+  ok &= benchSteadyStateHeap();
+  ok &= benchDiagnostics();
+  ok &= benchFleet(devices);
+  ok &= benchMqttBurst();
+  ok &= benchIna3221Scan(iterations);
+  ok &= benchIntensityInput();
+  ok &= benchEventLog();
+  ok &= benchOtaImage();
+  ok &= benchBrownoutRestore();
+  ok &= benchSnapshot(iterations);
+  ok &= benchJournalReplay();
+  ok &= benchSchedulerUptime();
+  return ok ? 0 : 1;
+}
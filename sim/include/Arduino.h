@@ -0,0 +1,115 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// --- NATIVE ARDUINO SHIM ---
+// Only the language-level parts of the Arduino core (types, constants, String,
+// Serial). Pins, time and the INA3221 are deliberately missing: portable code
+// has to go through hal.h, and a direct digitalWrite()/millis() call fails to
+// compile here instead of silently bypassing the simulator.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef void* TaskHandle_t; // Only passed around, never used, by portable code
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#if !defined(__APPLE__) && !(defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38)))
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t n = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return length;
+}
+
+inline size_t strlcat(char* dst, const char* src, size_t size) {
+  size_t used = strnlen(dst, size);
+  if (used == size) return size + strlen(src);
+  return used + strlcpy(dst + used, src, size - used);
+}
+#endif
+
+// --- String ---
+class String {
+public:
+  String() {}
+  String(const char* text) : value(text ? text : "") {}
+  String(char c) : value(1, c) {}
+  String(int number) : value(std::to_string(number)) {}
+  String(long number) : value(std::to_string(number)) {}
+  String(unsigned int number) : value(std::to_string(number)) {}
+  String(unsigned long number) : value(std::to_string(number)) {}
+  String(double number, unsigned int decimals = 2) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, number);
+    value = buffer;
+  }
+
+  const char* c_str() const { return value.c_str(); }
+  unsigned int length() const { return value.length(); }
+
+  String& operator+=(const String& other) { value += other.value; return *this; }
+  String& operator+=(const char* other) { value += other; return *this; }
+  String& operator+=(char c) { value += c; return *this; }
+
+  bool operator==(const String& other) const { return value == other.value; }
+  bool operator==(const char* other) const { return value == other; }
+  bool operator!=(const char* other) const { return value != other; }
+
+  friend String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+  friend String operator+(const String& a, const char* b) { String s(a); s += b; return s; }
+  friend String operator+(const char* a, const String& b) { String s(a); s += b; return s; }
+
+private:
+  std::string value;
+};
+
+// --- Serial ---
+// Quiet by default so benchmark output stays readable; set SIM_SERIAL=1 to see it.
+class SimSerial {
+public:
+  void begin(unsigned long) {}
+  template <typename T> void print(const T& value) { if (enabled()) write(value); }
+  template <typename T> void println(const T& value) { if (enabled()) { write(value); fputc('\n', stdout); } }
+  void println() { if (enabled()) fputc('\n', stdout); }
+  void printf(const char* format, ...) {
+    if (!enabled()) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+  }
+
+private:
+  static bool enabled() {
+    static int state = -1;
+    if (state < 0) state = getenv("SIM_SERIAL") != NULL && atoi(getenv("SIM_SERIAL")) != 0;
+    return state == 1;
+  }
+  void write(const char* text) { fputs(text, stdout); }
+  void write(const String& text) { fputs(text.c_str(), stdout); }
+  void write(char c) { fputc(c, stdout); }
+  void write(int number) { fprintf(stdout, "%d", number); }
+  void write(long number) { fprintf(stdout, "%ld", number); }
+  void write(unsigned int number) { fprintf(stdout, "%u", number); }
+  void write(unsigned long number) { fprintf(stdout, "%lu", number); }
+  void write(double number) { fprintf(stdout, "%.2f", number); }
+};
+
+extern SimSerial Serial;
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <Arduino.h>
+
+// --- NATIVE SIMULATOR ---
+// Stands in for the board in env:native: simulated GPIO, a virtual clock, a
+// scripted INA3221 read by the real sampler (sampler.cpp) on every virtual timer
+// tick, a model of the detect-pin ISR, and an in-process MQTT stub. Single threaded: the caller plays
+// the control task (runControlTick) and the network task (simMqttPump).
+
+// --- CLOCK ---
+void simReset(); // Clock, pins, supply script and MQTT log back to power-on state
+void simAdvance(unsigned long us); // Runs every sampler tick that falls due
+void simSkip(unsigned long ms);    // Days of uptime in one step: the clock moves, the sampler skips ahead
+
+// --- GPIO ---
+// Driving an input from outside; POWER_DETECT_PIN runs the ISR model on a cut
+// edge, the intensity pins run theirs on any edge
+void simSetPin(uint8_t pin, int level);
+int simPinLevel(uint8_t pin);
+uint32_t simPinWrites(); // halDigitalWrite() calls since simReset()
+
+// --- SCRIPTED INA3221 ---
+void simSetSupply(int channel, float volts, float milliamps); // From now on
+void simScriptSupply(unsigned long atMs, int channel, float volts, float milliamps);
+
+// --- POWER DETECT MODEL ---
+void simPowerDetectEdge(); // What the detect-pin ISR does (called by simSetPin)
+void simInaAlert();        // What the INA3221 alert ISR does
+void simIntensityEdge();   // What the intensity pin-change ISR does (called by simSetPin)
+
+// --- EVENT STORE ---
+// Survives simReset() like flash survives a reboot; simReset() rebuilds the event log from it
+void simEventStoreErase();           // Blank flash; call simReset() after it
+void simEventStoreTear(size_t slot); // Corrupts one slot, as a reset in the middle of a write would
+
+// --- JOURNAL STORE ---
+// Segments, cursor and boot counter survive simReset(); simReset() rebuilds the journal from them
+void simJournalErase();           // Blank flash and NVS; call simReset() after it
+uint32_t simJournalCursorWrites(); // NVS writes of the replay cursor, since start
+
+// --- STATE CHECKPOINT ---
+// The RTC and NVS copies survive simReset(), which then models a brownout or watchdog reset
+void simStatePowerLoss(); // Power removed: RTC memory reads back noise, NVS is kept; call simReset() after it
+void simStateErase();     // A board fresh from the factory: neither copy
+
+// --- OTA MODEL ---
+uint32_t simOtaRequests();  // otaRequest() calls that were accepted, since start
+const char* simOtaLastUrl();
+
+// --- MQTT STUB ---
+void simMqttDeliver(const char* topic, const char* payload); // Broker -> mqttCallback()
+size_t simMqttPump(); // serviceTelemetry() + serviceEventLog() + controlStatePersist() + serviceMqttOutbox(); returns messages written
+uint32_t simMqttCount(const char* topic);          // Publishes seen on a topic
+const char* simMqttLastPayload(const char* topic); // NULL if never published
+unsigned long simMqttFirstMillis(const char* topic); // Virtual time of the first publish
+uint32_t simMqttTotal(const char* prefix); // Publishes on every topic starting with prefix ("" = all)
+void simMqttSetLink(bool up);          // false: the socket takes nothing (full TCP window)
+void simMqttDropAcks(uint32_t count);  // The next count PUBACKs never arrive
+const char* simMqttFirstAfterLinkUp(); // Topic of the first write after the link came back
+uint32_t simMqttJournaled();           // Samples the outbox had no room for
+uint32_t simEpochSeconds(unsigned long uptimeMs); // The simulated NTP clock (always synced)
+// Sees every write the socket accepts, with its QoS (NULL to stop); kept across simReset()
+typedef void (*SimMqttTap)(const char* topic, const uint8_t* payload, size_t length, bool qos1);
+void simMqttSetTap(SimMqttTap tap);
+
+#endif
@@ -0,0 +1,375 @@
+#include <chrono>
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "globals.h"
+#include "sampler.h"
+#include "event_log.h"
+#include "journal.h"
+
+SimSerial Serial;
+
+const int SIM_PINS = 40;
+const int MAX_SCRIPT_STEPS = 16;
+
+struct SupplyStep {
+  unsigned long atMs;
+  int channel;
+  float volts;
+  float milliamps;
+};
+
+// --- VIRTUAL BOARD STATE ---
+static unsigned long clockMicros = 0;
+static uint8_t pinLevels[SIM_PINS];
+static uint32_t pinWrites = 0;
+
+static float supplyVolts[POWER_CHANNELS];
+static float supplyMilliamps[POWER_CHANNELS];
+static SupplyStep script[MAX_SCRIPT_STEPS];
+static int scriptLength = 0;
+
+// --- SAMPLE TIMER ---
+// The real sampler (sampler.cpp), ticked by simAdvance() on the virtual clock
+static HalSampleTickFn sampleTick = NULL;
+static unsigned long samplePeriodMicros = 0;
+static unsigned long nextSampleMicros = 0;
+
+void simResetPowerDetect(); // sim_power_detect.cpp
+void simResetIntensity();   // sim_intensity.cpp
+void simResetMqtt();        // sim_mqtt.cpp
+
+void simReset() {
+  clockMicros = 0;
+  pinWrites = 0;
+  memset(pinLevels, LOW, sizeof(pinLevels));
+  pinLevels[POWER_DETECT_PIN] = POWER_CUT_STATE == LOW ? HIGH : LOW; // Mains present
+
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    supplyVolts[ch] = 12.0;
+    supplyMilliamps[ch] = 250.0;
+  }
+  scriptLength = 0;
+
+  PowerReading discard;
+  while (samplerNextReading(discard)) {}
+  startSampler(); // First tick at 0, like the timer after power-on
+
+  // Control task state back to power-on values
+  powerCutDetected = false;
+  emergencyModeActive = false;
+  manualEmergencyControl = false;
+  gpio14Activated = false;
+  currentLightIntensity = 100.0;
+  totalEnergyConsumed = 0;
+
+  simResetPowerDetect();
+  simResetIntensity();
+  simResetMqtt();
+  setupJournal();  // Both stores are flash: they survive, the state is rebuilt from them
+  setupEventLog();
+}
+
+static void applyScript() {
+  unsigned long nowMs = clockMicros / 1000;
+  int kept = 0;
+  for (int i = 0; i < scriptLength; i++) {
+    if ((long)(nowMs - script[i].atMs) >= 0) {
+      supplyVolts[script[i].channel] = script[i].volts;
+      supplyMilliamps[script[i].channel] = script[i].milliamps;
+    } else {
+      script[kept++] = script[i];
+    }
+  }
+  scriptLength = kept;
+}
+
+void simAdvance(unsigned long us) {
+  unsigned long target = clockMicros + us;
+  while (sampleTick != NULL && (long)(target - nextSampleMicros) >= 0) {
+    clockMicros = nextSampleMicros;
+    applyScript();
+    sampleTick(0);
+    nextSampleMicros += samplePeriodMicros;
+  }
+  clockMicros = target;
+  applyScript();
+}
+
+void simSkip(unsigned long ms) {
+  clockMicros += ms * 1000UL;
+  nextSampleMicros = clockMicros;
+  applyScript();
+}
+
+void simSetPin(uint8_t pin, int level) {
+  bool edge = pinLevels[pin] != level;
+  pinLevels[pin] = level;
+  if (edge && pin == POWER_DETECT_PIN && level == POWER_CUT_STATE) simPowerDetectEdge();
+  if (edge && (pin == INTENSITY_B0_PIN || pin == INTENSITY_B1_PIN || pin == INTENSITY_B2_PIN)) simIntensityEdge();
+}
+
+int simPinLevel(uint8_t pin) {
+  return pinLevels[pin];
+}
+
+uint32_t simPinWrites() {
+  return pinWrites;
+}
+
+void simSetSupply(int channel, float volts, float milliamps) {
+  supplyVolts[channel] = volts;
+  supplyMilliamps[channel] = milliamps;
+}
+
+void simScriptSupply(unsigned long atMs, int channel, float volts, float milliamps) {
+  if (scriptLength >= MAX_SCRIPT_STEPS) return;
+  script[scriptLength++] = { atMs, channel, volts, milliamps };
+}
+
+// --- HAL ---
+void halPinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) pinLevels[pin] = HIGH;
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t level) {
+  pinLevels[pin] = level;
+  pinWrites++;
+}
+
+int halDigitalRead(uint8_t pin) {
+  return pinLevels[pin];
+}
+
+unsigned long halMillis() {
+  return clockMicros / 1000;
+}
+
+unsigned long halMicros() {
+  return clockMicros;
+}
+
+void halDelayMicroseconds(unsigned int /* us */) {
+  // Virtual time only moves in simAdvance(), so sampler ticks stay in order
+}
+
+uint32_t halEpochSeconds() {
+  return simEpochSeconds(halMillis());
+}
+
+// Host time, not virtual: diagnostics measure what the code really costs
+uint32_t halCycleCount() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t halCyclesPerMicro() {
+  return 1000; // One "cycle" per ns
+}
+
+// No heap or stack model on the host
+uint32_t halFreeHeap() {
+  return 0;
+}
+
+uint32_t halMinFreeHeap() {
+  return 0;
+}
+
+uint32_t halStackFree(TaskHandle_t /* task */) {
+  return 0;
+}
+
+bool halSensorBegin() {
+  return true;
+}
+
+// The scripted supply goes through the register encoding, so the simulated
+// readings carry the sensor's 8 mV / 400 uA resolution
+bool halSensorScan(SensorScan& scan) {
+  int32_t busMillivolts[INA3221_CHANNELS] = {0};
+  int32_t currentMicroamps[INA3221_CHANNELS] = {0};
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    busMillivolts[ch] = lroundf(supplyVolts[ch] * 1000.0f);
+    currentMicroamps[ch] = lroundf(supplyMilliamps[ch] * 1000.0f);
+  }
+  uint8_t raw[INA3221_SCAN_REGISTERS][2];
+  ina3221Encode(busMillivolts, currentMicroamps, raw);
+  ina3221Decode(raw, scan);
+  return true;
+}
+
+void halSensorConfigure(uint8_t /* averageIndex */, uint8_t /* conversionIndex */) {
+  // The scripted supply has no conversion time: every scan is fresh
+}
+
+TaskHandle_t halSampleTimerStart(uint32_t periodMicros, HalSampleTickFn tick) {
+  sampleTick = tick;
+  samplePeriodMicros = periodMicros;
+  nextSampleMicros = clockMicros;
+  return NULL;
+}
+
+// --- EVENT STORE ---
+// Flash model: kept across simReset(), like the board's LittleFS file
+const size_t SIM_EVENT_STORE_BYTES = 16384;
+static uint8_t eventStore[SIM_EVENT_STORE_BYTES];
+static size_t eventSlots = 0;
+static size_t eventRecordSize = 0;
+
+bool halEventStoreBegin(size_t slots, size_t recordSize) {
+  if (slots * recordSize > sizeof(eventStore)) return false;
+  eventSlots = slots;
+  eventRecordSize = recordSize;
+  return true;
+}
+
+bool halEventStoreRead(size_t slot, void* record) {
+  if (slot >= eventSlots) return false;
+  memcpy(record, eventStore + slot * eventRecordSize, eventRecordSize);
+  return true;
+}
+
+bool halEventStoreWrite(size_t slot, const void* record) {
+  if (slot >= eventSlots) return false;
+  memcpy(eventStore + slot * eventRecordSize, record, eventRecordSize);
+  return true;
+}
+
+void simEventStoreErase() {
+  memset(eventStore, 0, sizeof(eventStore));
+}
+
+void simEventStoreTear(size_t slot) {
+  if (slot < eventSlots) eventStore[slot * eventRecordSize + eventRecordSize / 2] ^= 0xFF;
+}
+
+// --- STATE CHECKPOINT ---
+// Both copies survive simReset(), which is a brownout or watchdog reset
+static uint8_t rtcState[CHECKPOINT_RECORD_MAX];
+static uint8_t nvsState[CHECKPOINT_RECORD_MAX];
+static size_t nvsLength = 0;
+
+bool halStateRtcRead(void* record, size_t size) {
+  if (size > sizeof(rtcState)) return false;
+  memcpy(record, rtcState, size);
+  return true;
+}
+
+void halStateRtcWrite(const void* record, size_t size) {
+  if (size <= sizeof(rtcState)) memcpy(rtcState, record, size);
+}
+
+bool halStateNvsRead(void* record, size_t size) {
+  if (nvsLength != size) return false;
+  memcpy(record, nvsState, size);
+  return true;
+}
+
+bool halStateNvsWrite(const void* record, size_t size) {
+  if (size > sizeof(nvsState)) return false;
+  memcpy(nvsState, record, size);
+  nvsLength = size;
+  return true;
+}
+
+void simStatePowerLoss() {
+  for (size_t i = 0; i < sizeof(rtcState); i++) rtcState[i] = (uint8_t)(i * 37 + 11); // Power-on noise
+}
+
+void simStateErase() {
+  simStatePowerLoss();
+  nvsLength = 0;
+}
+
+// --- JOURNAL STORE ---
+// Flash and NVS model: kept across simReset(), like the board's LittleFS files
+const size_t SIM_JOURNAL_SEGMENT_BYTES = 16384;
+struct SimJournalSegment {
+  bool used;
+  uint32_t number;
+  uint32_t bytes;
+  uint8_t data[SIM_JOURNAL_SEGMENT_BYTES];
+};
+static SimJournalSegment journalSegments[JOURNAL_MAX_SEGMENTS + 1];
+static uint32_t journalBoots = 0;
+static bool journalCursorWritten = false;
+static uint32_t journalCursor[2];
+static uint32_t journalCursorWrites = 0;
+
+static SimJournalSegment* findSegment(uint32_t segment, bool create) {
+  SimJournalSegment* unused = NULL;
+  for (SimJournalSegment& slot : journalSegments) {
+    if (slot.used && slot.number == segment) return &slot;
+    if (!slot.used && unused == NULL) unused = &slot;
+  }
+  if (!create || unused == NULL) return NULL;
+  unused->used = true;
+  unused->number = segment;
+  unused->bytes = 0;
+  return unused;
+}
+
+bool halJournalBegin() {
+  return true;
+}
+
+void halJournalList(HalJournalSegmentFn found) {
+  for (SimJournalSegment& slot : journalSegments) {
+    if (slot.used) found(slot.number, slot.bytes);
+  }
+}
+
+uint32_t halJournalSize(uint32_t segment) {
+  SimJournalSegment* slot = findSegment(segment, false);
+  return slot ? slot->bytes : 0;
+}
+
+bool halJournalAppend(uint32_t segment, const void* data, size_t length) {
+  SimJournalSegment* slot = findSegment(segment, true);
+  if (slot == NULL || slot->bytes + length > sizeof(slot->data)) return false;
+  memcpy(slot->data + slot->bytes, data, length);
+  slot->bytes += length;
+  return true;
+}
+
+size_t halJournalRead(uint32_t segment, uint32_t offset, void* data, size_t length) {
+  SimJournalSegment* slot = findSegment(segment, false);
+  if (slot == NULL || offset >= slot->bytes) return 0;
+  if (length > slot->bytes - offset) length = slot->bytes - offset;
+  memcpy(data, slot->data + offset, length);
+  return length;
+}
+
+void halJournalRemove(uint32_t segment) {
+  SimJournalSegment* slot = findSegment(segment, false);
+  if (slot) slot->used = false;
+}
+
+uint32_t halJournalBoot() {
+  return ++journalBoots;
+}
+
+bool halJournalCursorRead(uint32_t& segment, uint32_t& records) {
+  if (!journalCursorWritten) return false;
+  segment = journalCursor[0];
+  records = journalCursor[1];
+  return true;
+}
+
+void halJournalCursorWrite(uint32_t segment, uint32_t records) {
+  journalCursor[0] = segment;
+  journalCursor[1] = records;
+  journalCursorWritten = true;
+  journalCursorWrites++;
+}
+
+void simJournalErase() {
+  for (SimJournalSegment& slot : journalSegments) slot.used = false;
+  journalBoots = 0;
+  journalCursorWritten = false;
+}
+
+uint32_t simJournalCursorWrites() {
+  return journalCursorWrites;
+}
@@ -0,0 +1,84 @@
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "intensity_input.h"
+
+// Model of intensity_input.cpp: the same settle/bounce rules, with the ISR
+// replaced by a direct call from simSetPin()
+static const uint8_t NO_CODE = 0xFF;
+
+static uint32_t edgeCount = 0;
+static unsigned long edgeMicros = 0;
+
+static uint32_t handledEdges = 0;
+static bool settlePending = false;
+static unsigned long firstEdgeMicros = 0;
+static uint8_t settledCode = NO_CODE;
+static uint32_t changeCount = 0;
+static uint32_t bounceCount = 0;
+static unsigned long lastLatencyMicros = 0;
+static unsigned long worstLatencyMicros = 0;
+
+void simResetIntensity() {
+  edgeCount = handledEdges = changeCount = bounceCount = 0;
+  lastLatencyMicros = worstLatencyMicros = 0;
+  settledCode = NO_CODE;
+  settlePending = true; // As after setupIntensityInput()
+  firstEdgeMicros = edgeMicros = halMicros() - INTENSITY_DEBOUNCE_MS * 1000UL;
+}
+
+void simIntensityEdge() {
+  edgeMicros = halMicros();
+  edgeCount++;
+}
+
+static uint8_t readCode() {
+  return (halDigitalRead(INTENSITY_B2_PIN) << 2) | (halDigitalRead(INTENSITY_B1_PIN) << 1) |
+    halDigitalRead(INTENSITY_B0_PIN);
+}
+
+bool intensityDebouncePending() {
+  return settlePending || edgeCount != handledEdges;
+}
+
+bool intensityPoll() {
+  if (edgeCount != handledEdges) {
+    handledEdges = edgeCount;
+    if (!settlePending) firstEdgeMicros = edgeMicros;
+    settlePending = true;
+  }
+  if (!settlePending) return false;
+  if (halMicros() - edgeMicros < INTENSITY_DEBOUNCE_MS * 1000UL) return false;
+  settlePending = false;
+
+  uint8_t code = readCode();
+  if (code == settledCode) {
+    bounceCount++;
+    return false;
+  }
+  if (settledCode != NO_CODE) {
+    changeCount++;
+    lastLatencyMicros = halMicros() - firstEdgeMicros;
+    if (lastLatencyMicros > worstLatencyMicros) worstLatencyMicros = lastLatencyMicros;
+  }
+  settledCode = code;
+  return true;
+}
+
+uint8_t intensityCode() {
+  return settledCode == NO_CODE ? 0 : settledCode;
+}
+
+float intensityPercent() {
+  return (intensityCode() / 7.0) * 100.0;
+}
+
+IntensityStats intensityStats() {
+  IntensityStats stats;
+  stats.edges = edgeCount;
+  stats.changes = changeCount;
+  stats.bounces = bounceCount;
+  stats.lastLatencyMicros = lastLatencyMicros;
+  stats.worstLatencyMicros = worstLatencyMicros;
+  return stats;
+}
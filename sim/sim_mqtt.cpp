@@ -0,0 +1,221 @@
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "globals.h"
+#include "network.h"
+#include "rolling_stats.h"
+#include "report_filter.h"
+#include "mqtt_outbox.h"
+#include "event_log.h"
+#include "control_state.h"
+#include "reading_snapshot.h"
+
+// In-process broker: remembers what was published per topic and feeds inbound
+// messages straight into mqttCallback(), the same entry point PubSubClient uses.
+// Publishes go through the real outbox; the "socket" can be backed up and PUBACKs
+// lost to exercise its lanes, window and redelivery.
+const int MAX_SIM_TOPICS = 32;
+
+struct SimTopic {
+  char name[96]; // Copied: the topic table is rebuilt when the simulated device changes
+  uint32_t count;
+  unsigned long firstMillis;
+  char lastPayload[EVENT_PAGE_SIZE]; // Large enough for an event log page
+};
+
+static SimTopic topics[MAX_SIM_TOPICS];
+static int topicCount = 0;
+
+static bool linkUp = true;
+static uint32_t acksToDrop = 0;
+static uint32_t journaled = 0;
+static size_t written = 0; // Writes in the current pump
+static const char* firstAfterLinkUp = NULL;
+static bool awaitingFirst = false;
+static SimMqttTap tap = NULL;
+
+void simResetMqtt() {
+  topicCount = 0;
+  linkUp = true;
+  acksToDrop = 0;
+  journaled = 0;
+  awaitingFirst = false;
+  firstAfterLinkUp = NULL;
+  mqttOutboxReset();
+  reportForceAll();
+
+  OutboundMessage msg;
+  while (outboundQueue.pop(msg)) {}
+  SensorSample sample;
+  while (sampleQueue.pop(sample)) {}
+  ControlCommand cmd;
+  while (commandQueue.pop(cmd)) {}
+  StatsAggregate aggregate;
+  while (statsNextAggregate(aggregate)) {}
+  PowerCutEvent event;
+  while (eventQueue.pop(event)) {}
+  EventQuery query;
+  while (eventLogNextQuery(query)) {}
+}
+
+uint32_t simEpochSeconds(unsigned long uptimeMs) {
+  return 1700000000L + (long)uptimeMs / 1000; // Signed: a cut restored after a reset began before 0
+}
+
+static SimTopic* findTopic(const char* name, bool create) {
+  for (int i = 0; i < topicCount; i++) {
+    if (strcmp(topics[i].name, name) == 0) return &topics[i];
+  }
+  if (!create || topicCount >= MAX_SIM_TOPICS) return NULL;
+  SimTopic* topic = &topics[topicCount++];
+  strlcpy(topic->name, name, sizeof(topic->name));
+  topic->count = 0;
+  topic->firstMillis = halMillis();
+  topic->lastPayload[0] = '\0';
+  return topic;
+}
+
+static void record(const char* name, const uint8_t* payload, size_t length) {
+  SimTopic* topic = findTopic(name, true);
+  if (topic == NULL) return;
+  topic->count++;
+  if (length >= sizeof(topic->lastPayload)) length = sizeof(topic->lastPayload) - 1;
+  memcpy(topic->lastPayload, payload, length);
+  topic->lastPayload[length] = '\0';
+}
+
+static void record(const char* name, const char* payload) {
+  record(name, (const uint8_t*)payload, strlen(payload));
+}
+
+static bool publishQueued(const char* topic, const char* payload) {
+  return mqttOutboxPush(mqttLaneFor(topic), topic, (const uint8_t*)payload, strlen(payload));
+}
+
+// The socket: refuses everything while backed up; a QoS 1 write is acked at once
+static bool simWrite(const char* topic, const uint8_t* payload, size_t length, uint16_t packetId, bool /* dup */) {
+  if (!linkUp) return false;
+  record(topic, payload, length);
+  if (tap != NULL) tap(topic, payload, length, packetId != 0);
+  written++;
+  if (awaitingFirst) {
+    firstAfterLinkUp = topic;
+    awaitingFirst = false;
+  }
+  if (packetId != 0) {
+    if (acksToDrop > 0) acksToDrop--;
+    else mqttOutboxAck(packetId);
+  }
+  return true;
+}
+
+void simMqttDeliver(const char* topic, const char* payload) {
+  char topicCopy[128];
+  strlcpy(topicCopy, topic, sizeof(topicCopy));
+  mqttCallback(topicCopy, (byte*)payload, strlen(payload));
+}
+
+size_t simMqttPump() {
+  written = 0;
+
+  SensorSample sample;
+  while (sampleQueue.pop(sample)) {
+    if (!mqttOutboxFits(MQTT_LANE_STATE, TEXT_BLOCK_SIZE)) { // The board journals it
+      journaled++;
+      continue;
+    }
+    if (TELEMETRY_TEXT_TOPICS && !TELEMETRY_AGGREGATES) reportSampleText(sample, publishQueued);
+  }
+
+  StatsAggregate aggregate;
+  while (statsNextAggregate(aggregate)) {
+    if (!TELEMETRY_AGGREGATES) continue;
+    TextBuffer body;
+    statsFormatAggregate(aggregate, 0, body);
+    publishQueued(mqtt_aggregate_topic, body.c_str());
+  }
+
+  size_t telegrams = 0;
+  OutboundMessage msg;
+  while (outboundQueue.pop(msg)) {
+    if (msg.channel == OUT_TELEGRAM) {
+      record("telegram", msg.payload);
+      telegrams++;
+    } else {
+      publishQueued(msg.topic, msg.payload);
+    }
+  }
+  ReadingSnapshot snapshot; // status/get
+  if (snapshotAnswerReady(snapshot)) {
+    TextBuffer body;
+    snapshotFormat(snapshot, body);
+    if (body.length() > 0) publishQueued(mqtt_snapshot_topic, body.c_str()); // Empty if the text pool ran out
+  }
+
+  // serviceEventLog()
+  PowerCutEvent event;
+  while (eventQueue.pop(event)) {
+    eventLogAppend(event, simEpochSeconds(event.startMillis), simEpochSeconds(event.endMillis));
+  }
+  EventQuery query;
+  if (mqttOutboxFits(MQTT_LANE_BULK, EVENT_PAGE_SIZE) && eventLogNextQuery(query)) {
+    static char page[EVENT_PAGE_SIZE];
+    TextBuffer body(page, sizeof(page));
+    eventLogFormatPage(query, body);
+    publishQueued(mqtt_event_page_topic, body.c_str());
+  }
+
+  // The "checkpoint" task
+  controlStatePersist();
+
+  mqttOutboxService(simWrite, halMillis(), MQTT_OUTBOX_PASS_BYTES);
+  return written + telegrams;
+}
+
+void simMqttSetLink(bool up) {
+  if (up && !linkUp) {
+    awaitingFirst = true;
+    firstAfterLinkUp = NULL;
+  }
+  linkUp = up;
+}
+
+void simMqttSetTap(SimMqttTap callback) {
+  tap = callback;
+}
+
+void simMqttDropAcks(uint32_t count) {
+  acksToDrop = count;
+}
+
+const char* simMqttFirstAfterLinkUp() {
+  return firstAfterLinkUp;
+}
+
+uint32_t simMqttJournaled() {
+  return journaled;
+}
+
+uint32_t simMqttCount(const char* topic) {
+  SimTopic* entry = findTopic(topic, false);
+  return entry ? entry->count : 0;
+}
+
+const char* simMqttLastPayload(const char* topic) {
+  SimTopic* entry = findTopic(topic, false);
+  return entry ? entry->lastPayload : NULL;
+}
+
+unsigned long simMqttFirstMillis(const char* topic) {
+  SimTopic* entry = findTopic(topic, false);
+  return entry ? entry->firstMillis : 0;
+}
+
+uint32_t simMqttTotal(const char* prefix) {
+  size_t prefixLength = strlen(prefix);
+  uint32_t total = 0;
+  for (int i = 0; i < topicCount; i++) {
+    if (strncmp(topics[i].name, prefix, prefixLength) == 0) total += topics[i].count;
+  }
+  return total;
+}
@@ -0,0 +1,24 @@
+#include "sim.h"
+#include "config.h"
+#include "ota_update.h"
+
+// Model of ota_update.cpp: there is no second partition to flash on the host, so
+// a request is only recorded. The image decoder (ota_image.cpp) is the real one.
+static uint32_t requestCount = 0;
+static char lastUrl[OTA_URL_SIZE];
+
+bool otaRequest(const char* url, size_t length) {
+  if (length == 0 || length >= sizeof(lastUrl)) return false;
+  memcpy(lastUrl, url, length);
+  lastUrl[length] = '\0';
+  requestCount++;
+  return true;
+}
+
+uint32_t simOtaRequests() {
+  return requestCount;
+}
+
+const char* simOtaLastUrl() {
+  return lastUrl;
+}
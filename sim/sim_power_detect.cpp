@@ -0,0 +1,86 @@
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "globals.h"
+#include "power_detect.h"
+
+// Model of power_detect.cpp: the same edge/debounce/false-alarm rules, with the
+// ISRs replaced by direct calls from simSetPin() / simInaAlert().
+static uint32_t edgeCount = 0;
+static uint32_t alertCount = 0;
+static unsigned long edgeMicros = 0;
+static bool gpio13Preswitched = false;
+static uint8_t gpio13BeforeEdge = HIGH;
+
+static uint32_t handledEdges = 0;
+static uint32_t handledAlerts = 0;
+static bool confirmPending = false;
+static uint32_t falseAlarmCount = 0;
+
+void simResetPowerDetect() {
+  edgeCount = alertCount = handledEdges = handledAlerts = falseAlarmCount = 0;
+  confirmPending = false;
+  gpio13Preswitched = false;
+}
+
+void simPowerDetectEdge() {
+  if (halDigitalRead(POWER_DETECT_PIN) != POWER_CUT_STATE) return;
+  if (powerCutDetected) return;
+
+  if (!gpio13Preswitched) {
+    gpio13BeforeEdge = halDigitalRead(LED2_PIN);
+    halDigitalWrite(LED2_PIN, LOW);
+    gpio13Preswitched = true;
+  }
+  edgeMicros = halMicros();
+  edgeCount++;
+}
+
+void simInaAlert() {
+  alertCount++;
+}
+
+bool powerDetectPinCut() {
+  return halDigitalRead(POWER_DETECT_PIN) == POWER_CUT_STATE;
+}
+
+bool powerDetectConfirmPending() {
+  return confirmPending || edgeCount != handledEdges;
+}
+
+bool powerDetectConfirmCut() {
+  if (edgeCount != handledEdges) {
+    handledEdges = edgeCount;
+    confirmPending = true;
+  }
+  if (!confirmPending) return false;
+  if (halMicros() - edgeMicros < POWER_DETECT_DEBOUNCE_MS * 1000UL) return false;
+  confirmPending = false;
+
+  if (powerDetectPinCut()) {
+    gpio13Preswitched = false;
+    return true;
+  }
+
+  falseAlarmCount++;
+  if (gpio13Preswitched && !powerCutDetected) {
+    halDigitalWrite(LED2_PIN, gpio13BeforeEdge);
+  }
+  gpio13Preswitched = false;
+  return false;
+}
+
+bool powerDetectTakeAlert() {
+  if (alertCount == handledAlerts) return false;
+  handledAlerts = alertCount;
+  return true;
+}
+
+PowerDetectStats powerDetectStats() {
+  PowerDetectStats stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.edges = edgeCount;
+  stats.alerts = alertCount;
+  stats.falseAlarms = falseAlarmCount;
+  return stats;
+}
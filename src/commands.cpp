@@ -0,0 +1,124 @@
+#include "network.h"
+#include "config.h"
+#include "globals.h"
+#include "topics.h"
+#include "diagnostics.h"
+#include "event_log.h"
+#include "ota_update.h"
+#include "reading_snapshot.h"
+
+// MQTT command parsing is kept apart from the connection code so it builds
+// in the native environment as well.
+
+// --- COMMAND DISPATCH TABLE ---
+// Inbound topics are "<prefix>/<device id>/<suffix>". The device prefix is
+// checked with one strncmp, then the suffix is matched by FNV-1a hash (one pass,
+// then a few integer compares) and confirmed with strcmp. The suffix hashes are
+// computed at compile time; nothing here allocates.
+static constexpr uint32_t topicHash(const char* text, uint32_t hash = 2166136261u) {
+  return *text == '\0' ? hash : topicHash(text + 1, (hash ^ (uint8_t)*text) * 16777619u);
+}
+
+static uint32_t runtimeTopicHash(const char* text) {
+  uint32_t hash = 2166136261u;
+  while (*text != '\0') hash = (hash ^ (uint8_t)*text++) * 16777619u;
+  return hash;
+}
+
+struct CommandRoute {
+  uint32_t hash;
+  const char* topic;
+  CommandTarget target;
+  bool anyPayload; // Act even on an unknown payload
+};
+
+static constexpr CommandRoute COMMAND_ROUTES[] = {
+  { topicHash(MQTT_LED_TOPIC), MQTT_LED_TOPIC, CMD_LED, false },                 // --- LED 1 CONTROL ---
+  { topicHash(MQTT_LED2_TOPIC), MQTT_LED2_TOPIC, CMD_SYSTEM, false },            // --- LED 2 (GPIO13) CONTROL ---
+  { topicHash(MQTT_LED4_TOPIC), MQTT_LED4_TOPIC, CMD_GPIO14, false },            // --- LED 4 (GPIO14) CONTROL ---
+  // Any message on the emergency topic switches to manual control, even an unknown one
+  { topicHash(MQTT_EMERGENCY_LIGHT_TOPIC), MQTT_EMERGENCY_LIGHT_TOPIC, CMD_EMERGENCY_LIGHT, true },
+  { topicHash(MQTT_EVENT_QUERY_TOPIC), MQTT_EVENT_QUERY_TOPIC, CMD_EVENT_QUERY, true },     // --- EVENT LOG QUERY ---
+  { topicHash(MQTT_OTA_TOPIC), MQTT_OTA_TOPIC, CMD_OTA, true },                               // --- OTA UPDATE ---
+  { topicHash(MQTT_SNAPSHOT_GET_TOPIC), MQTT_SNAPSHOT_GET_TOPIC, CMD_SNAPSHOT, true },        // --- LATEST READING ---
+};
+static constexpr size_t COMMAND_ROUTE_COUNT = sizeof(COMMAND_ROUTES) / sizeof(COMMAND_ROUTES[0]);
+
+// The hash alone must tell the command topics apart
+static constexpr bool routeHashesUnique(size_t i = 0, size_t j = 1) {
+  return i >= COMMAND_ROUTE_COUNT ? true
+       : j >= COMMAND_ROUTE_COUNT ? routeHashesUnique(i + 1, i + 2)
+       : COMMAND_ROUTES[i].hash != COMMAND_ROUTES[j].hash && routeHashesUnique(i, j + 1);
+}
+static_assert(routeHashesUnique(), "MQTT command topic hash collision");
+
+struct ActionWord {
+  const char* text;
+  uint8_t length;
+  CommandAction action;
+};
+
+static const ActionWord ACTION_WORDS[] = {
+  { "ON", 2, ACTION_ON },
+  { "1", 1, ACTION_ON },
+  { "OFF", 3, ACTION_OFF },
+  { "0", 1, ACTION_OFF },
+  { "PULSE", 5, ACTION_PULSE },
+  { "AUTO", 4, ACTION_AUTO },
+};
+
+// Compares straight against the payload buffer (not NUL-terminated)
+static CommandAction parseAction(const byte* payload, unsigned int length) {
+  for (const ActionWord& word : ACTION_WORDS) {
+    if (length == word.length && memcmp(payload, word.text, length) == 0) return word.action;
+  }
+  return ACTION_NONE;
+}
+
+static const CommandRoute* findRoute(const char* topic) {
+  // Another device's namespace (a broad subscription or a misrouted message)
+  size_t prefixLength = topicDevicePrefixLength();
+  if (strncmp(topic, topicDevicePrefix(), prefixLength) != 0) return NULL;
+
+  const char* suffix = topic + prefixLength;
+  uint32_t hash = runtimeTopicHash(suffix);
+  for (const CommandRoute& route : COMMAND_ROUTES) {
+    if (route.hash == hash && strcmp(route.topic, suffix) == 0) return &route;
+  }
+  return NULL;
+}
+
+// Runs on the network core: translate the message into a command for the control core
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  DiagScope timing(DIAG_MQTT_CALLBACK);
+  Serial.printf("Msg on [%s]: %.*s\n", topic, (int)length, (const char*)payload);
+
+  const CommandRoute* route = findRoute(topic);
+  if (route == NULL) return;
+
+  // Flash reads belong to this task: the query waits for serviceEventLog()
+  if (route->target == CMD_EVENT_QUERY) {
+    EventQuery query;
+    if (eventLogParseQuery(payload, length, query) && !eventLogQueueQuery(query)) {
+      Serial.println("ERROR: Event query queue full, query dropped");
+    }
+    return;
+  }
+  if (route->target == CMD_OTA) {
+    if (!otaRequest((const char*)payload, length)) Serial.println("ERROR: OTA update refused (busy, unverified, no signing key or bad URL)");
+    return;
+  }
+  if (route->target == CMD_SNAPSHOT) {
+    snapshotRequest(); // Answered by serviceTelemetry(), after a fresh reading if this one is too old
+    return;
+  }
+
+  ControlCommand cmd;
+  cmd.target = route->target;
+  cmd.action = parseAction(payload, length);
+  if (cmd.action == ACTION_NONE && !route->anyPayload) return;
+
+  if (!commandQueue.push(cmd)) {
+    Serial.println("ERROR: Command queue full, command dropped");
+  }
+}
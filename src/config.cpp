@@ -4,31 +4,51 @@
 const char* ssid = "Dialog 4G 858";
 const char* password = "04588A9D";
 
-// --- MQTT SETTINGS ---
+// --- MQTT SETTINGS (defaults; NVS "device" namespace overrides them) ---
 const char* mqtt_broker = "broker.hivemq.com";
 const int mqtt_port = 1883;
-const char* mqtt_client_id = "ESP32_LED_Controller";
+
+// --- OTA SIGNING KEY ---
+// Public half of the key backend/ota-image.js signs images with. Generate a pair
+// with `npm run ota:keygen` in backend/ and paste the array it prints here. All
+// zeros (no key) refuses every update.
+const uint8_t ota_signing_key[OTA_SIGNING_KEY_SIZE] = { 0 };
 
 // --- MQTT TOPICS ---
-const char* mqtt_topic = "esp32/led/control";
-const char* mqtt_status_topic = "esp32/led/status";
-const char* mqtt_led2_topic = "esp32/led2/control";
-const char* mqtt_led2_status_topic = "esp32/led2/status";
-const char* mqtt_led4_topic = "esp32/led4/control";
-const char* mqtt_led4_status_topic = "esp32/led4/status";
-const char* mqtt_sensor_voltage_topic = "esp32/sensor/voltage";
-const char* mqtt_sensor_current_topic = "esp32/sensor/current";
+// Suffixes only: buildTopicTable() prefixes them with "<prefix>/<device id>/" at boot
+const char* mqtt_topic = MQTT_LED_TOPIC;
+const char* mqtt_status_topic = "led/status";
+const char* mqtt_led2_topic = MQTT_LED2_TOPIC;
+const char* mqtt_led2_status_topic = "led2/status";
+const char* mqtt_led4_topic = MQTT_LED4_TOPIC;
+const char* mqtt_led4_status_topic = "led4/status";
+const char* mqtt_sensor_voltage_topic = "sensor/voltage";
+const char* mqtt_sensor_current_topic = "sensor/current";
 // --- POWER TOPIC 1 ---
-const char* mqtt_sensor_power_topic = "esp32/sensor/power"; 
+const char* mqtt_sensor_power_topic = "sensor/power"; 
 // ---------------------
-const char* mqtt_sensor2_voltage_topic = "esp32/sensor2/voltage";
-const char* mqtt_sensor2_current_topic = "esp32/sensor2/current";
+const char* mqtt_sensor2_voltage_topic = "sensor2/voltage";
+const char* mqtt_sensor2_current_topic = "sensor2/current";
 // --- POWER TOPIC 2 ---
-const char* mqtt_sensor2_power_topic = "esp32/sensor2/power";
+const char* mqtt_sensor2_power_topic = "sensor2/power";
 // ---------------------
-const char* mqtt_powercut_topic = "esp32/powercut/status";
-const char* mqtt_command_status_topic = "esp32/command/status";
-const char* mqtt_emergency_light_topic = "esp32/emergency/control";
-const char* mqtt_emergency_light_status_topic = "esp32/emergency/status";
-const char* mqtt_powercut_history_topic = "esp32/history/powercut";
-const char* mqtt_light_intensity_topic = "esp32/light/intensity";
\ No newline at end of file
+const char* mqtt_powercut_topic = "powercut/status";
+const char* mqtt_command_status_topic = "command/status";
+const char* mqtt_emergency_light_topic = MQTT_EMERGENCY_LIGHT_TOPIC;
+const char* mqtt_emergency_light_status_topic = "emergency/status";
+const char* mqtt_powercut_history_topic = "history/powercut";
+const char* mqtt_light_intensity_topic = "light/intensity";
+const char* mqtt_loop_stats_topic = "stats/loop";
+const char* mqtt_telemetry_frame_topic = "telemetry/frame";
+const char* mqtt_aggregate_topic = "telemetry/aggregate";
+const char* mqtt_report_stats_topic = "stats/report";
+const char* mqtt_signal_topic = "stats/signal";
+const char* mqtt_diagnostics_topic = "stats/diag";
+const char* mqtt_stall_topic = "stats/stall";
+const char* mqtt_boot_topic = "stats/boot";
+const char* mqtt_event_query_topic = MQTT_EVENT_QUERY_TOPIC;
+const char* mqtt_event_page_topic = "history/powercut/page";
+const char* mqtt_ota_topic = MQTT_OTA_TOPIC;
+const char* mqtt_ota_status_topic = "ota/status";
+const char* mqtt_snapshot_get_topic = MQTT_SNAPSHOT_GET_TOPIC;
+const char* mqtt_snapshot_topic = "status/snapshot";
\ No newline at end of file
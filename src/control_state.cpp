@@ -0,0 +1,138 @@
+#include "control_state.h"
+#include "config.h"
+#include "hal.h"
+#include "spsc_queue.h"
+#include <stddef.h>
+
+// One record, the same in RTC memory and in NVS
+struct ControlRecord {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;       // sizeof(ControlState), so a changed layout is never misread
+  uint32_t sequence;   // RTC writes since the record was created
+  ControlState state;
+  uint32_t check;      // FNV-1a of everything above
+};
+
+static_assert(sizeof(ControlRecord) <= CHECKPOINT_RECORD_MAX, "ControlRecord outgrew CHECKPOINT_RECORD_MAX");
+
+static const uint32_t CONTROL_STATE_MAGIC = 0x43535441; // "CSTA"
+static const uint16_t CONTROL_STATE_VERSION = 1;
+
+enum RestoreSource : uint8_t { RESTORED_NONE, RESTORED_RTC, RESTORED_NVS };
+static const char* const SOURCE_NAMES[] = { "none", "rtc", "nvs" };
+
+// --- CONTROL TASK ---
+static ControlRecord current;  // Last record written to RTC memory
+static bool haveCurrent = false;
+static bool nvsPending = false;
+static unsigned long lastNvsQueued = 0;
+static SpscQueue<ControlState, CHECKPOINT_QUEUE_SIZE> nvsQueue; // control -> network
+
+// --- NETWORK TASK ---
+static uint32_t nvsWrites = 0;
+
+// --- BOOT ---
+static RestoreSource restoreSource = RESTORED_NONE;
+static unsigned long restoreMicros = 0;
+
+// Cheap enough to run on every control tick; only has to tell a record from noise
+static uint32_t recordCheck(const ControlRecord& record) {
+  const uint8_t* data = (const uint8_t*)&record;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(ControlRecord, check); i++) hash = (hash ^ data[i]) * 16777619UL;
+  return hash;
+}
+
+static bool recordValid(const ControlRecord& record) {
+  return record.magic == CONTROL_STATE_MAGIC && record.version == CONTROL_STATE_VERSION &&
+    record.size == sizeof(ControlState) && record.check == recordCheck(record);
+}
+
+// What NVS must not miss: a cut beginning or ending, a sequence step, an output
+static bool isTransition(const ControlState& a, const ControlState& b) {
+  return a.powerCut != b.powerCut || a.emergencyMode != b.emergencyMode || a.manualLight != b.manualLight ||
+    a.gpio14Activated != b.gpio14Activated || a.outputs != b.outputs;
+}
+
+void controlStateSave(const ControlState& state) {
+  if (!haveCurrent || memcmp(&state, &current.state, sizeof(state)) != 0) {
+    unsigned long now = halMillis();
+    if (!haveCurrent || isTransition(state, current.state)) nvsPending = true;
+    else if (state.powerCut && now - lastNvsQueued >= CHECKPOINT_NVS_INTERVAL) nvsPending = true;
+
+    current.magic = CONTROL_STATE_MAGIC;
+    current.version = CONTROL_STATE_VERSION;
+    current.size = sizeof(ControlState);
+    current.sequence++;
+    memcpy(&current.state, &state, sizeof(state)); // Padding included, for the memcmp above
+    current.check = recordCheck(current);
+    halStateRtcWrite(&current, sizeof(current));
+    haveCurrent = true;
+  }
+
+  // Retried every tick while the network task has not taken the last one
+  if (nvsPending && nvsQueue.push(current.state)) {
+    nvsPending = false;
+    lastNvsQueued = halMillis();
+  }
+}
+
+void controlStatePersist() {
+  ControlState state;
+  bool have = false;
+  while (nvsQueue.pop(state)) have = true; // Only the latest matters
+  if (!have) return;
+
+  ControlRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = CONTROL_STATE_MAGIC;
+  record.version = CONTROL_STATE_VERSION;
+  record.size = sizeof(ControlState);
+  record.state = state;
+  record.check = recordCheck(record);
+  if (halStateNvsWrite(&record, sizeof(record))) nvsWrites++;
+  else Serial.println("ERROR: Control state checkpoint not written to NVS");
+}
+
+bool controlStateLoad(ControlState& state) {
+  // Nothing from before the reset is still queued
+  ControlState discard;
+  while (nvsQueue.pop(discard)) {}
+  nvsPending = false;
+  lastNvsQueued = halMillis();
+  haveCurrent = false;
+  restoreSource = RESTORED_NONE;
+  restoreMicros = 0;
+
+  ControlRecord record;
+  if (halStateRtcRead(&record, sizeof(record)) && recordValid(record)) {
+    restoreSource = RESTORED_RTC;
+    nvsPending = true; // The reset may have come before the network task wrote the last transition
+  } else if (halStateNvsRead(&record, sizeof(record)) && recordValid(record)) {
+    restoreSource = RESTORED_NVS;
+    halStateRtcWrite(&record, sizeof(record));
+  } else {
+    return false;
+  }
+  current = record;
+  haveCurrent = true;
+  state = record.state;
+  return true;
+}
+
+void controlStateRestored() {
+  restoreMicros = halMicros();
+}
+
+const char* controlStateRestoredFrom() {
+  return SOURCE_NAMES[restoreSource];
+}
+
+unsigned long controlStateRestoreMicros() {
+  return restoreMicros;
+}
+
+uint32_t controlStateNvsWrites() {
+  return nvsWrites;
+}
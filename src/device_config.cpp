@@ -0,0 +1,34 @@
+#include "device_config.h"
+#include "topics.h"
+#include <Preferences.h>
+#include <esp_mac.h>
+
+static DeviceConfig config;
+
+void loadDeviceConfig() {
+  uint8_t mac[6];
+  esp_read_mac(mac, ESP_MAC_WIFI_STA); // Works before WiFi is started
+  char defaultId[DEVICE_ID_SIZE];
+  deviceIdFromMac(mac, defaultId, sizeof(defaultId));
+
+  memset(&config, 0, sizeof(config)); // getString() leaves the buffer alone on a missing key
+  Preferences prefs;
+  prefs.begin("device", true); // Read-only: provisioning tools write these keys
+  prefs.getString("id", config.deviceId, sizeof(config.deviceId));
+  prefs.getString("prefix", config.topicPrefix, sizeof(config.topicPrefix));
+  prefs.getString("broker", config.broker, sizeof(config.broker));
+  config.port = prefs.getUShort("port", mqtt_port);
+  prefs.end();
+
+  if (config.deviceId[0] == '\0') strlcpy(config.deviceId, defaultId, sizeof(config.deviceId));
+  if (config.topicPrefix[0] == '\0') strlcpy(config.topicPrefix, DEFAULT_TOPIC_PREFIX, sizeof(config.topicPrefix));
+  if (config.broker[0] == '\0') strlcpy(config.broker, mqtt_broker, sizeof(config.broker));
+
+  buildTopicTable(config.topicPrefix, config.deviceId);
+  Serial.printf("Device: %s, topics under %s, broker %s:%u\n",
+    config.deviceId, topicDevicePrefix(), config.broker, config.port);
+}
+
+const DeviceConfig& deviceConfig() {
+  return config;
+}
@@ -0,0 +1,181 @@
+#include "diagnostics.h"
+#include "text_buffer.h"
+
+struct ProbeState {
+  volatile uint32_t count;
+  volatile uint32_t totalMicros;
+  volatile uint32_t maxMicros;
+  volatile uint32_t buckets[DIAG_HISTOGRAM_BUCKETS];
+};
+
+struct TaskEntry {
+  const char* name;
+  TaskHandle_t handle;
+};
+
+static const char* const PROBE_NAMES[DIAG_PROBE_COUNT] = {
+  "sensors", "sampler_read", "mqtt_callback",
+  "mqtt_publish", "mqtt_connect", "tg_poll", "tg_send",
+};
+
+static const char* const MILESTONE_NAMES[DIAG_MILESTONE_COUNT] = {
+  "first_sample", "wifi", "mqtt", "first_publish",
+};
+
+static const char* const COUNTER_NAMES[DIAG_COUNTER_COUNT] = {
+  "wifi_reconnects", "mqtt_reconnects", "mqtt_connect_fails", "publish_fails",
+};
+
+static ProbeState probes[DIAG_PROBE_COUNT];
+static volatile uint32_t counters[DIAG_COUNTER_COUNT];
+static volatile uint32_t milestones[DIAG_MILESTONE_COUNT];
+static TaskEntry tasks[DIAG_MAX_TASKS];
+static size_t taskCount = 0;
+
+static uint32_t cyclesPerMicro = 1;
+static uint32_t probeCycles = 0;
+
+// --- REPORT STATE (network task) ---
+static char payload[DIAG_PAYLOAD_SIZE];
+static uint32_t lastReportProbes = 0;
+static unsigned long lastReportMicros = 0;
+
+static void record(ProbeState& state, uint32_t cycles) {
+  uint32_t micros = cycles / cyclesPerMicro;
+  size_t bucket = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+  if (bucket >= DIAG_HISTOGRAM_BUCKETS) bucket = DIAG_HISTOGRAM_BUCKETS - 1;
+
+  state.buckets[bucket] = state.buckets[bucket] + 1;
+  state.totalMicros = state.totalMicros + micros;
+  if (micros > state.maxMicros) state.maxMicros = micros;
+  state.count = state.count + 1;
+}
+
+void diagBegin() {
+  cyclesPerMicro = halCyclesPerMicro();
+  if (cyclesPerMicro == 0) cyclesPerMicro = 1;
+
+  // Same work as a DiagScope, recorded into a scratch probe
+  const uint32_t rounds = 64;
+  ProbeState scratch;
+  memset(&scratch, 0, sizeof(scratch));
+  uint32_t start = halCycleCount();
+  for (uint32_t i = 0; i < rounds; i++) {
+    uint32_t probeStart = halCycleCount();
+    record(scratch, halCycleCount() - probeStart);
+  }
+  probeCycles = (halCycleCount() - start) / rounds;
+  lastReportMicros = halMicros();
+}
+
+void diagRecord(DiagProbe probe, uint32_t startCycles) {
+  record(probes[probe], halCycleCount() - startCycles);
+}
+
+void diagCount(DiagCounter counter) {
+  counters[counter] = counters[counter] + 1;
+}
+
+void diagMilestone(DiagMilestone milestone) {
+  if (milestones[milestone] != 0) return;
+  uint32_t now = halMillis();
+  milestones[milestone] = now > 0 ? now : 1; // 0 means "not yet"
+}
+
+uint32_t diagMilestoneMillis(DiagMilestone milestone) {
+  return milestones[milestone];
+}
+
+void diagAppendMilestones(TextBuffer& out) {
+  out.append("{");
+  for (size_t m = 0; m < DIAG_MILESTONE_COUNT; m++) {
+    out.appendf("%s\"%s\":%lu", m > 0 ? "," : "", MILESTONE_NAMES[m], (unsigned long)milestones[m]);
+  }
+  out.append("}");
+}
+
+void diagRegisterTask(const char* name, TaskHandle_t task) {
+  if (taskCount >= DIAG_MAX_TASKS || task == NULL) return;
+  tasks[taskCount].name = name;
+  tasks[taskCount].handle = task;
+  taskCount++;
+}
+
+DiagProbeStats diagProbeStats(DiagProbe probe) {
+  const ProbeState& state = probes[probe];
+  DiagProbeStats stats;
+  stats.count = state.count;
+  stats.totalMicros = state.totalMicros;
+  stats.maxMicros = state.maxMicros;
+  for (size_t b = 0; b < DIAG_HISTOGRAM_BUCKETS; b++) stats.buckets[b] = state.buckets[b];
+  return stats;
+}
+
+uint32_t diagCounter(DiagCounter counter) {
+  return counters[counter];
+}
+
+uint32_t diagProbeCycles() {
+  return probeCycles;
+}
+
+uint32_t diagTotalProbes() {
+  uint32_t total = 0;
+  for (size_t p = 0; p < DIAG_PROBE_COUNT; p++) total += probes[p].count;
+  return total;
+}
+
+// {"probe_cycles":..,"overhead_pct":..,"probes":{"sensors":{"n","avg_us","max_us","hist":[..]},..},
+//  "counters":{..},"boot_ms":{..},"heap_free":..,"heap_min":..,"stack_free":{"control":..,..}}
+const char* diagFormatReport() {
+  TextBuffer out(payload, sizeof(payload));
+
+  // Probe cost as a share of one core's time since the last report
+  unsigned long now = halMicros();
+  uint32_t totalProbes = diagTotalProbes();
+  uint64_t elapsedCycles = (uint64_t)(now - lastReportMicros) * cyclesPerMicro;
+  float overhead = elapsedCycles > 0
+    ? 100.0f * (float)((uint64_t)(totalProbes - lastReportProbes) * probeCycles) / (float)elapsedCycles : 0;
+  lastReportMicros = now;
+  lastReportProbes = totalProbes;
+  if (overhead > DIAG_OVERHEAD_BUDGET_PCT) {
+    Serial.printf("WARNING: Diagnostics overhead %.2f%% over the %.2f%% budget\n", overhead, DIAG_OVERHEAD_BUDGET_PCT);
+  }
+
+  out.appendf("{\"probe_cycles\":%lu,\"overhead_pct\":%.3f,\"probes\":{",
+    (unsigned long)probeCycles, overhead);
+  for (size_t p = 0; p < DIAG_PROBE_COUNT; p++) {
+    DiagProbeStats stats = diagProbeStats((DiagProbe)p);
+    probes[p].maxMicros = 0; // Worst time per report interval
+
+    // Trailing empty buckets are left out
+    size_t used = DIAG_HISTOGRAM_BUCKETS;
+    while (used > 0 && stats.buckets[used - 1] == 0) used--;
+
+    out.appendf("%s\"%s\":{\"n\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"hist\":[",
+      p > 0 ? "," : "", PROBE_NAMES[p], (unsigned long)stats.count,
+      (unsigned long)(stats.count > 0 ? stats.totalMicros / stats.count : 0), (unsigned long)stats.maxMicros);
+    for (size_t b = 0; b < used; b++) {
+      out.appendf("%s%lu", b > 0 ? "," : "", (unsigned long)stats.buckets[b]);
+    }
+    out.append("]}");
+  }
+
+  out.append("},\"counters\":{");
+  for (size_t c = 0; c < DIAG_COUNTER_COUNT; c++) {
+    out.appendf("%s\"%s\":%lu", c > 0 ? "," : "", COUNTER_NAMES[c], (unsigned long)counters[c]);
+  }
+
+  out.append("},\"boot_ms\":");
+  diagAppendMilestones(out);
+
+  out.appendf(",\"heap_free\":%lu,\"heap_min\":%lu,\"stack_free\":{",
+    (unsigned long)halFreeHeap(), (unsigned long)halMinFreeHeap());
+  for (size_t t = 0; t < taskCount; t++) {
+    out.appendf("%s\"%s\":%lu", t > 0 ? "," : "", tasks[t].name, (unsigned long)halStackFree(tasks[t].handle));
+  }
+  out.append("}}");
+
+  if (out.truncated()) Serial.println("WARNING: Diagnostics report truncated, raise DIAG_PAYLOAD_SIZE");
+  return payload;
+}
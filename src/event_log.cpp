@@ -0,0 +1,229 @@
+#include "event_log.h"
+#include "config.h"
+#include "hal.h"
+#include "spsc_queue.h"
+#include "text_buffer.h"
+
+// One slot. Volts as mV and a trailing CRC keep it at 32 bytes.
+struct __attribute__((packed)) EventRecord {
+  uint32_t id;              // 0 = never written
+  uint32_t startEpoch;      // 0 = NTP had not synced
+  uint32_t endEpoch;
+  uint32_t durationMs;
+  float energy;             // mWh
+  uint16_t startMillivolts;
+  uint16_t endMillivolts;
+  uint16_t minMillivolts;
+  uint16_t reserved;
+  uint32_t crc;             // CRC-32 of everything above
+};
+static_assert(sizeof(EventRecord) == 32, "EventRecord must stay 32 bytes");
+
+// One more entry than full strides: the oldest stride may be partly overwritten
+// while the newest has already started
+static const uint32_t INDEX_ENTRIES = EVENT_LOG_CAPACITY / EVENT_INDEX_STRIDE + 1;
+
+static bool logReady = false;
+static uint32_t firstId = 0;
+static uint32_t lastId = 0;
+static uint32_t latestStart = 0;            // Running max of the start times
+static uint32_t indexKeys[INDEX_ENTRIES];   // latestStart at the first record of each stride
+static uint32_t slotReads = 0;
+
+static SpscQueue<EventQuery, EVENT_QUERY_QUEUE_SIZE> queries; // Pushed and popped by the network task
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (length--) {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint32_t recordCrc(const EventRecord& record) {
+  return crc32((const uint8_t*)&record, offsetof(EventRecord, crc));
+}
+
+static size_t slotOf(uint32_t id) {
+  return (id - 1) % EVENT_LOG_CAPACITY;
+}
+
+static uint32_t strideOf(uint32_t id) {
+  return (id - 1) / EVENT_INDEX_STRIDE;
+}
+
+static uint32_t& indexKey(uint32_t stride) {
+  return indexKeys[stride % INDEX_ENTRIES];
+}
+
+static bool readSlot(size_t slot, EventRecord& record) {
+  slotReads++;
+  return halEventStoreRead(slot, &record) && record.id != 0 && record.crc == recordCrc(record);
+}
+
+// False for a slot that was torn, or already holds a newer id
+static bool readRecord(uint32_t id, EventRecord& record) {
+  return readSlot(slotOf(id), record) && record.id == id;
+}
+
+static uint16_t toMillivolts(float volts) {
+  if (volts <= 0) return 0;
+  if (volts >= 65.535f) return UINT16_MAX;
+  return (uint16_t)(volts * 1000.0f + 0.5f);
+}
+
+void setupEventLog() {
+  logReady = halEventStoreBegin(EVENT_LOG_CAPACITY, sizeof(EventRecord));
+  if (!logReady) {
+    Serial.println("ERROR: Event store unavailable, event log disabled");
+    return;
+  }
+
+  // Pass 1: the newest id decides which ids the ring still holds
+  firstId = lastId = 0;
+  EventRecord record;
+  for (size_t slot = 0; slot < EVENT_LOG_CAPACITY; slot++) {
+    if (readSlot(slot, record) && slotOf(record.id) == slot && record.id > lastId) lastId = record.id;
+  }
+  if (lastId > 0) firstId = lastId > EVENT_LOG_CAPACITY ? lastId - EVENT_LOG_CAPACITY + 1 : 1;
+
+  // Pass 2: in id order, the running max of the start times gives the index
+  latestStart = 0;
+  memset(indexKeys, 0, sizeof(indexKeys));
+  for (uint32_t id = firstId; id != 0 && id <= lastId; id++) {
+    if (readRecord(id, record) && record.startEpoch > latestStart) latestStart = record.startEpoch;
+    if (id == firstId || (id - 1) % EVENT_INDEX_STRIDE == 0) indexKey(strideOf(id)) = latestStart;
+  }
+
+  Serial.printf("✓ Event log ready: %lu events\n", (unsigned long)(lastId > 0 ? lastId - firstId + 1 : 0));
+}
+
+uint32_t eventLogAppend(const PowerCutEvent& event, uint32_t startEpoch, uint32_t endEpoch) {
+  if (!logReady) return 0;
+
+  EventRecord record;
+  memset(&record, 0, sizeof(record));
+  record.id = lastId + 1;
+  record.startEpoch = startEpoch;
+  record.endEpoch = endEpoch;
+  record.durationMs = event.endMillis - event.startMillis;
+  record.energy = event.energy;
+  record.startMillivolts = toMillivolts(event.startVoltage);
+  record.endMillivolts = toMillivolts(event.endVoltage);
+  record.minMillivolts = toMillivolts(event.minVoltage);
+  record.crc = recordCrc(record);
+  if (!halEventStoreWrite(slotOf(record.id), &record)) return 0; // The id is used again next time
+
+  lastId = record.id;
+  if (firstId == 0) firstId = 1;
+  if (lastId - firstId + 1 > EVENT_LOG_CAPACITY) firstId = lastId - EVENT_LOG_CAPACITY + 1;
+  if (startEpoch > latestStart) latestStart = startEpoch;
+  if ((lastId - 1) % EVENT_INDEX_STRIDE == 0) indexKey(strideOf(lastId)) = latestStart;
+  return lastId;
+}
+
+// First id that started at or after since, lastId + 1 if none
+static uint32_t findSince(uint32_t since) {
+  uint32_t low = strideOf(firstId);
+  uint32_t high = strideOf(lastId);
+  uint32_t id = firstId;
+
+  // Last stride whose key is below since: the first match is in it, or starts the next one
+  if (indexKey(low) < since) {
+    while (low < high) {
+      uint32_t mid = low + (high - low + 1) / 2;
+      if (indexKey(mid) < since) low = mid;
+      else high = mid - 1;
+    }
+    id = low * EVENT_INDEX_STRIDE + 1;
+    if (id < firstId) id = firstId;
+  }
+
+  EventRecord record;
+  for (; id <= lastId; id++) {
+    if (readRecord(id, record) && record.startEpoch >= since) return id;
+  }
+  return lastId + 1;
+}
+
+// Finds the number after "key" (quotes included), e.g. "\"since\":123"
+static bool queryField(const char* text, const char* key, uint32_t& value) {
+  const char* at = strstr(text, key);
+  if (at == NULL) return false;
+  at += strlen(key);
+  while (*at == ' ' || *at == ':') at++;
+  if (*at < '0' || *at > '9') return false;
+  value = strtoul(at, NULL, 10);
+  return true;
+}
+
+bool eventLogParseQuery(const uint8_t* payload, size_t length, EventQuery& query) {
+  char text[96];
+  if (length >= sizeof(text)) return false;
+  memcpy(text, payload, length);
+  text[length] = '\0';
+
+  const char* start = text;
+  while (*start == ' ') start++;
+  if (*start != '{') return false;
+
+  uint32_t limit = EVENT_PAGE_LIMIT;
+  query.since = query.after = 0;
+  queryField(text, "\"since\"", query.since);
+  queryField(text, "\"after\"", query.after);
+  queryField(text, "\"limit\"", limit);
+  query.limit = limit < 1 ? 1 : limit > EVENT_PAGE_LIMIT ? EVENT_PAGE_LIMIT : limit;
+  return true;
+}
+
+bool eventLogQueueQuery(const EventQuery& query) {
+  return queries.push(query);
+}
+
+bool eventLogNextQuery(EventQuery& query) {
+  return queries.pop(query);
+}
+
+size_t eventLogFormatPage(const EventQuery& query, TextBuffer& out) {
+  uint32_t id = 0;
+  if (lastId > 0) {
+    id = query.after != 0 ? query.after + 1 : findSince(query.since);
+    if (id < firstId) id = firstId; // The cursor was overwritten: carry on from the oldest
+  }
+
+  out.appendf("{\"first\":%lu,\"last\":%lu,\"events\":[", (unsigned long)firstId, (unsigned long)lastId);
+  size_t count = 0;
+  EventRecord record;
+  for (; id != 0 && id <= lastId && count < query.limit; id++) {
+    if (!readRecord(id, record)) continue; // Torn by a reset: skipped
+
+    char event[192];
+    int length = snprintf(event, sizeof(event),
+      "%s{\"id\":%lu,\"start\":%lu,\"end\":%lu,\"duration\":%lu,\"startV\":%.2f,\"endV\":%.2f,"
+      "\"minV\":%.2f,\"drop\":%.2f,\"energy\":%.2f}",
+      count > 0 ? "," : "", (unsigned long)record.id, (unsigned long)record.startEpoch,
+      (unsigned long)record.endEpoch, (unsigned long)record.durationMs,
+      record.startMillivolts / 1000.0f, record.endMillivolts / 1000.0f, record.minMillivolts / 1000.0f,
+      ((int32_t)record.startMillivolts - record.endMillivolts) / 1000.0f, record.energy);
+    if (out.length() + length + 24 > EVENT_PAGE_SIZE) break; // Room for the closing "],"next":..}"
+    out.append(event);
+    count++;
+  }
+
+  uint32_t next = id != 0 && id <= lastId ? id - 1 : 0;
+  out.appendf("],\"next\":%lu}", (unsigned long)next);
+  return count;
+}
+
+uint32_t eventLogFirstId() {
+  return firstId;
+}
+
+uint32_t eventLogLastId() {
+  return lastId;
+}
+
+uint32_t eventLogSlotReads() {
+  return slotReads;
+}
@@ -0,0 +1,93 @@
+#include "fast_connect.h"
+#include "config.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+static const uint32_t WIFI_CACHE_MAGIC = 0x57494649; // "WIFI"
+
+struct WifiCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+RTC_NOINIT_ATTR static WifiCache rtcCache;
+static bool usedCache = false;
+
+static bool cacheValid(const WifiCache& cache) {
+  return cache.magic == WIFI_CACHE_MAGIC && cache.channel >= 1 && cache.channel <= 14 && cache.ip != 0;
+}
+
+static bool loadCache(WifiCache& cache) {
+  if (cacheValid(rtcCache)) {
+    cache = rtcCache;
+    return true;
+  }
+
+  // RTC memory is lost on a power cut; NVS is not
+  Preferences prefs;
+  prefs.begin("wifi", true);
+  size_t length = prefs.getBytes("cache", &cache, sizeof(cache));
+  prefs.end();
+  return length == sizeof(cache) && cacheValid(cache);
+}
+
+void setupFastConnect() {
+  WiFi.persistent(false); // Credentials come from config.cpp: don't rewrite them to flash on every begin()
+  WiFi.mode(WIFI_STA);
+}
+
+bool fastConnectBegin() {
+  WifiCache cache;
+  if (!loadCache(cache)) return false;
+
+  WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+  WiFi.begin(ssid, password, cache.channel, cache.bssid, true);
+  usedCache = true;
+  Serial.printf("Fast connect: channel %u, cached IP %s\n", cache.channel, IPAddress(cache.ip).toString().c_str());
+  return true;
+}
+
+void fastConnectSave() {
+  WifiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.magic = WIFI_CACHE_MAGIC;
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.ip = (uint32_t)WiFi.localIP();
+  cache.gateway = (uint32_t)WiFi.gatewayIP();
+  cache.subnet = (uint32_t)WiFi.subnetMask();
+  cache.dns = (uint32_t)WiFi.dnsIP();
+  rtcCache = cache;
+
+  // Flash is only written when the AP or the lease changed
+  Preferences prefs;
+  prefs.begin("wifi", false);
+  WifiCache stored;
+  if (prefs.getBytes("cache", &stored, sizeof(stored)) != sizeof(stored) ||
+      memcmp(&stored, &cache, sizeof(cache)) != 0) {
+    prefs.putBytes("cache", &cache, sizeof(cache));
+  }
+  prefs.end();
+}
+
+void fastConnectAbandon() {
+  Serial.println("Fast connect failed, scanning with DHCP");
+  memset(&rtcCache, 0, sizeof(rtcCache));
+  Preferences prefs;
+  prefs.begin("wifi", false);
+  prefs.remove("cache");
+  prefs.end();
+
+  WiFi.disconnect();
+  WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0)); // Back to DHCP
+  usedCache = false;
+}
+
+bool fastConnectUsed() {
+  return usedCache;
+}
@@ -1,13 +1,22 @@
 #include "globals.h"
 
 // --- SHARED OBJECTS ---
+#ifdef ARDUINO
 WiFiClient espClient;
-PubSubClient mqtt_client(espClient);
+MqttTransport mqttTransport(espClient);
+PubSubClient mqtt_client(mqttTransport);
 
 // RobTillaart's library accepts the standard integer address
-INA3221 INA(0x40);
+INA3221 INA(INA3221_ADDRESS);
+#endif
 
-// --- SHARED STATE VARIABLES ---
+// --- INTER-CORE QUEUES ---
+SpscQueue<SensorSample, SAMPLE_QUEUE_SIZE> sampleQueue;
+SpscQueue<OutboundMessage, OUTBOUND_QUEUE_SIZE> outboundQueue;
+SpscQueue<ControlCommand, COMMAND_QUEUE_SIZE> commandQueue;
+SpscQueue<PowerCutEvent, EVENT_QUEUE_SIZE> eventQueue;
+
+// --- SHARED STATE VARIABLES (owned by the control task) ---
 bool powerCutDetected = false;
 bool emergencyModeActive = false;
 bool manualEmergencyControl = false;
@@ -20,14 +29,4 @@ float endVoltage = 0;
 
 unsigned long emergencyStartTime = 0;
 unsigned long gpio14ActivationTime = 0;
-unsigned long powerCutStartTime = 0;
-unsigned long lastEnergyCalcTime = 0;
-
-// Define the shared variables here (initialize to 0)
-float shared_v1 = 0.0;
-float shared_c1 = 0.0;
-float shared_p1 = 0.0;
-float shared_v2 = 0.0;
-float shared_c2 = 0.0;
-float shared_p2 = 0.0;
-float shared_intensity = 0.0;
\ No newline at end of file
+unsigned long powerCutStartTime = 0;
\ No newline at end of file
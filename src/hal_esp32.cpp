@@ -0,0 +1,311 @@
+#include "hal.h"
+#include "globals.h"
+#include <esp_heap_caps.h>
+#include <driver/i2c.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+
+// --- GPIO ---
+void halPinMode(uint8_t pin, uint8_t mode) {
+  pinMode(pin, mode);
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t level) {
+  digitalWrite(pin, level);
+}
+
+int halDigitalRead(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+// --- TIME ---
+unsigned long halMillis() {
+  return millis();
+}
+
+unsigned long halMicros() {
+  return micros();
+}
+
+void halDelayMicroseconds(unsigned int us) {
+  delayMicroseconds(us);
+}
+
+uint32_t halEpochSeconds() {
+  time_t now = time(nullptr);
+  if (now < 1600000000) return 0; // Still counting from 1970 -> NTP has not synced
+  return (uint32_t)now;
+}
+
+// --- CYCLE COUNTER ---
+uint32_t halCycleCount() {
+  return ESP.getCycleCount();
+}
+
+uint32_t halCyclesPerMicro() {
+  return ESP.getCpuFreqMHz();
+}
+
+// --- MEMORY ---
+uint32_t halFreeHeap() {
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t halMinFreeHeap() {
+  return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t halStackFree(TaskHandle_t task) {
+  return uxTaskGetStackHighWaterMark(task); // Bytes on ESP-IDF
+}
+
+// --- INA3221 ---
+bool halSensorBegin() {
+  Wire.begin();
+
+  Serial.println("Initializing INA3221 (RobTillaart)...");
+
+  if (!INA.begin()) {
+    Serial.println("ERROR: Could not find INA3221. Check wiring/address!");
+    return false;
+  }
+  Serial.println("✓ INA3221 Sensor Connected!");
+  for (int ch = 0; ch < INA3221_CHANNELS; ch++) {
+    INA.setShuntR(ch, SHUNT_MILLIOHMS / 1000.0); // Used by the alert limits (power_detect.cpp)
+  }
+  return true;
+}
+
+// The whole scan is queued as one command link and run by the I2C driver in a
+// single call, instead of two Wire transactions per register. The Arduino core
+// runs Wire on the same IDF driver (port 0), which serialises the two.
+static uint8_t scanLink[I2C_LINK_RECOMMENDED_SIZE(INA3221_SCAN_REGISTERS)];
+
+bool halSensorScan(SensorScan& scan) {
+  uint8_t raw[INA3221_SCAN_REGISTERS][2];
+  i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(scanLink, sizeof(scanLink));
+  for (size_t r = 0; r < INA3221_SCAN_REGISTERS; r++) {
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, INA3221_ADDRESS << 1 | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, INA3221_FIRST_RESULT_REGISTER + r, true);
+    i2c_master_start(cmd); // Repeated START
+    i2c_master_write_byte(cmd, INA3221_ADDRESS << 1 | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, raw[r], 2, I2C_MASTER_LAST_NACK);
+  }
+  i2c_master_stop(cmd);
+  esp_err_t err = i2c_master_cmd_begin(I2C_NUM_0, cmd, pdMS_TO_TICKS(5));
+  i2c_cmd_link_delete_static(cmd);
+  if (err != ESP_OK) return false;
+
+  ina3221Decode(raw, scan);
+  return true;
+}
+
+void halSensorConfigure(uint8_t averageIndex, uint8_t conversionIndex) {
+  Wire.setClock(I2C_CLOCK_HZ);
+  INA.setAverage(averageIndex);
+  INA.setBusVoltageConversionTime(conversionIndex);
+  INA.setShuntVoltageConversionTime(conversionIndex);
+  INA.setModeShuntBusContinuous();
+}
+
+// --- SAMPLE TIMER ---
+static TaskHandle_t sampleTaskHandle = NULL;
+static hw_timer_t* sampleTimer = NULL;
+static HalSampleTickFn sampleTick = NULL;
+
+static void IRAM_ATTR onSampleTimer() {
+  BaseType_t higherPriorityWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(sampleTaskHandle, &higherPriorityWoken);
+  if (higherPriorityWoken) portYIELD_FROM_ISR();
+}
+
+static void sampleTask(void* param) {
+  for (;;) {
+    uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    sampleTick(ticks - 1);
+  }
+}
+
+TaskHandle_t halSampleTimerStart(uint32_t periodMicros, HalSampleTickFn tick) {
+  sampleTick = tick;
+  // Above the control task: a late sample skews the energy integral
+  xTaskCreatePinnedToCore(sampleTask, "sampler", 4096, NULL, 4, &sampleTaskHandle, CONTROL_CORE);
+
+  // Timer 0 at 1 MHz (80 MHz APB / 80), auto-reload every sample period
+  sampleTimer = timerBegin(0, 80, true);
+  timerAttachInterrupt(sampleTimer, &onSampleTimer, true);
+  timerAlarmWrite(sampleTimer, periodMicros, true);
+  timerAlarmEnable(sampleTimer);
+  return sampleTaskHandle;
+}
+
+// --- EVENT STORE ---
+// One LittleFS file of fixed-size slots, filled with zeros when it is created and
+// kept open; every write is flushed, which commits it to flash
+static const char* EVENT_STORE_PATH = "/events.bin";
+static File eventStore;
+static size_t eventRecordSize = 0;
+
+bool halEventStoreBegin(size_t slots, size_t recordSize) {
+  if (!LittleFS.begin(true)) return false;
+  eventRecordSize = recordSize;
+
+  size_t size = slots * recordSize;
+  if (!LittleFS.exists(EVENT_STORE_PATH)) {
+    File file = LittleFS.open(EVENT_STORE_PATH, FILE_WRITE);
+    if (!file) return false;
+    file.close();
+  }
+  eventStore = LittleFS.open(EVENT_STORE_PATH, "r+");
+  if (!eventStore) return false;
+
+  if (eventStore.size() < size) { // New, or EVENT_LOG_CAPACITY grew
+    uint8_t zeros[64];
+    memset(zeros, 0, sizeof(zeros));
+    eventStore.seek(eventStore.size());
+    for (size_t at = eventStore.size(); at < size; at += sizeof(zeros)) {
+      size_t chunk = size - at < sizeof(zeros) ? size - at : sizeof(zeros);
+      if (eventStore.write(zeros, chunk) != chunk) return false;
+    }
+    eventStore.flush();
+  }
+  return true;
+}
+
+bool halEventStoreRead(size_t slot, void* record) {
+  if (!eventStore.seek(slot * eventRecordSize)) return false;
+  return eventStore.read((uint8_t*)record, eventRecordSize) == eventRecordSize;
+}
+
+bool halEventStoreWrite(size_t slot, const void* record) {
+  if (!eventStore.seek(slot * eventRecordSize)) return false;
+  if (eventStore.write((const uint8_t*)record, eventRecordSize) != eventRecordSize) return false;
+  eventStore.flush();
+  return true;
+}
+
+// --- STATE CHECKPOINT ---
+// RTC slow memory, left alone by the startup code; NVS namespace "control"
+RTC_NOINIT_ATTR static uint8_t rtcState[CHECKPOINT_RECORD_MAX];
+
+bool halStateRtcRead(void* record, size_t size) {
+  if (size > sizeof(rtcState)) return false;
+  memcpy(record, rtcState, size);
+  return true;
+}
+
+void halStateRtcWrite(const void* record, size_t size) {
+  if (size <= sizeof(rtcState)) memcpy(rtcState, record, size);
+}
+
+bool halStateNvsRead(void* record, size_t size) {
+  Preferences prefs;
+  if (!prefs.begin("control", true)) return false; // Namespace not created yet
+  size_t length = prefs.getBytes("state", record, size);
+  prefs.end();
+  return length == size;
+}
+
+bool halStateNvsWrite(const void* record, size_t size) {
+  Preferences prefs;
+  if (!prefs.begin("control", false)) return false;
+  size_t written = prefs.putBytes("state", record, size);
+  prefs.end();
+  return written == size;
+}
+
+// --- JOURNAL STORE ---
+// One LittleFS file per segment (/journal/NNNNNNNN.bin); NVS namespace "journal"
+static const char* JOURNAL_DIR = "/journal";
+
+static void journalPath(uint32_t segment, char* path, size_t size) {
+  snprintf(path, size, "%s/%08lu.bin", JOURNAL_DIR, (unsigned long)segment);
+}
+
+bool halJournalBegin() {
+  if (!LittleFS.begin(true)) return false;
+  LittleFS.mkdir(JOURNAL_DIR);
+  return true;
+}
+
+void halJournalList(HalJournalSegmentFn found) {
+  File dir = LittleFS.open(JOURNAL_DIR);
+  if (!dir) return;
+  File entry = dir.openNextFile();
+  while (entry) {
+    const char* name = strrchr(entry.name(), '/');
+    name = name ? name + 1 : entry.name();
+    uint32_t segment = strtoul(name, NULL, 10);
+    uint32_t bytes = entry.size();
+    entry.close();
+    found(segment, bytes);
+    entry = dir.openNextFile();
+  }
+  dir.close();
+}
+
+uint32_t halJournalSize(uint32_t segment) {
+  char path[32];
+  journalPath(segment, path, sizeof(path));
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) return 0;
+  uint32_t bytes = file.size();
+  file.close();
+  return bytes;
+}
+
+bool halJournalAppend(uint32_t segment, const void* data, size_t length) {
+  char path[32];
+  journalPath(segment, path, sizeof(path));
+  File file = LittleFS.open(path, FILE_APPEND);
+  if (!file) return false;
+  size_t written = file.write((const uint8_t*)data, length);
+  file.close();
+  return written == length;
+}
+
+size_t halJournalRead(uint32_t segment, uint32_t offset, void* data, size_t length) {
+  char path[32];
+  journalPath(segment, path, sizeof(path));
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) return 0;
+  size_t read = file.seek(offset) ? file.read((uint8_t*)data, length) : 0;
+  file.close();
+  return read;
+}
+
+void halJournalRemove(uint32_t segment) {
+  char path[32];
+  journalPath(segment, path, sizeof(path));
+  LittleFS.remove(path);
+}
+
+uint32_t halJournalBoot() {
+  Preferences prefs;
+  prefs.begin("journal", false);
+  uint32_t boots = prefs.getUInt("boots", 0) + 1;
+  prefs.putUInt("boots", boots);
+  prefs.end();
+  return boots;
+}
+
+bool halJournalCursorRead(uint32_t& segment, uint32_t& records) {
+  Preferences prefs;
+  if (!prefs.begin("journal", true)) return false;
+  uint32_t cursor[2];
+  size_t length = prefs.getBytes("cursor", cursor, sizeof(cursor));
+  prefs.end();
+  if (length != sizeof(cursor)) return false;
+  segment = cursor[0];
+  records = cursor[1];
+  return true;
+}
+
+void halJournalCursorWrite(uint32_t segment, uint32_t records) {
+  Preferences prefs;
+  if (!prefs.begin("journal", false)) return;
+  uint32_t cursor[2] = { segment, records };
+  prefs.putBytes("cursor", cursor, sizeof(cursor));
+  prefs.end();
+}
@@ -1,232 +1,302 @@
 #include "hardware.h"
 #include "config.h"
 #include "globals.h"
-#include "network.h"
+#include "hal.h"
+#include "outbound.h"
+#include "sampler.h"
+#include "power_detect.h"
+#include "intensity_input.h"
+#include "text_buffer.h"
+#include "diagnostics.h"
+#include "control_state.h"
+#include "reading_snapshot.h"
+
+static void restoreControlState(const ControlState& saved);
+static void checkpointControlState();
+static uint8_t outputBits(bool resting);
 
 void setupHardware() {
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
+  // Power-on levels, unless a reset came in the middle of a cut or after a
+  // command: then straight to the levels saved before it (control_state.h)
+  ControlState saved;
+  bool restored = controlStateLoad(saved);
+  uint8_t outputs = restored ? saved.outputs : CONTROL_OUTPUTS_DEFAULT;
+
+  halPinMode(LED_PIN, OUTPUT);
+  halDigitalWrite(LED_PIN, (outputs & CONTROL_OUT_LED) ? HIGH : LOW);
   
-  pinMode(LED2_PIN, OUTPUT);
-  digitalWrite(LED2_PIN, HIGH); 
+  halPinMode(LED2_PIN, OUTPUT);
+  halDigitalWrite(LED2_PIN, (outputs & CONTROL_OUT_SYSTEM) ? HIGH : LOW); 
   
-  pinMode(LED4_PIN, OUTPUT);
-  digitalWrite(LED4_PIN, HIGH); 
+  halPinMode(LED4_PIN, OUTPUT);
+  halDigitalWrite(LED4_PIN, (outputs & CONTROL_OUT_GPIO14) ? HIGH : LOW); 
   
-  pinMode(POWER_STATUS_PIN, OUTPUT);
-  digitalWrite(POWER_STATUS_PIN, HIGH); 
+  halPinMode(POWER_STATUS_PIN, OUTPUT);
+  halDigitalWrite(POWER_STATUS_PIN, (outputs & CONTROL_OUT_LIGHT) ? HIGH : LOW); 
+
+  if (restored) restoreControlState(saved);
   
-  pinMode(INTENSITY_B0_PIN, INPUT);
-  pinMode(INTENSITY_B1_PIN, INPUT);
-  pinMode(INTENSITY_B2_PIN, INPUT);
+  halPinMode(INTENSITY_B0_PIN, INPUT);
+  halPinMode(INTENSITY_B1_PIN, INPUT);
+  halPinMode(INTENSITY_B2_PIN, INPUT);
   
-  Wire.begin();
+  halSensorBegin();
+}
+
+static uint32_t sampleSequence = 0;
+static void finishStatusReport(bool arrived);
+
+// Turns a decimated reading + intensity into one timestamped sample
+// and hands it to the network core
+static void publishSnapshot(const SensorSample& sample);
+
+static SensorSample publishSample(const PowerReading& reading) {
+  SensorSample sample;
+  sample.sequence = sampleSequence++;
+  sample.timestamp = reading.timestamp;
+  sample.flags = reading.flags;
+
+  // --- LIGHT INTENSITY --- kept current by handleIntensityInput()
+  sample.intensity = currentLightIntensity;
+
+  // --- CHANNEL 1 (Main Power) --- window means from the sampler
+  sample.v1 = reading.voltage[0];
+  sample.c1 = reading.current[0];
+  sample.p1 = reading.power[0];
+
+  // --- CHANNEL 2 (System Power) ---
+  sample.v2 = reading.voltage[1];
+  sample.c2 = reading.current[1];
+  sample.p2 = reading.power[1];
+
+  publishSnapshot(sample); // Before the sample: the network task may look at both
+
+  // If the network core is stalled the ring fills up and the newest samples are
+  // dropped (and counted); sampling itself never waits.
+  sampleQueue.push(sample);
+  return sample;
+}
+
+// --- LATEST-READING SNAPSHOT --- (reading_snapshot.h)
+static ReadingSnapshot snapshot;
+static bool snapshotStarted = false;
+
+static void publishSnapshot(const SensorSample& sample) {
+  snapshot.sequence = sample.sequence;
+  snapshot.timestamp = sample.timestamp;
+  snapshot.v1 = sample.v1;
+  snapshot.c1 = sample.c1;
+  snapshot.p1 = sample.p1;
+  snapshot.v2 = sample.v2;
+  snapshot.c2 = sample.c2;
+  snapshot.p2 = sample.p2;
+  snapshot.intensity = sample.intensity;
+  snapshot.flags = sample.flags;
+  snapshot.outputs = outputBits(false);
+  snapshot.powerCut = powerCutDetected;
+  snapshot.emergencyMode = emergencyModeActive;
+  snapshotPublish(snapshot);
+  snapshotStarted = true;
+}
+
+// Outputs or flags changed since the last reading: same reading, new state
+static void refreshSnapshot() {
+  if (!snapshotStarted) return; // Nothing to show without a reading
+  uint8_t outputs = outputBits(false);
+  if (outputs == snapshot.outputs && powerCutDetected == snapshot.powerCut &&
+      emergencyModeActive == snapshot.emergencyMode) return;
+  snapshot.outputs = outputs;
+  snapshot.powerCut = powerCutDetected;
+  snapshot.emergencyMode = emergencyModeActive;
+  snapshotPublish(snapshot);
+}
+
+// --- EMERGENCY LIGHT (automatic) ---
+// During a cut the light follows the intensity input with hysteresis: ON below
+// INTENSITY_LIGHT_ON_PCT, OFF above INTENSITY_LIGHT_OFF_PCT, left alone in
+// between, so an input sitting on one code boundary cannot flap the relay.
+static uint32_t lightToggleCount = 0;
+
+static void updateEmergencyLight() {
+  if (!powerCutDetected || manualEmergencyControl) return;
+
+  bool lightOn = halDigitalRead(POWER_STATUS_PIN) == LOW;
+  bool wantOn = lightOn;
+  if (currentLightIntensity < INTENSITY_LIGHT_ON_PCT) wantOn = true;
+  else if (currentLightIntensity > INTENSITY_LIGHT_OFF_PCT) wantOn = false;
+  if (wantOn == lightOn) return;
+
+  lightToggleCount++;
+  halDigitalWrite(POWER_STATUS_PIN, wantOn ? LOW : HIGH);
+  queuePublish(mqtt_emergency_light_status_topic, wantOn ? "ON" : "OFF");
+  queueCommandStatus(wantOn ? "💡 Light Intensity Low - Emergency Light ON"
+                            : "💡 Light Intensity Recovered - Emergency Light OFF");
+}
+
+uint32_t emergencyLightToggles() {
+  return lightToggleCount;
+}
+
+// Latest readings, for a cut flagged by the detect pin between two windows
+static float lastMainVoltage = 0;
+static float lastSystemVoltage = 0;
+static float cutMinVoltage = 0; // Lowest main voltage of the current cut
+
+static void beginPowerCut(unsigned long currentMillis) {
+  float v1 = lastMainVoltage;
+  float v2 = lastSystemVoltage;
+
+  powerCutDetected = true;
+  emergencyModeActive = true;
+  emergencyStartTime = currentMillis;
+  gpio14Activated = false;
   
-  Serial.println("Initializing INA3221 (RobTillaart)...");
+  powerCutStartTime = currentMillis;
+  startVoltage = v1;
+  cutMinVoltage = v1;
+  totalEnergyConsumed = 0;
   
-  if (!INA.begin()) {
-    Serial.println("ERROR: Could not find INA3221. Check wiring/address!");
-  } else {
-    Serial.println("✓ INA3221 Sensor Connected!");
-    INA.setShuntR(0, 0.1);
-    INA.setShuntR(1, 0.1);
-    INA.setShuntR(2, 0.1);
-  }
+  queuePublish(mqtt_powercut_topic, "POWER_CUT");
+  queueCommandStatus("⚠️ POWER CUT DETECTED! Starting emergency sequence...");
+  
+  // ---Send Telegram Alert ---
+  TextBuffer alertMsg;
+  alertMsg.append("⚠️ Power Cut Detected!\n");
+  alertMsg.appendf("Main Voltage: %.2fV\n", v1);
+  alertMsg.appendf("System Voltage: %.2fV", v2);
+  queueTelegram(alertMsg.c_str());
+  
+
+  // --- 1. IMMEDIATE SYSTEM ACTIONS ---
+  halDigitalWrite(LED2_PIN, LOW); // Turn System ON
+  queuePublish(mqtt_led2_status_topic, "ON");
+  queueCommandStatus("✓ Step 1: GPIO13 (System) turned ON");
+
+  // --- 2. IMMEDIATE EMERGENCY LIGHT CHECK --- then on every intensity change
+  updateEmergencyLight();
+  
+  gpio14ActivationTime = currentMillis + GPIO14_DELAY;
+  Serial.println("⚠️ POWER CUT DETECTED! Emergency mode activated.");
 }
 
-void updateSensors() {
-  static unsigned long lastSensorRead = 0;
-  static unsigned long lastIntensityRead = 0;
-  unsigned long currentMillis = millis();
-
-  // --- LIGHT INTENSITY ---
-  if (currentMillis - lastIntensityRead >= 2000) {
-    lastIntensityRead = currentMillis;
-    int b0 = digitalRead(INTENSITY_B0_PIN);
-    int b1 = digitalRead(INTENSITY_B1_PIN);
-    int b2 = digitalRead(INTENSITY_B2_PIN);
-    int val = (b2 << 2) | (b1 << 1) | b0;
-    currentLightIntensity = (val / 7.0) * 100.0;
-
-    //Save to Shared Variable for Telegram
-    shared_intensity = currentLightIntensity;
-
-    char intensityStr[10];
-    dtostrf(currentLightIntensity, 5, 1, intensityStr);
-    mqtt_client.publish(mqtt_light_intensity_topic, intensityStr);
-    Serial.printf("Light Intensity: %.1f%%\n", currentLightIntensity);
+static void endPowerCut(unsigned long currentMillis) {
+  float v1 = lastMainVoltage;
+
+  powerCutDetected = false;
+  endVoltage = v1;
+  float drop = startVoltage - endVoltage;
+  unsigned long dur = currentMillis - powerCutStartTime;
+  
+  TextBuffer history;
+  history.appendf("{\"duration\":%lu,\"startV\":%.2f,\"endV\":%.2f,\"drop\":%.2f,\"energy\":%.2f}",
+    dur, startVoltage, endVoltage, drop, totalEnergyConsumed);
+  queuePublish(mqtt_powercut_history_topic, history.c_str());
+
+  // The network task keeps it in the flash event log (event_log.h)
+  PowerCutEvent event = { powerCutStartTime, currentMillis, startVoltage, endVoltage, cutMinVoltage, totalEnergyConsumed };
+  if (!eventQueue.push(event)) Serial.println("ERROR: Event queue full, outage not logged");
+  
+  if (!manualEmergencyControl) {
+    halDigitalWrite(POWER_STATUS_PIN, HIGH);
+    queuePublish(mqtt_emergency_light_status_topic, "OFF");
   }
+  queuePublish(mqtt_powercut_topic, "NORMAL");
+  queuePublish(mqtt_command_status_topic, "CLEAR_LOG");
+  queueCommandStatus("✓ Power Restored.");
 
-  // --- INA3221 READINGS ---
-  if (currentMillis - lastSensorRead >= 2000) {
-    lastSensorRead = currentMillis;
-    
-    Serial.println("\n--- Channel Measurements ---");
-    
-    // --- CHANNEL 1 (Main Power) ---
-    float v1 = INA.getBusVoltage(0);
-    float c1 = fabsf(INA.getCurrent(0) * 1000.0); // Force Positive Current
-    float p1 = v1 * c1; // Calculate Power (mW)
-    
-    //Save Ch1 to Shared Variables
-    shared_v1 = v1;
-    shared_c1 = c1;
-    shared_p1 = p1;
-
-    char v1s[10], c1s[10], p1s[10];
-    dtostrf(v1, 5, 3, v1s); 
-    dtostrf(c1, 6, 2, c1s);
-    dtostrf(p1, 6, 2, p1s); // Convert Power to String
-
-    mqtt_client.publish(mqtt_sensor_voltage_topic, v1s);
-    mqtt_client.publish(mqtt_sensor_current_topic, c1s);
-    mqtt_client.publish(mqtt_sensor_power_topic, p1s); // <--- NEW: Publish Power
-    
-    Serial.printf("CH1: %.3f V | %.2f mA | %.2f mW\n", v1, c1, p1);
-
-    // --- CHANNEL 2 (System Power) ---
-    float v2 = INA.getBusVoltage(1);
-    float c2 = fabsf(INA.getCurrent(1) * 1000.0); // Force Positive Current
-    float p2 = v2 * c2; // Calculate Power (mW)
-
-    //Save Ch2 to Shared Variables
-    shared_v2 = v2;
-    shared_c2 = c2;
-    shared_p2 = p2;
-
-    char v2s[10], c2s[10], p2s[10];
-    dtostrf(v2, 5, 3, v2s); 
-    dtostrf(c2, 6, 2, c2s);
-    dtostrf(p2, 6, 2, p2s); // Convert Power to String
-
-    mqtt_client.publish(mqtt_sensor2_voltage_topic, v2s);
-    mqtt_client.publish(mqtt_sensor2_current_topic, c2s);
-    mqtt_client.publish(mqtt_sensor2_power_topic, p2s); // <--- NEW: Publish Power
-    
-    Serial.printf("CH2: %.3f V | %.2f mA | %.2f mW\n", v2, c2, p2);
-    
-    // --- ENERGY CALCULATION ---
-    if (powerCutDetected) {
-      float timeDelta = (currentMillis - lastEnergyCalcTime) / 1000.0;
-      // p1 is already calculated above as v1 * c1
-      totalEnergyConsumed += (p1 * (timeDelta / 3600.0)); 
-      lastEnergyCalcTime = currentMillis;
-    }
+  // ---Send Restoration Alert To Telegram ---
+  TextBuffer restoreMsg;
+  restoreMsg.append("✅ Power Restored.\n");
+  restoreMsg.appendf("Duration: %lu seconds\n", dur / 1000);
+  restoreMsg.appendf("Energy Used: %.2f mWh", totalEnergyConsumed);
+  queueTelegram(restoreMsg.c_str());
+  // ------------
+  
+  // Interrupt Emergency Mode if active
+  if (emergencyModeActive) {
+     halDigitalWrite(LED2_PIN, HIGH);
+     halDigitalWrite(LED4_PIN, HIGH);
+     queuePublish(mqtt_led2_status_topic, "OFF");
+     queuePublish(mqtt_led4_status_topic, "OFF");
+     emergencyModeActive = false;
+     Serial.println("Emergency mode interrupted.");
+  }
+}
 
-    // --- POWER CUT DETECTION LOGIC ---
-    if (v2 < POWER_CUT_THRESHOLD) {
-      if (!powerCutDetected) {
-        powerCutDetected = true;
-        emergencyModeActive = true;
-        emergencyStartTime = currentMillis;
-        gpio14Activated = false;
-        
-        powerCutStartTime = currentMillis;
-        lastEnergyCalcTime = currentMillis;
-        startVoltage = v1;
-        totalEnergyConsumed = 0;
-        
-        mqtt_client.publish(mqtt_powercut_topic, "POWER_CUT");
-        publishCommandStatus("⚠️ POWER CUT DETECTED! Starting emergency sequence...");
-        
-        // ---Send Telegram Alert ---
-        String alertMsg = "⚠️ Power Cut Detected!\n";
-        alertMsg += "Main Voltage: " + String(v1, 2) + "V\n";
-        alertMsg += "System Voltage: " + String(v2, 2) + "V";
-        sendTelegramMessage(alertMsg);
-        
-
-        // --- 1. IMMEDIATE SYSTEM ACTIONS ---
-        digitalWrite(LED2_PIN, LOW); // Turn System ON
-        mqtt_client.publish(mqtt_led2_status_topic, "ON");
-        publishCommandStatus("✓ Step 1: GPIO13 (System) turned ON");
-
-        // --- 2. IMMEDIATE EMERGENCY LIGHT CHECK ---
-        if (currentLightIntensity < 40.0 && !manualEmergencyControl) {
-            digitalWrite(POWER_STATUS_PIN, LOW); // ON
-            mqtt_client.publish(mqtt_emergency_light_status_topic, "ON");
-            publishCommandStatus("💡 Power Cut! Light Intensity Low - Emergency Light ON");
-        }
-        
-        gpio14ActivationTime = currentMillis + GPIO14_DELAY;
-        Serial.println("⚠️ POWER CUT DETECTED! Emergency mode activated.");
-      }
-    } else {
-      // Power Restored
-      if (powerCutDetected) {
-        powerCutDetected = false;
-        endVoltage = v1;
-        float drop = startVoltage - endVoltage;
-        unsigned long dur = currentMillis - powerCutStartTime;
-        
-        char history[200];
-        snprintf(history, sizeof(history), 
-          "{\"duration\":%lu,\"startV\":%.2f,\"endV\":%.2f,\"drop\":%.2f,\"energy\":%.2f}",
-          dur, startVoltage, endVoltage, drop, totalEnergyConsumed);
-        mqtt_client.publish(mqtt_powercut_history_topic, history);
-        
-        if (!manualEmergencyControl) {
-          digitalWrite(POWER_STATUS_PIN, HIGH);
-          mqtt_client.publish(mqtt_emergency_light_status_topic, "OFF");
-        }
-        mqtt_client.publish(mqtt_powercut_topic, "NORMAL");
-        mqtt_client.publish(mqtt_command_status_topic, "CLEAR_LOG");
-        delay(50);
-        publishCommandStatus("✓ Power Restored.");
-
-        // ---Send Restoration Alert To Telegram ---
-        String restoreMsg = "✅ Power Restored.\n";
-        restoreMsg += "Duration: " + String(dur / 1000) + " seconds\n";
-        restoreMsg += "Energy Used: " + String(totalEnergyConsumed, 2) + " mWh";
-        sendTelegramMessage(restoreMsg);
-        // ------------
-        
-        // Interrupt Emergency Mode if active
-        if (emergencyModeActive) {
-           digitalWrite(LED2_PIN, HIGH);
-           digitalWrite(LED4_PIN, HIGH);
-           mqtt_client.publish(mqtt_led2_status_topic, "OFF");
-           mqtt_client.publish(mqtt_led4_status_topic, "OFF");
-           emergencyModeActive = false;
-           Serial.println("Emergency mode interrupted.");
-        }
-      }
-    }
+// One control task tick. Shared with the native simulator so the benchmarks
+// measure exactly what runs on the board.
+void runControlTick() {
+  handlePowerDetect(); // First: may have been woken by the detect pin ISR
+  handleIntensityInput();
+  processCommands();
+  serviceOutputs();
+
+  PowerReading reading;
+  while (samplerNextReading(reading)) {
+    DiagScope timing(DIAG_SENSORS);
+    updateSensors(reading);
   }
+
+  handleEmergencyLogic();
+  refreshSnapshot();
+  checkpointControlState(); // Last: everything above may have changed the state
 }
 
-void handleEmergencyLogic() {
-  unsigned long currentMillis = millis();
+// Called by the control task for every decimated reading from the sampler
+void updateSensors(const PowerReading& reading) {
+  SensorSample sample = publishSample(reading);
+  lastMainVoltage = sample.v1;
+  lastSystemVoltage = reading.lastVoltage[1]; // Latest raw value, not the window mean
+
+  if (reading.flags & SAMPLE_FORCED) finishStatusReport(true);
 
-  // --- NEW: PERIODIC LIGHT CHECK (Every 20 Seconds) ---
-  // Requirement: "Check for every 20 sec... until power returns"
+  // --- ENERGY CALCULATION ---
+  // Integrated per sample by the sampler (trapezoidal rule at SAMPLE_RATE_HZ)
   if (powerCutDetected) {
-      static unsigned long lastLightCheck = 0;
-      
-      // The timer logic
-      if (currentMillis - lastLightCheck >= 20000) {
-          lastLightCheck = currentMillis;
-          
-          if (currentLightIntensity < 40.0 && !manualEmergencyControl) {
-             // Ensure it is ON
-             digitalWrite(POWER_STATUS_PIN, LOW); 
-             mqtt_client.publish(mqtt_emergency_light_status_topic, "ON");
-             publishCommandStatus("💡 20s Check: Light < 40% - Keeping Light ON");
-          } else if (!manualEmergencyControl) {
-             // Turn OFF if intensity improves (> 40%)
-             digitalWrite(POWER_STATUS_PIN, HIGH); 
-             mqtt_client.publish(mqtt_emergency_light_status_topic, "OFF");
-          }
-      }
+    totalEnergyConsumed += reading.energy[0];
+    if (sample.v1 < cutMinVoltage) cutMinVoltage = sample.v1;
+    if (reading.lastVoltage[0] < cutMinVoltage) cutMinVoltage = reading.lastVoltage[0];
+  }
+
+  // --- POWER CUT DETECTION LOGIC (polling cross-check) ---
+  // A cut is normally caught by the detect pin interrupt first; this catches it
+  // if the pin is not wired or missed the edge. Power only counts as restored
+  // once both the voltage and the detect pin agree.
+  if (lastSystemVoltage < POWER_CUT_THRESHOLD) {
+    if (!powerCutDetected) beginPowerCut(reading.timestamp);
+  } else if (powerCutDetected && !powerDetectPinCut()) {
+    endPowerCut(reading.timestamp);
+  }
+}
+
+// Called by the control task on every wake, including ISR wake-ups
+void handlePowerDetect() {
+  // INA3221 alert: don't wait for the end of the window to look at the voltage
+  if (powerDetectTakeAlert()) samplerRequestFlush(0);
+
+  if (powerDetectConfirmCut() && !powerCutDetected) {
+    beginPowerCut(halMillis());
   }
+}
+
+// Called by the control task on every wake, including pin-change wake-ups
+void handleIntensityInput() {
+  if (!intensityPoll()) return;
+  currentLightIntensity = intensityPercent();
+  samplerRequestFlush(0); // The new intensity goes out now, not at the end of the window
+  updateEmergencyLight(); // Replaces the old 20 s light check during a cut
+}
+
+void handleEmergencyLogic() {
+  unsigned long currentMillis = halMillis();
 
   // --- 1-MINUTE SHUTDOWN SEQUENCE ---
   if (emergencyModeActive) {
     // Step 2: Activate GPIO14 after delay
     if (!gpio14Activated && (currentMillis >= gpio14ActivationTime)) {
-      digitalWrite(LED4_PIN, LOW); delayMicroseconds(10); digitalWrite(LED4_PIN, HIGH);
-      mqtt_client.publish(mqtt_led4_status_topic, "PULSE");
-      publishCommandStatus("✓ Step 2: GPIO14 Pulse Sent");
+      strobeOutput(LED4_PIN, LOW);
+      queuePublish(mqtt_led4_status_topic, "PULSE");
+      queueCommandStatus("✓ Step 2: GPIO14 Pulse Sent");
       gpio14Activated = true;
     }
     
@@ -235,11 +305,11 @@ void handleEmergencyLogic() {
       
       // Requirement: "Full system off after 1 min must still function"
       // Turning off Systems (GPIO13, GPIO14)
-      digitalWrite(LED2_PIN, HIGH);
-      digitalWrite(LED4_PIN, HIGH);
-      mqtt_client.publish(mqtt_led2_status_topic, "OFF");
-      mqtt_client.publish(mqtt_led4_status_topic, "OFF");
-      publishCommandStatus("🔴 Emergency Sequence Complete. Systems OFF.");
+      halDigitalWrite(LED2_PIN, HIGH);
+      halDigitalWrite(LED4_PIN, HIGH);
+      queuePublish(mqtt_led2_status_topic, "OFF");
+      queuePublish(mqtt_led4_status_topic, "OFF");
+      queueCommandStatus("🔴 Emergency Sequence Complete. Systems OFF.");
       
       // Requirement: "Except for the emergency light keep on"
       // NOTE: We do NOT turn off POWER_STATUS_PIN here anymore.
@@ -251,35 +321,275 @@ void handleEmergencyLogic() {
   
 }
 // Force Immediate Reading for Telegram ---
-void forceSensorUpdate() {
+// Ends the sampler's current window now; the reading comes back through updateSensors()
+void forceSensorUpdate(uint8_t flags) {
   Serial.println("Forcing sensor update for Telegram...");
+  samplerRequestFlush(flags | SAMPLE_FORCED);
+}
 
-  // 1. Read Light Intensity Immediately
-  int b0 = digitalRead(INTENSITY_B0_PIN);
-  int b1 = digitalRead(INTENSITY_B1_PIN);
-  int b2 = digitalRead(INTENSITY_B2_PIN);
-  int val = (b2 << 2) | (b1 << 1) | b0;
-  
-  // Update the global variables
-  currentLightIntensity = (val / 7.0) * 100.0;
-  shared_intensity = currentLightIntensity;
-  
-  // 2. Read Power Sensors Immediately
-  float v1 = INA.getBusVoltage(0);
-  float c1 = fabsf(INA.getCurrent(0) * 1000.0);
-  float p1 = v1 * c1;
-  
-  shared_v1 = v1;
-  shared_c1 = c1;
-  shared_p1 = p1;
-  
-  float v2 = INA.getBusVoltage(1);
-  float c2 = fabsf(INA.getCurrent(1) * 1000.0);
-  float p2 = v2 * c2;
-  
-  shared_v2 = v2;
-  shared_c2 = c2;
-  shared_p2 = p2;
-  
-  Serial.println("✓ Sensors updated.");
- }
+// --- COMMANDS FROM THE NETWORK CORE ---
+// /status wakes GPIO13 and lets the sensors settle for 500 ms before the forced read
+static bool statusReportPending = false;
+static bool statusAwaitingSample = false;
+static bool statusWokeSystem = false;
+static unsigned long statusReadTime = 0;
+static unsigned long statusSampleDeadline = 0;
+
+static void executeCommand(const ControlCommand& cmd) {
+  switch (cmd.target) {
+    case CMD_LED:
+      if (cmd.action == ACTION_ON) {
+        halDigitalWrite(LED_PIN, HIGH);
+        queuePublish(mqtt_status_topic, "ON");
+      } else if (cmd.action == ACTION_OFF) {
+        halDigitalWrite(LED_PIN, LOW);
+        queuePublish(mqtt_status_topic, "OFF");
+      }
+      break;
+
+    case CMD_SYSTEM:
+      if (cmd.action == ACTION_ON) {
+        halDigitalWrite(LED2_PIN, LOW);
+      } else if (cmd.action == ACTION_OFF) {
+        startSystemOffSequence();
+      } else if (cmd.action == ACTION_PULSE) {
+        pulseOutput(LED2_PIN, HIGH, 2000);
+      }
+      break;
+
+    case CMD_GPIO14:
+      if (cmd.action == ACTION_ON || cmd.action == ACTION_OFF) {
+        strobeOutput(LED4_PIN, LOW);
+      } else if (cmd.action == ACTION_PULSE) {
+        pulseOutput(LED4_PIN, HIGH, 2000);
+      }
+      break;
+
+    case CMD_EMERGENCY_LIGHT:
+      manualEmergencyControl = true;
+      if (cmd.action == ACTION_ON) {
+        halDigitalWrite(POWER_STATUS_PIN, LOW);
+        queuePublish(mqtt_emergency_light_status_topic, "ON");
+      } else if (cmd.action == ACTION_OFF) {
+        halDigitalWrite(POWER_STATUS_PIN, HIGH);
+        queuePublish(mqtt_emergency_light_status_topic, "OFF");
+      } else if (cmd.action == ACTION_AUTO) {
+        manualEmergencyControl = false;
+        queuePublish(mqtt_emergency_light_status_topic, "AUTO");
+        updateEmergencyLight(); // Back to following the intensity input
+      }
+      break;
+
+    case CMD_STATUS_REPORT:
+      if (statusReportPending || statusAwaitingSample) break; // Already in progress
+      statusReportPending = true;
+      statusReadTime = halMillis();
+
+      // Check if System was OFF (Active LOW logic: HIGH = OFF)
+      statusWokeSystem = (halDigitalRead(LED2_PIN) == HIGH);
+      if (statusWokeSystem) {
+        halDigitalWrite(LED2_PIN, LOW); // Turn ON temporarily
+        Serial.println("Telegram: Temporarily waking system...");
+        statusReadTime += 500; // Wait 0.5s for sensors/power to stabilize
+      }
+      break;
+
+    case CMD_RESAMPLE:
+      samplerRequestFlush(0);
+      break;
+
+    case CMD_EVENT_QUERY: // Handled on the network task, never queued
+    case CMD_OTA:
+    case CMD_SNAPSHOT:
+      break;
+  }
+}
+
+void processCommands() {
+  ControlCommand cmd;
+  while (commandQueue.pop(cmd)) {
+    executeCommand(cmd);
+  }
+
+  if (statusReportPending && (long)(halMillis() - statusReadTime) >= 0) {
+    statusReportPending = false;
+    statusAwaitingSample = true;
+    statusSampleDeadline = halMillis() + STATUS_SAMPLE_TIMEOUT;
+    forceSensorUpdate(statusWokeSystem ? SAMPLE_SYSTEM_WOKEN : 0);
+  }
+
+  // A lost forced reading must not block /status (or leave GPIO13 awake) for good
+  if (statusAwaitingSample && (long)(halMillis() - statusSampleDeadline) >= 0) {
+    Serial.println("ERROR: Forced reading never arrived, status report dropped");
+    queueTelegram("⚠️ No fresh reading for /status, please try again.");
+    finishStatusReport(false);
+  }
+}
+
+// The forced reading has arrived, or will not
+static void finishStatusReport(bool arrived) {
+  if (!statusAwaitingSample) return;
+  statusAwaitingSample = false;
+  if (arrived) Serial.println("✓ Sensors updated.");
+
+  // If it was OFF before, turn it back OFF
+  if (statusWokeSystem) {
+    statusWokeSystem = false;
+    halDigitalWrite(LED2_PIN, HIGH);
+    Serial.println("Telegram: System returning to sleep.");
+    queuePublish(mqtt_led2_status_topic, "OFF");
+  }
+}
+
+// --- NON-BLOCKING OUTPUT SEQUENCES ---
+struct OutputPulse {
+  uint8_t pin;
+  uint8_t restLevel;
+  unsigned long endTime;
+  bool active;
+};
+
+const int MAX_OUTPUT_PULSES = 4;
+static OutputPulse outputPulses[MAX_OUTPUT_PULSES];
+
+// System OFF sequence (was: GPIO13 OFF, delay(1000), GPIO14 strobe, delay(100), strobe)
+enum SystemOffStep { OFF_IDLE, OFF_WAIT_GPIO14, OFF_WAIT_SECOND_STROBE };
+static SystemOffStep systemOffStep = OFF_IDLE;
+static unsigned long systemOffStepTime = 0;
+
+void strobeOutput(uint8_t pin, uint8_t strobeLevel) {
+  halDigitalWrite(pin, strobeLevel);
+  halDelayMicroseconds(10);
+  halDigitalWrite(pin, strobeLevel == LOW ? HIGH : LOW);
+}
+
+void pulseOutput(uint8_t pin, uint8_t activeLevel, unsigned long durationMs) {
+  // Re-triggering a pin that is already pulsing just extends the pulse
+  int slot = -1;
+  for (int i = 0; i < MAX_OUTPUT_PULSES; i++) {
+    if (outputPulses[i].active && outputPulses[i].pin == pin) { slot = i; break; }
+    if (!outputPulses[i].active && slot < 0) slot = i;
+  }
+  if (slot < 0) {
+    Serial.println("ERROR: No free output pulse slot");
+    return;
+  }
+
+  halDigitalWrite(pin, activeLevel);
+  outputPulses[slot].pin = pin;
+  outputPulses[slot].restLevel = (activeLevel == LOW) ? HIGH : LOW;
+  outputPulses[slot].endTime = halMillis() + durationMs;
+  outputPulses[slot].active = true;
+}
+
+void startSystemOffSequence() {
+  halDigitalWrite(LED2_PIN, HIGH);
+  systemOffStep = OFF_WAIT_GPIO14;
+  systemOffStepTime = halMillis() + 1000;
+}
+
+void serviceOutputs() {
+  unsigned long now = halMillis();
+
+  for (int i = 0; i < MAX_OUTPUT_PULSES; i++) {
+    if (outputPulses[i].active && (long)(now - outputPulses[i].endTime) >= 0) {
+      halDigitalWrite(outputPulses[i].pin, outputPulses[i].restLevel);
+      outputPulses[i].active = false;
+    }
+  }
+
+  if (systemOffStep != OFF_IDLE && (long)(now - systemOffStepTime) >= 0) {
+    if (systemOffStep == OFF_WAIT_GPIO14) {
+      if (halDigitalRead(LED4_PIN) == HIGH) {
+        strobeOutput(LED4_PIN, LOW);
+        systemOffStep = OFF_WAIT_SECOND_STROBE;
+        systemOffStepTime = now + 100;
+      } else {
+        strobeOutput(LED4_PIN, HIGH);
+        systemOffStep = OFF_IDLE;
+      }
+    } else {
+      strobeOutput(LED4_PIN, LOW);
+      systemOffStep = OFF_IDLE;
+    }
+  }
+}
+
+// --- STATE CHECKPOINT ---
+// Level a pin settles back to: a pulse in progress or the /status wake-up is
+// not worth restoring after a reset
+static uint8_t restingLevel(uint8_t pin) {
+  for (int i = 0; i < MAX_OUTPUT_PULSES; i++) {
+    if (outputPulses[i].active && outputPulses[i].pin == pin) return outputPulses[i].restLevel;
+  }
+  if (pin == LED2_PIN && statusWokeSystem) return HIGH;
+  return halDigitalRead(pin);
+}
+
+// CONTROL_OUT_* levels, as driven now or as they will settle
+static uint8_t outputBits(bool resting) {
+  uint8_t bits = 0;
+  if ((resting ? restingLevel(LED_PIN) : halDigitalRead(LED_PIN)) == HIGH) bits |= CONTROL_OUT_LED;
+  if ((resting ? restingLevel(LED2_PIN) : halDigitalRead(LED2_PIN)) == HIGH) bits |= CONTROL_OUT_SYSTEM;
+  if ((resting ? restingLevel(LED4_PIN) : halDigitalRead(LED4_PIN)) == HIGH) bits |= CONTROL_OUT_GPIO14;
+  if ((resting ? restingLevel(POWER_STATUS_PIN) : halDigitalRead(POWER_STATUS_PIN)) == HIGH) bits |= CONTROL_OUT_LIGHT;
+  return bits;
+}
+
+static void checkpointControlState() {
+  // The detect pin ISR may have switched GPIO13 for a cut that is not confirmed yet
+  if (powerDetectConfirmPending()) return;
+
+  unsigned long now = halMillis();
+  ControlState state;
+  memset(&state, 0, sizeof(state));
+  state.powerCut = powerCutDetected;
+  state.emergencyMode = emergencyModeActive;
+  state.manualLight = manualEmergencyControl;
+  state.gpio14Activated = gpio14Activated;
+  state.outputs = outputBits(true);
+
+  if (powerCutDetected) {
+    state.cutMillis = now - powerCutStartTime;
+    state.energy = totalEnergyConsumed;
+    state.startVoltage = startVoltage;
+    state.minVoltage = cutMinVoltage;
+  }
+  if (emergencyModeActive) {
+    state.emergencyMillis = now - emergencyStartTime;
+    if (!gpio14Activated && (long)(gpio14ActivationTime - now) > 0) state.gpio14DueMillis = gpio14ActivationTime - now;
+  }
+  controlStateSave(state);
+}
+
+// Picks the cut and the sequence up where they were. Start times land before
+// 0 on the new clock and wrap like millis() does; every use subtracts them.
+static void restoreControlState(const ControlState& saved) {
+  unsigned long now = halMillis();
+  powerCutDetected = saved.powerCut;
+  emergencyModeActive = saved.emergencyMode;
+  manualEmergencyControl = saved.manualLight;
+  gpio14Activated = saved.gpio14Activated;
+
+  if (saved.powerCut) {
+    powerCutStartTime = now - saved.cutMillis;
+    totalEnergyConsumed = saved.energy;
+    startVoltage = saved.startVoltage;
+    cutMinVoltage = saved.minVoltage;
+  }
+  if (saved.emergencyMode) {
+    emergencyStartTime = now - saved.emergencyMillis;
+    gpio14ActivationTime = now + saved.gpio14DueMillis;
+  }
+  controlStateRestored();
+
+  if (saved.powerCut) {
+    TextBuffer note;
+    note.appendf("↻ Restarted during a power cut (%s): emergency state restored, %lu s in",
+      controlStateRestoredFrom(), (unsigned long)(saved.cutMillis / 1000));
+    queueCommandStatus(note.c_str());
+  }
+  Serial.printf("Control state restored from %s, outputs back %lu us after boot (cut %s, emergency %s)\n",
+    controlStateRestoredFrom(), controlStateRestoreMicros(),
+    saved.powerCut ? "on" : "off", saved.emergencyMode ? "on" : "off");
+}
@@ -0,0 +1,47 @@
+#include "ina3221_scan.h"
+
+static const int32_t SHUNT_LSB_NANOVOLTS = 40000;
+static const int32_t BUS_LSB_MILLIVOLTS = 8;
+
+// Bits 15..3, sign kept by the arithmetic shift
+static int32_t registerValue(const uint8_t bytes[2]) {
+  return (int16_t)(bytes[0] << 8 | bytes[1]) >> 3;
+}
+
+static void setRegister(int32_t value, uint8_t bytes[2]) {
+  if (value > 4095) value = 4095;
+  if (value < -4096) value = -4096;
+  uint16_t word = (uint16_t)(value << 3);
+  bytes[0] = word >> 8;
+  bytes[1] = word & 0xFF;
+}
+
+void ina3221Decode(const uint8_t raw[INA3221_SCAN_REGISTERS][2], SensorScan& scan) {
+  for (int ch = 0; ch < INA3221_CHANNELS; ch++) {
+    int32_t shunt = registerValue(raw[2 * ch]);
+    int32_t bus = registerValue(raw[2 * ch + 1]);
+    // uA = nV / mOhm; 4096 * 40000 still fits in 32 bits
+    scan.currentMicroamps[ch] = shunt * SHUNT_LSB_NANOVOLTS / SHUNT_MILLIOHMS;
+    scan.busMillivolts[ch] = bus * BUS_LSB_MILLIVOLTS;
+  }
+}
+
+void ina3221Encode(const int32_t busMillivolts[INA3221_CHANNELS], const int32_t currentMicroamps[INA3221_CHANNELS],
+                   uint8_t raw[INA3221_SCAN_REGISTERS][2]) {
+  for (int ch = 0; ch < INA3221_CHANNELS; ch++) {
+    int64_t nanovolts = (int64_t)currentMicroamps[ch] * SHUNT_MILLIOHMS;
+    setRegister((int32_t)(nanovolts / SHUNT_LSB_NANOVOLTS), raw[2 * ch]);
+    setRegister(busMillivolts[ch] / BUS_LSB_MILLIVOLTS, raw[2 * ch + 1]);
+  }
+}
+
+uint32_t ina3221ScanBusClocks() {
+  // Per register: START, address+W, pointer, repeated START, address+R, 2 data
+  // bytes; 9 clocks per byte with its ACK. One STOP for the whole scan.
+  const uint32_t perRegister = 1 + 9 + 9 + 1 + 9 + 2 * 9;
+  return INA3221_SCAN_REGISTERS * perRegister + 1;
+}
+
+uint32_t ina3221ScanBusMicros(uint32_t clockHz) {
+  return (uint32_t)(((uint64_t)ina3221ScanBusClocks() * 1000000UL + clockHz - 1) / clockHz);
+}
@@ -0,0 +1,88 @@
+#include "intensity_input.h"
+#include "config.h"
+
+static TaskHandle_t controlTaskHandle = NULL;
+static const uint8_t NO_CODE = 0xFF;
+
+// --- ISR -> CONTROL TASK HANDOFF ---
+static volatile uint32_t edgeCount = 0;
+static volatile unsigned long edgeMicros = 0; // Latest edge
+
+// --- CONTROL TASK STATE ---
+static uint32_t handledEdges = 0;
+static bool settlePending = false;
+static unsigned long firstEdgeMicros = 0;
+static uint8_t settledCode = NO_CODE;
+static uint32_t changeCount = 0;
+static uint32_t bounceCount = 0;
+static unsigned long lastLatencyMicros = 0;
+static unsigned long worstLatencyMicros = 0;
+
+static void IRAM_ATTR onIntensityEdge() {
+  edgeMicros = micros();
+  edgeCount++;
+
+  BaseType_t higherPriorityWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(controlTaskHandle, &higherPriorityWoken);
+  if (higherPriorityWoken) portYIELD_FROM_ISR();
+}
+
+static uint8_t readCode() {
+  return (digitalRead(INTENSITY_B2_PIN) << 2) | (digitalRead(INTENSITY_B1_PIN) << 1) | digitalRead(INTENSITY_B0_PIN);
+}
+
+void setupIntensityInput(TaskHandle_t controlTask) {
+  controlTaskHandle = controlTask;
+  settlePending = true; // The first poll takes the code the pins show now
+  firstEdgeMicros = edgeMicros = micros() - INTENSITY_DEBOUNCE_MS * 1000UL;
+
+  attachInterrupt(digitalPinToInterrupt(INTENSITY_B0_PIN), onIntensityEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(INTENSITY_B1_PIN), onIntensityEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(INTENSITY_B2_PIN), onIntensityEdge, CHANGE);
+}
+
+bool intensityDebouncePending() {
+  return settlePending || edgeCount != handledEdges;
+}
+
+bool intensityPoll() {
+  if (edgeCount != handledEdges) {
+    handledEdges = edgeCount;
+    if (!settlePending) firstEdgeMicros = edgeMicros; // Start of this change
+    settlePending = true;
+  }
+  if (!settlePending) return false;
+  if (micros() - edgeMicros < INTENSITY_DEBOUNCE_MS * 1000UL) return false;
+  settlePending = false;
+
+  uint8_t code = readCode();
+  if (code == settledCode) {
+    bounceCount++;
+    return false;
+  }
+  if (settledCode != NO_CODE) {
+    changeCount++;
+    lastLatencyMicros = micros() - firstEdgeMicros;
+    if (lastLatencyMicros > worstLatencyMicros) worstLatencyMicros = lastLatencyMicros;
+  }
+  settledCode = code;
+  return true;
+}
+
+uint8_t intensityCode() {
+  return settledCode == NO_CODE ? 0 : settledCode;
+}
+
+float intensityPercent() {
+  return (intensityCode() / 7.0) * 100.0;
+}
+
+IntensityStats intensityStats() {
+  IntensityStats stats;
+  stats.edges = edgeCount;
+  stats.changes = changeCount;
+  stats.bounces = bounceCount;
+  stats.lastLatencyMicros = lastLatencyMicros;
+  stats.worstLatencyMicros = worstLatencyMicros;
+  return stats;
+}
@@ -0,0 +1,208 @@
+#include "journal.h"
+#include "config.h"
+#include "hal.h"
+#include "telemetry_frame.h"
+
+// One record = boot counter + encoded frame. The boot counter lets replay fill in
+// the wall-clock time of samples taken before NTP synced, as long as the device
+// has not rebooted since (millis() is only meaningful within one boot).
+struct __attribute__((packed)) JournalRecord {
+  uint32_t bootCount;
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+};
+
+static bool journalReady = false;
+static uint32_t bootCount = 0;
+static uint32_t firstSegment = 0;       // Oldest segment still on flash
+static uint32_t lastSegment = 0;        // Segment currently being appended to
+static uint32_t lastSegmentRecords = 0;
+static uint32_t replayedRecords = 0;    // Records of firstSegment already delivered
+static uint32_t unsettledRecords = 0;   // Sent by the last journalReplay(), not yet delivered
+static uint32_t pendingRecords = 0;
+static uint32_t droppedRecords = 0;
+static bool foundSegment = false;
+
+// Where replay resumes after a reboot, as last written to NVS
+static uint32_t savedSegment = 0;
+static uint32_t savedRecords = 0;
+
+// One batch is read with a single open of the segment
+static JournalRecord replayBuffer[JOURNAL_REPLAY_BATCH];
+
+static void saveCursor() {
+  if (savedSegment == firstSegment && savedRecords == replayedRecords) return;
+  halJournalCursorWrite(firstSegment, replayedRecords);
+  savedSegment = firstSegment;
+  savedRecords = replayedRecords;
+}
+
+static void countSegment(uint32_t segment, uint32_t bytes) {
+  pendingRecords += bytes / sizeof(JournalRecord);
+  if (!foundSegment || segment < firstSegment) firstSegment = segment;
+  if (!foundSegment || segment >= lastSegment) {
+    lastSegment = segment;
+    lastSegmentRecords = bytes / sizeof(JournalRecord);
+    // A reset in the middle of a write leaves a torn record; never append after it
+    if (bytes % sizeof(JournalRecord) != 0) lastSegmentRecords = JOURNAL_SEGMENT_RECORDS;
+  }
+  foundSegment = true;
+}
+
+void setupJournal() {
+  journalReady = false;
+  firstSegment = lastSegment = lastSegmentRecords = 0;
+  replayedRecords = unsettledRecords = pendingRecords = droppedRecords = 0;
+  foundSegment = false;
+  bootCount = halJournalBoot();
+
+  if (!halJournalBegin()) {
+    Serial.println("ERROR: Journal store unavailable, journal disabled");
+    return;
+  }
+
+  // Pick up any backlog left over from previous boots, minus what was already
+  // delivered from the oldest segment before the reset
+  halJournalList(countSegment);
+  if (!halJournalCursorRead(savedSegment, savedRecords)) {
+    savedSegment = savedRecords = 0;
+  }
+  if (foundSegment && savedSegment == firstSegment) {
+    uint32_t records = halJournalSize(firstSegment) / sizeof(JournalRecord);
+    replayedRecords = savedRecords < records ? savedRecords : records;
+    pendingRecords -= replayedRecords;
+  }
+  // A cursor into a segment that is gone must not apply to a new one reusing its number
+  saveCursor();
+
+  journalReady = true;
+  Serial.printf("✓ Journal ready: %lu records pending\n", (unsigned long)pendingRecords);
+}
+
+static void dropOldestSegment() {
+  uint32_t remaining = halJournalSize(firstSegment) / sizeof(JournalRecord);
+  remaining = remaining > replayedRecords ? remaining - replayedRecords : 0;
+
+  halJournalRemove(firstSegment);
+
+  droppedRecords += remaining;
+  pendingRecords = pendingRecords > remaining ? pendingRecords - remaining : 0;
+  firstSegment++;
+  replayedRecords = 0;
+  unsettledRecords = 0; // Any of it still on the way is sent again
+  saveCursor();
+}
+
+bool journalAppend(const SensorSample& sample) {
+  if (!journalReady) return false;
+
+  if (lastSegmentRecords >= JOURNAL_SEGMENT_RECORDS) {
+    lastSegment++;
+    lastSegmentRecords = 0;
+  }
+  if (lastSegment - firstSegment >= JOURNAL_MAX_SEGMENTS) {
+    dropOldestSegment();
+  }
+
+  JournalRecord record;
+  record.bootCount = bootCount;
+  encodeTelemetryFrame(sample, uptimeToEpochSeconds(sample.timestamp), record.frame, sizeof(record.frame));
+
+  if (!halJournalAppend(lastSegment, &record, sizeof(record))) return false;
+
+  lastSegmentRecords++;
+  pendingRecords++;
+  return true;
+}
+
+// Marks the frame as replayed and, if it was journaled before NTP synced during
+// this boot, back-fills its wall-clock time
+static void prepareForReplay(JournalRecord& record) {
+  TelemetryFrameHeader header;
+  memcpy(&header, record.frame, sizeof(header));
+  header.flags |= SAMPLE_REPLAYED;
+  if (header.epochSeconds == 0 && record.bootCount == bootCount) {
+    header.epochSeconds = uptimeToEpochSeconds(header.uptimeMs);
+  }
+  memcpy(record.frame, &header, sizeof(header));
+}
+
+size_t journalReplay(size_t maxRecords, JournalSendFn send) {
+  if (!journalReady || pendingRecords == 0 || unsettledRecords > 0) return 0;
+
+  // Read on from the saved cursor; it only moves in journalReplaySettled()
+  uint32_t segment = firstSegment;
+  uint32_t offset = replayedRecords;
+  size_t sent = 0;
+  while (sent < maxRecords && sent < pendingRecords) {
+    uint32_t records = halJournalSize(segment) / sizeof(JournalRecord);
+
+    if (offset >= records) {
+      if (segment == lastSegment) break;
+      segment++;
+      offset = 0;
+      continue;
+    }
+
+    size_t batch = records - offset;
+    if (batch > maxRecords - sent) batch = maxRecords - sent;
+    if (batch > JOURNAL_REPLAY_BATCH) batch = JOURNAL_REPLAY_BATCH;
+    bool sendFailed = false;
+    size_t read = halJournalRead(segment, offset * sizeof(JournalRecord),
+      replayBuffer, batch * sizeof(JournalRecord)) / sizeof(JournalRecord);
+    for (size_t i = 0; i < read; i++) {
+      prepareForReplay(replayBuffer[i]);
+      if (!send(replayBuffer[i].frame, sizeof(replayBuffer[i].frame))) {
+        sendFailed = true;
+        break;
+      }
+      offset++;
+      sent++;
+    }
+    if (sendFailed || read < batch) break;
+  }
+  unsettledRecords = sent;
+  return sent;
+}
+
+// Moves the cursor past delivered records, deleting each segment once all of it is
+static void advanceCursor(uint32_t delivered) {
+  pendingRecords = pendingRecords > delivered ? pendingRecords - delivered : 0;
+  while (true) {
+    uint32_t records = halJournalSize(firstSegment) / sizeof(JournalRecord);
+    uint32_t left = records > replayedRecords ? records - replayedRecords : 0;
+    uint32_t step = delivered < left ? delivered : left;
+    replayedRecords += step;
+    delivered -= step;
+    if (replayedRecords < records) break;
+
+    // Segment fully delivered
+    halJournalRemove(firstSegment);
+    replayedRecords = 0;
+    if (firstSegment == lastSegment) {
+      lastSegmentRecords = 0;
+      pendingRecords = 0;
+      break;
+    }
+    firstSegment++;
+    if (delivered == 0) break;
+  }
+  saveCursor(); // Once per batch: a reset now repeats only what was not yet delivered
+}
+
+void journalReplaySettled(bool delivered) {
+  uint32_t records = unsettledRecords;
+  unsettledRecords = 0;
+  if (delivered && records > 0) advanceCursor(records);
+}
+
+uint32_t journalUnsettledRecords() {
+  return unsettledRecords;
+}
+
+uint32_t journalPendingRecords() {
+  return pendingRecords;
+}
+
+uint32_t journalDroppedRecords() {
+  return droppedRecords;
+}
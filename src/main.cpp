@@ -3,23 +3,147 @@
 #include "globals.h"
 #include "network.h"
 #include "hardware.h"
+#include "scheduler.h"
+#include "tasks.h"
+#include "journal.h"
+#include "event_log.h"
+#include "ota_update.h"
+#include "telegram.h"
+#include "sampler.h"
+#include "power_detect.h"
+#include "intensity_input.h"
+#include "text_buffer.h"
+#include "rolling_stats.h"
+#include "device_config.h"
+#include "diagnostics.h"
+#include "stall_monitor.h"
+#include "fast_connect.h"
+#include "mqtt_outbox.h"
+#include "control_state.h"
+#include "status_http.h"
+#include <esp_heap_caps.h>
+
+// --- HEAP HEALTH ---
+// Steady state should allocate nothing: free heap flat between reports, and the
+// largest free block close to the total (fragmentation near 0%).
+static uint32_t lastHeapFree = 0;
+
+// Publishes the worst-case network loop pass and control tick since the last report,
+// so we can prove power-cut handling is never stuck behind a reconnect or a GPIO pulse.
+void reportLoopStats() {
+  TelegramStats tg = telegramStats();
+  SamplerStats smp = samplerStats();
+  PowerDetectStats pd = powerDetectStats();
+  IntensityStats in = intensityStats();
+  TextPoolStats text = textPoolStats();
+  MqttOutboxStats mq = mqttOutboxStats();
+  uint32_t heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  uint32_t heapFragPercent = heapFree > 0 ? 100 - (uint32_t)((uint64_t)heapLargest * 100 / heapFree) : 0;
+  long heapDelta = lastHeapFree > 0 ? (long)heapFree - (long)lastHeapFree : 0;
+  lastHeapFree = heapFree;
+  char stats[1024];
+  snprintf(stats, sizeof(stats),
+    "{\"worst_us\":%lu,\"avg_us\":%lu,\"worst_task\":\"%s\","
+    "\"ctrl_worst_us\":%lu,\"ctrl_late_us\":%lu,"
+    "\"sample_drops\":%lu,\"outbound_drops\":%lu,\"command_drops\":%lu,"
+    "\"journal_pending\":%lu,\"journal_dropped\":%lu,\"agg_drops\":%lu,"
+    "\"tg_sent\":%lu,\"tg_coalesced\":%lu,\"tg_dropped\":%lu,\"tg_handshakes\":%lu,\"tg_polls\":%lu,"
+    "\"smp_hz\":%lu,\"smp_worst_us\":%lu,\"smp_avg_us\":%lu,\"smp_overruns\":%lu,\"smp_i2c_errors\":%lu,"
+    "\"pd_edges\":%lu,\"pd_alerts\":%lu,\"pd_false\":%lu,\"pd_gpio_us\":%lu,\"pd_gpio_worst_us\":%lu,\"pd_handoff_us\":%lu,"
+    "\"in_edges\":%lu,\"in_changes\":%lu,\"in_bounces\":%lu,\"in_latency_us\":%lu,\"in_worst_us\":%lu,\"light_toggles\":%lu,"
+    "\"heap_free\":%lu,\"heap_min\":%lu,\"heap_largest\":%lu,\"heap_frag_pct\":%lu,\"heap_delta\":%ld,"
+    "\"text_hw\":%lu,\"text_exhausted\":%lu,\"text_truncated\":%lu,"
+    "\"mq_depth\":[%lu,%lu,%lu],\"mq_hw_bytes\":[%lu,%lu,%lu],\"mq_drops\":[%lu,%lu,%lu],"
+    "\"mq_inflight\":%lu,\"mq_redelivered\":%lu}",
+    schedulerWorstLoopMicros(), schedulerAverageLoopMicros(), schedulerWorstTaskName(),
+    controlWorstTickMicros(), controlWorstLatenessMicros(),
+    (unsigned long)sampleQueue.dropped(), (unsigned long)outboundQueue.dropped(),
+    (unsigned long)commandQueue.dropped(),
+    (unsigned long)journalPendingRecords(), (unsigned long)journalDroppedRecords(),
+    (unsigned long)statsDroppedAggregates(),
+    (unsigned long)tg.sent, (unsigned long)tg.coalesced, (unsigned long)tg.dropped,
+    (unsigned long)tg.handshakes, (unsigned long)tg.polls,
+    (unsigned long)smp.rateHz, smp.worstMicros, smp.averageMicros, (unsigned long)smp.overruns, (unsigned long)smp.readErrors,
+    (unsigned long)pd.edges, (unsigned long)pd.alerts, (unsigned long)pd.falseAlarms,
+    pd.lastGpioMicros, pd.worstGpioMicros, pd.lastHandoffMicros,
+    (unsigned long)in.edges, (unsigned long)in.changes, (unsigned long)in.bounces,
+    in.lastLatencyMicros, in.worstLatencyMicros, (unsigned long)emergencyLightToggles(),
+    (unsigned long)heapFree, (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+    (unsigned long)heapLargest, (unsigned long)heapFragPercent, heapDelta,
+    (unsigned long)text.highWater, (unsigned long)text.exhausted, (unsigned long)text.truncated,
+    (unsigned long)mq.lanes[MQTT_LANE_ALARM].depth, (unsigned long)mq.lanes[MQTT_LANE_STATE].depth,
+    (unsigned long)mq.lanes[MQTT_LANE_BULK].depth,
+    (unsigned long)mq.lanes[MQTT_LANE_ALARM].highWater, (unsigned long)mq.lanes[MQTT_LANE_STATE].highWater,
+    (unsigned long)mq.lanes[MQTT_LANE_BULK].highWater,
+    (unsigned long)mq.lanes[MQTT_LANE_ALARM].dropped, (unsigned long)mq.lanes[MQTT_LANE_STATE].dropped,
+    (unsigned long)mq.lanes[MQTT_LANE_BULK].dropped,
+    (unsigned long)mq.inflight, (unsigned long)mq.redelivered);
+  mqttPublish(mqtt_loop_stats_topic, stats);
+  Serial.printf("Loop: worst %lu us (%s), avg %lu us | Control: worst %lu us, late %lu us\n",
+    schedulerWorstLoopMicros(), schedulerWorstTaskName(), schedulerAverageLoopMicros(),
+    controlWorstTickMicros(), controlWorstLatenessMicros());
+  schedulerResetStats();
+  controlResetStats();
+  samplerResetStats();
+}
+
+// A task that did not fit in the scheduler table would silently never run
+static void addNetworkTask(const char* name, TaskCallback callback, unsigned long intervalMs) {
+  if (schedulerAddTask(name, callback, intervalMs) < 0) {
+    Serial.printf("ERROR: Scheduler table full, task \"%s\" not started\n", name);
+  }
+}
 
 void setup() {
   Serial.begin(115200);
-  delay(1000);
   Serial.println("\n=== ESP32 MQTT LED Controller (Modular) ===");
 
-  setupHardware();
-  
+  loadDeviceConfig(); // Device ID and topic table first: everything below publishes
+  diagBegin();
+  setupStallMonitor(); // Keeps the events of the last boot for the first connect
+  setupHardware(); // Outputs and emergency timers restored here after a brownout
+
+  // Sampling first: it needs no network, and samples taken while WiFi comes up
+  // are journaled like any other outage
+  startControlTasks();
+
+  // Connections are non-blocking; the "network" task finishes them in the background
+  setupFastConnect();
   connectWiFi();
-  
-  mqtt_client.setServer(mqtt_broker, mqtt_port);
+  setupStatusHttp();
+
+  setupJournal();
+  setupEventLog(); // After the journal: both live on LittleFS
+  setupOta();
+
+  mqtt_client.setServer(deviceConfig().broker, deviceConfig().port);
   mqtt_client.setCallback(mqttCallback);
-  connectMQTT();
+  mqttTransport.onPubAck(mqttOutboxAck);
+  mqtt_client.setSocketTimeout(2); // Bound the wait for CONNACK/acks on a dead link
+  mqtt_client.setBufferSize(DIAG_PAYLOAD_SIZE + 128); // Diagnostics JSON + topic and header; the default is 256
+
+  // Network core scheduler (sampling and emergency logic run on the control task)
+  addNetworkTask("network", checkNetwork, 0);                        // Keeps WiFi/MQTT alive
+  addNetworkTask("telemetry", serviceTelemetry, 0);                  // Publishes queued samples/alerts
+  addNetworkTask("mqttOut", serviceMqttOutbox, 0);                   // Writes the outbox, alarms first
+  addNetworkTask("telegram", serviceTelegramCommands, 0);            // Commands from the long-poll listener
+  addNetworkTask("journal", replayJournal, JOURNAL_REPLAY_INTERVAL); // Flash backlog after an outage
+  addNetworkTask("eventLog", serviceEventLog, 0);                    // Outage records + history queries
+  addNetworkTask("ota", serviceOta, 0);                              // Update progress, new image health
+  addNetworkTask("checkpoint", controlStatePersist, 0);              // Control state transitions to NVS
+  addNetworkTask("statusHttp", serviceStatusHttp, 0);                // GET /status on the LAN
+  addNetworkTask("loopStats", reportLoopStats, LOOP_STATS_INTERVAL);
+  addNetworkTask("reportStats", publishReportStats, LOOP_STATS_INTERVAL);
+  addNetworkTask("diagnostics", publishDiagnostics, DIAG_REPORT_INTERVAL);
+
+  startTelegramOutbox();
+  startTelegramListener();
+  startNetworkTask();
+  startStallMonitor();
 }
 
 void loop() {
-  checkNetwork(); // Keeps WiFi/MQTT alive
-  updateSensors(); // Reads INA3221 and Intensity
-  handleEmergencyLogic(); // Handles the 1-minute timer
-}
\ No newline at end of file
+  // Everything runs in the pinned control/network tasks
+  vTaskDelete(NULL);
+}
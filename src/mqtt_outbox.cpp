@@ -0,0 +1,274 @@
+#include "mqtt_outbox.h"
+
+enum RecordState : uint8_t {
+  REC_QUEUED,   // Never written
+  REC_INFLIGHT, // QoS 1, written, waiting for the PUBACK
+  REC_RESEND,   // QoS 1, to be written again with DUP
+  REC_ACKED     // QoS 1, done; removed by the next service pass once it is at the head
+};
+
+struct RecordHeader {
+  const char* topic;
+  uint32_t sentAt;
+  uint16_t length;
+  uint16_t packetId; // 0 until the first QoS 1 write
+  uint8_t state;
+};
+
+// Records live in [head, end) and, once the ring has wrapped, in [0, tail)
+struct Lane {
+  uint8_t* data;
+  size_t capacity;
+  bool qos1;
+  size_t head;
+  size_t tail;
+  size_t end;
+  bool wrapped;
+  uint32_t depth;
+  uint32_t bytes;
+  uint32_t highWater;
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t dropped;
+};
+
+alignas(RecordHeader) static uint8_t alarmRing[MQTT_LANE_ALARM_BYTES];
+alignas(RecordHeader) static uint8_t stateRing[MQTT_LANE_STATE_BYTES];
+alignas(RecordHeader) static uint8_t bulkRing[MQTT_LANE_BULK_BYTES];
+
+static Lane lanes[MQTT_LANE_COUNT] = {
+  { alarmRing, sizeof(alarmRing), true, 0, 0, 0, false, 0, 0, 0, 0, 0, 0 },
+  { stateRing, sizeof(stateRing), false, 0, 0, 0, false, 0, 0, 0, 0, 0, 0 },
+  { bulkRing, sizeof(bulkRing), false, 0, 0, 0, false, 0, 0, 0, 0, 0, 0 },
+};
+
+static uint32_t inflight = 0;
+static uint32_t ackedCount = 0;
+static uint32_t redeliveredCount = 0;
+static uint16_t lastPacketId = 0;
+
+static size_t recordSize(size_t length) {
+  const size_t align = alignof(RecordHeader);
+  return (sizeof(RecordHeader) + length + align - 1) & ~(align - 1);
+}
+
+static RecordHeader* recordAt(Lane& lane, size_t pos) {
+  return (RecordHeader*)(lane.data + pos);
+}
+
+static size_t nextRecord(Lane& lane, size_t pos) {
+  pos += recordSize(recordAt(lane, pos)->length);
+  if (lane.wrapped && pos >= lane.end) pos = 0;
+  return pos;
+}
+
+static void clearLane(Lane& lane) {
+  lane.head = 0;
+  lane.tail = 0;
+  lane.end = lane.capacity;
+  lane.wrapped = false;
+}
+
+static void popHead(Lane& lane) {
+  RecordHeader* record = recordAt(lane, lane.head);
+  if (record->state == REC_INFLIGHT || record->state == REC_RESEND) inflight--;
+  size_t size = recordSize(record->length);
+  lane.bytes -= size;
+  lane.depth--;
+  lane.head += size;
+  if (lane.wrapped && lane.head >= lane.end) {
+    lane.head = 0;
+    lane.wrapped = false;
+    lane.end = lane.capacity;
+  }
+  if (lane.depth == 0) clearLane(lane);
+}
+
+// Where a record of this size would go without dropping anything; false if full
+static bool findSpace(const Lane& lane, size_t size, size_t& pos, bool& wraps) {
+  wraps = false;
+  if (!lane.wrapped) {
+    if (lane.capacity - lane.tail >= size) {
+      pos = lane.tail;
+      return true;
+    }
+    if (lane.head >= size) {
+      pos = 0;
+      wraps = true;
+      return true;
+    }
+    return false;
+  }
+  pos = lane.tail;
+  return lane.head - lane.tail >= size;
+}
+
+MqttLane mqttLaneFor(const char* topic) {
+  if (topic == mqtt_powercut_topic || topic == mqtt_powercut_history_topic ||
+      topic == mqtt_emergency_light_status_topic) {
+    return MQTT_LANE_ALARM;
+  }
+  if (topic == mqtt_diagnostics_topic || topic == mqtt_loop_stats_topic || topic == mqtt_report_stats_topic ||
+      topic == mqtt_event_page_topic || topic == mqtt_ota_status_topic) {
+    return MQTT_LANE_BULK;
+  }
+  return MQTT_LANE_STATE;
+}
+
+bool mqttOutboxFits(MqttLane lane, size_t length) {
+  size_t pos;
+  bool wraps;
+  return findSpace(lanes[lane], recordSize(length), pos, wraps);
+}
+
+bool mqttOutboxPush(MqttLane laneId, const char* topic, const uint8_t* payload, size_t length) {
+  Lane& lane = lanes[laneId];
+  size_t size = recordSize(length);
+  if (size > lane.capacity || length > UINT16_MAX) {
+    lane.dropped++;
+    return false;
+  }
+
+  // Oldest first out until the new record fits
+  size_t pos;
+  bool wraps;
+  while (!findSpace(lane, size, pos, wraps)) {
+    popHead(lane);
+    lane.dropped++;
+  }
+  if (wraps) {
+    lane.end = lane.tail;
+    lane.wrapped = true;
+  }
+
+  RecordHeader* record = recordAt(lane, pos);
+  record->topic = topic;
+  record->sentAt = 0;
+  record->length = length;
+  record->packetId = 0;
+  record->state = REC_QUEUED;
+  memcpy(record + 1, payload, length);
+
+  lane.tail = pos + size;
+  lane.queued++;
+  lane.depth++;
+  lane.bytes += size;
+  if (lane.bytes > lane.highWater) lane.highWater = lane.bytes;
+  return true;
+}
+
+static uint16_t nextPacketId() {
+  if (++lastPacketId == 0) lastPacketId = 1;
+  return lastPacketId;
+}
+
+static void popAcked(Lane& lane) {
+  while (lane.depth > 0 && recordAt(lane, lane.head)->state == REC_ACKED) popHead(lane);
+}
+
+// QoS 1 lane: resends first come up in ring order like everything else, new
+// records only while the in-flight window has room
+static bool serviceQos1(Lane& lane, MqttWriteFn write, unsigned long now, size_t byteBudget, size_t& written) {
+  popAcked(lane);
+  size_t pos = lane.head;
+  for (uint32_t i = 0; i < lane.depth; i++, pos = nextRecord(lane, pos)) {
+    RecordHeader* record = recordAt(lane, pos);
+    if (record->state == REC_ACKED) continue;
+    if (record->state == REC_INFLIGHT && now - record->sentAt < MQTT_ACK_TIMEOUT) continue;
+    if (record->state == REC_QUEUED && inflight >= MQTT_INFLIGHT_WINDOW) continue;
+    if (written >= byteBudget) return false;
+
+    // In flight before the write: the PUBACK may be read while it is going out
+    bool resend = record->state != REC_QUEUED;
+    if (record->packetId == 0) record->packetId = nextPacketId();
+    record->state = REC_INFLIGHT;
+    record->sentAt = now;
+    if (!resend) inflight++;
+
+    if (!write(record->topic, (const uint8_t*)(record + 1), record->length, record->packetId, resend)) {
+      record->state = resend ? REC_RESEND : REC_QUEUED;
+      if (!resend) inflight--;
+      return false;
+    }
+    written += record->length;
+    if (resend) redeliveredCount++;
+    else lane.sent++;
+  }
+  popAcked(lane);
+  return true;
+}
+
+static bool serviceQos0(Lane& lane, MqttWriteFn write, size_t byteBudget, size_t& written) {
+  while (lane.depth > 0) {
+    if (written >= byteBudget) return false;
+    RecordHeader* record = recordAt(lane, lane.head);
+    if (!write(record->topic, (const uint8_t*)(record + 1), record->length, 0, false)) return false;
+    written += record->length;
+    lane.sent++;
+    popHead(lane);
+  }
+  return true;
+}
+
+size_t mqttOutboxService(MqttWriteFn write, unsigned long now, size_t byteBudget) {
+  size_t written = 0;
+  for (Lane& lane : lanes) {
+    bool more = lane.qos1 ? serviceQos1(lane, write, now, byteBudget, written)
+                          : serviceQos0(lane, write, byteBudget, written);
+    if (!more) break; // Budget spent or the socket is backed up: the next pass goes on
+  }
+  return written;
+}
+
+void mqttOutboxAck(uint16_t packetId) {
+  for (Lane& lane : lanes) {
+    if (!lane.qos1) continue;
+    size_t pos = lane.head;
+    for (uint32_t i = 0; i < lane.depth; i++, pos = nextRecord(lane, pos)) {
+      RecordHeader* record = recordAt(lane, pos);
+      if (record->packetId != packetId) continue;
+      if (record->state == REC_INFLIGHT || record->state == REC_RESEND) {
+        record->state = REC_ACKED;
+        inflight--;
+        ackedCount++;
+      }
+      break;
+    }
+  }
+}
+
+void mqttOutboxReconnected() {
+  for (Lane& lane : lanes) {
+    if (!lane.qos1) continue;
+    size_t pos = lane.head;
+    for (uint32_t i = 0; i < lane.depth; i++, pos = nextRecord(lane, pos)) {
+      RecordHeader* record = recordAt(lane, pos);
+      if (record->state == REC_INFLIGHT) record->state = REC_RESEND;
+    }
+  }
+}
+
+void mqttOutboxReset() {
+  for (Lane& lane : lanes) {
+    clearLane(lane);
+    lane.depth = lane.bytes = lane.highWater = lane.queued = lane.sent = lane.dropped = 0;
+  }
+  inflight = ackedCount = redeliveredCount = 0;
+}
+
+MqttOutboxStats mqttOutboxStats() {
+  MqttOutboxStats stats;
+  for (size_t l = 0; l < MQTT_LANE_COUNT; l++) {
+    const Lane& lane = lanes[l];
+    stats.lanes[l].depth = lane.depth;
+    stats.lanes[l].bytes = lane.bytes;
+    stats.lanes[l].highWater = lane.highWater;
+    stats.lanes[l].queued = lane.queued;
+    stats.lanes[l].sent = lane.sent;
+    stats.lanes[l].dropped = lane.dropped;
+  }
+  stats.inflight = inflight;
+  stats.acked = ackedCount;
+  stats.redelivered = redeliveredCount;
+  return stats;
+}
@@ -0,0 +1,102 @@
+#include "mqtt_transport.h"
+
+static const uint8_t MQTT_CONNACK = 0x20;
+static const uint8_t MQTT_PUBLISH_QOS1 = 0x32;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_DUP = 0x08;
+static const uint8_t CONNACK_SESSION_PRESENT = 0x01;
+static const size_t MQTT_TOPIC_MAX = 128;
+
+int MqttTransport::connect(IPAddress ip, uint16_t port) {
+  resetFraming();
+  sessionPresent_ = false;
+  return inner_.connect(ip, port);
+}
+
+int MqttTransport::connect(const char* host, uint16_t port) {
+  resetFraming();
+  sessionPresent_ = false;
+  return inner_.connect(host, port);
+}
+
+int MqttTransport::read() {
+  int b = inner_.read();
+  if (b >= 0) consume((uint8_t)b);
+  return b;
+}
+
+int MqttTransport::read(uint8_t* buf, size_t size) {
+  int length = inner_.read(buf, size);
+  for (int i = 0; i < length; i++) consume(buf[i]);
+  return length;
+}
+
+void MqttTransport::resetFraming() {
+  state_ = FRAME_TYPE;
+  type_ = 0;
+  remaining_ = 0;
+  multiplier_ = 1;
+  bodyRead_ = 0;
+}
+
+void MqttTransport::consume(uint8_t b) {
+  switch (state_) {
+    case FRAME_TYPE:
+      type_ = b;
+      remaining_ = 0;
+      multiplier_ = 1;
+      bodyRead_ = 0;
+      state_ = FRAME_LENGTH;
+      break;
+
+    case FRAME_LENGTH: // Variable-length integer, 7 bits per byte
+      remaining_ += (b & 0x7F) * multiplier_;
+      multiplier_ <<= 7;
+      if ((b & 0x80) == 0) {
+        if (remaining_ == 0) packetDone();
+        else state_ = FRAME_BODY;
+      }
+      break;
+
+    case FRAME_BODY:
+      if (bodyRead_ < sizeof(body_)) body_[bodyRead_] = b;
+      if (++bodyRead_ == remaining_) packetDone();
+      break;
+  }
+}
+
+void MqttTransport::packetDone() {
+  if (remaining_ == 2) {
+    if (type_ == MQTT_CONNACK) {
+      sessionPresent_ = body_[1] == 0 && (body_[0] & CONNACK_SESSION_PRESENT) != 0;
+    } else if (type_ == MQTT_PUBACK && ackFn_ != NULL) {
+      ackFn_((uint16_t)(body_[0] << 8 | body_[1]));
+    }
+  }
+  state_ = FRAME_TYPE;
+}
+
+bool MqttTransport::publishQos1(const char* topic, const uint8_t* payload, size_t length, uint16_t packetId, bool dup) {
+  size_t topicLength = strlen(topic);
+  if (topicLength > MQTT_TOPIC_MAX) return false;
+
+  // Fixed header, remaining length, topic and packet ID in one write, then the payload
+  uint8_t head[1 + 4 + 2 + MQTT_TOPIC_MAX + 2];
+  size_t used = 0;
+  head[used++] = MQTT_PUBLISH_QOS1 | (dup ? MQTT_DUP : 0);
+  uint32_t remaining = 2 + topicLength + 2 + length;
+  do {
+    uint8_t digit = remaining & 0x7F;
+    remaining >>= 7;
+    head[used++] = remaining > 0 ? (digit | 0x80) : digit;
+  } while (remaining > 0);
+  head[used++] = topicLength >> 8;
+  head[used++] = topicLength & 0xFF;
+  memcpy(head + used, topic, topicLength);
+  used += topicLength;
+  head[used++] = packetId >> 8;
+  head[used++] = packetId & 0xFF;
+
+  if (inner_.write(head, used) != used) return false;
+  return length == 0 || inner_.write(payload, length) == length;
+}
@@ -3,233 +3,465 @@
 #include "globals.h"
 #include <WiFi.h>
 #include "hardware.h"
-#include <WiFiClientSecure.h>
-#include <UniversalTelegramBot.h>
+#include "telemetry_frame.h"
+#include "journal.h"
+#include "telegram.h"
+#include "text_buffer.h"
+#include "rolling_stats.h"
+#include "report_filter.h"
+#include "device_config.h"
+#include "diagnostics.h"
+#include "stall_monitor.h"
+#include "fast_connect.h"
+#include "mqtt_outbox.h"
+#include "event_log.h"
+#include "ota_update.h"
+#include "control_state.h"
+#include "reading_snapshot.h"
+#include <esp_system.h>
 
 unsigned long lastSignalUpdate = 0;
 
-// --- TELEGRAM SETUP ---
-WiFiClientSecure secured_client;
-UniversalTelegramBot bot(TELEGRAM_BOT_TOKEN, secured_client);
+// Every publish goes through the outbox (mqtt_outbox.h), in the lane its topic belongs to
+bool mqttPublish(const char* topic, const uint8_t* payload, size_t length) {
+  return mqttOutboxPush(mqttLaneFor(topic), topic, payload, length);
+}
+
+bool mqttPublish(const char* topic, const char* payload) {
+  return mqttPublish(topic, (const uint8_t*)payload, strlen(payload));
+}
 
-// Timer for checking new Telegram messages (every 1 second)
-unsigned long lastTelegramCheck = 0;
-const unsigned long TELEGRAM_INTERVAL = 1000; 
+// One outbox write: timed, and failures counted
+static bool writePublish(const char* topic, const uint8_t* payload, size_t length, uint16_t packetId, bool dup) {
+  uint32_t start = halCycleCount();
+  bool sent = packetId == 0 ? mqtt_client.publish(topic, payload, length)
+                            : mqttTransport.publishQos1(topic, payload, length, packetId, dup);
+  diagRecord(DIAG_MQTT_PUBLISH, start);
+  if (sent) diagMilestone(DIAG_BOOT_FIRST_PUBLISH);
+  else diagCount(DIAG_PUBLISH_FAILS);
+  return sent;
+}
 
 void publishCommandStatus(const char* message) {
-  mqtt_client.publish(mqtt_command_status_topic, message);
+  mqttPublish(mqtt_command_status_topic, message);
   Serial.println(message);
 }
 
+// --- CONNECTION STATE MACHINES ---
+// Both connect functions make at most one attempt per call and return immediately,
+// so the scheduler keeps servicing sensors and emergency logic during an outage.
+static bool wifiConnecting = false;
+static bool wifiFastAttempt = false; // Current attempt uses the cached AP and IP (fast_connect.h)
+static unsigned long wifiAttemptStart = 0;
+static bool mqttAttempted = false;
+static unsigned long lastMqttAttempt = 0;
+static bool wifiWasConnected = false; // For the reconnect counters
+static bool mqttWasConnected = false;
+static bool bootReported = false;
+static bool sessionResumed = false; // Last CONNACK had session present
+
 void connectWiFi() {
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(ssid);
-  
-  WiFi.begin(ssid, password);
-  
-  while (WiFi.status() != WL_CONNECTED) {
-    digitalWrite(LED_PIN, HIGH);
-    delay(250);
-    digitalWrite(LED_PIN, LOW);
-    delay(250);
-    Serial.print(".");
+  unsigned long now = millis();
+
+  if (WiFi.status() == WL_CONNECTED) {
+    wifiWasConnected = true;
+    if (wifiConnecting) {
+      wifiConnecting = false;
+      digitalWrite(LED_PIN, LOW);
+
+      Serial.println("\n✓ WiFi Connected!");
+      Serial.print("IP Address: ");
+      Serial.println(WiFi.localIP());
+      diagMilestone(DIAG_BOOT_WIFI);
+      fastConnectSave();
+
+      // Set time via NTP so HTTPS certificates work (optional but good practice)
+      configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    }
+    return;
   }
-  
-  Serial.println("\n✓ WiFi Connected!");
-  Serial.print("IP Address: ");
-  Serial.println(WiFi.localIP());
-  
-  secured_client.setInsecure(); // Allow Telegram connection immediately
-  // Set time via NTP so HTTPS certificates work (optional but good practice)
-  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+
+  if (wifiWasConnected) {
+    wifiWasConnected = false;
+    diagCount(DIAG_WIFI_RECONNECTS);
+  }
+
+  // The cached AP gets a short window; then scan and ask DHCP as usual
+  if (wifiConnecting && wifiFastAttempt && now - wifiAttemptStart >= WIFI_FAST_CONNECT_TIMEOUT) {
+    fastConnectAbandon();
+    wifiConnecting = false;
+  }
+
+  if (!wifiConnecting || now - wifiAttemptStart >= WIFI_RETRY_INTERVAL) {
+    Serial.print("Connecting to WiFi: ");
+    Serial.println(ssid);
+
+    wifiFastAttempt = fastConnectBegin();
+    if (!wifiFastAttempt) WiFi.begin(ssid, password);
+    wifiConnecting = true;
+    wifiAttemptStart = now;
+  }
+
+  // Blink the status LED while associating (250 ms on / 250 ms off)
+  digitalWrite(LED_PIN, ((now - wifiAttemptStart) / 250) % 2 == 0 ? HIGH : LOW);
 }
 
-void connectMQTT() {
-  while (!mqtt_client.connected()) {
-    Serial.print("Connecting to MQTT broker: ");
-    Serial.println(mqtt_broker);
-    
-    if (mqtt_client.connect(mqtt_client_id)) {
-      Serial.println("✓ MQTT Connected!");
-      
-      mqtt_client.subscribe(mqtt_topic);
-      mqtt_client.subscribe(mqtt_led2_topic);
-      mqtt_client.subscribe(mqtt_led4_topic);
-      mqtt_client.subscribe(mqtt_emergency_light_topic);
-      
-      mqtt_client.publish(mqtt_status_topic, "OFF");
-    } else {
-      Serial.print("Failed, rc=");
-      Serial.print(mqtt_client.state());
-      Serial.println(" Retrying in 5 seconds...");
-      delay(5000);
+// --- STALL EVENTS ---
+// From the RTC ring, oldest first; an event leaves the ring only once it is published
+static void publishStallEvents() {
+  StallEvent event;
+  while (stallPeekEvent(event)) {
+    TextBuffer body;
+    body.appendf("{\"boots_ago\":%lu,\"uptime_ms\":%lu,\"task\":\"%s\",\"tag\":\"%s\","
+                 "\"stall_ms\":%lu,\"budget_ms\":%lu,\"ended\":%s,\"backtrace\":\"",
+      (unsigned long)event.bootsAgo, (unsigned long)event.startMillis, event.task, event.tag,
+      (unsigned long)event.stallMillis, (unsigned long)event.budgetMillis, event.ended ? "true" : "false");
+    for (uint8_t i = 0; i < event.depth; i++) {
+      body.appendf("%s0x%08lx", i > 0 ? " " : "", (unsigned long)event.pcs[i]);
     }
+    body.append("\"}");
+    // No text block free, or no room in the outbox: the event stays for the next connect or report
+    if (body.length() == 0) return;
+    if (!mqttOutboxFits(mqttLaneFor(mqtt_stall_topic), body.length())) return;
+    if (!mqttPublish(mqtt_stall_topic, body.c_str())) return;
+    stallPopEvent();
   }
 }
-// Handle new Telegram messages
-void handleNewMessages(int numNewMessages) {
-  for (int i = 0; i < numNewMessages; i++) {
-    String chat_id = String(bot.messages[i].chat_id);
-    String text = bot.messages[i].text;
 
-    if (chat_id != TELEGRAM_CHAT_ID) continue;
+static const char* resetReasonName(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_POWERON:  return "power_on";
+    case ESP_RST_EXT:      return "external";
+    case ESP_RST_SW:       return "software";
+    case ESP_RST_PANIC:    return "panic";
+    case ESP_RST_INT_WDT:  return "int_wdt";
+    case ESP_RST_TASK_WDT: return "task_wdt";
+    case ESP_RST_WDT:      return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deep_sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default:               return "unknown";
+  }
+}
 
-    if (text == "/status") {
-      bot.sendMessage(chat_id, "⏳ Waking up system to check status...", "");
+// --- BOOT REPORT ---
+// Once per boot, after the first publish went out: how long each step of the boot
+// took (uptime in ms) and which shortcuts were taken
+static void publishBootReport() {
+  TextBuffer body;
+  body.appendf("{\"reset_reason\":\"%s\",\"fast_wifi\":%s,\"session_present\":%s,"
+    "\"restored\":\"%s\",\"restore_us\":%lu,\"boot_ms\":",
+    resetReasonName(esp_reset_reason()), fastConnectUsed() ? "true" : "false", sessionResumed ? "true" : "false",
+    controlStateRestoredFrom(), controlStateRestoreMicros());
+  diagAppendMilestones(body);
+  body.append("}");
+  mqttPublish(mqtt_boot_topic, body.c_str());
+  bootReported = true;
+  Serial.printf("Boot: outputs restored (%s) %lu us, first sample %lu ms, WiFi %lu ms, MQTT %lu ms, first publish %lu ms\n",
+    controlStateRestoredFrom(), controlStateRestoreMicros(),
+    (unsigned long)diagMilestoneMillis(DIAG_BOOT_FIRST_SAMPLE), (unsigned long)diagMilestoneMillis(DIAG_BOOT_WIFI),
+    (unsigned long)diagMilestoneMillis(DIAG_BOOT_MQTT), (unsigned long)diagMilestoneMillis(DIAG_BOOT_FIRST_PUBLISH));
+}
 
-      // 1. Check if System was OFF (Active LOW logic: HIGH = OFF)
-      bool wasSystemOff = (digitalRead(LED2_PIN) == HIGH);
+void connectMQTT() {
+  if (mqtt_client.connected() || WiFi.status() != WL_CONNECTED) return;
 
-      // 2. If it was OFF, Turn it ON temporarily
-      if (wasSystemOff) {
-         digitalWrite(LED2_PIN, LOW); // Turn ON
-         Serial.println("Telegram: Temporarily waking system...");
-         delay(500); // Wait 0.5s for sensors/power to stabilize
-      }
+  unsigned long now = millis();
+  if (mqttAttempted && now - lastMqttAttempt < MQTT_RETRY_INTERVAL) return;
+  mqttAttempted = true;
+  lastMqttAttempt = now;
 
-      // 3. Force a fresh reading immediately
-      forceSensorUpdate();
-
-      // 4. Prepare the Report
-      String msg = "📊 *SYSTEM STATUS* 📊\n\n";
-      msg += "⚡ *Main Power*\n";
-      msg += "   Voltage: " + String(shared_v1, 2) + " V\n";
-      msg += "   Current:   " + String(shared_c1, 1) + " mA\n\n";
-      
-      msg += "🔋 *BATTERY:*\n";
-      msg += "   Voltage: " + String(shared_v2, 2) + " V\n";
-      msg += "   Current: " + String(shared_c2, 1) + " mA\n\n";
-      
-      msg += "☀️ *LIGHT INTENSITY*\n";
-      msg += "   Light: " + String(shared_intensity, 0) + "%\n";
-
-      // 5. If it was OFF before, turn it back OFF
-      if (wasSystemOff) {
-         digitalWrite(LED2_PIN, HIGH); // Turn OFF
-         Serial.println("Telegram: System returning to sleep.");
-         msg += "\n_(System returned to sleep mode)_";
-         // Also update MQTT to show it's off
-         mqtt_client.publish(mqtt_led2_status_topic, "OFF");
-      }
+  Serial.print("Connecting to MQTT broker: ");
+  Serial.println(deviceConfig().broker);
 
-      // 6. Send the report
-      bot.sendMessage(chat_id, msg, "Markdown");
-    }
-    
-    else if (text == "/start") {
-      bot.sendMessage(chat_id, "Welcome! Send /status to check sensors.", "");
+  uint32_t connectStart = halCycleCount();
+  // Persistent session (clean session off): the broker keeps our subscriptions
+  // between connections, keyed by the device ID
+  bool connected = mqtt_client.connect(deviceConfig().deviceId, NULL, NULL, NULL, 0, false, NULL, false);
+  diagRecord(DIAG_MQTT_CONNECT, connectStart);
+
+  if (connected) {
+    diagMilestone(DIAG_BOOT_MQTT);
+    if (mqttWasConnected) diagCount(DIAG_MQTT_RECONNECTS);
+    mqttWasConnected = true;
+
+    sessionResumed = mqttTransport.sessionPresent();
+    mqttOutboxReconnected(); // Alarms the old connection never got a PUBACK for
+    if (sessionResumed) {
+      Serial.println("✓ MQTT Connected! (session resumed, subscriptions kept)");
+    } else {
+      Serial.println("✓ MQTT Connected!");
+      // QoS 1, so commands sent while we are offline wait in the session
+      mqtt_client.subscribe(mqtt_topic, 1);
+      mqtt_client.subscribe(mqtt_led2_topic, 1);
+      mqtt_client.subscribe(mqtt_led4_topic, 1);
+      mqtt_client.subscribe(mqtt_emergency_light_topic, 1);
+      mqtt_client.subscribe(mqtt_event_query_topic, 1);
+      mqtt_client.subscribe(mqtt_ota_topic, 1);
+      mqtt_client.subscribe(mqtt_snapshot_get_topic, 1);
     }
+
+    mqttPublish(mqtt_status_topic, "OFF");
+    reportForceAll(); // Fresh values for anyone who subscribed while we were away
+    publishStallEvents(); // Including those from before a reset
+  } else {
+    diagCount(DIAG_MQTT_CONNECT_FAILS);
+    Serial.print("Failed, rc=");
+    Serial.print(mqtt_client.state());
+    Serial.println(" Retrying in 5 seconds...");
   }
 }
 
-void sendTelegramMessage(String message) {
-  // 1. Configure security (Insecure is fast & easiest for simple projects)
-  secured_client.setInsecure(); // Use this if certificates fail, much simpler for ESP32
+// Runs every pass; the byte budget keeps a burst from holding up the other tasks
+void serviceMqttOutbox() {
+  if (!mqtt_client.connected()) return;
+  mqttOutboxService(writePublish, millis(), MQTT_OUTBOX_PASS_BYTES);
 
-  // 2. Send the message
-  if (WiFi.status() == WL_CONNECTED) {
-      Serial.print("Sending Telegram: ");
-      Serial.println(message);
-      
-      bool sent = bot.sendMessage(TELEGRAM_CHAT_ID, message, "");
-      
-      if (sent) {
-        Serial.println("✓ Telegram sent successfully");
-      } else {
-        Serial.println("X Telegram failed to send");
-      }
-  } else {
-      Serial.println("Error: No WiFi, cannot send Telegram.");
-  }
+  // Once the first publish is out, so the report has every milestone
+  if (!bootReported && diagMilestoneMillis(DIAG_BOOT_FIRST_PUBLISH) != 0) publishBootReport();
 }
 
-void checkNetwork() {
-  if (WiFi.status() != WL_CONNECTED) {
-    connectWiFi();
+// --- TELEGRAM STATUS REPORT ---
+// From the latest-reading snapshot: straight away if it is fresh, otherwise
+// once the forced sample the control task takes after a /status command is in
+static void sendStatusReport(const ReadingSnapshot& snapshot, bool systemWoken) {
+  TextBuffer msg;
+  msg.append("📊 *SYSTEM STATUS* 📊\n\n");
+  msg.append("⚡ *Main Power*\n");
+  msg.appendf("   Voltage: %.2f V\n", snapshot.v1);
+  msg.appendf("   Current:   %.1f mA\n\n", snapshot.c1);
+  
+  msg.append("🔋 *BATTERY:*\n");
+  msg.appendf("   Voltage: %.2f V\n", snapshot.v2);
+  msg.appendf("   Current: %.1f mA\n\n", snapshot.c2);
+  
+  msg.append("☀️ *LIGHT INTENSITY*\n");
+  msg.appendf("   Light: %.0f%%\n\n", snapshot.intensity);
+
+  msg.append("🔌 *OUTPUTS*\n");
+  msg.appendf("   System: %s | Emergency Light: %s\n", (snapshot.outputs & CONTROL_OUT_SYSTEM) ? "OFF" : "ON",
+    (snapshot.outputs & CONTROL_OUT_LIGHT) ? "OFF" : "ON");
+  if (snapshot.powerCut) msg.appendf("   ⚠️ Power cut%s\n", snapshot.emergencyMode ? ", emergency sequence running" : "");
+  msg.appendf("\n_Reading from %.1f s ago_", snapshotAge(snapshot) / 1000.0f);
+
+  if (systemWoken) {
+     msg.append("\n_(System returned to sleep mode)_");
   }
-  if (!mqtt_client.connected()) {
-    connectMQTT();
+
+  telegramEnqueue(msg.c_str(), true);
+}
+
+// --- TELEMETRY PUBLISHING ---
+static void publishSampleFrame(const SensorSample& sample) {
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  size_t length = encodeTelemetryFrame(sample, uptimeToEpochSeconds(sample.timestamp), frame, sizeof(frame));
+  mqttPublish(mqtt_telemetry_frame_topic, frame, length);
+}
+
+static bool publishText(const char* topic, const char* payload) {
+  return mqttPublish(topic, payload);
+}
+
+// Only the values that changed (or whose heartbeat ran out) reach the broker
+static void publishSampleText(const SensorSample& sample) {
+  reportSampleText(sample, publishText);
+
+  Serial.printf("Light Intensity: %.1f%%\n", sample.intensity);
+  Serial.println("\n--- Channel Measurements ---");
+  Serial.printf("CH1: %.3f V | %.2f mA | %.2f mW\n", sample.v1, sample.c1, sample.p1);
+  Serial.printf("CH2: %.3f V | %.2f mA | %.2f mW\n", sample.v2, sample.c2, sample.p2);
+}
+
+// Sent vs. suppressed per text topic
+void publishReportStats() {
+  if (!mqtt_client.connected()) return;
+  TextBuffer body;
+  reportFormatStats(body);
+  mqttPublish(mqtt_report_stats_topic, body.c_str());
+}
+
+// Subsystem timings, reconnect/publish counters, heap and stacks (diagnostics.h)
+void publishDiagnostics() {
+  const char* report = diagFormatReport(); // Also when offline: keeps the overhead window aligned
+  if (!mqtt_client.connected()) return;
+  mqttPublish(mqtt_diagnostics_topic, report);
+  publishStallEvents(); // Stalls of this session
+}
+
+// Drains everything the control core queued since the last pass
+void serviceTelemetry() {
+  SensorSample sample;
+  while (sampleQueue.pop(sample)) {
+    if (sample.flags & SAMPLE_FORCED) {
+      ReadingSnapshot snapshot; // Published before the sample, so at least as new
+      if (snapshotRead(snapshot)) sendStatusReport(snapshot, sample.flags & SAMPLE_SYSTEM_WOKEN);
+    } else if (!mqtt_client.connected() || !mqttOutboxFits(MQTT_LANE_STATE, TEXT_BLOCK_SIZE)) {
+      journalAppend(sample); // Replayed by replayJournal() once the broker (or the socket) catches up
+    } else {
+      if (TELEMETRY_BINARY_FRAME) publishSampleFrame(sample);
+      if (TELEMETRY_TEXT_TOPICS && !TELEMETRY_AGGREGATES) publishSampleText(sample);
+    }
   }
-  mqtt_client.loop();
 
-  // --- SIGNAL STRENGTH CHECK (Every 5 Seconds) ---
-  unsigned long now = millis();
-  if (now - lastSignalUpdate > SIGNAL_UPDATE_INTERVAL) {
-    lastSignalUpdate = now;
-    long rssi = WiFi.RSSI();
-    mqtt_client.publish("chami/esp32/stats/signal", String(rssi).c_str());
+  // Window aggregates are live-only: while MQTT is down they are dropped, the
+  // journaled samples cover the gap
+  StatsAggregate aggregate;
+  while (statsNextAggregate(aggregate)) {
+    if (!TELEMETRY_AGGREGATES || !mqtt_client.connected()) continue;
+    TextBuffer body;
+    statsFormatAggregate(aggregate, uptimeToEpochSeconds(aggregate.endMillis), body);
+    mqttPublish(mqtt_aggregate_topic, body.c_str());
   }
 
-  // --- NEW: TELEGRAM POLLING (Every 1 Second) ---
-  // This actively checks if YOU sent a command to the bot
-  if (now - lastTelegramCheck > TELEGRAM_INTERVAL) {
-    int numNewMessages = bot.getUpdates(bot.last_message_received + 1);
-    
-    while(numNewMessages) {
-      handleNewMessages(numNewMessages);
-      numNewMessages = bot.getUpdates(bot.last_message_received + 1);
+  OutboundMessage msg;
+  while (outboundQueue.pop(msg)) {
+    if (msg.channel == OUT_TELEGRAM) {
+      telegramEnqueue(msg.payload);
+    } else {
+      mqttPublish(msg.topic, msg.payload);
     }
-    lastTelegramCheck = now;
   }
-  // ----------------------------------------------
+
+  // status/get, once the snapshot is fresh enough
+  ReadingSnapshot snapshot;
+  if (snapshotAnswerReady(snapshot)) {
+    TextBuffer body;
+    snapshotFormat(snapshot, body);
+    if (body.length() > 0) mqttPublish(mqtt_snapshot_topic, body.c_str()); // Empty if the text pool ran out
+  }
 }
 
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String message = "";
-  for (int i = 0; i < length; i++) {
-    message += (char)payload[i];
+static bool sendJournalFrame(const uint8_t* frame, size_t length) {
+  return mqttPublish(mqtt_telemetry_frame_topic, frame, length);
+}
+
+// State lane counters taken around the last replayed batch
+static uint32_t replayQueuedMark = 0;
+static uint32_t replayDroppedMark = 0;
+
+// Replays the flash backlog in small batches. Live samples always go first:
+// a batch is only sent when nothing newer is waiting in the sample ring.
+// The journal cursor moves past a batch only once all of it has left the
+// outbox; if the full lane pushed out records meanwhile, it is sent again.
+void replayJournal() {
+  if (journalUnsettledRecords() > 0) {
+    MqttLaneStats lane = mqttOutboxStats().lanes[MQTT_LANE_STATE];
+    if (lane.queued - lane.depth < replayQueuedMark) return; // Still in the outbox
+    journalReplaySettled(lane.dropped == replayDroppedMark);
+    if (journalPendingRecords() == 0) Serial.println("✓ Journal backlog fully replayed");
   }
-  
-  Serial.print("Msg on ["); Serial.print(topic); Serial.print("]: "); Serial.println(message);
-
-  // --- LED 1 CONTROL ---
-  if (String(topic) == mqtt_topic) {
-    if (message == "ON" || message == "1") {
-      digitalWrite(LED_PIN, HIGH);
-      mqtt_client.publish(mqtt_status_topic, "ON");
-    } else if (message == "OFF" || message == "0") {
-      digitalWrite(LED_PIN, LOW);
-      mqtt_client.publish(mqtt_status_topic, "OFF");
-    }
+
+  if (!mqtt_client.connected() || sampleQueue.size() > 0) return;
+  if (journalPendingRecords() == 0) return;
+  if (!mqttOutboxFits(MQTT_LANE_STATE, JOURNAL_REPLAY_BATCH * TELEMETRY_FRAME_SIZE)) return; // Backpressure
+
+  replayDroppedMark = mqttOutboxStats().lanes[MQTT_LANE_STATE].dropped;
+  if (journalReplay(JOURNAL_REPLAY_BATCH, sendJournalFrame) > 0) {
+    replayQueuedMark = mqttOutboxStats().lanes[MQTT_LANE_STATE].queued;
+  }
+}
+
+// --- POWER-CUT EVENT LOG ---
+// Finished outages go to flash whether or not the broker is up; queries are
+// answered one page per pass, in the bulk lane
+static char eventPage[EVENT_PAGE_SIZE];
+
+void serviceEventLog() {
+  PowerCutEvent event;
+  while (eventQueue.pop(event)) {
+    uint32_t id = eventLogAppend(event, uptimeToEpochSeconds(event.startMillis), uptimeToEpochSeconds(event.endMillis));
+    if (id == 0) Serial.println("ERROR: Event log write failed, outage not logged");
+  }
+
+  if (!mqtt_client.connected() || !mqttOutboxFits(MQTT_LANE_BULK, EVENT_PAGE_SIZE)) return;
+  EventQuery query;
+  if (!eventLogNextQuery(query)) return;
+  TextBuffer page(eventPage, sizeof(eventPage));
+  eventLogFormatPage(query, page);
+  mqttPublish(mqtt_event_page_topic, page.c_str());
+}
+
+// --- OTA UPDATES ---
+// Progress while the OTA task runs, the outcome once, and the verdict on a new
+// image after its first boot
+static unsigned long lastOtaReport = 0;
+static uint16_t finishedOtaAttempt = 0;
+
+static const char* otaStateName(OtaState state) {
+  switch (state) {
+    case OTA_DOWNLOADING: return "downloading";
+    case OTA_DONE: return "done";
+    case OTA_FAILED: return "failed";
+    default: return "idle";
   }
-  // --- LED 2 (GPIO13) CONTROL ---
-  else if (String(topic) == mqtt_led2_topic) {
-    if (message == "ON" || message == "1") {
-      digitalWrite(LED2_PIN, LOW);
-    } else if (message == "OFF" || message == "0") {
-      digitalWrite(LED2_PIN, HIGH);
-      delay(1000); 
-      if (digitalRead(LED4_PIN) == HIGH) {
-         digitalWrite(LED4_PIN, LOW); delayMicroseconds(10); digitalWrite(LED4_PIN, HIGH);
-         delay(100);
-         digitalWrite(LED4_PIN, LOW); delayMicroseconds(10); digitalWrite(LED4_PIN, HIGH);
-      } else {
-         digitalWrite(LED4_PIN, HIGH); delayMicroseconds(10); digitalWrite(LED4_PIN, LOW);
+}
+
+void serviceOta() {
+  if (otaCheckHealth()) {
+    char verified[64];
+    snprintf(verified, sizeof(verified), "{\"state\":\"verified\",\"partition\":\"%s\"}", otaRunningPartition());
+    mqttPublish(mqtt_ota_status_topic, verified);
+  }
+
+  OtaStatus status = otaStatus();
+  if (status.state == OTA_IDLE) return;
+  bool finished = status.state != OTA_DOWNLOADING;
+  if (finished ? status.attempt == finishedOtaAttempt : millis() - lastOtaReport < OTA_PROGRESS_INTERVAL) return;
+  if (!mqtt_client.connected()) return;
+  lastOtaReport = millis();
+  if (finished) finishedOtaAttempt = status.attempt;
+
+  char report[384];
+  TextBuffer out(report, sizeof(report));
+  out.appendf("{\"state\":\"%s\",\"partition\":\"%s\",\"delta\":%s,\"bytes_in\":%lu,\"bytes_out\":%lu,\"image\":%lu,",
+    otaStateName(status.state), otaRunningPartition(), status.delta ? "true" : "false",
+    (unsigned long)status.bytesIn, (unsigned long)status.bytesOut, (unsigned long)status.imageSize);
+  out.appendf("\"download_ms\":%lu,\"flash_ms\":%lu,\"flash_kbps\":%lu,\"jitter_us\":%lu,\"overruns\":%lu",
+    (unsigned long)status.downloadMillis, (unsigned long)status.flashMillis,
+    status.flashMillis > 0 ? (unsigned long)(status.bytesOut / status.flashMillis) : 0UL,
+    status.jitterMicros, (unsigned long)status.sampleOverruns);
+  if (status.error != NULL) out.appendf(",\"error\":\"%s\"", status.error);
+  out.append("}");
+  mqttPublish(mqtt_ota_status_topic, out.c_str());
+}
+
+// Handle commands received by the Telegram listener task
+void serviceTelegramCommands() {
+  TelegramCommand command;
+  while (telegramNextCommand(command)) {
+    if (command == TG_STATUS) {
+      ReadingSnapshot snapshot;
+      if (snapshotRead(snapshot) && snapshotAge(snapshot) <= SNAPSHOT_MAX_AGE) {
+        sendStatusReport(snapshot, false); // No wake-up, no wait: the sampler read it moments ago
+        continue;
       }
-    } else if (message == "PULSE") {
-      digitalWrite(LED2_PIN, HIGH); delay(2000); digitalWrite(LED2_PIN, LOW);
+      telegramEnqueue("⏳ Waking up system to check status...");
+
+      // The control core wakes GPIO13 if needed and queues a forced sample;
+      // serviceTelemetry() turns that sample into the report.
+      ControlCommand cmd = { CMD_STATUS_REPORT, ACTION_NONE };
+      commandQueue.push(cmd);
     }
-  }
-  // --- LED 4 (GPIO14) CONTROL ---
-  else if (String(topic) == mqtt_led4_topic) {
-    if (message == "ON" || message == "1" || message == "OFF" || message == "0") {
-      digitalWrite(LED4_PIN, LOW); delayMicroseconds(10); digitalWrite(LED4_PIN, HIGH);
-    } else if (message == "PULSE") {
-      digitalWrite(LED4_PIN, HIGH); delay(2000); digitalWrite(LED4_PIN, LOW);
+    
+    else if (command == TG_START) {
+      telegramEnqueue("Welcome! Send /status to check sensors.");
     }
   }
-  // --- EMERGENCY LIGHT CONTROL ---
-  else if (String(topic) == mqtt_emergency_light_topic) {
-    manualEmergencyControl = true;
-    if (message == "ON" || message == "1") {
-      digitalWrite(POWER_STATUS_PIN, LOW);
-      mqtt_client.publish(mqtt_emergency_light_status_topic, "ON");
-    } else if (message == "OFF" || message == "0") {
-      digitalWrite(POWER_STATUS_PIN, HIGH);
-      mqtt_client.publish(mqtt_emergency_light_status_topic, "OFF");
-    } else if (message == "AUTO") {
-      manualEmergencyControl = false;
-      mqtt_client.publish(mqtt_emergency_light_status_topic, "AUTO");
-    }
+}
+
+void checkNetwork() {
+  connectWiFi();
+  if (WiFi.status() != WL_CONNECTED) return;
+
+  connectMQTT();
+  mqtt_client.loop();
+
+  // --- SIGNAL STRENGTH CHECK (Every 5 Seconds) ---
+  unsigned long now = millis();
+  if (now - lastSignalUpdate > SIGNAL_UPDATE_INTERVAL) {
+    lastSignalUpdate = now;
+    char rssi[12];
+    snprintf(rssi, sizeof(rssi), "%ld", (long)WiFi.RSSI());
+    mqttPublish(mqtt_signal_topic, rssi);
   }
-}
\ No newline at end of file
+
+}
@@ -0,0 +1,148 @@
+#include "ota_image.h"
+
+enum DecoderStage : uint8_t { STAGE_HEADER, STAGE_FULL, STAGE_OP, STAGE_DATA, STAGE_DONE, STAGE_ERROR };
+
+static const size_t COPY_CHUNK = 256; // Bounce buffer between the running image and the sink
+
+static OtaSourceFn sourceFn = NULL;
+static OtaSinkFn sinkFn = NULL;
+static DecoderStage stage = STAGE_HEADER;
+static OtaImageHeader header;
+static uint8_t pending[OTA_IMAGE_HEADER_SIZE]; // Header or op arguments split across pieces
+static size_t pendingLength = 0;
+static size_t pendingNeeded = 0;
+static uint32_t produced = 0;
+static uint32_t dataLeft = 0;
+static const char* error = NULL;
+
+static uint32_t readU32(const uint8_t* bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static OtaImageResult fail(const char* reason) {
+  error = reason;
+  stage = STAGE_ERROR;
+  return OTA_IMAGE_ERROR;
+}
+
+void otaImageBegin(OtaSourceFn source, OtaSinkFn sink) {
+  sourceFn = source;
+  sinkFn = sink;
+  stage = STAGE_HEADER;
+  memset(&header, 0, sizeof(header));
+  pendingLength = 0;
+  pendingNeeded = OTA_IMAGE_HEADER_SIZE;
+  produced = 0;
+  dataLeft = 0;
+  error = NULL;
+}
+
+static bool emit(const uint8_t* data, size_t length) {
+  if (!sinkFn(data, length)) return false;
+  produced += length;
+  return true;
+}
+
+static OtaImageResult parseHeader() {
+  if (readU32(pending) != OTA_IMAGE_MAGIC) return fail("not an OTA image");
+  header.version = pending[4];
+  header.flags = pending[5];
+  header.imageSize = readU32(pending + 8);
+  memcpy(header.baseSha256, pending + 12, sizeof(header.baseSha256));
+  memcpy(header.imageSha256, pending + 44, sizeof(header.imageSha256));
+  memcpy(header.signature, pending + 76, sizeof(header.signature));
+  if (header.version != OTA_IMAGE_VERSION) return fail("unsupported image version");
+  if (header.imageSize == 0) return fail("empty image");
+  if ((header.flags & OTA_IMAGE_DELTA) && sourceFn == NULL) return fail("delta without a base image");
+
+  stage = header.flags & OTA_IMAGE_DELTA ? STAGE_OP : STAGE_FULL;
+  pendingLength = 0;
+  pendingNeeded = 1;
+  return OTA_IMAGE_MORE;
+}
+
+static OtaImageResult runCopy(uint32_t offset, uint32_t length) {
+  uint8_t chunk[COPY_CHUNK];
+  while (length > 0) {
+    size_t part = length < sizeof(chunk) ? length : sizeof(chunk);
+    if (!sourceFn(offset, chunk, part)) return fail("base image read failed");
+    if (!emit(chunk, part)) return fail("flash write failed");
+    offset += part;
+    length -= part;
+  }
+  return OTA_IMAGE_MORE;
+}
+
+// An op byte and its arguments are complete in pending
+static OtaImageResult parseOp() {
+  uint8_t op = pending[0];
+  if (pendingLength == 1) { // Op byte only: now its arguments
+    if (op == OTA_OP_COPY) pendingNeeded = 9;
+    else if (op == OTA_OP_DATA) pendingNeeded = 5;
+    else return fail("unknown delta op");
+    return OTA_IMAGE_MORE;
+  }
+
+  uint32_t length = readU32(pending + pendingLength - 4);
+  pendingLength = 0;
+  pendingNeeded = 1;
+  if (length > header.imageSize - produced) return fail("delta op past the end of the image");
+
+  if (op == OTA_OP_COPY) {
+    if (runCopy(readU32(pending + 1), length) == OTA_IMAGE_ERROR) return OTA_IMAGE_ERROR;
+  } else {
+    dataLeft = length;
+    stage = STAGE_DATA;
+  }
+  return OTA_IMAGE_MORE;
+}
+
+OtaImageResult otaImageFeed(const uint8_t* data, size_t length) {
+  for (;;) {
+    if (stage == STAGE_ERROR) return OTA_IMAGE_ERROR;
+    if (stage != STAGE_HEADER && produced == header.imageSize) stage = STAGE_DONE;
+    if (stage == STAGE_DONE) return OTA_IMAGE_DONE;
+    if (length == 0) return OTA_IMAGE_MORE;
+
+    if (stage == STAGE_FULL || stage == STAGE_DATA) {
+      uint32_t want = stage == STAGE_FULL ? header.imageSize - produced : dataLeft;
+      size_t part = length < want ? length : want;
+      if (!emit(data, part)) return fail("flash write failed");
+      data += part;
+      length -= part;
+      if (stage == STAGE_DATA) {
+        dataLeft -= part;
+        if (dataLeft == 0) stage = STAGE_OP;
+      }
+      continue;
+    }
+
+    // STAGE_HEADER / STAGE_OP: the fixed-size fields may arrive split
+    size_t part = pendingNeeded - pendingLength;
+    if (part > length) part = length;
+    memcpy(pending + pendingLength, data, part);
+    pendingLength += part;
+    data += part;
+    length -= part;
+    if (pendingLength < pendingNeeded) continue;
+
+    if (stage == STAGE_HEADER) parseHeader();
+    else parseOp();
+  }
+}
+
+bool otaImageHeaderReady() {
+  return stage != STAGE_HEADER && stage != STAGE_ERROR;
+}
+
+const OtaImageHeader& otaImageHeader() {
+  return header;
+}
+
+uint32_t otaImageProduced() {
+  return produced;
+}
+
+const char* otaImageError() {
+  return error;
+}
@@ -0,0 +1,341 @@
+#include "ota_update.h"
+#include "ota_image.h"
+#include "config.h"
+#include "globals.h"
+#include "sampler.h"
+#include "diagnostics.h"
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp32/rom/miniz.h>
+#include <esp_system.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/ecdsa.h>
+
+// --- STATE ---
+// Written by the OTA task, read by the network task (32-bit words, never torn)
+static volatile OtaState state = OTA_IDLE;
+static uint16_t attempt = 0;
+static const char* volatile failure = NULL;
+static volatile bool deltaImage = false;
+static volatile uint32_t bytesIn = 0;
+static volatile uint32_t bytesOut = 0;
+static volatile uint32_t downloadMillis = 0;
+static uint32_t downloadStart = 0;
+static volatile uint32_t flashMillis = 0;
+static uint32_t overrunsAtStart = 0;
+
+static char url[OTA_URL_SIZE];
+static TaskHandle_t otaHandle = NULL;
+static bool pendingVerify = false;
+
+// --- OTA TASK ---
+static const esp_partition_t* running = NULL;
+static const esp_partition_t* target = NULL;
+static esp_ota_handle_t otaWrite = 0;
+static uint8_t sector[OTA_CHUNK_SIZE]; // The sink fills one sector, then writes it
+static size_t sectorUsed = 0;
+static bool signatureChecked = false;
+static mbedtls_sha256_context imageHash; // Of everything handed to flash
+
+// The ROM's inflate works on a 32 KB circular window; both only exist during an update
+static tinfl_decompressor* inflator = NULL;
+static uint8_t* window = NULL;
+static size_t windowPos = 0;
+
+// Bootloader rollback: Arduino would mark this image valid before setup(); we
+// decide in otaCheckHealth() instead
+bool verifyRollbackLater() {
+  return true;
+}
+
+void setupOta() {
+  running = esp_ota_get_running_partition();
+  esp_ota_img_states_t imageState;
+  if (esp_ota_get_state_partition(running, &imageState) == ESP_OK && imageState == ESP_OTA_IMG_PENDING_VERIFY) {
+    pendingVerify = true;
+    Serial.printf("OTA: running %s, new image pending verification\n", running->label);
+  }
+}
+
+static bool writeSector() {
+  uint32_t start = millis();
+  esp_err_t err = esp_ota_write(otaWrite, sector, sectorUsed);
+  flashMillis += millis() - start;
+  if (err != ESP_OK) return false;
+  bytesOut += sectorUsed;
+  sectorUsed = 0;
+  return true;
+}
+
+// --- SIGNATURE ---
+// The header carries the new image's SHA-256 and an ECDSA P-256 signature of it.
+// The signature is checked before the first byte goes to flash, the SHA-256 of
+// what was written before the boot partition is switched.
+static bool signingKeyConfigured() {
+  return ota_signing_key[0] == 0x04; // Uncompressed point; all zeros = no key
+}
+
+static bool signatureValid(const uint8_t* sha256, const uint8_t* signature) {
+  mbedtls_ecp_group group;
+  mbedtls_ecp_point key;
+  mbedtls_mpi r, s;
+  mbedtls_ecp_group_init(&group);
+  mbedtls_ecp_point_init(&key);
+  mbedtls_mpi_init(&r);
+  mbedtls_mpi_init(&s);
+  bool valid = mbedtls_ecp_group_load(&group, MBEDTLS_ECP_DP_SECP256R1) == 0 &&
+    mbedtls_ecp_point_read_binary(&group, &key, ota_signing_key, OTA_SIGNING_KEY_SIZE) == 0 &&
+    mbedtls_mpi_read_binary(&r, signature, 32) == 0 &&
+    mbedtls_mpi_read_binary(&s, signature + 32, 32) == 0 &&
+    mbedtls_ecdsa_verify(&group, sha256, 32, &key, &r, &s) == 0;
+  mbedtls_mpi_free(&s);
+  mbedtls_mpi_free(&r);
+  mbedtls_ecp_point_free(&key);
+  mbedtls_ecp_group_free(&group);
+  return valid;
+}
+
+static bool sinkImage(const uint8_t* data, size_t length) {
+  // The header is complete before the decoder produces anything
+  if (!signatureChecked) {
+    if (!signatureValid(otaImageHeader().imageSha256, otaImageHeader().signature)) {
+      failure = "image not signed with our key";
+      return false;
+    }
+    signatureChecked = true;
+  }
+  mbedtls_sha256_update(&imageHash, data, length);
+
+  while (length > 0) {
+    size_t part = sizeof(sector) - sectorUsed;
+    if (part > length) part = length;
+    memcpy(sector + sectorUsed, data, part);
+    sectorUsed += part;
+    data += part;
+    length -= part;
+    if (sectorUsed == sizeof(sector) && !writeSector()) return false;
+  }
+  return true;
+}
+
+static bool readRunningImage(uint32_t offset, uint8_t* buffer, size_t length) {
+  return esp_partition_read(running, offset, buffer, length) == ESP_OK;
+}
+
+// A delta only applies to the image it was built against. This is the ESP image
+// digest (the SHA-256 esptool appends, not a hash of the whole .bin), which is what
+// the packer's espImageDigest() puts in the header.
+static bool checkDeltaBase() {
+  if (!otaImageHeaderReady() || !(otaImageHeader().flags & OTA_IMAGE_DELTA) || deltaImage) return true;
+  deltaImage = true;
+  uint8_t sha[32];
+  if (esp_partition_get_sha256(running, sha) != ESP_OK) return false;
+  return memcmp(sha, otaImageHeader().baseSha256, sizeof(sha)) == 0;
+}
+
+// Inflates one downloaded piece into the image decoder
+static OtaImageResult inflatePiece(const uint8_t* data, size_t length) {
+  for (;;) {
+    size_t inBytes = length;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - windowPos;
+    tinfl_status status = tinfl_decompress(inflator, data, &inBytes, window, window + windowPos, &outBytes,
+      TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+    data += inBytes;
+    length -= inBytes;
+
+    if (outBytes > 0) {
+      OtaImageResult result = otaImageFeed(window + windowPos, outBytes);
+      windowPos = (windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+      if (result != OTA_IMAGE_MORE) return result;
+    }
+    if (status < TINFL_STATUS_DONE) {
+      failure = "inflate failed";
+      return OTA_IMAGE_ERROR;
+    }
+    if (status == TINFL_STATUS_DONE) return OTA_IMAGE_MORE; // Image decoder decides if it is complete
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && length == 0) return OTA_IMAGE_MORE;
+  }
+}
+
+static const char* runUpdate() {
+  target = esp_ota_get_next_update_partition(NULL);
+  if (target == NULL) return "no OTA partition";
+
+  HTTPClient http;
+  http.setTimeout(OTA_HTTP_TIMEOUT);
+  if (!http.begin(url)) return "bad URL";
+  int code = http.GET();
+  if (code != HTTP_CODE_OK) {
+    http.end();
+    return "HTTP request failed";
+  }
+
+  // Sequential writes: each sector is erased right before it is written, so the
+  // caches are off for one sector erase at a time instead of the whole partition
+  if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &otaWrite) != ESP_OK) {
+    http.end();
+    return "esp_ota_begin failed";
+  }
+
+  otaImageBegin(readRunningImage, sinkImage);
+  signatureChecked = false;
+  mbedtls_sha256_init(&imageHash);
+  mbedtls_sha256_starts(&imageHash, 0);
+  WiFiClient* stream = http.getStreamPtr();
+  int remaining = http.getSize(); // -1 if the server did not say
+  uint8_t chunk[OTA_CHUNK_SIZE / 4];
+  bool compressed = false;
+  bool firstPiece = true;
+  OtaImageResult result = OTA_IMAGE_MORE;
+  unsigned long lastData = millis();
+
+  while (result == OTA_IMAGE_MORE && remaining != 0 && (http.connected() || stream->available() > 0)) {
+    size_t available = stream->available();
+    if (available == 0) {
+      if (millis() - lastData > OTA_HTTP_TIMEOUT) break;
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+    size_t length = stream->readBytes(chunk, available < sizeof(chunk) ? available : sizeof(chunk));
+    lastData = millis();
+    bytesIn += length;
+    if (remaining > 0) remaining -= length;
+
+    if (firstPiece) { // zlib streams start with 0x78, raw images with the magic
+      compressed = chunk[0] == 0x78;
+      firstPiece = false;
+      if (compressed) {
+        inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+        window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+        if (inflator == NULL || window == NULL) {
+          result = OTA_IMAGE_ERROR;
+          failure = "out of memory";
+          break;
+        }
+        tinfl_init(inflator);
+        windowPos = 0;
+      }
+    }
+    result = compressed ? inflatePiece(chunk, length) : otaImageFeed(chunk, length);
+    if (result != OTA_IMAGE_ERROR && !checkDeltaBase()) {
+      result = OTA_IMAGE_ERROR;
+      failure = "delta built for another image";
+    }
+    vTaskDelay(1); // Low priority, but leave the network task its share of the core
+  }
+  downloadMillis = millis() - downloadStart;
+  http.end();
+  free(inflator);
+  free(window);
+  inflator = NULL;
+  window = NULL;
+
+  uint8_t sha[32];
+  mbedtls_sha256_finish(&imageHash, sha);
+  mbedtls_sha256_free(&imageHash);
+
+  if (result != OTA_IMAGE_DONE) {
+    esp_ota_abort(otaWrite);
+    if (failure != NULL) return failure;
+    if (otaImageError() != NULL) return otaImageError();
+    return "download incomplete";
+  }
+  if (sectorUsed > 0 && !writeSector()) {
+    esp_ota_abort(otaWrite);
+    return "flash write failed";
+  }
+
+  uint32_t start = millis();
+  esp_err_t err = esp_ota_end(otaWrite); // Checks the image and its SHA-256
+  flashMillis += millis() - start;
+  if (err != ESP_OK) return "image verification failed";
+  if (!signatureChecked || memcmp(sha, otaImageHeader().imageSha256, sizeof(sha)) != 0) return "image does not match its signature";
+  if (esp_ota_set_boot_partition(target) != ESP_OK) return "could not switch boot partition";
+  return NULL;
+}
+
+static void otaTask(void* param) {
+  const char* error = runUpdate();
+  failure = error;
+  state = error == NULL ? OTA_DONE : OTA_FAILED;
+  if (error != NULL) {
+    Serial.printf("OTA: failed (%s)\n", error);
+    otaHandle = NULL;
+    vTaskDelete(NULL);
+  }
+
+  Serial.printf("OTA: %lu bytes to %s in %lu ms, restarting\n",
+    (unsigned long)bytesOut, target->label, (unsigned long)downloadMillis);
+  vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY)); // Lets the final report out
+  while (powerCutDetected) vTaskDelay(pdMS_TO_TICKS(1000)); // Never in the middle of an emergency sequence
+  esp_restart();
+}
+
+bool otaRequest(const char* text, size_t length) {
+  if (otaHandle != NULL || state == OTA_DONE) return false;
+  if (pendingVerify) return false; // Not on top of an image that has not proved itself yet
+  if (!signingKeyConfigured()) return false; // Nothing could be verified
+  if (length == 0 || length >= sizeof(url)) return false;
+  memcpy(url, text, length);
+  url[length] = '\0';
+
+  failure = NULL;
+  deltaImage = false;
+  bytesIn = bytesOut = flashMillis = 0;
+  sectorUsed = 0;
+  downloadStart = millis();
+  downloadMillis = 0;
+  overrunsAtStart = samplerStats().overruns;
+  samplerMarkJitter();
+  state = OTA_DOWNLOADING;
+  attempt++;
+
+  Serial.printf("OTA: fetching %s\n", url);
+  // Below the network task on its own core: sampling and control never wait for it
+  if (xTaskCreatePinnedToCore(otaTask, "ota", 8192, NULL, 1, &otaHandle, NETWORK_CORE) != pdPASS) {
+    otaHandle = NULL;
+    state = OTA_FAILED;
+    failure = "no memory for the OTA task";
+    return false;
+  }
+  return true;
+}
+
+OtaStatus otaStatus() {
+  OtaStatus status;
+  status.state = state;
+  status.attempt = attempt;
+  status.error = failure;
+  status.delta = deltaImage;
+  status.bytesIn = bytesIn;
+  status.bytesOut = bytesOut;
+  status.imageSize = otaImageHeaderReady() ? otaImageHeader().imageSize : 0;
+  status.downloadMillis = state == OTA_DOWNLOADING ? millis() - downloadStart : downloadMillis;
+  status.flashMillis = flashMillis;
+  SamplerStats smp = samplerStats();
+  status.jitterMicros = smp.markJitterMicros;
+  status.sampleOverruns = smp.overruns - overrunsAtStart;
+  return status;
+}
+
+bool otaCheckHealth() {
+  if (!pendingVerify) return false;
+
+  // Sampling and the broker both work: this image is good
+  if (diagMilestoneMillis(DIAG_BOOT_FIRST_SAMPLE) != 0 && diagMilestoneMillis(DIAG_BOOT_FIRST_PUBLISH) != 0) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    pendingVerify = false;
+    Serial.println("✓ OTA: new image verified");
+    return true;
+  }
+  if (millis() > OTA_VERIFY_TIMEOUT) {
+    Serial.println("OTA: new image never got online, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+  return false;
+}
+
+const char* otaRunningPartition() {
+  return running != NULL ? running->label : "?";
+}
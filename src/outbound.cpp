@@ -0,0 +1,24 @@
+#include "outbound.h"
+#include "config.h"
+#include "globals.h"
+
+bool queuePublish(const char* topic, const char* payload) {
+  OutboundMessage msg;
+  msg.channel = OUT_MQTT;
+  msg.topic = topic;
+  strlcpy(msg.payload, payload, sizeof(msg.payload));
+  return outboundQueue.push(msg);
+}
+
+bool queueCommandStatus(const char* message) {
+  Serial.println(message);
+  return queuePublish(mqtt_command_status_topic, message);
+}
+
+bool queueTelegram(const char* message) {
+  OutboundMessage msg;
+  msg.channel = OUT_TELEGRAM;
+  msg.topic = NULL;
+  strlcpy(msg.payload, message, sizeof(msg.payload));
+  return outboundQueue.push(msg);
+}
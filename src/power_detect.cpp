@@ -0,0 +1,118 @@
+#include "power_detect.h"
+#include "config.h"
+#include "globals.h"
+
+static TaskHandle_t controlTaskHandle = NULL;
+
+// --- ISR -> CONTROL TASK HANDOFF ---
+// The ISRs only bump counters and stamp times; the control task compares the
+// counters with the ones it has already handled. 32-bit stores are atomic here.
+static volatile uint32_t edgeCount = 0;
+static volatile uint32_t alertCount = 0;
+static volatile unsigned long edgeMicros = 0;
+static volatile unsigned long edgeToGpioMicros = 0;
+static volatile bool gpio13Preswitched = false;
+static volatile uint8_t gpio13BeforeEdge = HIGH;
+
+// --- CONTROL TASK STATE ---
+static uint32_t handledEdges = 0;
+static uint32_t handledAlerts = 0;
+static bool confirmPending = false;
+static uint32_t falseAlarmCount = 0;
+static unsigned long lastGpioMicros = 0;
+static unsigned long worstGpioMicros = 0;
+static unsigned long lastHandoffMicros = 0;
+
+static void IRAM_ATTR onPowerDetectEdge() {
+  if (digitalRead(POWER_DETECT_PIN) != POWER_CUT_STATE) return; // Bounce back to normal
+  if (powerCutDetected) return;                                 // Already handling a cut
+
+  unsigned long now = micros();
+  if (!gpio13Preswitched) {
+    gpio13BeforeEdge = digitalRead(LED2_PIN);
+    digitalWrite(LED2_PIN, LOW); // Turn System ON without waiting for any task
+    gpio13Preswitched = true;
+    edgeToGpioMicros = micros() - now;
+  }
+  edgeMicros = now;
+  edgeCount++;
+
+  BaseType_t higherPriorityWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(controlTaskHandle, &higherPriorityWoken);
+  if (higherPriorityWoken) portYIELD_FROM_ISR();
+}
+
+static void IRAM_ATTR onInaAlert() {
+  alertCount++;
+  BaseType_t higherPriorityWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(controlTaskHandle, &higherPriorityWoken);
+  if (higherPriorityWoken) portYIELD_FROM_ISR();
+}
+
+void setupPowerDetect(TaskHandle_t controlTask) {
+  controlTaskHandle = controlTask;
+
+  // Pulled up so an unconnected pin never reads as a cut
+  pinMode(POWER_DETECT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(POWER_DETECT_PIN), onPowerDetectEdge,
+                  POWER_CUT_STATE == LOW ? FALLING : RISING);
+
+  // INA3221 alert outputs are open drain, active LOW
+  INA.setCriticalCurrent(INA_ALERT_CHANNEL, INA_CRITICAL_CURRENT_MA);
+  INA.setWarningCurrent(INA_ALERT_CHANNEL, INA_WARNING_CURRENT_MA);
+  pinMode(INA_CRITICAL_PIN, INPUT_PULLUP);
+  pinMode(INA_WARNING_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(INA_CRITICAL_PIN), onInaAlert, FALLING);
+  attachInterrupt(digitalPinToInterrupt(INA_WARNING_PIN), onInaAlert, FALLING);
+}
+
+bool powerDetectPinCut() {
+  return digitalRead(POWER_DETECT_PIN) == POWER_CUT_STATE;
+}
+
+bool powerDetectConfirmPending() {
+  return confirmPending || edgeCount != handledEdges;
+}
+
+bool powerDetectConfirmCut() {
+  if (edgeCount != handledEdges) {
+    handledEdges = edgeCount;
+    confirmPending = true;
+    lastHandoffMicros = micros() - edgeMicros;
+  }
+  if (!confirmPending) return false;
+  if (micros() - edgeMicros < POWER_DETECT_DEBOUNCE_MS * 1000UL) return false;
+  confirmPending = false;
+
+  if (powerDetectPinCut()) {
+    lastGpioMicros = edgeToGpioMicros;
+    if (lastGpioMicros > worstGpioMicros) worstGpioMicros = lastGpioMicros;
+    gpio13Preswitched = false;
+    return true;
+  }
+
+  // The edge did not last: put GPIO13 back the way it was
+  falseAlarmCount++;
+  if (gpio13Preswitched && !powerCutDetected) {
+    digitalWrite(LED2_PIN, gpio13BeforeEdge);
+  }
+  gpio13Preswitched = false;
+  return false;
+}
+
+bool powerDetectTakeAlert() {
+  if (alertCount == handledAlerts) return false;
+  handledAlerts = alertCount;
+  return true;
+}
+
+PowerDetectStats powerDetectStats() {
+  PowerDetectStats stats;
+  stats.edges = edgeCount;
+  stats.alerts = alertCount;
+  stats.falseAlarms = falseAlarmCount;
+  stats.lastGpioMicros = lastGpioMicros;
+  stats.worstGpioMicros = worstGpioMicros;
+  stats.lastHandoffMicros = lastHandoffMicros;
+  return stats;
+}
@@ -0,0 +1,119 @@
+#include "reading_snapshot.h"
+#include "config.h"
+#include "globals.h"
+#include "hal.h"
+#include "text_buffer.h"
+#include "control_state.h"
+#include <atomic>
+
+// --- SEQLOCK ---
+// The snapshot lives in 32-bit atomic words, so a reader racing the writer
+// copies stale or new words, never undefined ones; the sequence tells which.
+// Odd while a write is in progress.
+static const size_t SNAPSHOT_WORDS = sizeof(ReadingSnapshot) / sizeof(uint32_t);
+static_assert(sizeof(ReadingSnapshot) % sizeof(uint32_t) == 0, "ReadingSnapshot must be whole words");
+
+static std::atomic<uint32_t> sequence{0};
+static std::atomic<uint32_t> words[SNAPSHOT_WORDS];
+
+static std::atomic<uint32_t> writes{0};
+static std::atomic<uint32_t> reads{0};
+static std::atomic<uint32_t> retries{0};
+
+// --- REQUESTS (network task) ---
+static bool requestPending = false;
+static uint32_t requestSequence = 0; // Snapshot sequence when the resample was asked for
+static bool resampling = false;
+static unsigned long resampleTime = 0;
+static uint32_t resamples = 0;
+
+void snapshotPublish(const ReadingSnapshot& snapshot) {
+  uint32_t raw[SNAPSHOT_WORDS];
+  memcpy(raw, &snapshot, sizeof(raw));
+
+  uint32_t seq = sequence.load(std::memory_order_relaxed);
+  sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release); // The odd sequence is seen before any new word
+  for (size_t i = 0; i < SNAPSHOT_WORDS; i++) words[i].store(raw[i], std::memory_order_relaxed);
+  sequence.store(seq + 2, std::memory_order_release);
+  writes.store(writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool snapshotRead(ReadingSnapshot& snapshot) {
+  uint32_t raw[SNAPSHOT_WORDS];
+  for (;;) {
+    uint32_t before = sequence.load(std::memory_order_acquire);
+    if (before == 0) return false;
+    if (!(before & 1)) {
+      for (size_t i = 0; i < SNAPSHOT_WORDS; i++) raw[i] = words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire); // Words read before the sequence is checked again
+      if (sequence.load(std::memory_order_relaxed) == before) break;
+    }
+    retries.fetch_add(1, std::memory_order_relaxed); // A write takes well under a microsecond
+  }
+  memcpy(&snapshot, raw, sizeof(raw));
+  reads.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+uint32_t snapshotAge(const ReadingSnapshot& snapshot) {
+  return (uint32_t)halMillis() - snapshot.timestamp;
+}
+
+static const char* onOff(bool on) {
+  return on ? "\"ON\"" : "\"OFF\"";
+}
+
+void snapshotFormat(const ReadingSnapshot& snapshot, TextBuffer& out) {
+  out.appendf("{\"seq\":%lu,\"age_ms\":%lu,", (unsigned long)snapshot.sequence, (unsigned long)snapshotAge(snapshot));
+  out.appendf("\"v1\":%.3f,\"c1\":%.2f,\"p1\":%.2f,\"v2\":%.3f,\"c2\":%.2f,\"p2\":%.2f,\"intensity\":%.1f,",
+    snapshot.v1, snapshot.c1, snapshot.p1, snapshot.v2, snapshot.c2, snapshot.p2, snapshot.intensity);
+  // Active LOW: system, GPIO14 and the emergency light are ON when their pin is LOW
+  out.appendf("\"led\":%s,\"system\":%s,\"gpio14\":%s,\"light\":%s,\"power_cut\":%s,\"emergency\":%s}",
+    onOff(snapshot.outputs & CONTROL_OUT_LED), onOff(!(snapshot.outputs & CONTROL_OUT_SYSTEM)),
+    onOff(!(snapshot.outputs & CONTROL_OUT_GPIO14)), onOff(!(snapshot.outputs & CONTROL_OUT_LIGHT)),
+    snapshot.powerCut ? "true" : "false", snapshot.emergencyMode ? "true" : "false");
+}
+
+void snapshotRequestResample() {
+  unsigned long now = halMillis();
+  if (resampling && now - resampleTime < SNAPSHOT_RESAMPLE_TIMEOUT) return;
+
+  ReadingSnapshot snapshot;
+  requestSequence = snapshotRead(snapshot) ? snapshot.sequence : 0;
+  ControlCommand cmd = { CMD_RESAMPLE, ACTION_NONE };
+  if (!commandQueue.push(cmd)) Serial.println("ERROR: Command queue full, resample dropped");
+  resampling = true;
+  resampleTime = now;
+  resamples++;
+}
+
+void snapshotRequest() {
+  requestPending = true;
+}
+
+bool snapshotAnswerReady(ReadingSnapshot& snapshot) {
+  if (!requestPending) return false;
+  bool have = snapshotRead(snapshot);
+  if (have && snapshotAge(snapshot) <= SNAPSHOT_MAX_AGE) {
+    resampling = false;
+  } else if (!resampling) {
+    snapshotRequestResample();
+    return false;
+  } else if ((!have || snapshot.sequence == requestSequence) && halMillis() - resampleTime < SNAPSHOT_RESAMPLE_TIMEOUT) {
+    return false; // Still waiting for the fresh reading
+  } else {
+    resampling = false;
+  }
+  requestPending = false;
+  return have; // Timed out: the old snapshot, with its age
+}
+
+SnapshotStats snapshotStats() {
+  SnapshotStats stats;
+  stats.writes = writes.load(std::memory_order_relaxed);
+  stats.reads = reads.load(std::memory_order_relaxed);
+  stats.retries = retries.load(std::memory_order_relaxed);
+  stats.resamples = resamples;
+  return stats;
+}
@@ -0,0 +1,84 @@
+#include "report_filter.h"
+#include "config.h"
+
+struct ReportSignal {
+  const char* const* topic; // Topic strings are set up at startup, so keep a reference
+  const char* format;       // Same widths the text topics always used
+  float deadband;           // Absolute change that always counts
+  float lastSent;
+  unsigned long lastSentMillis;
+  bool everSent;
+  ReportCounters counters;
+};
+
+static ReportSignal signals[] = {
+  { &mqtt_light_intensity_topic, "%5.1f", REPORT_DEADBAND_INTENSITY, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor_voltage_topic, "%5.3f", REPORT_DEADBAND_VOLTS, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor_current_topic, "%6.2f", REPORT_DEADBAND_MILLIAMPS, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor_power_topic, "%6.2f", REPORT_DEADBAND_MILLIWATTS, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor2_voltage_topic, "%5.3f", REPORT_DEADBAND_VOLTS, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor2_current_topic, "%6.2f", REPORT_DEADBAND_MILLIAMPS, 0, 0, false, { 0, 0 } },
+  { &mqtt_sensor2_power_topic, "%6.2f", REPORT_DEADBAND_MILLIWATTS, 0, 0, false, { 0, 0 } },
+};
+static const int SIGNAL_COUNT = sizeof(signals) / sizeof(signals[0]);
+
+static bool shouldSend(const ReportSignal& signal, float value, unsigned long nowMs) {
+  if (!signal.everSent) return true;
+  if (nowMs - signal.lastSentMillis >= REPORT_HEARTBEAT_MS) return true;
+
+  float change = fabsf(value - signal.lastSent);
+  if (change > signal.deadband) return true;
+  // Near zero any noise is a large percentage: there only the deadband counts
+  float magnitude = fabsf(signal.lastSent);
+  if (magnitude < signal.deadband * REPORT_PERCENT_MIN_DEADBANDS) return false;
+  return change * 100.0f > magnitude * REPORT_PERCENT_CHANGE;
+}
+
+int reportSampleText(const SensorSample& sample, ReportPublishFn publish) {
+  // Same order as the signals table
+  const float values[] = { sample.intensity, sample.v1, sample.c1, sample.p1, sample.v2, sample.c2, sample.p2 };
+  static_assert(sizeof(values) / sizeof(values[0]) == sizeof(signals) / sizeof(signals[0]),
+                "One value per report signal");
+
+  int sent = 0;
+  for (int i = 0; i < SIGNAL_COUNT; i++) {
+    ReportSignal& signal = signals[i];
+    if (!shouldSend(signal, values[i], sample.timestamp)) {
+      signal.counters.suppressed++;
+      continue;
+    }
+
+    char payload[16];
+    snprintf(payload, sizeof(payload), signal.format, values[i]);
+    if (!publish(*signal.topic, payload)) continue; // Not sent: try again next sample
+
+    signal.lastSent = values[i];
+    signal.lastSentMillis = sample.timestamp;
+    signal.everSent = true;
+    signal.counters.sent++;
+    sent++;
+  }
+  return sent;
+}
+
+void reportForceAll() {
+  for (int i = 0; i < SIGNAL_COUNT; i++) signals[i].everSent = false;
+}
+
+ReportCounters reportTotals() {
+  ReportCounters totals = { 0, 0 };
+  for (int i = 0; i < SIGNAL_COUNT; i++) {
+    totals.sent += signals[i].counters.sent;
+    totals.suppressed += signals[i].counters.suppressed;
+  }
+  return totals;
+}
+
+void reportFormatStats(TextBuffer& out) {
+  out.append("{");
+  for (int i = 0; i < SIGNAL_COUNT; i++) {
+    out.appendf("%s\"%s\":[%lu,%lu]", i == 0 ? "" : ",", *signals[i].topic,
+      (unsigned long)signals[i].counters.sent, (unsigned long)signals[i].counters.suppressed);
+  }
+  out.append("}");
+}
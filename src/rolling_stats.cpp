@@ -0,0 +1,120 @@
+#include "rolling_stats.h"
+#include "config.h"
+#include "spsc_queue.h"
+
+// Fixed-point scale per quantity: mV, 0.01 mA, 0.1 mW. A 60 s window at 1 kHz of
+// full-scale INA3221 values keeps every sum of squares well inside int64_t.
+static const float STATS_SCALE[STATS_QUANTITIES] = { 1000.0f, 100.0f, 10.0f };
+
+struct WindowAccumulator {
+  uint32_t count;
+  unsigned long startMillis; // First and last sample in the window
+  unsigned long lastMillis;
+  int32_t min[POWER_CHANNELS][STATS_QUANTITIES];
+  int32_t max[POWER_CHANNELS][STATS_QUANTITIES];
+  int64_t sum[POWER_CHANNELS][STATS_QUANTITIES];
+  int64_t sumSquares[POWER_CHANNELS][STATS_QUANTITIES];
+};
+
+static WindowAccumulator windows[STATS_WINDOW_COUNT];
+static SpscQueue<StatsAggregate, AGGREGATE_QUEUE_SIZE> aggregateQueue; // sampler -> network
+
+static void clearWindow(WindowAccumulator& window) {
+  window.count = 0;
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    for (int q = 0; q < STATS_QUANTITIES; q++) {
+      window.min[ch][q] = INT32_MAX;
+      window.max[ch][q] = INT32_MIN;
+      window.sum[ch][q] = 0;
+      window.sumSquares[ch][q] = 0;
+    }
+  }
+}
+
+void statsReset() {
+  for (size_t w = 0; w < STATS_WINDOW_COUNT; w++) clearWindow(windows[w]);
+}
+
+// Runs once per closed window, so the float math here is off the per-sample path
+static void closeWindow(size_t w) {
+  WindowAccumulator& window = windows[w];
+  StatsAggregate aggregate;
+  aggregate.windowMs = STATS_WINDOWS_MS[w];
+  aggregate.startMillis = window.startMillis;
+  aggregate.endMillis = window.lastMillis;
+  aggregate.samples = window.count;
+
+  double n = window.count;
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    for (int q = 0; q < STATS_QUANTITIES; q++) {
+      double scale = STATS_SCALE[q];
+      double mean = window.sum[ch][q] / n;
+      double meanSquare = window.sumSquares[ch][q] / n;
+      double variance = meanSquare - mean * mean;
+
+      StatsSummary& summary = aggregate.channel[ch][q];
+      summary.min = window.min[ch][q] / scale;
+      summary.max = window.max[ch][q] / scale;
+      summary.mean = mean / scale;
+      summary.rms = sqrt(meanSquare) / scale;
+      summary.stddev = variance > 0 ? sqrt(variance) / scale : 0;
+    }
+  }
+
+  aggregateQueue.push(aggregate); // Counted by the ring if the network task is stalled
+  clearWindow(window);
+}
+
+void statsAddSample(const float* voltage, const float* current, const float* power, unsigned long nowMs) {
+  int32_t fixed[POWER_CHANNELS][STATS_QUANTITIES];
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    fixed[ch][STAT_VOLTAGE] = lroundf(voltage[ch] * STATS_SCALE[STAT_VOLTAGE]);
+    fixed[ch][STAT_CURRENT] = lroundf(current[ch] * STATS_SCALE[STAT_CURRENT]);
+    fixed[ch][STAT_POWER] = lroundf(power[ch] * STATS_SCALE[STAT_POWER]);
+  }
+
+  for (size_t w = 0; w < STATS_WINDOW_COUNT; w++) {
+    WindowAccumulator& window = windows[w];
+    // Closed on the sample clock, not on a sample count: skipped ticks and bus
+    // errors leave the window short of samples instead of stretching it
+    if (window.count > 0 && nowMs - window.startMillis >= STATS_WINDOWS_MS[w]) closeWindow(w);
+    if (window.count == 0) window.startMillis = nowMs;
+    for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+      for (int q = 0; q < STATS_QUANTITIES; q++) {
+        int32_t value = fixed[ch][q];
+        if (value < window.min[ch][q]) window.min[ch][q] = value;
+        if (value > window.max[ch][q]) window.max[ch][q] = value;
+        window.sum[ch][q] += value;
+        window.sumSquares[ch][q] += (int64_t)value * value;
+      }
+    }
+    window.lastMillis = nowMs;
+    window.count++;
+  }
+}
+
+bool statsNextAggregate(StatsAggregate& aggregate) {
+  return aggregateQueue.pop(aggregate);
+}
+
+uint32_t statsDroppedAggregates() {
+  return aggregateQueue.dropped();
+}
+
+void statsFormatAggregate(const StatsAggregate& aggregate, uint32_t epochSeconds, TextBuffer& out) {
+  static const char* const KEYS[STATS_QUANTITIES] = { "v", "i", "p" };
+
+  out.appendf("{\"window_ms\":%lu,\"start_ms\":%lu,\"uptime_ms\":%lu,\"epoch\":%lu,\"samples\":%lu,\"channels\":[",
+    (unsigned long)aggregate.windowMs, aggregate.startMillis, aggregate.endMillis, (unsigned long)epochSeconds,
+    (unsigned long)aggregate.samples);
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    out.append(ch == 0 ? "{" : ",{");
+    for (int q = 0; q < STATS_QUANTITIES; q++) {
+      const StatsSummary& summary = aggregate.channel[ch][q];
+      out.appendf("%s\"%s\":[%.3f,%.3f,%.3f,%.3f,%.3f]", q == 0 ? "" : ",", KEYS[q],
+        summary.min, summary.max, summary.mean, summary.rms, summary.stddev);
+    }
+    out.append("}");
+  }
+  out.append("]}");
+}
@@ -0,0 +1,196 @@
+#include "sampler.h"
+#include "config.h"
+#include "globals.h"
+#include "hal.h"
+#include "rolling_stats.h"
+#include "diagnostics.h"
+#include <atomic>
+
+static SpscQueue<PowerReading, READING_QUEUE_SIZE> readingQueue; // sampler -> control task
+
+// Flush request from the control task: bit 8 = pending, low byte = flags
+static std::atomic<uint16_t> flushRequest(0);
+const uint16_t FLUSH_PENDING = 0x100;
+
+// --- STATS (written by the sampler, read by the loop report) ---
+static volatile uint32_t sampleCount = 0;
+static volatile uint32_t overrunCount = 0;
+static volatile uint32_t readErrorCount = 0;
+static volatile unsigned long worstSampleMicros = 0;
+static volatile unsigned long worstJitterMicros = 0; // |tick interval - period|, since the last reset
+static volatile unsigned long markJitterMicros = 0;  // Same, since samplerMarkJitter()
+static volatile unsigned long totalSampleMicros = 0;
+static volatile uint32_t statSamples = 0;
+
+// --- WINDOW ACCUMULATORS (sampler task only) ---
+static PowerReading window;
+static double sumVoltage[POWER_CHANNELS];
+static double sumCurrent[POWER_CHANNELS];
+static double sumPower[POWER_CHANNELS];
+static double windowEnergy[POWER_CHANNELS];
+static float lastPower[POWER_CHANNELS];
+static unsigned long lastSampleMicros = 0;
+static unsigned long lastTickMicros = 0;
+static unsigned long windowStart = 0;
+static bool havePrevious = false;
+
+// --- INA3221 CONVERSION SETUP ---
+// Index -> value tables from the INA3221 datasheet (AVG and VBUSCT/VSHCT fields)
+static const uint16_t AVERAGE_COUNTS[8] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+static const uint16_t CONVERSION_MICROS[8] = { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+
+// Picks the most filtering that still finishes a full 3-channel shunt+bus cycle
+// within one sample period, so every tick reads a fresh conversion.
+static void configureConversion(uint32_t rateHz) {
+  uint32_t periodMicros = 1000000UL / rateHz;
+  int bestAverage = 0, bestConversion = 0;
+  uint32_t bestWindow = 0;
+
+  for (int a = 0; a < 8; a++) {
+    for (int c = 0; c < 8; c++) {
+      uint32_t cycle = 3UL * 2UL * CONVERSION_MICROS[c] * AVERAGE_COUNTS[a];
+      uint32_t window = CONVERSION_MICROS[c] * AVERAGE_COUNTS[a];
+      if (cycle <= periodMicros && window > bestWindow) {
+        bestWindow = window;
+        bestAverage = a;
+        bestConversion = c;
+      }
+    }
+  }
+
+  halSensorConfigure(bestAverage, bestConversion);
+  Serial.printf("INA3221: %lu Hz, avg x%u, %u us conversions\n",
+    (unsigned long)rateHz, AVERAGE_COUNTS[bestAverage], CONVERSION_MICROS[bestConversion]);
+}
+
+static void samplerTick(uint32_t missed) {
+  const unsigned long periodMicros = 1000000UL / SAMPLE_RATE_HZ;
+  overrunCount += missed;
+
+  unsigned long start = halMicros();
+
+  // Timer jitter: flash erases (OTA, LittleFS) turn the cache off on both cores
+  if (lastTickMicros != 0) {
+    unsigned long interval = start - lastTickMicros;
+    unsigned long jitter = interval > periodMicros ? interval - periodMicros : periodMicros - interval;
+    if (jitter > worstJitterMicros) worstJitterMicros = jitter;
+    if (jitter > markJitterMicros) markJitterMicros = jitter;
+  }
+  lastTickMicros = start;
+
+  SensorScan scan;
+  uint32_t readStart = halCycleCount();
+  bool read = halSensorScan(scan);
+  diagRecord(DIAG_SAMPLER_READ, readStart);
+  if (!read) { // Bus error: this tick is skipped, the energy integral bridges it
+    readErrorCount++;
+    return;
+  }
+  diagMilestone(DIAG_BOOT_FIRST_SAMPLE);
+
+  float voltage[POWER_CHANNELS], current[POWER_CHANNELS], power[POWER_CHANNELS];
+  for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+    float v = scan.busMillivolts[ch] / 1000.0f;
+    float c = abs(scan.currentMicroamps[ch]) / 1000.0f; // Force Positive Current (mA)
+    float p = v * c;                                      // mW
+    voltage[ch] = v;
+    current[ch] = c;
+    power[ch] = p;
+
+    // Trapezoidal rule between this sample and the previous one
+    if (havePrevious) {
+      double hours = (start - lastSampleMicros) / 3600000000.0;
+      windowEnergy[ch] += 0.5 * (lastPower[ch] + p) * hours;
+    }
+    lastPower[ch] = p;
+
+    sumVoltage[ch] += v;
+    sumCurrent[ch] += c;
+    sumPower[ch] += p;
+    window.lastVoltage[ch] = v;
+  }
+  lastSampleMicros = start;
+  havePrevious = true;
+  window.count++;
+  sampleCount++;
+
+  // --- DECIMATE TO PUBLISH RATE ---
+  unsigned long now = halMillis();
+  statsAddSample(voltage, current, power, now);
+  uint16_t request = flushRequest.exchange(0);
+  if ((request & FLUSH_PENDING) || now - windowStart >= SENSOR_READ_INTERVAL) {
+    window.timestamp = now;
+    window.flags = request & 0xFF;
+    for (int ch = 0; ch < POWER_CHANNELS; ch++) {
+      window.voltage[ch] = sumVoltage[ch] / window.count;
+      window.current[ch] = sumCurrent[ch] / window.count;
+      window.power[ch] = sumPower[ch] / window.count;
+      window.energy[ch] = windowEnergy[ch];
+      sumVoltage[ch] = sumCurrent[ch] = sumPower[ch] = windowEnergy[ch] = 0;
+    }
+    readingQueue.push(window);
+    window.count = 0;
+    windowStart = now;
+  }
+
+  unsigned long cost = halMicros() - start;
+  if (cost > worstSampleMicros) worstSampleMicros = cost;
+  totalSampleMicros += cost;
+  statSamples++;
+}
+
+void startSampler() {
+  configureConversion(SAMPLE_RATE_HZ);
+  statsReset();
+
+  // Power-on state; the native build restarts the sampler on every simReset()
+  memset(&window, 0, sizeof(window));
+  memset(sumVoltage, 0, sizeof(sumVoltage));
+  memset(sumCurrent, 0, sizeof(sumCurrent));
+  memset(sumPower, 0, sizeof(sumPower));
+  memset(windowEnergy, 0, sizeof(windowEnergy));
+  memset(lastPower, 0, sizeof(lastPower));
+  lastSampleMicros = lastTickMicros = 0;
+  windowStart = halMillis();
+  havePrevious = false;
+  flushRequest = 0;
+  sampleCount = 0;
+  overrunCount = 0;
+  readErrorCount = 0;
+  samplerResetStats();
+  samplerMarkJitter();
+
+  diagRegisterTask("sampler", halSampleTimerStart(1000000UL / SAMPLE_RATE_HZ, samplerTick));
+}
+
+bool samplerNextReading(PowerReading& reading) {
+  return readingQueue.pop(reading);
+}
+
+void samplerRequestFlush(uint8_t flags) {
+  flushRequest.fetch_or(FLUSH_PENDING | flags); // Flags of a request not yet taken are kept
+}
+
+SamplerStats samplerStats() {
+  SamplerStats stats;
+  stats.rateHz = SAMPLE_RATE_HZ;
+  stats.samples = sampleCount;
+  stats.overruns = overrunCount;
+  stats.readErrors = readErrorCount;
+  stats.worstMicros = worstSampleMicros;
+  stats.averageMicros = statSamples > 0 ? totalSampleMicros / statSamples : 0;
+  stats.worstJitterMicros = worstJitterMicros;
+  stats.markJitterMicros = markJitterMicros;
+  return stats;
+}
+
+void samplerResetStats() {
+  worstSampleMicros = 0;
+  worstJitterMicros = 0;
+  totalSampleMicros = 0;
+  statSamples = 0;
+}
+
+void samplerMarkJitter() {
+  markJitterMicros = 0;
+}
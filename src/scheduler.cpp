@@ -0,0 +1,147 @@
+#include "scheduler.h"
+#include "hal.h"
+
+struct SchedulerTask {
+  const char* name;
+  TaskCallback callback;
+  uint32_t interval;
+  uint32_t nextRun; // 32-bit like millis() on the board, so the host build wraps the same way
+  bool oneShot;
+  bool inUse;
+};
+
+static SchedulerTask tasks[MAX_SCHEDULER_TASKS];
+
+// Slots of the active tasks, sorted by nextRun (earliest first)
+static int queue[MAX_SCHEDULER_TASKS];
+static int queueLength = 0;
+
+// --- LOOP LATENCY STATS ---
+static unsigned long worstLoopMicros = 0;
+static unsigned long totalLoopMicros = 0;
+static unsigned long loopCount = 0;
+static const char* worstTaskName = "none";
+static const char* volatile runningTaskName = NULL; // Read by the stall monitor on this core
+
+// millis() wraps after ~49 days, so deadlines are compared by signed difference.
+// That only holds while they stay within 2^31 ms (~24.8 days) of now.
+static bool isBefore(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static void enqueue(int slot) {
+  int pos = queueLength;
+  while (pos > 0 && isBefore(tasks[slot].nextRun, tasks[queue[pos - 1]].nextRun)) {
+    queue[pos] = queue[pos - 1];
+    pos--;
+  }
+  queue[pos] = slot;
+  queueLength++;
+}
+
+static int allocateTask(const char* name, TaskCallback callback, unsigned long intervalMs, bool oneShot) {
+  for (int i = 0; i < MAX_SCHEDULER_TASKS; i++) {
+    if (!tasks[i].inUse) {
+      tasks[i].name = name;
+      tasks[i].callback = callback;
+      tasks[i].interval = intervalMs;
+      tasks[i].nextRun = (uint32_t)halMillis() + (oneShot ? intervalMs : 0);
+      tasks[i].oneShot = oneShot;
+      tasks[i].inUse = true;
+      enqueue(i);
+      return i;
+    }
+  }
+  Serial.printf("ERROR: Scheduler full, cannot add task '%s'\n", name);
+  return -1;
+}
+
+int schedulerAddTask(const char* name, TaskCallback callback, unsigned long intervalMs) {
+  return allocateTask(name, callback, intervalMs, false);
+}
+
+int schedulerAddTimer(const char* name, TaskCallback callback, unsigned long delayMs) {
+  return allocateTask(name, callback, delayMs, true);
+}
+
+void schedulerRun() {
+  unsigned long passStart = halMicros();
+  uint32_t now = (uint32_t)halMillis();
+
+  // 1. Pop every task that is due. The queue is sorted, so we stop at the first
+  //    task that is still in the future.
+  int due[MAX_SCHEDULER_TASKS];
+  int dueCount = 0;
+  while (queueLength > 0 && !isBefore(now, tasks[queue[0]].nextRun)) {
+    due[dueCount++] = queue[0];
+    queueLength--;
+    for (int i = 0; i < queueLength; i++) queue[i] = queue[i + 1];
+  }
+
+  // 2. Run them in deadline order and put periodic tasks back in the queue
+  const char* slowestName = "none";
+  unsigned long slowestMicros = 0;
+
+  for (int i = 0; i < dueCount; i++) {
+    SchedulerTask& task = tasks[due[i]];
+
+    unsigned long taskStart = halMicros();
+    runningTaskName = task.name;
+    task.callback();
+    runningTaskName = NULL;
+    unsigned long taskTime = halMicros() - taskStart;
+
+    if (taskTime > slowestMicros) {
+      slowestMicros = taskTime;
+      slowestName = task.name;
+    }
+
+    if (task.oneShot) {
+      task.inUse = false;
+      continue;
+    }
+
+    // Fixed-rate schedule; if we fell a whole period behind, skip ahead instead of
+    // bursting. An every-pass task (interval 0) is due again now: left at its
+    // registration time it would read as ~24.8 days in the future once uptime
+    // passes 2^31 ms, and stall the whole queue behind it.
+    task.nextRun += task.interval;
+    if (!isBefore(now, task.nextRun)) {
+      task.nextRun = now + task.interval;
+    }
+    enqueue(due[i]);
+  }
+
+  // 3. Loop latency bookkeeping
+  unsigned long passTime = halMicros() - passStart;
+  totalLoopMicros += passTime;
+  loopCount++;
+  if (passTime > worstLoopMicros) {
+    worstLoopMicros = passTime;
+    worstTaskName = slowestName;
+  }
+}
+
+unsigned long schedulerWorstLoopMicros() {
+  return worstLoopMicros;
+}
+
+unsigned long schedulerAverageLoopMicros() {
+  return loopCount > 0 ? totalLoopMicros / loopCount : 0;
+}
+
+const char* schedulerWorstTaskName() {
+  return worstTaskName;
+}
+
+const char* schedulerRunningTaskName() {
+  const char* name = runningTaskName;
+  return name != NULL ? name : "scheduler";
+}
+
+void schedulerResetStats() {
+  worstLoopMicros = 0;
+  totalLoopMicros = 0;
+  loopCount = 0;
+  worstTaskName = "none";
+}
@@ -0,0 +1,221 @@
+#include "stall_monitor.h"
+#include <esp_debug_helpers.h>
+#include <freertos/task_snapshot.h>
+#include <freertos/xtensa_context.h>
+
+static const uint32_t STALL_RING_MAGIC = 0x5354414C; // "STAL"
+
+// --- RTC RING ---
+// RTC_NOINIT memory is left alone by a software/watchdog reset, so the magic and
+// bounds are checked at boot instead of zeroing it.
+struct StallRecord {
+  uint32_t boot;     // Boot number the event happened in
+  uint32_t sequence; // Matches the event to the pass that is still running
+  uint32_t startMillis;
+  uint32_t stallMillis;
+  uint32_t budgetMillis;
+  uint8_t ended;
+  uint8_t depth;
+  char task[12];
+  char tag[16];
+  uint32_t pcs[STALL_BACKTRACE_DEPTH];
+};
+
+struct StallRing {
+  uint32_t magic;
+  uint32_t boot;
+  uint32_t head;  // Oldest record
+  uint32_t count;
+  StallRecord records[STALL_RING_SIZE];
+};
+
+RTC_NOINIT_ATTR static StallRing ring;
+static portMUX_TYPE ringLock = portMUX_INITIALIZER_UNLOCKED; // Monitors on both cores + the watched tasks
+
+struct StallWatchState {
+  const char* name;
+  TaskHandle_t task;
+  uint32_t budgetMillis;
+  StallTagFn tagFn;
+  int core;
+  volatile uint32_t passStart;
+  volatile bool busy;
+  const char* volatile tag;
+  volatile bool captured; // One event per pass
+  volatile uint32_t slot;
+  volatile uint32_t sequence;
+};
+
+static StallWatchState watches[STALL_WATCH_COUNT];
+static uint32_t nextSequence = 0;
+static volatile uint32_t capturedCount = 0;
+
+void setupStallMonitor() {
+  if (ring.magic != STALL_RING_MAGIC || ring.head >= STALL_RING_SIZE || ring.count > STALL_RING_SIZE) {
+    memset(&ring, 0, sizeof(ring)); // Power-on: RTC memory holds garbage
+    ring.magic = STALL_RING_MAGIC;
+  }
+  ring.boot++;
+  if (ring.count > 0) {
+    Serial.printf("Stall profiler: %lu event(s) from before the reset\n", (unsigned long)ring.count);
+  }
+}
+
+void stallWatch(StallWatchId id, const char* name, TaskHandle_t task, uint32_t budgetMillis, StallTagFn tagFn) {
+  StallWatchState& watch = watches[id];
+  watch.name = name;
+  watch.budgetMillis = budgetMillis;
+  watch.tagFn = tagFn;
+  watch.core = xTaskGetAffinity(task);
+  watch.busy = false;
+  watch.task = task; // Last: the monitor skips watches without a task
+}
+
+void stallPassBegin(StallWatchId id, const char* tag) {
+  StallWatchState& watch = watches[id];
+  watch.passStart = millis();
+  watch.tag = tag;
+  watch.captured = false;
+  watch.busy = true;
+}
+
+void stallPassEnd(StallWatchId id) {
+  StallWatchState& watch = watches[id];
+  watch.busy = false;
+  if (!watch.captured) return;
+
+  // Fill in how long the stall really lasted
+  portENTER_CRITICAL(&ringLock);
+  StallRecord& record = ring.records[watch.slot];
+  if (record.boot == ring.boot && record.sequence == watch.sequence) {
+    record.stallMillis = millis() - watch.passStart;
+    record.ended = 1;
+  }
+  portEXIT_CRITICAL(&ringLock);
+}
+
+// Windowed-ABI return addresses carry the call size in the top bits
+static uint32_t stackPc(uint32_t pc) {
+  if (pc & 0x80000000) pc = (pc & 0x3fffffff) | 0x40000000;
+  return pc - 3; // Point at the call, not the return address
+}
+
+// Walks the saved context of a task that is not running right now
+static uint8_t captureBacktrace(TaskHandle_t task, uint32_t* pcs) {
+  TaskSnapshot_t snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  vTaskGetSnapshot(task, &snapshot);
+  if (snapshot.pxTopOfStack == NULL) return 0;
+
+  esp_backtrace_frame_t frame;
+  memset(&frame, 0, sizeof(frame));
+  const XtExcFrame* exception = (const XtExcFrame*)snapshot.pxTopOfStack;
+  if (exception->exit != 0) { // Preempted by an interrupt: full exception frame
+    frame.pc = exception->pc;
+    frame.sp = exception->a1;
+    frame.next_pc = exception->a0;
+  } else {                    // Yielded or blocked: solicited frame
+    const XtSolFrame* solicited = (const XtSolFrame*)snapshot.pxTopOfStack;
+    frame.pc = solicited->pc;
+    frame.sp = solicited->a1;
+    frame.next_pc = solicited->a0;
+  }
+
+  uint8_t depth = 0;
+  pcs[depth++] = frame.pc; // Where the task is now, not a return address
+  while (depth < STALL_BACKTRACE_DEPTH && frame.next_pc != 0 && esp_backtrace_get_next_frame(&frame)) {
+    pcs[depth++] = stackPc(frame.pc);
+  }
+  return depth;
+}
+
+static void capture(StallWatchState& watch, uint32_t elapsed) {
+  StallRecord record;
+  memset(&record, 0, sizeof(record));
+  record.startMillis = watch.passStart;
+  record.stallMillis = elapsed;
+  record.budgetMillis = watch.budgetMillis;
+  strlcpy(record.task, watch.name, sizeof(record.task));
+  const char* tag = watch.tagFn != NULL ? watch.tagFn() : watch.tag;
+  strlcpy(record.tag, tag != NULL ? tag : "-", sizeof(record.tag));
+  record.depth = captureBacktrace(watch.task, record.pcs);
+
+  portENTER_CRITICAL(&ringLock);
+  if (ring.count == STALL_RING_SIZE) { // Full: the oldest event makes room
+    ring.head = (ring.head + 1) % STALL_RING_SIZE;
+    ring.count--;
+  }
+  uint32_t slot = (ring.head + ring.count) % STALL_RING_SIZE;
+  record.boot = ring.boot;
+  record.sequence = ++nextSequence;
+  ring.records[slot] = record;
+  ring.count++;
+  portEXIT_CRITICAL(&ringLock);
+
+  watch.slot = slot;
+  watch.sequence = record.sequence;
+  watch.captured = true;
+  capturedCount++;
+}
+
+// One per core, above every task of ours: while it runs, the watched tasks on its
+// core are suspended with their context saved on their stacks
+static void monitorTask(void* param) {
+  int core = (int)(intptr_t)param;
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(STALL_CHECK_MS));
+    uint32_t now = millis();
+
+    for (StallWatchState& watch : watches) {
+      if (watch.task == NULL || watch.core != core) continue;
+      if (!watch.busy || watch.captured) continue;
+      uint32_t elapsed = now - watch.passStart;
+      if (elapsed > watch.budgetMillis) capture(watch, elapsed);
+    }
+  }
+}
+
+void startStallMonitor() {
+  xTaskCreatePinnedToCore(monitorTask, "stallMon0", 2048, (void*)0, 5, NULL, 0);
+  xTaskCreatePinnedToCore(monitorTask, "stallMon1", 2048, (void*)1, 5, NULL, 1);
+}
+
+bool stallPeekEvent(StallEvent& event) {
+  bool found = false;
+  portENTER_CRITICAL(&ringLock);
+  if (ring.count > 0) {
+    const StallRecord& record = ring.records[ring.head];
+    // A pass still running in this boot is reported once it ends
+    if (record.ended || record.boot != ring.boot) {
+      event.bootsAgo = ring.boot - record.boot;
+      event.startMillis = record.startMillis;
+      event.stallMillis = record.stallMillis;
+      event.budgetMillis = record.budgetMillis;
+      event.ended = record.ended;
+      memcpy(event.task, record.task, sizeof(event.task));
+      memcpy(event.tag, record.tag, sizeof(event.tag));
+      event.task[sizeof(event.task) - 1] = '\0'; // From RTC memory: never trust the terminators
+      event.tag[sizeof(event.tag) - 1] = '\0';
+      event.depth = record.depth <= STALL_BACKTRACE_DEPTH ? record.depth : 0;
+      memcpy(event.pcs, record.pcs, sizeof(event.pcs));
+      found = true;
+    }
+  }
+  portEXIT_CRITICAL(&ringLock);
+  return found;
+}
+
+void stallPopEvent() {
+  portENTER_CRITICAL(&ringLock);
+  if (ring.count > 0) {
+    ring.head = (ring.head + 1) % STALL_RING_SIZE;
+    ring.count--;
+  }
+  portEXIT_CRITICAL(&ringLock);
+}
+
+uint32_t stallEventCount() {
+  return capturedCount;
+}
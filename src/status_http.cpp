@@ -0,0 +1,64 @@
+#include "status_http.h"
+#include "config.h"
+#include "reading_snapshot.h"
+#include "text_buffer.h"
+#include <WiFi.h>
+
+static WiFiServer server(STATUS_HTTP_PORT);
+static WiFiClient client;
+static char request[STATUS_HTTP_REQUEST_SIZE];
+static size_t requestLength = 0;
+static unsigned long clientSince = 0;
+
+void setupStatusHttp() {
+  server.begin();
+  server.setNoDelay(true);
+}
+
+static void respond(int code, const char* reason, const char* body) {
+  TextBuffer head;
+  head.appendf("HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\n"
+               "Cache-Control: no-store\r\nConnection: close\r\n\r\n", code, reason, (unsigned)strlen(body));
+  client.write((const uint8_t*)head.c_str(), strlen(head.c_str()));
+  client.write((const uint8_t*)body, strlen(body));
+}
+
+static void answer() {
+  if (strncmp(request, "GET /status ", 12) != 0 && strncmp(request, "GET /status?", 12) != 0) {
+    respond(404, "Not Found", "{\"error\":\"try GET /status\"}");
+    return;
+  }
+  ReadingSnapshot snapshot;
+  if (!snapshotRead(snapshot)) {
+    respond(503, "Service Unavailable", "{\"error\":\"no reading yet\"}");
+    return;
+  }
+  if (snapshotAge(snapshot) > SNAPSHOT_MAX_AGE) snapshotRequestResample();
+  TextBuffer body;
+  snapshotFormat(snapshot, body);
+  if (body.length() == 0) { // Text pool exhausted
+    respond(503, "Service Unavailable", "{\"error\":\"busy, retry\"}");
+    return;
+  }
+  respond(200, "OK", body.c_str());
+}
+
+void serviceStatusHttp() {
+  if (!client) {
+    client = server.available();
+    if (!client) return;
+    requestLength = 0;
+    clientSince = millis();
+  }
+
+  while (client.available() > 0 && requestLength < sizeof(request) - 1) {
+    request[requestLength++] = (char)client.read();
+  }
+  request[requestLength] = '\0';
+
+  // Only the request line matters, but the whole header is read before answering
+  bool complete = strstr(request, "\r\n\r\n") != NULL || requestLength == sizeof(request) - 1;
+  if (!complete && client.connected() && millis() - clientSince < STATUS_HTTP_TIMEOUT) return;
+  if (complete) answer();
+  client.stop();
+}
@@ -0,0 +1,101 @@
+#include "tasks.h"
+#include "config.h"
+#include "globals.h"
+#include "hardware.h"
+#include "scheduler.h"
+#include "sampler.h"
+#include "power_detect.h"
+#include "intensity_input.h"
+#include "diagnostics.h"
+#include "stall_monitor.h"
+
+static TaskHandle_t controlTaskHandle = NULL;
+static TaskHandle_t networkTaskHandle = NULL;
+
+// Written by the control task, read by the network task's loop report.
+// Plain 32-bit words, so a read never tears.
+static volatile unsigned long worstTickMicros = 0;
+static volatile unsigned long worstLatenessMicros = 0;
+
+static void controlTask(void* param) {
+  const TickType_t period = pdMS_TO_TICKS(CONTROL_TICK_MS);
+  TickType_t nextTick = xTaskGetTickCount() + period;
+  unsigned long expectedWake = micros() + CONTROL_TICK_MS * 1000UL;
+
+  for (;;) {
+    unsigned long tickStart = micros();
+
+    stallPassBegin(STALL_CONTROL, "control_tick");
+    runControlTick();
+    stallPassEnd(STALL_CONTROL);
+
+    unsigned long tickTime = micros() - tickStart;
+    if (tickTime > worstTickMicros) worstTickMicros = tickTime;
+
+    // Sleep until the next tick, unless an ISR notifies us first. While a detect
+    // pin or intensity edge is being debounced, wake up again as soon as the
+    // debounce ends.
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(nextTick - now) > 0) {
+      TickType_t wait = nextTick - now;
+      if (powerDetectConfirmPending() && wait > pdMS_TO_TICKS(POWER_DETECT_DEBOUNCE_MS)) {
+        wait = pdMS_TO_TICKS(POWER_DETECT_DEBOUNCE_MS);
+      }
+      if (intensityDebouncePending() && wait > pdMS_TO_TICKS(INTENSITY_DEBOUNCE_MS)) {
+        wait = pdMS_TO_TICKS(INTENSITY_DEBOUNCE_MS);
+      }
+      ulTaskNotifyTake(pdTRUE, wait);
+    }
+
+    // Lateness is only meaningful for scheduled wakes, not ISR wake-ups
+    now = xTaskGetTickCount();
+    if ((int32_t)(now - nextTick) >= 0) {
+      long lateness = (long)(micros() - expectedWake);
+      if (lateness > (long)worstLatenessMicros) worstLatenessMicros = lateness;
+      nextTick += period;
+      expectedWake += CONTROL_TICK_MS * 1000UL;
+      if ((int32_t)(now - nextTick) >= 0) { // Fell a whole tick behind: resync instead of bursting
+        nextTick = now + period;
+        expectedWake = micros() + CONTROL_TICK_MS * 1000UL;
+      }
+    }
+  }
+}
+
+static void networkTask(void* param) {
+  for (;;) {
+    stallPassBegin(STALL_NETWORK, NULL); // Tagged with the scheduler task that is running
+    schedulerRun();
+    stallPassEnd(STALL_NETWORK);
+    vTaskDelay(1); // Let the idle task feed the watchdog on this core
+  }
+}
+
+void startControlTasks() {
+  // Control runs above the network task so a TLS handshake can never preempt it
+  xTaskCreatePinnedToCore(controlTask, "control", 4096, NULL, 3, &controlTaskHandle, CONTROL_CORE);
+  diagRegisterTask("control", controlTaskHandle);
+  stallWatch(STALL_CONTROL, "control", controlTaskHandle, STALL_BUDGET_CONTROL_MS);
+  setupPowerDetect(controlTaskHandle);
+  setupIntensityInput(controlTaskHandle);
+  startSampler();
+}
+
+void startNetworkTask() {
+  xTaskCreatePinnedToCore(networkTask, "network", 8192, NULL, 2, &networkTaskHandle, NETWORK_CORE);
+  diagRegisterTask("network", networkTaskHandle);
+  stallWatch(STALL_NETWORK, "network", networkTaskHandle, STALL_BUDGET_NETWORK_MS, schedulerRunningTaskName);
+}
+
+unsigned long controlWorstTickMicros() {
+  return worstTickMicros;
+}
+
+unsigned long controlWorstLatenessMicros() {
+  return worstLatenessMicros;
+}
+
+void controlResetStats() {
+  worstTickMicros = 0;
+  worstLatenessMicros = 0;
+}
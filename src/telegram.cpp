@@ -0,0 +1,238 @@
+#include "telegram.h"
+#include "config.h"
+#include "spsc_queue.h"
+#include "diagnostics.h"
+#include "stall_monitor.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include <UniversalTelegramBot.h>
+
+struct TelegramMessage {
+  bool markdown;
+  char text[TELEGRAM_MESSAGE_SIZE];
+};
+
+static const char* TELEGRAM_HOST = "api.telegram.org";
+
+static SpscQueue<TelegramMessage, TELEGRAM_OUTBOX_SIZE> outbox; // network task -> worker
+static TaskHandle_t workerHandle = NULL;
+
+// Owned by the worker task. Separate from the listener's client so a send never
+// waits behind a long-poll.
+static WiFiClientSecure outboxClient;
+
+// Written by the worker, read by the loop report (32-bit words, never torn)
+static volatile uint32_t sentCount = 0;
+static volatile uint32_t coalescedCount = 0;
+static volatile uint32_t retryCount = 0;
+static volatile uint32_t droppedCount = 0; // Out of attempts (outbox-full drops are counted by the ring)
+static volatile uint32_t handshakeCount = 0;
+static volatile uint32_t pollCount = 0;
+
+// --- LISTENER STATE (owned by the listener task) ---
+static WiFiClientSecure pollClient;
+static UniversalTelegramBot bot(TELEGRAM_BOT_TOKEN, pollClient);
+static SpscQueue<TelegramCommand, TELEGRAM_COMMAND_QUEUE_SIZE> commandRing; // listener -> network task
+
+bool telegramEnqueue(const char* text, bool markdown) {
+  TelegramMessage msg;
+  msg.markdown = markdown;
+  strlcpy(msg.text, text, sizeof(msg.text));
+  if (!outbox.push(msg)) { // Counted by the ring
+    Serial.println("X Telegram outbox full, message dropped");
+    return false;
+  }
+  if (workerHandle != NULL) xTaskNotifyGive(workerHandle);
+  return true;
+}
+
+// One sendMessage request over the persistent connection. Returns true on HTTP 200.
+static bool telegramPost(const TelegramMessage& msg) {
+  StaticJsonDocument<TELEGRAM_MESSAGE_SIZE + 128> doc;
+  doc["chat_id"] = TELEGRAM_CHAT_ID;
+  doc["text"] = msg.text;
+  if (msg.markdown) doc["parse_mode"] = "Markdown";
+
+  char body[TELEGRAM_MESSAGE_SIZE * 2]; // Room for JSON escaping of newlines/quotes
+  size_t bodyLength = serializeJson(doc, body, sizeof(body));
+  if (bodyLength == 0) return false;
+
+  if (!outboxClient.connected()) {
+    if (!outboxClient.connect(TELEGRAM_HOST, 443)) return false;
+    handshakeCount++;
+  }
+
+  char header[160];
+  int headerLength = snprintf(header, sizeof(header),
+    "POST /bot%s/sendMessage HTTP/1.1\r\n"
+    "Host: %s\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: %u\r\n"
+    "Connection: keep-alive\r\n\r\n",
+    TELEGRAM_BOT_TOKEN, TELEGRAM_HOST, (unsigned)bodyLength);
+  outboxClient.write((const uint8_t*)header, headerLength);
+  outboxClient.write((const uint8_t*)body, bodyLength);
+
+  // Status line, e.g. "HTTP/1.1 200 OK"
+  char line[128];
+  size_t n = outboxClient.readBytesUntil('\n', line, sizeof(line) - 1);
+  line[n] = '\0';
+  int status = (n > 9) ? atoi(line + 9) : 0;
+
+  // Headers: we only need the body length and whether the server keeps the connection
+  long contentLength = -1;
+  bool serverCloses = false;
+  for (;;) {
+    n = outboxClient.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    if (n == 0 || (n == 1 && line[0] == '\r')) break;
+    if (strncasecmp(line, "Content-Length:", 15) == 0) contentLength = atol(line + 15);
+    if (strncasecmp(line, "Connection: close", 17) == 0) serverCloses = true;
+  }
+
+  // Drain the body so the next request starts on a clean stream
+  while (contentLength > 0) {
+    uint8_t discard[64];
+    size_t chunk = outboxClient.readBytes(discard, contentLength < 64 ? contentLength : 64);
+    if (chunk == 0) break;
+    contentLength -= chunk;
+  }
+
+  if (status == 0 || contentLength != 0 || serverCloses) outboxClient.stop();
+  return status == 200;
+}
+
+static void sendWithRetry(const TelegramMessage& msg) {
+  for (int attempt = 0; attempt < TELEGRAM_MAX_ATTEMPTS; attempt++) {
+    // Waiting for WiFi does not use up attempts
+    while (WiFi.status() != WL_CONNECTED) vTaskDelay(pdMS_TO_TICKS(500));
+
+    uint32_t sendStart = halCycleCount();
+    stallPassBegin(STALL_TELEGRAM, "tg_send"); // Waiting for WiFi or backing off is not a stall
+    bool sent = telegramPost(msg);
+    stallPassEnd(STALL_TELEGRAM);
+    diagRecord(DIAG_TELEGRAM_SEND, sendStart);
+    if (sent) {
+      sentCount++;
+      Serial.println("✓ Telegram sent successfully");
+      return;
+    }
+
+    outboxClient.stop(); // Start the next attempt on a fresh connection
+    retryCount++;
+    Serial.printf("X Telegram failed to send (attempt %d/%d)\n", attempt + 1, TELEGRAM_MAX_ATTEMPTS);
+    if (attempt + 1 < TELEGRAM_MAX_ATTEMPTS) {
+      vTaskDelay(pdMS_TO_TICKS(TELEGRAM_RETRY_BASE << attempt));
+    }
+  }
+  droppedCount++;
+}
+
+static void telegramWorker(void* param) {
+  outboxClient.setInsecure(); // Once, not per message
+  outboxClient.setTimeout(5); // Seconds, for the response reads
+
+  TelegramMessage batch;
+  TelegramMessage next;
+  bool haveNext = false;
+
+  for (;;) {
+    if (haveNext) {
+      batch = next;
+      haveNext = false;
+    } else {
+      while (!outbox.pop(batch)) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    // Plain alerts: keep collecting for the coalescing window and send them as one
+    if (!batch.markdown) {
+      unsigned long windowEnd = millis() + TELEGRAM_COALESCE_WINDOW;
+      for (;;) {
+        long remaining = (long)(windowEnd - millis()); // Read once: a second read could be past windowEnd
+        if (remaining <= 0) break;
+        if (!outbox.pop(next)) {
+          ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(remaining));
+          continue;
+        }
+        size_t used = strlen(batch.text);
+        if (next.markdown || used + 2 + strlen(next.text) >= sizeof(batch.text)) {
+          haveNext = true; // Doesn't fit: it starts the next batch
+          break;
+        }
+        strlcat(batch.text, "\n\n", sizeof(batch.text));
+        strlcat(batch.text, next.text, sizeof(batch.text));
+        coalescedCount++;
+      }
+    }
+
+    Serial.print("Sending Telegram: ");
+    Serial.println(batch.text);
+    sendWithRetry(batch);
+  }
+}
+
+void startTelegramOutbox() {
+  // Below the network task: TLS work only runs when the scheduler is idle
+  xTaskCreatePinnedToCore(telegramWorker, "telegram", 8192, NULL, 1, &workerHandle, NETWORK_CORE);
+  diagRegisterTask("telegram", workerHandle);
+  stallWatch(STALL_TELEGRAM, "telegram", workerHandle, STALL_BUDGET_TELEGRAM_MS);
+}
+
+static void telegramListener(void* param) {
+  pollClient.setInsecure();
+  bot.longPoll = TELEGRAM_LONG_POLL;
+
+  for (;;) {
+    if (WiFi.status() != WL_CONNECTED) {
+      vTaskDelay(pdMS_TO_TICKS(1000));
+      continue;
+    }
+
+    // Returns as soon as a message arrives, or empty after TELEGRAM_LONG_POLL seconds
+    uint32_t pollStart = halCycleCount();
+    int numNewMessages = bot.getUpdates(bot.last_message_received + 1);
+    diagRecord(DIAG_TELEGRAM_POLL, pollStart);
+    pollCount++;
+
+    for (int i = 0; i < numNewMessages; i++) {
+      if (bot.messages[i].chat_id != TELEGRAM_CHAT_ID) continue;
+
+      const String& text = bot.messages[i].text;
+      TelegramCommand command;
+      if (text == "/status") command = TG_STATUS;
+      else if (text == "/start") command = TG_START;
+      else continue;
+
+      if (!commandRing.push(command)) {
+        Serial.println("X Telegram command queue full, command dropped");
+      }
+    }
+
+    // Back off briefly after a failed request instead of hammering the API
+    if (numNewMessages == 0 && !pollClient.connected()) {
+      vTaskDelay(pdMS_TO_TICKS(TELEGRAM_RETRY_BASE));
+    }
+  }
+}
+
+void startTelegramListener() {
+  TaskHandle_t listenerHandle = NULL;
+  xTaskCreatePinnedToCore(telegramListener, "tgListen", 8192, NULL, 1, &listenerHandle, NETWORK_CORE);
+  diagRegisterTask("tg_listen", listenerHandle);
+}
+
+bool telegramNextCommand(TelegramCommand& command) {
+  return commandRing.pop(command);
+}
+
+TelegramStats telegramStats() {
+  TelegramStats stats;
+  stats.sent = sentCount;
+  stats.coalesced = coalescedCount;
+  stats.retries = retryCount;
+  stats.dropped = droppedCount + outbox.dropped();
+  stats.handshakes = handshakeCount;
+  stats.polls = pollCount;
+  return stats;
+}
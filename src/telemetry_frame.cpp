@@ -0,0 +1,37 @@
+#include "telemetry_frame.h"
+#include "hal.h"
+
+uint32_t uptimeToEpochSeconds(unsigned long uptimeMs) {
+  uint32_t now = halEpochSeconds();
+  if (now == 0) return 0; // NTP has not synced
+  return now - (uint32_t)((halMillis() - uptimeMs) / 1000);
+}
+
+size_t encodeTelemetryFrame(const SensorSample& sample, uint32_t epochSeconds, uint8_t* buffer, size_t bufferSize) {
+  if (bufferSize < TELEMETRY_FRAME_SIZE) return 0;
+
+  TelemetryFrameHeader header;
+  header.version = TELEMETRY_FRAME_VERSION;
+  header.channelCount = TELEMETRY_FRAME_CHANNELS;
+  header.flags = sample.flags;
+  header.reserved = 0;
+  header.sequence = sample.sequence;
+  header.uptimeMs = sample.timestamp;
+  header.epochSeconds = epochSeconds;
+
+  TelemetryFrameChannel channels[TELEMETRY_FRAME_CHANNELS] = {
+    { sample.v1, sample.c1, sample.p1 },
+    { sample.v2, sample.c2, sample.p2 },
+  };
+
+  // The ESP32 is little-endian, so the packed structs are already in wire order
+  size_t offset = 0;
+  memcpy(buffer + offset, &header, sizeof(header));
+  offset += sizeof(header);
+  memcpy(buffer + offset, &sample.intensity, sizeof(float));
+  offset += sizeof(float);
+  memcpy(buffer + offset, channels, sizeof(channels));
+  offset += sizeof(channels);
+
+  return offset;
+}
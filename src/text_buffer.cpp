@@ -0,0 +1,102 @@
+#include "text_buffer.h"
+#include "config.h"
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(TEXT_POOL_BLOCKS <= 32, "TextBuffer pool bitmask holds 32 blocks");
+
+static char pool[TEXT_POOL_BLOCKS][TEXT_BLOCK_SIZE];
+static std::atomic<uint32_t> usedBlocks(0); // Bit n set = pool[n] taken
+
+static std::atomic<uint32_t> highWater(0);
+static std::atomic<uint32_t> exhaustedCount(0);
+static std::atomic<uint32_t> truncatedCount(0);
+
+static char emptyText[1] = { '\0' }; // Stands in for a block when the pool is exhausted
+static const int NO_BLOCK = -1;
+static const int CALLER_STORAGE = -2;
+
+static int claimBlock() {
+  uint32_t used = usedBlocks.load(std::memory_order_relaxed);
+  for (;;) {
+    int block = -1;
+    for (int i = 0; i < (int)TEXT_POOL_BLOCKS; i++) {
+      if (!(used & (1UL << i))) { block = i; break; }
+    }
+    if (block < 0) return NO_BLOCK;
+    uint32_t claimed = used | (1UL << block);
+    if (usedBlocks.compare_exchange_weak(used, claimed, std::memory_order_acquire)) {
+      uint32_t inUse = __builtin_popcount(claimed);
+      uint32_t seen = highWater.load(std::memory_order_relaxed);
+      while (inUse > seen && !highWater.compare_exchange_weak(seen, inUse)) {}
+      return block;
+    }
+    // Another task took a block in between: 'used' now holds the fresh mask
+  }
+}
+
+TextBuffer::TextBuffer() : used_(0), truncated_(false) {
+  block_ = claimBlock();
+  if (block_ == NO_BLOCK) {
+    exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+    text_ = emptyText;
+    capacity_ = 1;
+    truncated_ = true;
+  } else {
+    text_ = pool[block_];
+    capacity_ = TEXT_BLOCK_SIZE;
+  }
+  text_[0] = '\0';
+}
+
+TextBuffer::TextBuffer(char* storage, size_t capacity)
+    : block_(CALLER_STORAGE), text_(storage), capacity_(capacity), used_(0), truncated_(false) {
+  text_[0] = '\0';
+}
+
+TextBuffer::~TextBuffer() {
+  if (truncated_ && block_ != NO_BLOCK) truncatedCount.fetch_add(1, std::memory_order_relaxed);
+  if (block_ >= 0) usedBlocks.fetch_and(~(1UL << block_), std::memory_order_release);
+}
+
+TextBuffer& TextBuffer::append(const char* text) {
+  size_t length = strlen(text);
+  size_t room = capacity_ - 1 - used_;
+  if (length > room) {
+    length = room;
+    truncated_ = true;
+  }
+  memcpy(text_ + used_, text, length);
+  used_ += length;
+  text_[used_] = '\0';
+  return *this;
+}
+
+TextBuffer& TextBuffer::appendf(const char* format, ...) {
+  size_t room = capacity_ - used_;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(text_ + used_, room, format, args);
+  va_end(args);
+
+  if (written < 0) {
+    text_[used_] = '\0';
+  } else if ((size_t)written >= room) {
+    used_ = capacity_ - 1;
+    truncated_ = true;
+  } else {
+    used_ += written;
+  }
+  return *this;
+}
+
+TextPoolStats textPoolStats() {
+  TextPoolStats stats;
+  stats.blocks = TEXT_POOL_BLOCKS;
+  stats.highWater = highWater.load(std::memory_order_relaxed);
+  stats.exhausted = exhaustedCount.load(std::memory_order_relaxed);
+  stats.truncated = truncatedCount.load(std::memory_order_relaxed);
+  return stats;
+}
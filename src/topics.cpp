@@ -0,0 +1,67 @@
+#include "topics.h"
+#include "config.h"
+
+// Every topic global, in config.h order
+static const char** const TOPIC_SLOTS[] = {
+  &mqtt_topic, &mqtt_status_topic,
+  &mqtt_led2_topic, &mqtt_led2_status_topic,
+  &mqtt_led4_topic, &mqtt_led4_status_topic,
+  &mqtt_sensor_voltage_topic, &mqtt_sensor_current_topic, &mqtt_sensor_power_topic,
+  &mqtt_sensor2_voltage_topic, &mqtt_sensor2_current_topic, &mqtt_sensor2_power_topic,
+  &mqtt_powercut_topic, &mqtt_command_status_topic,
+  &mqtt_emergency_light_topic, &mqtt_emergency_light_status_topic,
+  &mqtt_powercut_history_topic, &mqtt_light_intensity_topic,
+  &mqtt_loop_stats_topic, &mqtt_telemetry_frame_topic,
+  &mqtt_aggregate_topic, &mqtt_report_stats_topic, &mqtt_signal_topic,
+  &mqtt_diagnostics_topic, &mqtt_stall_topic, &mqtt_boot_topic,
+  &mqtt_event_query_topic, &mqtt_event_page_topic, &mqtt_ota_topic, &mqtt_ota_status_topic,
+  &mqtt_snapshot_get_topic, &mqtt_snapshot_topic,
+};
+static const size_t TOPIC_COUNT = sizeof(TOPIC_SLOTS) / sizeof(TOPIC_SLOTS[0]);
+
+static const char* suffixes[TOPIC_COUNT]; // Captured on the first build, so the table can be rebuilt
+static bool suffixesCaptured = false;
+
+static char topicStorage[TOPIC_STORAGE_SIZE];
+static char devicePrefix[DEVICE_PREFIX_SIZE];
+static size_t devicePrefixLength = 0;
+
+void buildTopicTable(const char* prefix, const char* deviceId) {
+  if (!suffixesCaptured) {
+    for (size_t i = 0; i < TOPIC_COUNT; i++) suffixes[i] = *TOPIC_SLOTS[i];
+    suffixesCaptured = true;
+  }
+
+  int length = snprintf(devicePrefix, sizeof(devicePrefix), "%s/%s/", prefix, deviceId);
+  if (length < 0 || (size_t)length >= sizeof(devicePrefix)) {
+    Serial.println("ERROR: Device ID/prefix too long, falling back to the default namespace");
+    length = snprintf(devicePrefix, sizeof(devicePrefix), "%s/%s/", DEFAULT_TOPIC_PREFIX, "unnamed");
+  }
+  devicePrefixLength = length;
+
+  size_t used = 0;
+  for (size_t i = 0; i < TOPIC_COUNT; i++) {
+    char* topic = topicStorage + used;
+    int written = snprintf(topic, sizeof(topicStorage) - used, "%s%s", devicePrefix, suffixes[i]);
+    if (written < 0 || used + written + 1 > sizeof(topicStorage)) {
+      // Sized in config.h for the longest prefix and ID; only a config error gets here
+      Serial.println("ERROR: Topic table full");
+      *TOPIC_SLOTS[i] = suffixes[i];
+      continue;
+    }
+    *TOPIC_SLOTS[i] = topic;
+    used += written + 1;
+  }
+}
+
+const char* topicDevicePrefix() {
+  return devicePrefix;
+}
+
+size_t topicDevicePrefixLength() {
+  return devicePrefixLength;
+}
+
+void deviceIdFromMac(const uint8_t mac[6], char* out, size_t size) {
+  snprintf(out, size, "esp32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+}
@@ -0,0 +1,663 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include "sim.h"
+#include "hal.h"
+#include "config.h"
+#include "globals.h"
+#include "hardware.h"
+#include "topics.h"
+#include "mqtt_wire.h"
+
+// --- FLEET LOAD GENERATOR ---
+// Drives a real broker (and the backend behind it) with thousands of virtual
+// controllers, without hardware. The firmware state is global, so the devices
+// cannot all run the firmware at once. Instead, each supply profile runs the
+// real control code (runControlTick, the report filter, the outbox) on the
+// simulator's virtual clock, and what the outbox writes is recorded with its
+// virtual time and QoS. A thread pool then replays those recordings in real
+// time: every virtual device has its own MQTT connection, client ID and topic
+// namespace, and starts up to a second after the others, as real boards would.
+//
+// A probe connection subscribes to the whole namespace and matches each
+// delivery to the recorded publish it came from. That gives schedule-to-delivery
+// latency and loss without stamping the firmware's payloads. With --backend,
+// the backend's /api/ingest-stats adds what the ingest received and how far
+// behind its inserts run.
+
+typedef std::chrono::steady_clock LoadClock;
+
+struct LoadOptions {
+  std::string host = "127.0.0.1";
+  uint16_t port = 1883;
+  int devices = 100;
+  int seconds = 60;
+  int threads = 0;           // 0 = one per core
+  int profiles = 32;         // Distinct recordings, shared round-robin by the devices
+  int stormAt = 20;          // Seconds into the run; negative = no power cuts
+  int stormLength = 10;
+  int stormEvery = 0;        // Seconds between storms, 0 = one storm
+  int stormPercent = 100;    // Share of the profiles hit by a storm
+  std::string backend;       // "host:port" of backend/server.js, empty = not queried
+};
+
+static LoadOptions options;
+
+// --- RECORDING ---
+struct TraceEntry {
+  uint32_t atMs;             // Virtual time of the write
+  uint16_t suffix;           // Index into suffixes
+  bool qos1;
+  uint32_t payloadOffset;    // Into Profile::payloads
+  uint32_t payloadLength;
+};
+
+struct Profile {
+  std::vector<TraceEntry> entries;
+  std::string payloads;
+  std::vector<std::vector<uint32_t>> bySuffix; // Entry indexes per topic suffix, for the probe
+};
+
+static std::vector<Profile> profiles;
+static std::vector<std::string> suffixes; // "sensor/voltage", ...: the part after the device prefix
+static std::unordered_map<std::string, uint16_t> suffixIndex;
+static Profile* recording = NULL;
+static uint32_t recordingMs = 0;
+
+static uint16_t internSuffix(const std::string& suffix) {
+  auto found = suffixIndex.find(suffix);
+  if (found != suffixIndex.end()) return found->second;
+  suffixes.push_back(suffix);
+  suffixIndex[suffix] = (uint16_t)(suffixes.size() - 1);
+  return (uint16_t)(suffixes.size() - 1);
+}
+
+static void recordWrite(const char* topic, const uint8_t* payload, size_t length, bool qos1) {
+  size_t prefixLength = topicDevicePrefixLength();
+  if (strncmp(topic, topicDevicePrefix(), prefixLength) != 0) return;
+  TraceEntry entry;
+  entry.atMs = recordingMs;
+  entry.suffix = internSuffix(topic + prefixLength);
+  entry.qos1 = qos1;
+  entry.payloadOffset = recording->payloads.size();
+  entry.payloadLength = length;
+  recording->payloads.append((const char*)payload, length);
+  recording->entries.push_back(entry);
+}
+
+static bool inStorm(int profile, uint32_t ms) {
+  if (options.stormAt < 0 || profile * 100 >= options.stormPercent * options.profiles) return false;
+  long since = (long)ms - options.stormAt * 1000L;
+  if (since < 0) return false;
+  if (options.stormEvery > 0) since %= options.stormEvery * 1000L;
+  return since < options.stormLength * 1000L;
+}
+
+// Each profile reads a little differently and drifts on its own period; during
+// a storm the main supply is gone
+static void applySupply(int profile, uint32_t ms) {
+  double t = ms / 1000.0;
+  double drift = sin(2 * M_PI * t / (20.0 + profile));
+  simSetSupply(0, 12.6f - 0.05f * (profile % 8) + 0.15f * drift, 200.0f + 5.0f * profile + 40.0f * drift);
+  if (inStorm(profile, ms)) simSetSupply(1, 0.0f, 0.0f);
+  else simSetSupply(1, 12.0f + 0.1f * drift, 250.0f + 3.0f * profile);
+}
+
+static void recordProfile(int index) {
+  Profile& profile = profiles[index];
+  recording = &profile;
+
+  // What setup() does, minus the network
+  char deviceId[DEVICE_ID_SIZE];
+  uint8_t mac[6] = { 0x24, 0x6f, 0x28, 0xfe, (uint8_t)(index >> 8), (uint8_t)index };
+  deviceIdFromMac(mac, deviceId, sizeof(deviceId));
+  simStateErase();
+  simReset();
+  buildTopicTable(DEFAULT_TOPIC_PREFIX, deviceId);
+  setupHardware();
+
+  simMqttSetTap(recordWrite);
+  const uint32_t endMs = options.seconds * 1000UL;
+  for (recordingMs = 0; recordingMs < endMs; recordingMs += CONTROL_TICK_MS) {
+    if (recordingMs % 100 == 0) applySupply(index, recordingMs);
+    simAdvance(CONTROL_TICK_MS * 1000UL);
+    runControlTick();
+    simMqttPump();
+  }
+  simMqttSetTap(NULL);
+  recording = NULL;
+}
+
+static void indexProfiles() {
+  for (Profile& profile : profiles) {
+    profile.bySuffix.assign(suffixes.size(), std::vector<uint32_t>());
+    for (uint32_t i = 0; i < profile.entries.size(); i++) profile.bySuffix[profile.entries[i].suffix].push_back(i);
+  }
+}
+
+// --- VIRTUAL DEVICES ---
+struct VirtualDevice {
+  char id[DEVICE_ID_SIZE];
+  int profile;
+  uint32_t offsetMs;         // Boot jitter
+  int fd = -1;
+  size_t next = 0;           // Next trace entry to publish
+  uint16_t packetId = 0;
+  std::deque<std::pair<uint16_t, LoadClock::time_point>> inflight; // QoS 1 publishes awaiting PUBACK
+  MqttReader reader;
+  LoadClock::time_point lastPing;
+};
+
+static std::vector<VirtualDevice> fleet;
+static std::unordered_map<std::string, int> fleetIndex; // Device ID -> index, read-only once running
+static LoadClock::time_point runStart;
+static std::atomic<int> connectedWorkers(0);
+static std::atomic<bool> running(false);
+static std::atomic<bool> stopping(false);
+
+struct WorkerStats {
+  std::atomic<uint64_t> published{0};
+  uint64_t bytes = 0;
+  uint32_t connectFailures = 0;
+  uint32_t disconnects = 0;
+  uint64_t acked = 0;
+  std::vector<uint32_t> sendLagMicros;   // Publish written vs when the firmware wrote it
+  std::vector<uint32_t> ackMicros;       // QoS 1: publish to PUBACK
+};
+
+static const size_t MAX_LATENCY_SAMPLES = 4000000; // Per list; later ones are dropped
+
+static void addSample(std::vector<uint32_t>& samples, LoadClock::duration elapsed) {
+  if (samples.size() >= MAX_LATENCY_SAMPLES) return;
+  long long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  samples.push_back(micros < 0 ? 0 : (uint32_t)std::min<long long>(micros, UINT32_MAX));
+}
+
+// Up to 5 s for the broker's answer to CONNECT / SUBSCRIBE
+static bool awaitReply(int fd, MqttReader& reader, MqttPacket& reply) {
+  for (int waited = 0; waited < 50; waited++) {
+    if (mqttWireNextPacket(reader, reply)) return true;
+    if (!mqttWireRead(fd, reader, 100)) return false;
+  }
+  return false;
+}
+
+static bool connectDevice(VirtualDevice& device, uint8_t* packet, size_t size) {
+  device.fd = mqttWireConnect(options.host.c_str(), options.port);
+  if (device.fd < 0) return false;
+  size_t length = mqttWireConnectPacket(packet, size, device.id, 60);
+  MqttPacket reply;
+  if (mqttWireSend(device.fd, packet, length) && awaitReply(device.fd, device.reader, reply) &&
+      reply.type == MQTT_CONNACK && reply.length >= 2 && reply.body[1] == 0) {
+    device.lastPing = LoadClock::now();
+    return true;
+  }
+  mqttWireClose(device.fd);
+  device.fd = -1;
+  return false;
+}
+
+static void dropDevice(VirtualDevice& device, WorkerStats& stats) {
+  mqttWireClose(device.fd);
+  device.fd = -1;
+  stats.disconnects++;
+}
+
+static void serviceReplies(VirtualDevice& device, WorkerStats& stats) {
+  if (!mqttWireRead(device.fd, device.reader, 0)) {
+    dropDevice(device, stats);
+    return;
+  }
+  MqttPacket reply;
+  while (mqttWireNextPacket(device.reader, reply)) {
+    if (reply.type != MQTT_PUBACK) continue;
+    uint16_t id = mqttWirePacketId(reply);
+    for (auto at = device.inflight.begin(); at != device.inflight.end(); ++at) {
+      if (at->first != id) continue;
+      addSample(stats.ackMicros, LoadClock::now() - at->second);
+      device.inflight.erase(at);
+      stats.acked++;
+      break;
+    }
+  }
+}
+
+// Publishes everything due; the next due time (ms into the run) or UINT32_MAX
+static uint32_t publishDue(VirtualDevice& device, WorkerStats& stats, uint8_t* packet, size_t size, char* topic) {
+  const Profile& profile = profiles[device.profile];
+  LoadClock::time_point now = LoadClock::now();
+  uint32_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - runStart).count();
+
+  while (device.next < profile.entries.size()) {
+    const TraceEntry& entry = profile.entries[device.next];
+    uint32_t dueMs = device.offsetMs + entry.atMs;
+    if (dueMs > elapsedMs) return dueMs;
+
+    snprintf(topic, 128, "%s/%s/%s", DEFAULT_TOPIC_PREFIX, device.id, suffixes[entry.suffix].c_str());
+    uint16_t id = 0;
+    if (entry.qos1) {
+      if (++device.packetId == 0) device.packetId = 1;
+      id = device.packetId;
+    }
+    size_t length = mqttWirePublishPacket(packet, size, topic,
+      (const uint8_t*)profile.payloads.data() + entry.payloadOffset, entry.payloadLength, id);
+    if (length == 0 || !mqttWireSend(device.fd, packet, length)) {
+      dropDevice(device, stats);
+      return UINT32_MAX;
+    }
+    LoadClock::time_point sent = LoadClock::now();
+    if (id != 0) device.inflight.push_back(std::make_pair(id, sent));
+    addSample(stats.sendLagMicros, sent - (runStart + std::chrono::milliseconds(dueMs)));
+    stats.published.fetch_add(1, std::memory_order_relaxed);
+    stats.bytes += length;
+    device.next++;
+  }
+  return UINT32_MAX;
+}
+
+// One thread serves a slice of the fleet: publishes what falls due, then sleeps
+// in poll() on all its sockets until the next one
+static void workerTask(int begin, int end, WorkerStats* stats) {
+  uint8_t packet[EVENT_PAGE_SIZE + 256];
+  char topic[128];
+  for (int d = begin; d < end; d++) {
+    if (!connectDevice(fleet[d], packet, sizeof(packet))) stats->connectFailures++;
+  }
+  connectedWorkers++;
+  while (!running.load(std::memory_order_acquire)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  std::this_thread::sleep_until(runStart);
+
+  std::vector<pollfd> waits;
+  std::vector<int> owners;
+  while (!stopping.load(std::memory_order_relaxed)) {
+    uint32_t nextDue = UINT32_MAX;
+    waits.clear();
+    owners.clear();
+    LoadClock::time_point now = LoadClock::now();
+    for (int d = begin; d < end; d++) {
+      VirtualDevice& device = fleet[d];
+      if (device.fd < 0) continue;
+      nextDue = std::min(nextDue, publishDue(device, *stats, packet, sizeof(packet), topic));
+      if (device.fd < 0) continue;
+      if (now - device.lastPing > std::chrono::seconds(30)) { // Keepalive is 60 s
+        size_t length = mqttWirePingPacket(packet, sizeof(packet));
+        if (!mqttWireSend(device.fd, packet, length)) {
+          dropDevice(device, *stats);
+          continue;
+        }
+        device.lastPing = now;
+      }
+      waits.push_back({ device.fd, POLLIN, 0 });
+      owners.push_back(d);
+    }
+
+    uint32_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(LoadClock::now() - runStart).count();
+    int timeout = nextDue == UINT32_MAX ? 50 : nextDue > elapsedMs ? (int)std::min<uint32_t>(nextDue - elapsedMs, 50) : 0;
+    if (waits.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout > 0 ? timeout : 1));
+      continue;
+    }
+    if (poll(waits.data(), waits.size(), timeout) <= 0) continue;
+    for (size_t i = 0; i < waits.size(); i++) {
+      if (waits[i].revents != 0) serviceReplies(fleet[owners[i]], *stats);
+    }
+  }
+
+  for (int d = begin; d < end; d++) {
+    if (fleet[d].fd < 0) continue;
+    size_t length = mqttWireDisconnectPacket(packet, sizeof(packet));
+    mqttWireSend(fleet[d].fd, packet, length);
+    mqttWireClose(fleet[d].fd);
+  }
+}
+
+// --- PROBE ---
+// Messages on a topic arrive in the order one client published them, so the
+// k-th delivery for (device, suffix) is the k-th recorded publish there. One
+// that does not match was lost; the next few are tried before giving up.
+struct ProbeStats {
+  std::atomic<uint64_t> received{0};
+  uint64_t matched = 0;
+  uint64_t lost = 0;
+  uint64_t unmatched = 0;
+  std::vector<uint32_t> latencyMicros; // Due time to delivery
+  std::vector<uint32_t> alarmMicros;   // The same, QoS 1 (alarm lane) only
+};
+
+static const uint32_t PROBE_SEARCH = 8;
+
+static void probeMatch(ProbeStats& stats, std::vector<uint32_t>& cursors, const char* topic, size_t topicLength,
+  const uint8_t* payload, size_t payloadLength, LoadClock::time_point at) {
+  // "<prefix>/<device id>/<suffix>"
+  size_t prefixLength = strlen(DEFAULT_TOPIC_PREFIX);
+  const char* idStart = topic + prefixLength + 1;
+  const char* idEnd = (const char*)memchr(idStart, '/', topic + topicLength - idStart);
+  if (topicLength <= prefixLength + 1 || idEnd == NULL) {
+    stats.unmatched++;
+    return;
+  }
+  auto device = fleetIndex.find(std::string(idStart, idEnd - idStart));
+  auto suffix = suffixIndex.find(std::string(idEnd + 1, topic + topicLength - idEnd - 1));
+  if (device == fleetIndex.end() || suffix == suffixIndex.end()) {
+    stats.unmatched++; // A real device on the same broker, or a topic never recorded
+    return;
+  }
+
+  const VirtualDevice& owner = fleet[device->second];
+  const Profile& profile = profiles[owner.profile];
+  const std::vector<uint32_t>& sent = profile.bySuffix[suffix->second];
+  uint32_t& cursor = cursors[(size_t)device->second * suffixes.size() + suffix->second];
+  for (uint32_t k = cursor; k < sent.size() && k < cursor + PROBE_SEARCH; k++) {
+    const TraceEntry& entry = profile.entries[sent[k]];
+    if (entry.payloadLength != payloadLength ||
+        memcmp(profile.payloads.data() + entry.payloadOffset, payload, payloadLength) != 0) {
+      continue;
+    }
+    LoadClock::duration latency = at - (runStart + std::chrono::milliseconds(owner.offsetMs + entry.atMs));
+    addSample(stats.latencyMicros, latency);
+    if (entry.qos1) addSample(stats.alarmMicros, latency);
+    stats.lost += k - cursor;
+    stats.matched++;
+    cursor = k + 1;
+    return;
+  }
+  stats.unmatched++;
+}
+
+static void probeTask(int fd, ProbeStats* stats) {
+  std::vector<uint32_t> cursors(fleet.size() * suffixes.size(), 0);
+  MqttReader reader;
+  uint8_t ping[2];
+  LoadClock::time_point lastPing = LoadClock::now();
+  while (!stopping.load(std::memory_order_relaxed)) {
+    if (!mqttWireRead(fd, reader, 50)) break;
+    LoadClock::time_point now = LoadClock::now();
+    MqttPacket packet;
+    while (mqttWireNextPacket(reader, packet)) {
+      const char* topic;
+      const uint8_t* payload;
+      size_t topicLength, payloadLength;
+      if (!mqttWireParsePublish(packet, topic, topicLength, payload, payloadLength)) continue;
+      stats->received.fetch_add(1, std::memory_order_relaxed);
+      probeMatch(*stats, cursors, topic, topicLength, payload, payloadLength, now);
+    }
+    if (now - lastPing > std::chrono::seconds(30)) {
+      mqttWireSend(fd, ping, mqttWirePingPacket(ping, sizeof(ping)));
+      lastPing = now;
+    }
+  }
+}
+
+static int connectProbe() {
+  VirtualDevice probe;
+  strlcpy(probe.id, "loadgen-probe", sizeof(probe.id));
+  uint8_t packet[256];
+  if (!connectDevice(probe, packet, sizeof(packet))) return -1;
+
+  char filter[64];
+  snprintf(filter, sizeof(filter), "%s/#", DEFAULT_TOPIC_PREFIX);
+  size_t length = mqttWireSubscribePacket(packet, sizeof(packet), 1, filter, 0);
+  MqttPacket reply;
+  if (!mqttWireSend(probe.fd, packet, length) || !awaitReply(probe.fd, probe.reader, reply) ||
+      reply.type != MQTT_SUBACK) {
+    mqttWireClose(probe.fd);
+    return -1;
+  }
+  return probe.fd;
+}
+
+// --- BACKEND ---
+struct IngestStats {
+  bool valid = false;
+  double received = 0;
+  double inserted = 0;
+  double insertLagAvgMs = 0;
+  double insertLagMaxMs = 0;
+  double eventLoopP99Ms = 0;
+};
+
+static double jsonNumber(const char* text, const char* key) {
+  const char* at = strstr(text, key);
+  if (at == NULL) return 0;
+  at += strlen(key);
+  while (*at == '"' || *at == ' ' || *at == ':') at++;
+  return strtod(at, NULL);
+}
+
+static IngestStats fetchIngestStats(bool reset) {
+  IngestStats stats;
+  if (options.backend.empty()) return stats;
+  std::string host = options.backend;
+  uint16_t port = 3000;
+  size_t colon = host.rfind(':');
+  if (colon != std::string::npos) {
+    port = (uint16_t)atoi(host.c_str() + colon + 1);
+    host.resize(colon);
+  }
+
+  int fd = mqttWireConnect(host.c_str(), port);
+  if (fd < 0) return stats;
+  char request[160];
+  int length = snprintf(request, sizeof(request), "GET /api/ingest-stats%s HTTP/1.0\r\nHost: %s\r\n\r\n",
+    reset ? "?reset=1" : "", host.c_str());
+  MqttReader reader; // Just a byte buffer here
+  if (mqttWireSend(fd, (const uint8_t*)request, length)) {
+    for (int waited = 0; waited < 50 && mqttWireRead(fd, reader, 100); waited++) {}
+  }
+  mqttWireClose(fd);
+
+  std::string response(reader.buffer.begin(), reader.buffer.end());
+  size_t body = response.find("\r\n\r\n");
+  if (response.compare(0, 12, "HTTP/1.1 200") != 0 || body == std::string::npos) return stats;
+  const char* json = response.c_str() + body + 4;
+  stats.valid = true;
+  stats.received = jsonNumber(json, "\"received\"");
+  stats.inserted = jsonNumber(json, "\"inserted\"");
+  stats.insertLagAvgMs = jsonNumber(json, "\"insert_lag_avg_ms\"");
+  stats.insertLagMaxMs = jsonNumber(json, "\"insert_lag_max_ms\"");
+  stats.eventLoopP99Ms = jsonNumber(json, "\"event_loop_p99_ms\"");
+  return stats;
+}
+
+// --- REPORT ---
+static double percentileMs(std::vector<uint32_t>& samples, double share) {
+  if (samples.empty()) return 0;
+  size_t at = (size_t)(share * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + at, samples.end());
+  return samples[at] / 1000.0;
+}
+
+static void printLatency(const char* label, std::vector<uint32_t>& samples) {
+  if (samples.empty()) {
+    printf("  %-12s no samples\n", label);
+    return;
+  }
+  printf("  %-12s p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  p99.9 %.2f ms  max %.2f ms  (%lu)\n", label,
+    percentileMs(samples, 0.50), percentileMs(samples, 0.90), percentileMs(samples, 0.99),
+    percentileMs(samples, 0.999), percentileMs(samples, 1.0), (unsigned long)samples.size());
+}
+
+static void usage(const char* name) {
+  printf("Usage: %s [--broker host:port] [--devices N] [--seconds S] [--threads T] [--profiles P]\n"
+         "          [--storm-at S|-1] [--storm-length S] [--storm-every S] [--storm-percent P] [--backend host:port]\n", name);
+}
+
+static bool parseOptions(int argc, char** argv) {
+  static const option longOptions[] = {
+    { "broker", required_argument, NULL, 'b' },
+    { "devices", required_argument, NULL, 'd' },
+    { "seconds", required_argument, NULL, 's' },
+    { "threads", required_argument, NULL, 't' },
+    { "profiles", required_argument, NULL, 'p' },
+    { "storm-at", required_argument, NULL, 'a' },
+    { "storm-length", required_argument, NULL, 'l' },
+    { "storm-every", required_argument, NULL, 'e' },
+    { "storm-percent", required_argument, NULL, 'c' },
+    { "backend", required_argument, NULL, 'k' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 },
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "b:d:s:t:p:h", longOptions, NULL)) != -1) {
+    switch (option) {
+      case 'b': {
+        options.host = optarg;
+        size_t colon = options.host.rfind(':');
+        if (colon != std::string::npos) {
+          options.port = (uint16_t)atoi(options.host.c_str() + colon + 1);
+          options.host.resize(colon);
+        }
+        break;
+      }
+      case 'd': options.devices = atoi(optarg); break;
+      case 's': options.seconds = atoi(optarg); break;
+      case 't': options.threads = atoi(optarg); break;
+      case 'p': options.profiles = atoi(optarg); break;
+      case 'a': options.stormAt = atoi(optarg); break;
+      case 'l': options.stormLength = atoi(optarg); break;
+      case 'e': options.stormEvery = atoi(optarg); break;
+      case 'c': options.stormPercent = atoi(optarg); break;
+      case 'k': options.backend = optarg; break;
+      default: return false;
+    }
+  }
+  if (options.devices < 1 || options.devices > 0xFFFFFF || options.seconds < 1 || options.profiles < 1) return false;
+  if (options.profiles > options.devices) options.profiles = options.devices;
+  if (options.threads <= 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+  if (options.threads > options.devices) options.threads = options.devices;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // One socket per device, plus the probe
+  rlimit files;
+  if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+  }
+
+  LoadClock::time_point recordStart = LoadClock::now();
+  profiles.resize(options.profiles);
+  size_t recorded = 0;
+  for (int p = 0; p < options.profiles; p++) {
+    recordProfile(p);
+    recorded += profiles[p].entries.size();
+  }
+  indexProfiles();
+  printf("recorded %d profiles x %d s: %lu publishes on %lu topics in %lld ms\n", options.profiles, options.seconds,
+    (unsigned long)recorded, (unsigned long)suffixes.size(),
+    (long long)std::chrono::duration_cast<std::chrono::milliseconds>(LoadClock::now() - recordStart).count());
+
+  fleet.resize(options.devices);
+  uint64_t scheduled = 0;
+  for (int d = 0; d < options.devices; d++) {
+    uint8_t mac[6] = { 0x24, 0x6f, 0x28, (uint8_t)(d >> 16), (uint8_t)(d >> 8), (uint8_t)d };
+    deviceIdFromMac(mac, fleet[d].id, sizeof(fleet[d].id));
+    fleet[d].profile = d % options.profiles;
+    fleet[d].offsetMs = (uint32_t)(((uint64_t)d * 7919) % 1000);
+    fleetIndex[fleet[d].id] = d;
+    scheduled += profiles[fleet[d].profile].entries.size();
+  }
+
+  int probeFd = connectProbe();
+  if (probeFd < 0) {
+    fprintf(stderr, "ERROR: cannot reach the broker at %s:%u\n", options.host.c_str(), options.port);
+    return 1;
+  }
+  IngestStats ingestBefore = fetchIngestStats(true); // Zeroes the backend's counters
+  if (!options.backend.empty() && !ingestBefore.valid) {
+    fprintf(stderr, "WARNING: no /api/ingest-stats at %s, backend lag not reported\n", options.backend.c_str());
+  }
+
+  // Connect everything first, then start the clock for all at once
+  std::vector<WorkerStats> workerStats(options.threads);
+  std::vector<std::thread> workers;
+  LoadClock::time_point connectStart = LoadClock::now();
+  for (int t = 0; t < options.threads; t++) {
+    int begin = (int)((int64_t)options.devices * t / options.threads);
+    int end = (int)((int64_t)options.devices * (t + 1) / options.threads);
+    workers.emplace_back(workerTask, begin, end, &workerStats[t]);
+  }
+  while (connectedWorkers.load() < options.threads) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  uint32_t connectFailures = 0;
+  for (WorkerStats& stats : workerStats) connectFailures += stats.connectFailures;
+  printf("connected %d devices in %lld ms (%u failed), %d threads\n", options.devices - (int)connectFailures,
+    (long long)std::chrono::duration_cast<std::chrono::milliseconds>(LoadClock::now() - connectStart).count(),
+    connectFailures, options.threads);
+
+  ProbeStats probeStats;
+  runStart = LoadClock::now() + std::chrono::milliseconds(100);
+  running.store(true, std::memory_order_release);
+  std::thread probe(probeTask, probeFd, &probeStats);
+
+  // Progress every 5 s, then a grace period for the last deliveries
+  const int endSecond = options.seconds + 2;
+  uint64_t lastPublished = 0;
+  for (int second = 0; second < endSecond;) {
+    int previous = second;
+    second = std::min(second + 5, endSecond);
+    std::this_thread::sleep_until(runStart + std::chrono::seconds(second));
+    uint64_t published = 0;
+    for (WorkerStats& stats : workerStats) published += stats.published.load(std::memory_order_relaxed);
+    printf("  %3d s  %8lu published  %7.0f msg/s  %8lu delivered\n", second, (unsigned long)published,
+      (published - lastPublished) / (double)(second - previous),
+      (unsigned long)probeStats.received.load(std::memory_order_relaxed));
+    lastPublished = published;
+  }
+  stopping.store(true);
+  for (std::thread& worker : workers) worker.join();
+  probe.join();
+  mqttWireClose(probeFd);
+  IngestStats ingestAfter = fetchIngestStats(false);
+
+  uint64_t published = 0, bytes = 0, acked = 0, qos1 = 0;
+  uint32_t disconnects = 0;
+  std::vector<uint32_t> sendLag, ackLatency;
+  for (WorkerStats& stats : workerStats) {
+    published += stats.published.load();
+    bytes += stats.bytes;
+    acked += stats.acked;
+    disconnects += stats.disconnects;
+    sendLag.insert(sendLag.end(), stats.sendLagMicros.begin(), stats.sendLagMicros.end());
+    ackLatency.insert(ackLatency.end(), stats.ackMicros.begin(), stats.ackMicros.end());
+  }
+  for (const VirtualDevice& device : fleet) {
+    const Profile& profile = profiles[device.profile];
+    for (size_t i = 0; i < device.next; i++) qos1 += profile.entries[i].qos1;
+  }
+
+  printf("\n=== fleet load: %d devices, %d s, broker %s:%u ===\n", options.devices, options.seconds,
+    options.host.c_str(), options.port);
+  printf("  published   %lu of %lu scheduled (%.0f msg/s, %.1f KB/s), %u disconnects\n",
+    (unsigned long)published, (unsigned long)scheduled, published / (double)options.seconds,
+    bytes / 1024.0 / options.seconds, disconnects);
+  printf("  qos 1       %lu acked of %lu\n", (unsigned long)acked, (unsigned long)qos1);
+  printf("  delivered   %lu matched, %lu lost, %lu not ours\n", (unsigned long)probeStats.matched,
+    (unsigned long)probeStats.lost, (unsigned long)probeStats.unmatched);
+  printLatency("send lag", sendLag);
+  printLatency("end to end", probeStats.latencyMicros);
+  printLatency("alarms", probeStats.alarmMicros);
+  printLatency("puback", ackLatency);
+  if (ingestBefore.valid && ingestAfter.valid) { // Counted from the reset at the start
+    double received = ingestAfter.received;
+    double inserted = ingestAfter.inserted;
+    printf("  backend     %.0f received, %.0f rows (%.1f rows/s), insert lag avg %.1f ms max %.1f ms, "
+           "event loop p99 %.1f ms\n",
+      received, inserted, inserted / options.seconds,
+      ingestAfter.insertLagAvgMs, ingestAfter.insertLagMaxMs, ingestAfter.eventLoopP99Ms);
+  }
+  return connectFailures == 0 && disconnects == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#include "mqtt_wire.h"
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+int mqttWireConnect(const char* host, uint16_t port) {
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* found = NULL;
+  if (getaddrinfo(host, service, &hints, &found) != 0) return -1;
+
+  int fd = -1;
+  for (addrinfo* at = found; at != NULL && fd < 0; at = at->ai_next) {
+    fd = socket(at->ai_family, at->ai_socktype, at->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, at->ai_addr, at->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(found);
+  if (fd >= 0) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // The firmware's small publishes go out at once too
+  }
+  return fd;
+}
+
+bool mqttWireSend(int fd, const uint8_t* data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent <= 0) return false;
+    data += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+void mqttWireClose(int fd) {
+  if (fd >= 0) close(fd);
+}
+
+// --- PACKET BUILDERS ---
+// Fixed header: type/flags and the variable-length "remaining length"
+static size_t fixedHeader(uint8_t* out, uint8_t typeAndFlags, size_t remaining) {
+  size_t length = 0;
+  out[length++] = typeAndFlags;
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    out[length++] = remaining > 0 ? digit | 0x80 : digit;
+  } while (remaining > 0);
+  return length;
+}
+
+static size_t putString(uint8_t* out, const char* text, size_t length) {
+  out[0] = (uint8_t)(length >> 8);
+  out[1] = (uint8_t)length;
+  memcpy(out + 2, text, length);
+  return 2 + length;
+}
+
+size_t mqttWireConnectPacket(uint8_t* out, size_t size, const char* clientId, uint16_t keepAliveSeconds) {
+  size_t idLength = strlen(clientId);
+  size_t remaining = 10 + 2 + idLength;
+  if (size < 5 + remaining) return 0;
+  size_t length = fixedHeader(out, MQTT_CONNECT << 4, remaining);
+  length += putString(out + length, "MQTT", 4);
+  out[length++] = 4;    // 3.1.1
+  out[length++] = 0x02; // Clean session
+  out[length++] = (uint8_t)(keepAliveSeconds >> 8);
+  out[length++] = (uint8_t)keepAliveSeconds;
+  length += putString(out + length, clientId, idLength);
+  return length;
+}
+
+size_t mqttWirePublishPacket(uint8_t* out, size_t size, const char* topic,
+  const uint8_t* payload, size_t payloadLength, uint16_t packetId) {
+  size_t topicLength = strlen(topic);
+  size_t remaining = 2 + topicLength + (packetId != 0 ? 2 : 0) + payloadLength;
+  if (size < 5 + remaining) return 0;
+  size_t length = fixedHeader(out, MQTT_PUBLISH << 4 | (packetId != 0 ? 0x02 : 0), remaining);
+  length += putString(out + length, topic, topicLength);
+  if (packetId != 0) {
+    out[length++] = (uint8_t)(packetId >> 8);
+    out[length++] = (uint8_t)packetId;
+  }
+  memcpy(out + length, payload, payloadLength);
+  return length + payloadLength;
+}
+
+size_t mqttWireSubscribePacket(uint8_t* out, size_t size, uint16_t packetId, const char* filter, uint8_t qos) {
+  size_t filterLength = strlen(filter);
+  size_t remaining = 2 + 2 + filterLength + 1;
+  if (size < 5 + remaining) return 0;
+  size_t length = fixedHeader(out, MQTT_SUBSCRIBE << 4 | 0x02, remaining);
+  out[length++] = (uint8_t)(packetId >> 8);
+  out[length++] = (uint8_t)packetId;
+  length += putString(out + length, filter, filterLength);
+  out[length++] = qos;
+  return length;
+}
+
+size_t mqttWirePingPacket(uint8_t* out, size_t size) {
+  if (size < 2) return 0;
+  return fixedHeader(out, MQTT_PINGREQ << 4, 0);
+}
+
+size_t mqttWireDisconnectPacket(uint8_t* out, size_t size) {
+  if (size < 2) return 0;
+  return fixedHeader(out, MQTT_DISCONNECT << 4, 0);
+}
+
+// --- PARSER ---
+bool mqttWireRead(int fd, MqttReader& reader, int timeoutMs) {
+  if (reader.start > 0) { // Drop what was parsed already
+    reader.buffer.erase(reader.buffer.begin(), reader.buffer.begin() + reader.start);
+    reader.start = 0;
+  }
+  pollfd wait = { fd, POLLIN, 0 };
+  if (poll(&wait, 1, timeoutMs) <= 0) return true;
+
+  uint8_t chunk[4096];
+  for (;;) {
+    ssize_t received = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received == 0) return false;
+    if (received < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    reader.buffer.insert(reader.buffer.end(), chunk, chunk + received);
+    if ((size_t)received < sizeof(chunk)) return true;
+  }
+}
+
+bool mqttWireNextPacket(MqttReader& reader, MqttPacket& packet) {
+  const uint8_t* data = reader.buffer.data() + reader.start;
+  size_t available = reader.buffer.size() - reader.start;
+  if (available < 2) return false;
+
+  size_t remaining = 0, header = 1;
+  for (int shift = 0; ; shift += 7) {
+    if (header >= available) return false;
+    uint8_t digit = data[header++];
+    remaining |= (size_t)(digit & 0x7F) << shift;
+    if (!(digit & 0x80)) break;
+    if (shift >= 21) return false; // Malformed; the broker would have closed us
+  }
+  if (available < header + remaining) return false;
+
+  packet.type = data[0] >> 4;
+  packet.flags = data[0] & 0x0F;
+  packet.body = data + header;
+  packet.length = remaining;
+  reader.start += header + remaining;
+  return true;
+}
+
+bool mqttWireParsePublish(const MqttPacket& packet, const char*& topic, size_t& topicLength,
+  const uint8_t*& payload, size_t& payloadLength) {
+  if (packet.type != MQTT_PUBLISH || packet.length < 2) return false;
+  topicLength = (size_t)packet.body[0] << 8 | packet.body[1];
+  size_t idLength = (packet.flags & 0x06) != 0 ? 2 : 0;
+  if (packet.length < 2 + topicLength + idLength) return false;
+  topic = (const char*)packet.body + 2;
+  payload = packet.body + 2 + topicLength + idLength;
+  payloadLength = packet.length - 2 - topicLength - idLength;
+  return true;
+}
+
+uint16_t mqttWirePacketId(const MqttPacket& packet) {
+  if (packet.length < 2) return 0;
+  return (uint16_t)(packet.body[0] << 8 | packet.body[1]);
+}
@@ -0,0 +1,59 @@
+#ifndef MQTT_WIRE_H
+#define MQTT_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// --- MINIMAL MQTT 3.1.1 CLIENT ---
+// Only what the load generator needs: CONNECT, PUBLISH at QoS 0/1, SUBSCRIBE,
+// PINGREQ and DISCONNECT out, and a parser for whatever the broker sends back.
+// Plain TCP sockets; writes block, reads are drained by the caller's poll().
+
+enum MqttPacketType : uint8_t {
+  MQTT_CONNECT = 1,
+  MQTT_CONNACK = 2,
+  MQTT_PUBLISH = 3,
+  MQTT_PUBACK = 4,
+  MQTT_SUBSCRIBE = 8,
+  MQTT_SUBACK = 9,
+  MQTT_PINGREQ = 12,
+  MQTT_PINGRESP = 13,
+  MQTT_DISCONNECT = 14,
+};
+
+struct MqttPacket {
+  uint8_t type;
+  uint8_t flags;       // Low nibble of the fixed header (QoS of a PUBLISH)
+  const uint8_t* body; // Valid until the next mqttWireRead()
+  size_t length;
+};
+
+// Bytes received but not parsed yet
+struct MqttReader {
+  std::vector<uint8_t> buffer;
+  size_t start = 0;
+};
+
+int mqttWireConnect(const char* host, uint16_t port); // Socket, or -1
+bool mqttWireSend(int fd, const uint8_t* data, size_t length);
+void mqttWireClose(int fd);
+
+// Packet builders: bytes written to out, 0 if it is too small
+size_t mqttWireConnectPacket(uint8_t* out, size_t size, const char* clientId, uint16_t keepAliveSeconds);
+size_t mqttWirePublishPacket(uint8_t* out, size_t size, const char* topic,
+  const uint8_t* payload, size_t length, uint16_t packetId); // packetId 0 = QoS 0
+size_t mqttWireSubscribePacket(uint8_t* out, size_t size, uint16_t packetId, const char* filter, uint8_t qos);
+size_t mqttWirePingPacket(uint8_t* out, size_t size);
+size_t mqttWireDisconnectPacket(uint8_t* out, size_t size);
+
+// Reads what the socket has (waiting up to timeoutMs if nothing); false once it closed
+bool mqttWireRead(int fd, MqttReader& reader, int timeoutMs);
+bool mqttWireNextPacket(MqttReader& reader, MqttPacket& packet);
+
+// PUBLISH body: topic (not terminated) and payload
+bool mqttWireParsePublish(const MqttPacket& packet, const char*& topic, size_t& topicLength,
+  const uint8_t*& payload, size_t& payloadLength);
+uint16_t mqttWirePacketId(const MqttPacket& packet); // PUBACK / SUBACK
+
+#endif